@@ -0,0 +1,212 @@
+#include "Checkpoint.h"
+#include "Lexer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Identifies checkpoint files (the trailing digit is the format version)
+static const char checkpointMagic[8] = {'S', 'K', 'L', 'X', 'C', 'K', 'P', '1'};
+
+// Fixed-size header written in front of the checkpoints
+typedef struct {
+    char magic[8];                  // Must match checkpointMagic
+    int wcharSize;                  // sizeof(wchar_t) of the writer, tables are stored raw
+    int interval;                   // Characters between checkpoints
+    int count;                      // Number of checkpoints that follow
+    int tableCounts[3];             // Used rows of the variable, function and class tables
+    long long sourceLength;         // Length of the indexed input
+    unsigned long long sourceHash;  // Hash of the indexed input
+} CheckpointFileHeader;
+
+// Prepare an empty index that records a checkpoint every intervalKB KB
+void initCheckpointIndex(LexerCheckpointIndex *index, int intervalKB) {
+    memset(index, 0, sizeof(*index));
+    if (intervalKB <= 0) {
+        intervalKB = CHECKPOINT_INTERVAL_KB;
+    }
+    index->interval = intervalKB * 1024;
+}
+
+// Release the checkpoint array of an index
+void freeCheckpointIndex(LexerCheckpointIndex *index) {
+    free(index->checkpoints);
+    index->checkpoints = NULL;
+    index->count = 0;
+    index->capacity = 0;
+}
+
+// Append a checkpoint, growing the array geometrically
+int recordCheckpoint(LexerCheckpointIndex *index, const LexerCheckpoint *checkpoint) {
+    if (index->count == index->capacity) {
+        int newCapacity = index->capacity ? index->capacity * 2 : 64;
+        LexerCheckpoint *grown = realloc(index->checkpoints, newCapacity * sizeof(LexerCheckpoint));
+        if (!grown) {
+            fprintf(stderr, "Memory allocation failed for checkpoints!\n");
+            return 0;
+        }
+        index->checkpoints = grown;
+        index->capacity = newCapacity;
+    }
+    index->checkpoints[index->count++] = *checkpoint;
+    return 1;
+}
+
+// Hash the input text (FNV-1a) and report its length in characters
+unsigned long long hashInput(const wchar_t *input, long int *length) {
+    unsigned long long hash = 14695981039346656037ULL;
+    long int i = 0;
+    for (; input[i] != L'\0'; i++) {
+        hash ^= (unsigned long long)(unsigned int)input[i];
+        hash *= 1099511628211ULL;
+    }
+    if (length) {
+        *length = i;
+    }
+    return hash;
+}
+
+// Copy the lexer's declaration tables into the index at the end of the first pass
+void captureDeclarationTables(LexerCheckpointIndex *index, const wchar_t *input) {
+    memcpy(index->variables, variables, sizeof(index->variables));
+    memcpy(index->functions, functions, sizeof(index->functions));
+    memcpy(index->class_variables, class_variables, sizeof(index->class_variables));
+    index->variable_count = variable_count;
+    index->function_count = function_count;
+    index->class_variable_count = class_variable_count;
+    index->sourceHash = hashInput(input, &index->sourceLength);
+}
+
+// Binary search for the last checkpoint on a line before the given one. Checkpoints
+// are taken at whatever token boundary follows each interval, so one on the line
+// itself may sit in its middle; the lexer skips ahead to the line's start instead
+const LexerCheckpoint *findCheckpointForLine(const LexerCheckpointIndex *index, int line) {
+    int low = 0, high = index->count - 1, found = -1;
+    while (low <= high) {
+        int mid = low + (high - low) / 2;
+        if (index->checkpoints[mid].line < line) {
+            found = mid;
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return found >= 0 ? &index->checkpoints[found] : NULL;
+}
+
+// Load the lexer's declaration tables so that lexing can resume at the checkpoint.
+// The tables are append-only, so truncating the final tables to the recorded
+// counts reproduces exactly what the lexer had seen at that offset.
+void restoreCheckpoint(const LexerCheckpointIndex *index, const LexerCheckpoint *checkpoint) {
+    memcpy(variables, index->variables, sizeof(index->variables));
+    memcpy(functions, index->functions, sizeof(index->functions));
+    memcpy(class_variables, index->class_variables, sizeof(index->class_variables));
+    variable_count = checkpoint->variable_count;
+    function_count = checkpoint->function_count;
+    class_variable_count = checkpoint->class_variable_count;
+}
+
+// Write the index to disk: header, checkpoints, then the used table rows
+int saveCheckpointIndex(const LexerCheckpointIndex *index, const char *path) {
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Error: Unable to write checkpoint file %s\n", path);
+        return 0;
+    }
+
+    CheckpointFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, checkpointMagic, sizeof(header.magic));
+    header.wcharSize = (int)sizeof(wchar_t);
+    header.interval = index->interval;
+    header.count = index->count;
+    header.tableCounts[0] = index->variable_count;
+    header.tableCounts[1] = index->function_count;
+    header.tableCounts[2] = index->class_variable_count;
+    header.sourceLength = index->sourceLength;
+    header.sourceHash = index->sourceHash;
+
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    if (ok && index->count > 0) {
+        ok = fwrite(index->checkpoints, sizeof(LexerCheckpoint), index->count, file) == (size_t)index->count;
+    }
+    if (ok && index->variable_count > 0) {
+        ok = fwrite(index->variables, sizeof(index->variables[0]), index->variable_count, file) ==
+             (size_t)index->variable_count;
+    }
+    if (ok && index->function_count > 0) {
+        ok = fwrite(index->functions, sizeof(index->functions[0]), index->function_count, file) ==
+             (size_t)index->function_count;
+    }
+    if (ok && index->class_variable_count > 0) {
+        ok = fwrite(index->class_variables, sizeof(index->class_variables[0]), index->class_variable_count, file) ==
+             (size_t)index->class_variable_count;
+    }
+
+    if (fclose(file) != 0) {
+        ok = 0;
+    }
+    if (!ok) {
+        fprintf(stderr, "Error: Failed to write checkpoint file %s\n", path);
+    }
+    return ok;
+}
+
+// Read an index from disk and check that it was built from this input
+int loadCheckpointIndex(LexerCheckpointIndex *index, const char *path, const wchar_t *input) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return 0;  // No index yet - not an error
+    }
+
+    CheckpointFileHeader header;
+    long int length = 0;
+    unsigned long long hash = hashInput(input, &length);
+
+    // Reject files from another format, platform or version of the input
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, checkpointMagic, sizeof(header.magic)) != 0 ||
+        header.wcharSize != (int)sizeof(wchar_t) ||
+        header.count < 0 || header.interval <= 0 ||
+        header.tableCounts[0] < 0 || header.tableCounts[0] > 100 ||
+        header.tableCounts[1] < 0 || header.tableCounts[1] > 100 ||
+        header.tableCounts[2] < 0 || header.tableCounts[2] > 100 ||
+        header.sourceLength != length || header.sourceHash != hash) {
+        fclose(file);
+        return 0;
+    }
+
+    initCheckpointIndex(index, 1);
+    index->interval = header.interval;
+    index->sourceLength = (long int)header.sourceLength;
+    index->sourceHash = header.sourceHash;
+    index->variable_count = header.tableCounts[0];
+    index->function_count = header.tableCounts[1];
+    index->class_variable_count = header.tableCounts[2];
+
+    int ok = 1;
+    if (header.count > 0) {
+        index->checkpoints = malloc(header.count * sizeof(LexerCheckpoint));
+        ok = index->checkpoints &&
+             fread(index->checkpoints, sizeof(LexerCheckpoint), header.count, file) == (size_t)header.count;
+        index->count = index->capacity = ok ? header.count : 0;
+    }
+    if (ok && index->variable_count > 0) {
+        ok = fread(index->variables, sizeof(index->variables[0]), index->variable_count, file) ==
+             (size_t)index->variable_count;
+    }
+    if (ok && index->function_count > 0) {
+        ok = fread(index->functions, sizeof(index->functions[0]), index->function_count, file) ==
+             (size_t)index->function_count;
+    }
+    if (ok && index->class_variable_count > 0) {
+        ok = fread(index->class_variables, sizeof(index->class_variables[0]), index->class_variable_count, file) ==
+             (size_t)index->class_variable_count;
+    }
+    fclose(file);
+
+    if (!ok) {
+        fprintf(stderr, "Error: Corrupt checkpoint file %s\n", path);
+        freeCheckpointIndex(index);
+    }
+    return ok;
+}
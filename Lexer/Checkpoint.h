@@ -0,0 +1,73 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <wchar.h>
+
+// Default distance between two checkpoints, in KB of source characters
+#define CHECKPOINT_INTERVAL_KB 64
+
+// Checkpoint files live next to the source file with this suffix appended
+#define CHECKPOINT_FILE_SUFFIX ".ckpt"
+
+// A snapshot of everything the lexer needs to resume at a given position.
+// Checkpoints are only taken between tokens, so the lexer is never inside a
+// (possibly nested) comment or string at a checkpoint and no depth has to be saved.
+// The declaration tables only ever grow during a pass, so instead of copying them
+// a checkpoint remembers how many entries each table had at that point.
+typedef struct {
+    int offset;                          // Position in the wide-character input
+    int line;                            // Line number (1-based) at that position
+    unsigned char isVariable;            // Pending पूर्ण context flag
+    unsigned char isClassVariable;       // Pending कक्षा context flag
+    unsigned char isFunction;            // Pending कर्म context flag
+    unsigned char variable_count;        // Number of declared variables so far
+    unsigned char function_count;        // Number of declared functions so far
+    unsigned char class_variable_count;  // Number of declared class variables so far
+} LexerCheckpoint;
+
+// All checkpoints of one input plus the declaration tables as they were at the
+// end of the first pass. Restoring a checkpoint truncates these tables.
+typedef struct {
+    LexerCheckpoint *checkpoints;        // Checkpoints in increasing offset order
+    int count;                           // Number of recorded checkpoints
+    int capacity;                        // Allocated checkpoint slots
+    int interval;                        // Characters between checkpoints
+    long int sourceLength;               // Length of the indexed input (characters)
+    unsigned long long sourceHash;       // Hash of the indexed input, to detect stale files
+    wchar_t variables[100][100];         // Final variable table
+    wchar_t functions[100][100];         // Final function table
+    wchar_t class_variables[100][100];   // Final class variable table
+    int variable_count;                  // Entries used in each table
+    int function_count;
+    int class_variable_count;
+} LexerCheckpointIndex;
+
+// Prepare an empty index that records a checkpoint every intervalKB KB
+void initCheckpointIndex(LexerCheckpointIndex *index, int intervalKB);
+
+// Release the checkpoint array of an index
+void freeCheckpointIndex(LexerCheckpointIndex *index);
+
+// Append a checkpoint (offsets must be increasing). Returns 1 on success, 0 on failure
+int recordCheckpoint(LexerCheckpointIndex *index, const LexerCheckpoint *checkpoint);
+
+// Copy the lexer's declaration tables into the index at the end of the first pass
+void captureDeclarationTables(LexerCheckpointIndex *index, const wchar_t *input);
+
+// Find the last checkpoint on an earlier line than the given one (NULL if none)
+const LexerCheckpoint *findCheckpointForLine(const LexerCheckpointIndex *index, int line);
+
+// Load the lexer's declaration tables so that lexing can resume at the checkpoint
+void restoreCheckpoint(const LexerCheckpointIndex *index, const LexerCheckpoint *checkpoint);
+
+// Write the index to disk. Returns 1 on success, 0 on failure
+int saveCheckpointIndex(const LexerCheckpointIndex *index, const char *path);
+
+// Read an index from disk and check that it was built from this input.
+// Returns 1 on success, 0 if the file is missing, corrupt or stale
+int loadCheckpointIndex(LexerCheckpointIndex *index, const char *path, const wchar_t *input);
+
+// Hash the input text (FNV-1a) and report its length in characters
+unsigned long long hashInput(const wchar_t *input, long int *length);
+
+#endif // CHECKPOINT_H
@@ -4,6 +4,7 @@
 #include <wctype.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdarg.h>
 
 // Global arrays to track declared identifiers
 // These help determine token types for identifiers based on previous declarations
@@ -60,23 +61,80 @@ int isClassVariableDeclared(const wchar_t *word) {
     return 0;
 }
 
+// Token output is switched off while lexing outside the requested lines
+// (or during a silent indexing pass); errors are always reported
+static int printTokens = 1;
+
+// printf wrapper used for token output
+static void lexPrint(const char *format, ...) {
+    if (!printTokens) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
 // Main tokenization function - processes the input text and identifies tokens
 // This is the core of the lexical analyzer
 void tokenize(const wchar_t *input) {
+    LexerPass pass = {0};
+    tokenizePass(input, &pass);
+}
+
+// Run the lexer over the input as described by pass: optionally resume from a
+// checkpoint, only print tokens on a range of lines, and record checkpoints
+void tokenizePass(const wchar_t *input, const LexerPass *pass) {
     int i = 0;                                  // Current position in input
-    long int line = 1, column = 1;              // Track line and column for error reporting
+    int line = 1;                               // Line of the current position
+    int scanned = 0;                            // Newlines have been counted up to here
     int isVariable = 0, isClassVariable = 0, isFunction = 0;  // Context flags
-    
-    printf("\nLexical Analysis:\n");
+    int nextCheckpoint = 0;                     // Offset at which to record the next checkpoint
+    int reachedEnd = 1;                         // Cleared when we stop after lastLine
+    LexerCheckpointIndex *index = pass->index;  // Where checkpoints are recorded (may be NULL)
+
+    // Resume from a checkpoint: restore position and declaration context
+    if (pass->start) {
+        i = scanned = pass->start->offset;
+        line = pass->start->line;
+        isVariable = pass->start->isVariable;
+        isClassVariable = pass->start->isClassVariable;
+        isFunction = pass->start->isFunction;
+    }
+
+    printTokens = !pass->quiet && pass->firstLine <= line;
+    if (printTokens && !pass->start) {
+        printf("\nLexical Analysis:\n");
+    }
     while (input[i] != L'\0') {                 // Process until end of input
         wchar_t c = input[i];                   // Current character
 
-        // Track line and column numbers for error reporting
-        if (c == L'\n') {
-            line++;
-            column = 1;
-        } else {
-            column++;
+        // Track line numbers, including newlines inside comments and strings
+        while (scanned < i) {
+            if (input[scanned++] == L'\n') {
+                line++;
+            }
+        }
+        if (pass->lastLine > 0 && line > pass->lastLine) {
+            reachedEnd = 0;
+            break;
+        }
+        printTokens = !pass->quiet && line >= pass->firstLine;
+
+        // Record a checkpoint between tokens once enough text has been lexed
+        if (index && i >= nextCheckpoint) {
+            LexerCheckpoint checkpoint = {
+                i, line,
+                (unsigned char)isVariable, (unsigned char)isClassVariable, (unsigned char)isFunction,
+                (unsigned char)variable_count, (unsigned char)function_count,
+                (unsigned char)class_variable_count
+            };
+            if (!recordCheckpoint(index, &checkpoint)) {
+                index = NULL;  // Out of memory - finish the pass without an index
+            } else {
+                nextCheckpoint = i + index->interval;
+            }
         }
 
         // Skip whitespace characters
@@ -84,7 +142,6 @@ void tokenize(const wchar_t *input) {
             i++;
             continue;
         }
-
         // Handle single-line comments (// style)
         if (c == L'/' && input[i + 1] == L'/') {
             handleComment(input, &i, 0);
@@ -143,20 +200,28 @@ void tokenize(const wchar_t *input) {
         // Handle unknown characters that don't match any pattern
         wchar_t unknown[2] = {c, L'\0'};
         Token token = createToken(TOKEN_UNKNOWN, unknown);
-        printf("Unknown: %ls\n", token.value);
+        lexPrint("Unknown: %ls\n", token.value);
         i++;
     }
 
     // Create and output the end-of-file token
-    Token eofToken = createToken(TOKEN_EOF, L"EOF");
-    printf("End of Input: %ls\n", eofToken.value);
+    if (reachedEnd) {
+        Token eofToken = createToken(TOKEN_EOF, L"EOF");
+        lexPrint("End of Input: %ls\n", eofToken.value);
+    }
+
+    // The first pass ends with the declaration tables the checkpoints refer to
+    if (index) {
+        captureDeclarationTables(index, input);
+    }
+    printTokens = 1;
 }
 
 // Process character literals (single characters in single quotes)
 void handleCharLiteral(const wchar_t *input, int *i) {
     wchar_t buffer[2] = {input[*i], L'\0'};
     Token token = createToken(TOKEN_wchar_t, buffer);
-    printf("Character Literal: '%ls'\n", token.value);
+    lexPrint("Character Literal: '%ls'\n", token.value);
     (*i)++;
 }
 
@@ -221,7 +286,7 @@ void handleComment(const wchar_t *input, int *i, int isMultiLine) {
     
     // Create and output the comment token
     Token token = createToken(TOKEN_COMMENT, buffer);
-    printf("%s Comment: %ls\n", isMultiLine ? "Multi-line" : "Single-line", token.value);
+    lexPrint("%s Comment: %ls\n", isMultiLine ? "Multi-line" : "Single-line", token.value);
 }
 
 // Process operators (+, -, *, /, ==, !=, etc.)
@@ -237,7 +302,7 @@ void handleOperator(const wchar_t *input, int *i) {
     
     // Create and output the operator token
     Token token = createToken(TOKEN_OPERATOR, operatorStr);
-    printf("Operator: %ls\n", token.value);
+    lexPrint("Operator: %ls\n", token.value);
     (*i)++;
 }
 
@@ -249,10 +314,10 @@ void handleSpecialSymbol(const wchar_t *input, int *i) {
     // Special case: | is treated as end-of-line
     if (wcscmp(symbol, L"|") == 0) {
         token = createToken(TOKEN_EOL, symbol);
-        printf("End of Line: %ls\n", token.value);
+        lexPrint("End of Line: %ls\n", token.value);
     } else {
         token = createToken(TOKEN_SPECIAL_SYMBOL, symbol);
-        printf("Special Symbol: %ls\n", token.value);
+        lexPrint("Special Symbol: %ls\n", token.value);
     }
 
     (*i)++;
@@ -287,7 +352,7 @@ void handleString(const wchar_t *input, int *i) {
     
     // Create and output the string token
     Token token = createToken(TOKEN_STRING, buffer);
-    printf("String: \"%ls\"\n", token.value);
+    lexPrint("String: \"%ls\"\n", token.value);
 }
 
 // Process numeric literals (including Devanagari digits)
@@ -326,11 +391,11 @@ void handleNumber(const wchar_t *input, int *i) {
     if (isIdentifier) {
         // Treat as an unknown identifier (not a valid number)
         Token token = createToken(TOKEN_UNKNOWN, buffer);
-        printf("Unknown: %ls\n", token.value);
+        lexPrint("Unknown: %ls\n", token.value);
     } else if (hasDigits) {
         // It's a valid number
         Token token = createToken(TOKEN_NUMBER, buffer);
-        printf("Number: %ls\n", token.value);
+        lexPrint("Number: %ls\n", token.value);
     }
 }
 
@@ -357,7 +422,7 @@ void handleIdentifier(const wchar_t *input, int *i, int *isVariable, int *isClas
     // Check if it's a keyword (like पूर्ण, यदि, etc.)
     if (isKeyword(buffer)) {
         Token token = createToken(TOKEN_KEYWORD, buffer);
-        printf("Keyword: %ls\n", token.value);
+        lexPrint("Keyword: %ls\n", token.value);
 
         // Set context flags based on specific keywords
         // These flags affect how subsequent identifiers are processed
@@ -374,28 +439,28 @@ void handleIdentifier(const wchar_t *input, int *i, int *isVariable, int *isClas
     // Check if it's a boolean literal (सत्य or असत्य)
     if (isBooleanLiteral(buffer)) {
         Token token = createToken(TOKEN_BOOLEAN, buffer);
-        printf("Boolean: %ls\n", token.value);
+        lexPrint("Boolean: %ls\n", token.value);
         return;
     }
 
     // Check if it's a previously declared variable
     if (isVariableDeclared(buffer)) {
         Token token = createToken(TOKEN_VARIABLE, buffer);
-        printf("Variable: %ls\n", token.value);
+        lexPrint("Variable: %ls\n", token.value);
         return;
     }
 
     // Check if it's a previously declared class variable
     if (isClassVariableDeclared(buffer)) {
         Token token = createToken(TOKEN_CLASSED_VARIABLE, buffer);
-        printf("Class Variable: %ls\n", token.value);
+        lexPrint("Class Variable: %ls\n", token.value);
         return;
     }
 
     // Check if it's a previously declared function
     if (isFunctionDeclared(buffer)) {
         Token token = createToken(TOKEN_FUNCTION, buffer);
-        printf("Function: %ls\n", token.value);
+        lexPrint("Function: %ls\n", token.value);
         return;
     }
 
@@ -408,7 +473,7 @@ void handleIdentifier(const wchar_t *input, int *i, int *isVariable, int *isClas
         // Add to function list and create token
         wcscpy(functions[function_count++], buffer);
         Token token = createToken(TOKEN_FUNCTION, buffer);
-        printf("Function: %ls\n", token.value);
+        lexPrint("Function: %ls\n", token.value);
         *isFunction = 0;  // Reset the context flag
         return;
     }
@@ -422,7 +487,7 @@ void handleIdentifier(const wchar_t *input, int *i, int *isVariable, int *isClas
         // Add to class variable list and create token
         wcscpy(class_variables[class_variable_count++], buffer);
         Token token = createToken(TOKEN_CLASSED_VARIABLE, buffer);
-        printf("Class Variable: %ls\n", token.value);
+        lexPrint("Class Variable: %ls\n", token.value);
         *isClassVariable = 0;  // Reset the context flag
         return;
     }
@@ -437,12 +502,12 @@ void handleIdentifier(const wchar_t *input, int *i, int *isVariable, int *isClas
         // Add to variable list and create token
         wcscpy(variables[variable_count++], buffer);
         Token token = createToken(TOKEN_VARIABLE, buffer);
-        printf("Variable: %ls\n", token.value);
+        lexPrint("Variable: %ls\n", token.value);
         *isVariable = 0;  // Reset the context flag
         return;
     }
 
     // If nothing matched, treat it as an unknown identifier
     Token token = createToken(TOKEN_UNKNOWN, buffer);
-    printf("Unknown: %ls\n", token.value);
+    lexPrint("Unknown: %ls\n", token.value);
 }
\ No newline at end of file
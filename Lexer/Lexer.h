@@ -2,11 +2,24 @@
 #define LEXER_H
 
 #include "Tokens.h"  // For Token and TokenType definitions
+#include "Checkpoint.h"  // For resumable lexing
 #include <wchar.h>   // For wide character support
 
+// Describes one run of the lexer over an input
+typedef struct {
+    const LexerCheckpoint *start;   // Resume at this checkpoint (NULL = start of input)
+    int firstLine;                  // Only print tokens from this line on (0 = all)
+    int lastLine;                   // Stop after this line (0 = lex to the end)
+    int quiet;                      // Don't print any tokens
+    LexerCheckpointIndex *index;    // Record checkpoints into this index (NULL = don't)
+} LexerPass;
+
 // Main tokenization function - processes input text and identifies tokens
 void tokenize(const wchar_t *input);
 
+// Resumable tokenization - runs the lexer as described by pass
+void tokenizePass(const wchar_t *input, const LexerPass *pass);
+
 // Helper function prototypes (used internally in lexer.c)
 // These handle specific token types during lexical analysis
 void handleComment(const wchar_t *input, int *i, int isMultiLine);
@@ -2,9 +2,57 @@
 #include <stdlib.h>
 #include <wchar.h>
 #include <locale.h>
+#include <string.h>
 #include "file_io.h"
 #include "Lexer.h"
 
+// Lex the whole input silently, recording checkpoints into index
+static void buildCheckpointIndex(const wchar_t *program, LexerCheckpointIndex *index) {
+    LexerPass pass = {0};
+    pass.quiet = 1;
+    pass.index = index;
+    initCheckpointIndex(index, CHECKPOINT_INTERVAL_KB);
+    tokenizePass(program, &pass);
+}
+
+// Print the tokens of one line, resuming from the nearest checkpoint so that
+// only up to CHECKPOINT_INTERVAL_KB of text has to be lexed before it
+static void tokenizeLine(const char *filename, const wchar_t *program, int line) {
+    // Checkpoints are stored next to the source file
+    char *indexPath = malloc(strlen(filename) + sizeof(CHECKPOINT_FILE_SUFFIX));
+    if (!indexPath) {
+        printf("Memory allocation failed!\n");
+        return;
+    }
+    sprintf(indexPath, "%s%s", filename, CHECKPOINT_FILE_SUFFIX);
+
+    // Build (and save) the index on first use or when the file has changed
+    LexerCheckpointIndex *index = malloc(sizeof(LexerCheckpointIndex));
+    if (!index) {
+        printf("Memory allocation failed!\n");
+        free(indexPath);
+        return;
+    }
+    if (!loadCheckpointIndex(index, indexPath, program)) {
+        buildCheckpointIndex(program, index);
+        saveCheckpointIndex(index, indexPath);
+    }
+
+    LexerPass pass = {0};
+    pass.start = findCheckpointForLine(index, line);
+    pass.firstLine = line;
+    pass.lastLine = line;
+    if (pass.start) {
+        restoreCheckpoint(index, pass.start);
+    }
+    printf("\nLexical Analysis (line %d):\n", line);
+    tokenizePass(program, &pass);
+
+    freeCheckpointIndex(index);
+    free(index);
+    free(indexPath);
+}
+
 int main(int argc, char *argv[]) {
     // Try to set locale for Unicode/Devanagari support
     // We try multiple locales in case some aren't available on the system
@@ -22,17 +70,49 @@ int main(int argc, char *argv[]) {
     
     // Check for command line arguments
     if (argc < 2) {
-        printf("Usage: %s <filename>\n", argv[0]);
+        printf("Usage: %s <filename> [--index | --line <number>]\n", argv[0]);
         return 1;
     }
 
+    // Optional modes: build the checkpoint index, or lex a single line
+    int buildIndex = argc >= 3 && strcmp(argv[2], "--index") == 0;
+    int line = 0;
+    if (argc >= 4 && strcmp(argv[2], "--line") == 0) {
+        line = atoi(argv[3]);
+        if (line <= 0) {
+            printf("Error: Line numbers start at 1\n");
+            return 1;
+        }
+    }
+
     // Read the input file into a wide character buffer
     wchar_t *program = readFile(argv[1]);
     if (program) {
         printf("\n");
         
-        // Process the input and identify tokens
-        tokenize(program);
+        if (buildIndex) {
+            // Write <filename>.ckpt for later --line lookups
+            LexerCheckpointIndex *index = malloc(sizeof(LexerCheckpointIndex));
+            char *indexPath = malloc(strlen(argv[1]) + sizeof(CHECKPOINT_FILE_SUFFIX));
+            if (index && indexPath) {
+                sprintf(indexPath, "%s%s", argv[1], CHECKPOINT_FILE_SUFFIX);
+                buildCheckpointIndex(program, index);
+                if (saveCheckpointIndex(index, indexPath)) {
+                    printf("Wrote %d checkpoints to %s\n", index->count, indexPath);
+                }
+                freeCheckpointIndex(index);
+            } else {
+                printf("Memory allocation failed!\n");
+            }
+            free(index);
+            free(indexPath);
+        } else if (line > 0) {
+            // Lex only the requested line
+            tokenizeLine(argv[1], program, line);
+        } else {
+            // Process the input and identify tokens
+            tokenize(program);
+        }
         
         // Clean up
         free(program);
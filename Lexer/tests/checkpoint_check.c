@@ -0,0 +1,126 @@
+// Checkpoint check
+// Lexing one line from a checkpoint (as --line does) must print exactly the
+// tokens that lexing the whole input from its start prints for that line. The
+// input has lines longer than the checkpoint interval, so checkpoints fall in
+// the middle of lines, and declarations after them, so the restored tables matter.
+// Each mismatch is printed; the exit status is 1 if there was one.
+//
+// Usage: checkpoint_check
+#define _POSIX_C_SOURCE 200809L
+#include "../Lexer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <locale.h>
+
+#define LONG_LINE_CHARS (CHECKPOINT_INTERVAL_KB * 1024 + 4096)
+
+// Text of the test input. Returns a malloc'd string (NULL if out of memory)
+static wchar_t *makeInput(int *lineCount) {
+    size_t size = 2 * LONG_LINE_CHARS + 1024;
+    wchar_t *text = malloc(size * sizeof(wchar_t));
+    if (!text) {
+        fprintf(stderr, "Memory allocation failed for the test input!\n");
+        return NULL;
+    }
+    size_t n = 0;
+    n += swprintf(text + n, size - n, L"पूर्ण क = 1|\nकर्म फ(पूर्ण ख) { लेख(ख)| }\nक = क");
+    while (n < LONG_LINE_CHARS) {
+        n += swprintf(text + n, size - n, L" + क * 2");
+    }
+    n += swprintf(text + n, size - n, L"|\nपूर्ण ग = क|\nलेख(\"शुरू\"");
+    while (n < 2 * LONG_LINE_CHARS) {
+        n += swprintf(text + n, size - n, L", ग, फ(ग), \"पाठ\"");
+    }
+    n += swprintf(text + n, size - n, L")|\nफ(ग)|\n");
+    *lineCount = 6;
+    return text;
+}
+
+// Run one pass with its output captured. Returns a malloc'd string (NULL on failure)
+static char *capturePass(const wchar_t *input, const LexerPass *pass) {
+    FILE *capture = tmpfile();
+    if (!capture) {
+        fprintf(stderr, "Error: Unable to create a temporary file\n");
+        return NULL;
+    }
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    dup2(fileno(capture), STDOUT_FILENO);
+    tokenizePass(input, pass);
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+
+    fseek(capture, 0, SEEK_END);
+    long size = ftell(capture);
+    char *output = size >= 0 ? malloc((size_t)size + 1) : NULL;
+    if (output) {
+        rewind(capture);
+        output[fread(output, 1, (size_t)size, capture)] = '\0';
+    } else {
+        fprintf(stderr, "Memory allocation failed for the lexer output!\n");
+    }
+    fclose(capture);
+    return output;
+}
+
+// Lex every line from a checkpoint index with checkpoints intervalKB KB apart
+// and compare with lexing from the start. Returns the number of mismatches
+static int checkInterval(const wchar_t *input, int lineCount, int intervalKB) {
+    LexerCheckpointIndex *index = malloc(sizeof(LexerCheckpointIndex));
+    if (!index) {
+        fprintf(stderr, "Memory allocation failed for the checkpoint index!\n");
+        return 1;
+    }
+    variable_count = function_count = class_variable_count = 0;
+    initCheckpointIndex(index, intervalKB);
+    LexerPass indexing = {0};
+    indexing.quiet = 1;
+    indexing.index = index;
+    tokenizePass(input, &indexing);
+
+    int failures = 0;
+    for (int line = 1; line <= lineCount; line++) {
+        LexerPass pass = {0};
+        pass.firstLine = line;
+        pass.lastLine = line;
+        variable_count = function_count = class_variable_count = 0;
+        char *expected = capturePass(input, &pass);
+
+        pass.start = findCheckpointForLine(index, line);
+        if (pass.start) {
+            restoreCheckpoint(index, pass.start);
+        } else {
+            variable_count = function_count = class_variable_count = 0;
+        }
+        char *actual = capturePass(input, &pass);
+        if (!expected || !actual || strcmp(expected, actual) != 0) {
+            failures++;
+            printf("FAIL line %d with checkpoints every %d KB (%d recorded): %zu bytes of output instead of %zu\n",
+                   line, intervalKB, index->count, actual ? strlen(actual) : 0, expected ? strlen(expected) : 0);
+        }
+        free(expected);
+        free(actual);
+    }
+    freeCheckpointIndex(index);
+    free(index);
+    return failures;
+}
+
+int main(void) {
+    if (setlocale(LC_ALL, "C.UTF-8") == NULL) {
+        setlocale(LC_ALL, "");
+    }
+    int lineCount = 0;
+    wchar_t *input = makeInput(&lineCount);
+    if (!input) {
+        return 1;
+    }
+    int failures = checkInterval(input, lineCount, CHECKPOINT_INTERVAL_KB);
+    failures += checkInterval(input, lineCount, 1);
+    free(input);
+    printf("checkpoint_check: %d of %d lines lexed differently\n", failures, 2 * lineCount);
+    return failures == 0 ? 0 : 1;
+}
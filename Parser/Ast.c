@@ -0,0 +1,365 @@
+#include "Ast.h"
+#include "Interner.h"
+#include "utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Field layout of every node kind (see AstKind for what each field means)
+const AstLayout astLayouts[AST_KIND_COUNT] = {
+    [AST_NONE]      = {"None", 0, 0, 0},
+    [AST_PROGRAM]   = {"Program", 0, 0, 1},
+    [AST_BLOCK]     = {"Block", 0, 0, 1},
+    [AST_VAR_DECL]  = {"VariableDeclaration", AST_FIELD_B, AST_FIELD_A | AST_FIELD_C, 0},
+    [AST_FUNC_DECL] = {"FunctionDeclaration", AST_FIELD_B | AST_FIELD_C, AST_FIELD_A, 0},
+    [AST_PARAMS]    = {"Parameters", 0, 0, 1},
+    [AST_CLASS_DECL]= {"ClassDeclaration", AST_FIELD_B, AST_FIELD_A, 0},
+    [AST_IF]        = {"IfStatement", AST_FIELD_A | AST_FIELD_B | AST_FIELD_C, 0, 0},
+    [AST_LOOP]      = {"LoopStatement", AST_FIELD_A | AST_FIELD_B | AST_FIELD_C, 0, 0},
+    [AST_WHILE]     = {"WhileStatement", AST_FIELD_A | AST_FIELD_B, 0, 0},
+    [AST_PRINT]     = {"PrintStatement", 0, 0, 1},
+    [AST_INPUT]     = {"InputStatement", AST_FIELD_A, 0, 0},
+    [AST_EXPR_STMT] = {"ExpressionStatement", AST_FIELD_A, 0, 0},
+    [AST_NUMBER]    = {"Number", 0, 0, 0},
+    [AST_STRING]    = {"String", 0, AST_FIELD_A, 0},
+    [AST_CHAR]      = {"Character", 0, 0, 0},
+    [AST_BOOL]      = {"Boolean", 0, 0, 0},
+    [AST_IDENT]     = {"Identifier", 0, AST_FIELD_A, 0},
+    [AST_UNARY]     = {"UnaryExpression", AST_FIELD_A, 0, 0},
+    [AST_BINARY]    = {"BinaryExpression", AST_FIELD_A | AST_FIELD_B, 0, 0},
+    [AST_ASSIGN]    = {"Assignment", AST_FIELD_A | AST_FIELD_B, 0, 0},
+    [AST_TERNARY]   = {"Conditional", AST_FIELD_A | AST_FIELD_B | AST_FIELD_C, 0, 0},
+    [AST_CALL]      = {"Call", 0, AST_FIELD_C, 1},
+    [AST_ERROR]     = {"Error", 0, 0, 0},
+    [AST_LAZY_BODY] = {"LazyBody", 0, 0, 0},
+};
+
+// Grow the node and span arrays to hold at least needed nodes
+static int reserveNodes(Ast *ast, uint32_t needed) {
+    if (needed <= ast->nodeCapacity) {
+        return 1;
+    }
+    if (ast->readOnly) {
+        fprintf(stderr, "Cannot add nodes to a read-only AST!\n");
+        ast->failed = 1;
+        return 0;
+    }
+    uint32_t newCapacity = ast->nodeCapacity ? ast->nodeCapacity : 1024;
+    while (newCapacity < needed) {
+        newCapacity *= 2;
+    }
+    AstNode *nodes = realloc(ast->nodes, newCapacity * sizeof(AstNode));
+    if (nodes) ast->nodes = nodes;
+    AstSpan *spans = realloc(ast->spans, newCapacity * sizeof(AstSpan));
+    if (spans) ast->spans = spans;
+    if (!nodes || !spans) {
+        fprintf(stderr, "Memory allocation failed for AST nodes!\n");
+        ast->failed = 1;
+        return 0;
+    }
+    ast->nodeCapacity = newCapacity;
+    return 1;
+}
+
+// Prepare an empty tree with room for about nodeHint nodes
+void initAst(Ast *ast, uint32_t nodeHint) {
+    memset(ast, 0, sizeof(*ast));
+    reserveNodes(ast, nodeHint > 0 ? nodeHint : 1);
+    resetAst(ast);
+}
+
+// Free the whole tree
+void freeAst(Ast *ast) {
+    if (!ast->readOnly) {
+        free(ast->nodes);
+        free(ast->spans);
+        free(ast->lists);
+    }
+    memset(ast, 0, sizeof(*ast));
+}
+
+// Drop every node but keep the memory. Only the sentinel is rewritten
+void resetAst(Ast *ast) {
+    if (ast->readOnly) {
+        return;
+    }
+    ast->nodeCount = 0;
+    ast->listCount = 0;
+    ast->root = 0;
+    if (ast->nodeCapacity > 0) {
+        memset(&ast->nodes[0], 0, sizeof(AstNode));
+        ast->spans[0].first = ast->spans[0].end = 0;
+        ast->nodeCount = 1;
+    }
+}
+
+// Bump-allocate a node
+uint32_t astAddNode(Ast *ast, AstKind kind, uint8_t op, SourceLocation location,
+                    uint32_t a, uint32_t b, uint32_t c) {
+    // Make sure the sentinel exists (initAst may have failed to allocate)
+    if (ast->nodeCount == 0) {
+        if (!reserveNodes(ast, 1)) {
+            return 0;
+        }
+        resetAst(ast);
+    }
+    if (!reserveNodes(ast, ast->nodeCount + 1)) {
+        return 0;
+    }
+    uint32_t index = ast->nodeCount++;
+    AstNode *node = &ast->nodes[index];
+    node->kind = (uint8_t)kind;
+    node->op = op;
+    node->flags = 0;
+    node->location = location;
+    node->a = a;
+    node->b = b;
+    node->c = c;
+    ast->spans[index].first = ast->spans[index].end = 0;
+    return index;
+}
+
+// Copy count child indices into the side array
+uint32_t astAddList(Ast *ast, const uint32_t *items, uint32_t count) {
+    if (ast->listCount + count > ast->listCapacity) {
+        if (ast->readOnly) {
+            ast->failed = 1;
+            return 0;
+        }
+        uint32_t newCapacity = ast->listCapacity ? ast->listCapacity : 1024;
+        while (newCapacity < ast->listCount + count) {
+            newCapacity *= 2;
+        }
+        uint32_t *lists = realloc(ast->lists, newCapacity * sizeof(uint32_t));
+        if (!lists) {
+            fprintf(stderr, "Memory allocation failed for AST lists!\n");
+            ast->failed = 1;
+            return 0;
+        }
+        ast->lists = lists;
+        ast->listCapacity = newCapacity;
+    }
+    uint32_t start = ast->listCount;
+    if (count > 0) {
+        memcpy(&ast->lists[start], items, count * sizeof(uint32_t));
+    }
+    ast->listCount += count;
+    return start;
+}
+
+// Remember which tokens a node was parsed from
+void astSetSpan(Ast *ast, uint32_t node, uint32_t firstToken, uint32_t endToken) {
+    if (node != 0 && node < ast->nodeCount) {
+        ast->spans[node].first = firstToken;
+        ast->spans[node].end = endToken;
+    }
+}
+
+// Append every node of src except its sentinel to dest, renumbering child
+// indices and list positions
+int astAppend(Ast *dest, const Ast *src, uint32_t *nodeShift, uint32_t *listShift) {
+    if (dest->nodeCount == 0) {
+        if (!reserveNodes(dest, 1)) {
+            return 0;
+        }
+        resetAst(dest);
+    }
+    uint32_t added = src->nodeCount > 0 ? src->nodeCount - 1 : 0;
+    if (!reserveNodes(dest, dest->nodeCount + added)) {
+        return 0;
+    }
+    uint32_t shift = dest->nodeCount - 1;
+    uint32_t listStart = astAddList(dest, src->lists, src->listCount);
+    if (src->listCount > 0 && dest->failed) {
+        return 0;
+    }
+
+    // Child references inside the copied lists
+    for (uint32_t i = 0; i < src->listCount; i++) {
+        if (dest->lists[listStart + i] != 0) {
+            dest->lists[listStart + i] += shift;
+        }
+    }
+
+    memcpy(&dest->nodes[dest->nodeCount], &src->nodes[1], added * sizeof(AstNode));
+    memcpy(&dest->spans[dest->nodeCount], &src->spans[1], added * sizeof(AstSpan));
+    for (uint32_t i = 0; i < added; i++) {
+        AstNode *node = &dest->nodes[dest->nodeCount + i];
+        const AstLayout *layout = &astLayouts[node->kind];
+        if (src->symbolMap) {
+            if (layout->symbolFields & AST_FIELD_A) node->a = src->symbolMap[node->a];
+            if (layout->symbolFields & AST_FIELD_B) node->b = src->symbolMap[node->b];
+            if (layout->symbolFields & AST_FIELD_C) node->c = src->symbolMap[node->c];
+        }
+        node->location = astLocation(src, i + 1);
+        if (layout->hasList) {
+            node->a += listStart;
+        }
+        if ((layout->nodeFields & AST_FIELD_A) && node->a) node->a += shift;
+        if ((layout->nodeFields & AST_FIELD_B) && node->b) node->b += shift;
+        if ((layout->nodeFields & AST_FIELD_C) && node->c) node->c += shift;
+    }
+    dest->nodeCount += added;
+
+    *nodeShift = shift;
+    *listShift = listStart;
+    return 1;
+}
+
+// Number of children of a node
+uint32_t astChildCount(const Ast *ast, uint32_t node) {
+    const AstNode *n = &ast->nodes[node];
+    const AstLayout *layout = &astLayouts[n->kind];
+    if (layout->hasList) {
+        return n->b;
+    }
+    uint32_t count = 0;
+    if ((layout->nodeFields & AST_FIELD_A) && n->a) count++;
+    if ((layout->nodeFields & AST_FIELD_B) && n->b) count++;
+    if ((layout->nodeFields & AST_FIELD_C) && n->c) count++;
+    return count;
+}
+
+// The i-th child of a node, in source order
+uint32_t astChild(const Ast *ast, uint32_t node, uint32_t i) {
+    const AstNode *n = &ast->nodes[node];
+    const AstLayout *layout = &astLayouts[n->kind];
+    if (layout->hasList) {
+        return i < n->b ? ast->lists[n->a + i] : 0;
+    }
+    const uint32_t fields[3] = {
+        (layout->nodeFields & AST_FIELD_A) ? n->a : 0,
+        (layout->nodeFields & AST_FIELD_B) ? n->b : 0,
+        (layout->nodeFields & AST_FIELD_C) ? n->c : 0,
+    };
+    for (int f = 0; f < 3; f++) {
+        if (fields[f] != 0 && i-- == 0) {
+            return fields[f];
+        }
+    }
+    return 0;
+}
+
+// Value of an AST_NUMBER node
+int64_t astNumberValue(const AstNode *node) {
+    return (int64_t)(((uint64_t)node->b << 32) | node->a);
+}
+
+// Store a value in the a/b fields of a node
+void astSetNumberValue(AstNode *node, int64_t value) {
+    node->a = (uint32_t)((uint64_t)value & 0xFFFFFFFFu);
+    node->b = (uint32_t)((uint64_t)value >> 32);
+}
+
+// Bytes used by the tree's arrays
+size_t astMemoryBytes(const Ast *ast) {
+    return (size_t)ast->nodeCount * (sizeof(AstNode) + sizeof(AstSpan)) +
+           (size_t)ast->listCount * sizeof(uint32_t);
+}
+
+// Print one node's name and payload on a line (without indentation)
+static void printAstNode(const Ast *ast, uint32_t index, FILE *out) {
+    const AstNode *node = &ast->nodes[index];
+    fprintf(out, "%s", astLayouts[node->kind].name);
+    switch (node->kind) {
+        case AST_VAR_DECL:
+            if (node->c) {
+                fprintf(out, "(%ls %ls)", symbolText(astSymbol(ast, node->c)), symbolText(astSymbol(ast, node->a)));
+            } else {
+                fprintf(out, "(पूर्ण %ls)", symbolText(astSymbol(ast, node->a)));
+            }
+            break;
+        case AST_FUNC_DECL:
+        case AST_CLASS_DECL:
+        case AST_IDENT:
+            fprintf(out, "(%ls)", symbolText(astSymbol(ast, node->a)));
+            break;
+        case AST_CALL:
+            fprintf(out, "(%ls)", symbolText(astSymbol(ast, node->c)));
+            break;
+        case AST_NUMBER:
+            fprintf(out, "(%lld)", (long long)astNumberValue(node));
+            break;
+        case AST_STRING:
+            fprintf(out, "(\"%ls\")", symbolText(astSymbol(ast, node->a)));
+            break;
+        case AST_CHAR: {
+            wchar_t text[2] = {(wchar_t)node->a, L'\0'};
+            fprintf(out, "('%ls')", text);
+            break;
+        }
+        case AST_BOOL:
+            fprintf(out, "(%ls)", node->a ? L"सत्य" : L"असत्य");
+            break;
+        case AST_LAZY_BODY:
+            fprintf(out, "(tokens %u-%u)", node->a, node->b);
+            break;
+        case AST_UNARY:
+        case AST_BINARY:
+        case AST_ASSIGN:
+            fprintf(out, "(%ls)", node->op < OPERATOR_COUNT ? operators[node->op] : L"?");
+            break;
+        default:
+            break;
+    }
+    fputc('\n', out);
+}
+
+// Print the tree below node as an indented outline, like:
+//   Program
+//   ├── VariableDeclaration(पूर्ण संख्या)
+//   │   └── Number(10)
+// Uses an explicit stack, so arbitrarily deep trees can be printed
+void printAst(const Ast *ast, uint32_t node, FILE *out) {
+    typedef struct {
+        uint32_t node;
+        uint32_t depth;
+        uint8_t last;          // Last child of its parent
+    } PrintItem;
+
+    uint32_t stackCapacity = 256, depthCapacity = 256, top = 0;
+    PrintItem *stack = malloc(stackCapacity * sizeof(PrintItem));
+    uint8_t *lastAtDepth = malloc(depthCapacity);  // Whether the ancestor at each depth was a last child
+    if (!stack || !lastAtDepth) {
+        fprintf(stderr, "Memory allocation failed!\n");
+        free(stack);
+        free(lastAtDepth);
+        return;
+    }
+    stack[top++] = (PrintItem){node, 0, 1};
+
+    while (top > 0) {
+        PrintItem item = stack[--top];
+
+        // Draw the connecting lines of every ancestor, then this node
+        for (uint32_t d = 1; d < item.depth; d++) {
+            fputs(lastAtDepth[d] ? "    " : "│   ", out);
+        }
+        if (item.depth > 0) {
+            fputs(item.last ? "└── " : "├── ", out);
+        }
+        printAstNode(ast, item.node, out);
+
+        if (item.depth + 1 >= depthCapacity) {
+            uint8_t *grown = realloc(lastAtDepth, depthCapacity * 2);
+            if (!grown) break;
+            lastAtDepth = grown;
+            depthCapacity *= 2;
+        }
+        lastAtDepth[item.depth] = item.last;
+
+        // Push children last-to-first so that the first is printed first
+        uint32_t count = astChildCount(ast, item.node);
+        if (top + count > stackCapacity) {
+            while (top + count > stackCapacity) stackCapacity *= 2;
+            PrintItem *grown = realloc(stack, stackCapacity * sizeof(PrintItem));
+            if (!grown) break;
+            stack = grown;
+        }
+        for (uint32_t i = count; i > 0; i--) {
+            stack[top++] = (PrintItem){astChild(ast, item.node, i - 1), item.depth + 1, i == count};
+        }
+    }
+
+    free(stack);
+    free(lastAtDepth);
+}
@@ -0,0 +1,151 @@
+#ifndef AST_H
+#define AST_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "SourceManager.h"  // For SourceLocation
+
+// Flat Abstract Syntax Tree
+// All nodes of a tree live in one contiguous array and refer to each other by
+// 32-bit index instead of by pointer. Nodes are bump-allocated at the end of the
+// array; when it fills up it is moved to a bigger block, which is safe because
+// no node holds a pointer. A whole tree is freed with a constant number of free()
+// calls, and a 1 MB source becomes a handful of large allocations instead of
+// hundreds of thousands of small ones.
+//
+// Index 0 is a sentinel (AST_NONE) meaning "no node", so optional children are 0.
+// Nodes with a variable number of children (blocks, argument lists, ...) keep
+// them in the shared side array `lists`: a = first entry, b = number of entries.
+
+// Kinds of nodes and the meaning of their a/b/c fields
+typedef enum {
+    AST_NONE,          // Sentinel at index 0
+    AST_PROGRAM,       // a,b = list of statements
+    AST_BLOCK,         // a,b = list of statements ({ ... })
+    AST_VAR_DECL,      // a = name symbol, b = initializer (0 if none), c = class type symbol (0 = पूर्ण)
+    AST_FUNC_DECL,     // a = name symbol, b = AST_PARAMS node, c = body block
+    AST_PARAMS,        // a,b = list of parameter AST_VAR_DECL nodes
+    AST_CLASS_DECL,    // a = name symbol, b = body block
+    AST_IF,            // a = condition, b = then block, c = else block or AST_IF (0 if none)
+    AST_LOOP,          // a = loop variable AST_VAR_DECL (its initializer is the start), b = end, c = body
+    AST_WHILE,         // a = condition, b = body
+    AST_PRINT,         // a,b = list of arguments (लेख)
+    AST_INPUT,         // a = target AST_IDENT (प्रवे)
+    AST_EXPR_STMT,     // a = expression
+    AST_NUMBER,        // a = low 32 bits, b = high 32 bits of the value
+    AST_STRING,        // a = text symbol
+    AST_CHAR,          // a = code point
+    AST_BOOL,          // a = 1 for सत्य, 0 for असत्य
+    AST_IDENT,         // a = name symbol
+    AST_UNARY,         // op = OperatorId, a = operand
+    AST_BINARY,        // op = OperatorId, a = left, b = right
+    AST_ASSIGN,        // op = OperatorId (= += -= *= /=), a = target AST_IDENT, b = value
+    AST_TERNARY,       // a = condition, b = value if true, c = value if false
+    AST_CALL,          // a,b = list of arguments, c = callee symbol
+    AST_ERROR,         // Placeholder for code that failed to parse
+    AST_LAZY_BODY,     // Function body not parsed yet: a = its '{' token, b = one past its '}'
+    AST_KIND_COUNT
+} AstKind;
+
+// One node: 20 bytes, no pointers
+typedef struct {
+    uint8_t kind;              // AstKind
+    uint8_t op;                // Operator of unary/binary/assignment nodes
+    uint16_t flags;            // Free for passes to use
+    SourceLocation location;   // Where the node starts (NO_LOCATION if unknown)
+    uint32_t a, b, c;          // Children, symbols or values, depending on kind
+} AstNode;
+
+// Range of tokens [first, end) a node was parsed from
+typedef struct {
+    uint32_t first;
+    uint32_t end;
+} AstSpan;
+
+// A whole tree
+typedef struct {
+    AstNode *nodes;            // Node array, nodes[0] is the AST_NONE sentinel
+    AstSpan *spans;            // Token span of each node (parallel to nodes)
+    uint32_t nodeCount;        // Nodes in use
+    uint32_t nodeCapacity;     // Allocated nodes
+    uint32_t *lists;           // Side array holding the children of list nodes
+    uint32_t listCount;        // Entries in use
+    uint32_t listCapacity;     // Allocated entries
+    uint32_t root;             // Root node (usually AST_PROGRAM), 0 if none
+    int failed;                // Set if an allocation failed
+
+    // Set for trees used straight from a cache file (see AstCache.h): the arrays
+    // are read-only, symbol fields hold the file's own symbol numbers and
+    // locations are relative to the start of the source file
+    const uint32_t *symbolMap; // File symbol number -> SymbolId (NULL for ordinary trees)
+    SourceLocation locationBase; // Added to stored locations (0 for ordinary trees)
+    int readOnly;              // Arrays must not be changed or freed
+} Ast;
+
+// Bits naming the a, b and c fields of a node
+#define AST_FIELD_A 1
+#define AST_FIELD_B 2
+#define AST_FIELD_C 4
+
+// What the fields of each kind of node hold
+typedef struct {
+    const char *name;          // Name used when printing the tree
+    uint8_t nodeFields;        // Fields holding child node indices
+    uint8_t symbolFields;      // Fields holding SymbolIds
+    uint8_t hasList;           // Children are lists[a .. a+b)
+} AstLayout;
+
+extern const AstLayout astLayouts[AST_KIND_COUNT];
+
+// SymbolId held in a symbol field of a node (translates cached trees)
+static inline uint32_t astSymbol(const Ast *ast, uint32_t value) {
+    return ast->symbolMap ? ast->symbolMap[value] : value;
+}
+
+// Location of a node (translates cached trees)
+static inline SourceLocation astLocation(const Ast *ast, uint32_t node) {
+    SourceLocation location = ast->nodes[node].location;
+    return (location != NO_LOCATION && ast->locationBase != NO_LOCATION) ? ast->locationBase + location : location;
+}
+
+// Prepare an empty tree with room for about nodeHint nodes
+void initAst(Ast *ast, uint32_t nodeHint);
+
+// Free the whole tree (a constant number of free() calls; read-only trees are only forgotten)
+void freeAst(Ast *ast);
+
+// Drop every node but keep the memory, in O(1)
+void resetAst(Ast *ast);
+
+// Bump-allocate a node. Returns its index, or 0 if out of memory
+uint32_t astAddNode(Ast *ast, AstKind kind, uint8_t op, SourceLocation location,
+                    uint32_t a, uint32_t b, uint32_t c);
+
+// Copy count child indices into the side array. Returns the first entry's index
+uint32_t astAddList(Ast *ast, const uint32_t *items, uint32_t count);
+
+// Remember which tokens a node was parsed from
+void astSetSpan(Ast *ast, uint32_t node, uint32_t firstToken, uint32_t endToken);
+
+// Append every node of src except its sentinel to dest, renumbering child
+// indices and list positions. Node i of src becomes node i + *nodeShift of dest
+// and its list entries move by *listShift. Returns 1 on success, 0 if out of memory
+int astAppend(Ast *dest, const Ast *src, uint32_t *nodeShift, uint32_t *listShift);
+
+// Number of children of a node (list entries and non-zero child fields)
+uint32_t astChildCount(const Ast *ast, uint32_t node);
+
+// The i-th child of a node, in source order
+uint32_t astChild(const Ast *ast, uint32_t node, uint32_t i);
+
+// Value of an AST_NUMBER node, and the a/b fields that store a value
+int64_t astNumberValue(const AstNode *node);
+void astSetNumberValue(AstNode *node, int64_t value);
+
+// Bytes used by the tree's arrays
+size_t astMemoryBytes(const Ast *ast);
+
+// Print the tree below node as an indented outline
+void printAst(const Ast *ast, uint32_t node, FILE *out);
+
+#endif // AST_H
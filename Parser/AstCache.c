@@ -0,0 +1,381 @@
+#include "AstCache.h"
+#include "Interner.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Identifies AST cache files
+static const char cacheMagic[8] = {'S', 'K', 'A', 'S', 'T', 'C', 'A', 'C'};
+
+// Fixed-size header at the start of a cache file. Every section starts at an
+// offset that is a multiple of 8 so the arrays can be used in place
+typedef struct {
+    char magic[8];             // Must match cacheMagic
+    uint32_t version;          // AST_CACHE_VERSION
+    uint32_t byteOrder;        // 0x01020304 as written by the writer
+    uint32_t nodeSize;         // sizeof(AstNode) of the writer
+    uint32_t wcharSize;        // sizeof(wchar_t) of the writer
+    uint64_t sourceHash;       // hashSource() of the source text
+    uint32_t sourceLength;     // Its length in characters
+    uint32_t nodeCount;
+    uint32_t listCount;
+    uint32_t root;
+    uint32_t symbolCount;      // Symbols are numbered 1 .. symbolCount
+    uint32_t textLength;       // Characters of symbol text, including terminators
+    uint64_t nodesOffset;      // AstNode[nodeCount]
+    uint64_t spansOffset;      // AstSpan[nodeCount]
+    uint64_t listsOffset;      // uint32_t[listCount]
+    uint64_t symbolsOffset;    // uint32_t[symbolCount + 1]: start of each symbol's text
+    uint64_t textOffset;       // wchar_t[textLength]
+    uint64_t payloadHash;      // hashPayload() of everything after the header
+} AstCacheHeader;
+
+#define CACHE_BYTE_ORDER 0x01020304u
+
+// Hash of a source text (64-bit FNV-1a over its characters)
+uint64_t hashSource(const wchar_t *text, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (uint64_t)(uint32_t)text[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Mix bytes, padded with zeros to a multiple of 8, into a hash of the sections
+// after the header (FNV-1a over 8-byte words). The sections are padded the same
+// way and lie back to back, so the writer can hash them one by one and the
+// reader all at once
+static uint64_t hashPayload(uint64_t hash, const void *data, size_t bytes) {
+    const unsigned char *p = data;
+    for (size_t i = 0; i < bytes; i += 8) {
+        uint64_t word = 0;
+        memcpy(&word, p + i, bytes - i < 8 ? bytes - i : 8);
+        hash = (hash ^ word) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Numbering of the symbols used by a tree: an open-addressing table from
+// SymbolId to file symbol number, plus the SymbolIds in number order
+typedef struct {
+    uint32_t *keys;            // SymbolIds (0 = empty slot)
+    uint32_t *values;          // File symbol numbers
+    uint32_t capacity;         // Power of two
+    SymbolId *order;           // order[n] = SymbolId of file symbol n (order[0] unused)
+    uint32_t count;
+} SymbolNumbering;
+
+// File symbol number of a SymbolId, giving it the next number if it is new
+static uint32_t numberSymbol(SymbolNumbering *numbering, SymbolId symbol) {
+    if (symbol == NO_SYMBOL) {
+        return 0;
+    }
+    uint32_t mask = numbering->capacity - 1;
+    uint32_t slot = (symbol * 2654435761u) & mask;
+    while (numbering->keys[slot] != 0) {
+        if (numbering->keys[slot] == symbol) {
+            return numbering->values[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+    numbering->keys[slot] = symbol;
+    numbering->values[slot] = ++numbering->count;
+    numbering->order[numbering->count] = symbol;
+    return numbering->count;
+}
+
+// Write count bytes and pad the file to a multiple of 8, adding them to *hash
+static int writeSection(FILE *file, const void *data, size_t bytes, uint64_t *offset, uint64_t *hash) {
+    static const char zeros[8] = {0};
+    *offset = (uint64_t)ftell(file);
+    *hash = hashPayload(*hash, data, bytes);
+    if (bytes > 0 && fwrite(data, 1, bytes, file) != bytes) {
+        return 0;
+    }
+    size_t padding = (8 - bytes % 8) % 8;
+    return fwrite(zeros, 1, padding, file) == padding;
+}
+
+// Write ast for a source with the given hash and length
+int saveAstCache(const char *path, const Ast *ast, uint64_t sourceHash, uint32_t sourceLength,
+                 SourceLocation fileStart) {
+    if (ast->symbolMap || ast->readOnly) {
+        fprintf(stderr, "Error: A cached AST cannot be cached again\n");
+        return 0;
+    }
+
+    // Copy the nodes, renumbering symbols and making locations file-relative
+    // A node has at most two symbol fields; the table is kept at most half full
+    SymbolNumbering numbering = {0};
+    uint64_t maxSymbols = (uint64_t)ast->nodeCount * 2 + 1;
+    numbering.capacity = 1024;
+    while (numbering.capacity < maxSymbols * 2 && numbering.capacity < (1u << 31)) {
+        numbering.capacity *= 2;
+    }
+    numbering.keys = calloc(numbering.capacity, sizeof(uint32_t));
+    numbering.values = malloc(numbering.capacity * sizeof(uint32_t));
+    numbering.order = malloc((maxSymbols + 1) * sizeof(SymbolId));
+    AstNode *nodes = malloc((ast->nodeCount + 1) * sizeof(AstNode));
+    int ok = numbering.keys && numbering.values && numbering.order && nodes;
+
+    for (uint32_t i = 0; ok && i < ast->nodeCount; i++) {
+        AstNode node = ast->nodes[i];
+        const AstLayout *layout = &astLayouts[node.kind];
+        if (layout->symbolFields & AST_FIELD_A) node.a = numberSymbol(&numbering, node.a);
+        if (layout->symbolFields & AST_FIELD_B) node.b = numberSymbol(&numbering, node.b);
+        if (layout->symbolFields & AST_FIELD_C) node.c = numberSymbol(&numbering, node.c);
+        if (fileStart != NO_LOCATION && node.location >= fileStart) {
+            node.location = node.location - fileStart + 1;  // Stored as offset + 1, 0 stays unknown
+        } else {
+            node.location = NO_LOCATION;
+        }
+        nodes[i] = node;
+    }
+
+    // Symbol texts, each followed by a terminator
+    uint32_t textLength = 0;
+    uint32_t *symbolStarts = ok ? malloc((numbering.count + 1) * sizeof(uint32_t)) : NULL;
+    ok = ok && symbolStarts;
+    for (uint32_t n = 1; ok && n <= numbering.count; n++) {
+        symbolStarts[n] = textLength;
+        textLength += symbolLength(numbering.order[n]) + 1;
+    }
+    wchar_t *text = ok ? malloc((textLength + 1) * sizeof(wchar_t)) : NULL;
+    ok = ok && text;
+    if (ok) {
+        symbolStarts[0] = 0;
+        for (uint32_t n = 1; n <= numbering.count; n++) {
+            uint32_t length = symbolLength(numbering.order[n]);
+            memcpy(&text[symbolStarts[n]], symbolText(numbering.order[n]), length * sizeof(wchar_t));
+            text[symbolStarts[n] + length] = L'\0';
+        }
+    }
+    if (!ok) {
+        fprintf(stderr, "Memory allocation failed for AST cache!\n");
+    }
+
+    // Write to a temporary name first so readers never see a half-written file
+    char temporary[4096];
+    FILE *file = NULL;
+    if (ok && snprintf(temporary, sizeof(temporary), "%s.tmp%ld", path, (long)getpid()) < (int)sizeof(temporary)) {
+        file = fopen(temporary, "wb");
+    }
+    if (ok && !file) {
+        fprintf(stderr, "Error: Could not create AST cache %s\n", path);
+        ok = 0;
+    }
+    if (ok) {
+        AstCacheHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+        header.version = AST_CACHE_VERSION;
+        header.byteOrder = CACHE_BYTE_ORDER;
+        header.nodeSize = sizeof(AstNode);
+        header.wcharSize = sizeof(wchar_t);
+        header.sourceHash = sourceHash;
+        header.sourceLength = sourceLength;
+        header.nodeCount = ast->nodeCount;
+        header.listCount = ast->listCount;
+        header.root = ast->root;
+        header.symbolCount = numbering.count;
+        header.textLength = textLength;
+
+        uint64_t headerOffset, headerHash = 0;
+        header.payloadHash = 14695981039346656037ULL;
+        ok = writeSection(file, &header, sizeof(header), &headerOffset, &headerHash) &&
+             writeSection(file, nodes, ast->nodeCount * sizeof(AstNode), &header.nodesOffset, &header.payloadHash) &&
+             writeSection(file, ast->spans, ast->nodeCount * sizeof(AstSpan), &header.spansOffset,
+                          &header.payloadHash) &&
+             writeSection(file, ast->lists, ast->listCount * sizeof(uint32_t), &header.listsOffset,
+                          &header.payloadHash) &&
+             writeSection(file, symbolStarts, (numbering.count + 1) * sizeof(uint32_t), &header.symbolsOffset,
+                          &header.payloadHash) &&
+             writeSection(file, text, textLength * sizeof(wchar_t), &header.textOffset, &header.payloadHash);
+        // Rewrite the header now that the offsets are known
+        ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+        ok = (fclose(file) == 0) && ok;
+        if (ok && rename(temporary, path) != 0) {
+            ok = 0;
+        }
+        if (!ok) {
+            fprintf(stderr, "Error: Could not write AST cache %s\n", path);
+            remove(temporary);
+        }
+    }
+
+    free(numbering.keys);
+    free(numbering.values);
+    free(numbering.order);
+    free(nodes);
+    free(symbolStarts);
+    free(text);
+    return ok;
+}
+
+// Does [offset, offset + bytes) lie inside a file of size bytes?
+static int sectionFits(uint64_t offset, uint64_t bytes, size_t size) {
+    return offset % 8 == 0 && offset <= size && bytes <= size - offset;
+}
+
+// Do all node kinds, child indices, lists and symbol numbers of a cached tree
+// lie in range? Node locations are offsets + 1 into a source of sourceLength
+static int treeFits(const AstCacheHeader *header, const AstNode *nodes, const uint32_t *lists) {
+    for (uint32_t i = 0; i < header->listCount; i++) {
+        if (lists[i] >= header->nodeCount) {
+            return 0;
+        }
+    }
+    for (uint32_t i = 0; i < header->nodeCount; i++) {
+        const AstNode *node = &nodes[i];
+        if (node->kind >= AST_KIND_COUNT || node->location > header->sourceLength + 1) {
+            return 0;
+        }
+        const AstLayout *layout = &astLayouts[node->kind];
+        const uint32_t fields[3] = {node->a, node->b, node->c};
+        for (int f = 0; f < 3; f++) {
+            uint8_t bit = (uint8_t)(1 << f);
+            if (((layout->nodeFields & bit) && fields[f] >= header->nodeCount) ||
+                ((layout->symbolFields & bit) && fields[f] > header->symbolCount)) {
+                return 0;
+            }
+        }
+        if (layout->hasList && (node->a > header->listCount || node->b > header->listCount - node->a)) {
+            return 0;
+        }
+    }
+    return nodes[0].kind == AST_NONE;
+}
+
+// Map a cache file and make ast use it
+int loadAstCache(const char *path, uint64_t sourceHash, uint32_t sourceLength, SourceLocation fileStart,
+                 Ast *ast, AstCache *cache) {
+    memset(cache, 0, sizeof(*cache));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;  // No cache yet
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(AstCacheHeader)) {
+        close(fd);
+        return 0;
+    }
+    size_t size = (size_t)info.st_size;
+    void *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return 0;
+    }
+
+    const AstCacheHeader *header = mapping;
+    int ok = memcmp(header->magic, cacheMagic, sizeof(cacheMagic)) == 0 &&
+             header->version == AST_CACHE_VERSION && header->byteOrder == CACHE_BYTE_ORDER &&
+             header->nodeSize == sizeof(AstNode) && header->wcharSize == sizeof(wchar_t) &&
+             header->sourceHash == sourceHash && header->sourceLength == sourceLength &&
+             header->nodeCount > 0 && header->root < header->nodeCount &&
+             sectionFits(header->nodesOffset, (uint64_t)header->nodeCount * sizeof(AstNode), size) &&
+             sectionFits(header->spansOffset, (uint64_t)header->nodeCount * sizeof(AstSpan), size) &&
+             sectionFits(header->listsOffset, (uint64_t)header->listCount * sizeof(uint32_t), size) &&
+             sectionFits(header->symbolsOffset, ((uint64_t)header->symbolCount + 1) * sizeof(uint32_t), size) &&
+             sectionFits(header->textOffset, (uint64_t)header->textLength * sizeof(wchar_t), size) &&
+             header->nodesOffset >= sizeof(AstCacheHeader) &&
+             hashPayload(14695981039346656037ULL, (const char *)mapping + header->nodesOffset,
+                         size - header->nodesOffset) == header->payloadHash &&
+             treeFits(header, (const AstNode *)((const char *)mapping + header->nodesOffset),
+                      (const uint32_t *)((const char *)mapping + header->listsOffset));
+
+    // Intern every symbol once; the nodes keep their file numbers
+    uint32_t *symbolMap = ok ? malloc(((size_t)header->symbolCount + 1) * sizeof(uint32_t)) : NULL;
+    if (ok && !symbolMap) {
+        fprintf(stderr, "Memory allocation failed for AST cache symbols!\n");
+        ok = 0;
+    }
+    if (ok) {
+        const uint32_t *starts = (const uint32_t *)((const char *)mapping + header->symbolsOffset);
+        const wchar_t *text = (const wchar_t *)((const char *)mapping + header->textOffset);
+        symbolMap[0] = NO_SYMBOL;
+        for (uint32_t n = 1; ok && n <= header->symbolCount; n++) {
+            uint32_t start = starts[n];
+            uint32_t end = n < header->symbolCount ? starts[n + 1] : header->textLength;
+            ok = start < end && end <= header->textLength && text[end - 1] == L'\0';
+            if (ok) {
+                symbolMap[n] = internSymbol(&text[start], end - start - 1);
+                ok = symbolMap[n] != NO_SYMBOL;
+            }
+        }
+    }
+    if (!ok) {
+        free(symbolMap);
+        munmap(mapping, size);
+        return 0;
+    }
+
+    memset(ast, 0, sizeof(*ast));
+    ast->nodes = (AstNode *)((char *)mapping + header->nodesOffset);
+    ast->spans = (AstSpan *)((char *)mapping + header->spansOffset);
+    ast->lists = (uint32_t *)((char *)mapping + header->listsOffset);
+    ast->nodeCount = ast->nodeCapacity = header->nodeCount;
+    ast->listCount = ast->listCapacity = header->listCount;
+    ast->root = header->root;
+    ast->symbolMap = symbolMap;
+    ast->locationBase = fileStart != NO_LOCATION ? fileStart - 1 : NO_LOCATION;
+    ast->readOnly = 1;
+
+    cache->mapping = mapping;
+    cache->size = size;
+    cache->symbolMap = symbolMap;
+    cache->sourceHash = sourceHash;
+    return 1;
+}
+
+// Unmap a cache file
+void closeAstCache(AstCache *cache) {
+    if (cache->mapping) {
+        munmap(cache->mapping, cache->size);
+    }
+    free(cache->symbolMap);
+    memset(cache, 0, sizeof(*cache));
+}
+
+// Name of the cache file for a source hash inside directory
+int astCachePath(const char *directory, uint64_t sourceHash, char *buffer, size_t bufferSize) {
+    int written = snprintf(buffer, bufferSize, "%s/%016llx.skast", directory, (unsigned long long)sourceHash);
+    return written > 0 && (size_t)written < bufferSize;
+}
+
+// Parse a source file, or load its tree from the cache if the text has not changed
+SourceFileId parseFileCached(const char *sourcePath, const char *cacheDirectory, Ast *ast,
+                             AstCache *cache, DiagnosticBuffer *diagnostics) {
+    memset(cache, 0, sizeof(*cache));
+    SourceFileId file = loadSourceFile(sourcePath);
+    if (file == NO_FILE) {
+        return NO_FILE;
+    }
+    uint32_t length = sourceLength(file);
+    uint64_t hash = hashSource(sourceBuffer(file), length);
+    char cachePath[4096];
+    int havePath = cacheDirectory && astCachePath(cacheDirectory, hash, cachePath, sizeof(cachePath));
+
+    if (havePath && loadAstCache(cachePath, hash, length, sourceFileStart(file), ast, cache)) {
+        return file;
+    }
+
+    TokenCollector tokens = tokenizeSourceFile(file);
+    Parser parser;
+    initAst(ast, tokens.count / 2 + 16);
+    initParser(&parser, &tokens, ast);
+    parser.diagnostics = diagnostics;
+    parseProgram(&parser);
+    if (havePath && parser.errorCount == 0 && !ast->failed && !tokens.failed) {
+        saveAstCache(cachePath, ast, hash, length, sourceFileStart(file));
+    }
+    freeParser(&parser);
+    freeTokenCollector(&tokens);
+    return file;
+}
@@ -0,0 +1,64 @@
+#ifndef AST_CACHE_H
+#define AST_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Ast.h"
+#include "Diagnostics.h"
+
+// Binary AST cache
+// A parsed tree is written to disk exactly as it lies in memory: the node, span
+// and list arrays back to back, followed by the file's own symbol table. Loading
+// maps the file and points an Ast straight at those arrays - nothing is decoded
+// and no pointers are patched, since the tree holds none.
+//
+// What cannot be stored as is gets translated on use instead:
+//   - symbol fields hold numbers into the file's symbol table; loading interns
+//     each symbol once and astSymbol() maps node fields to SymbolIds
+//   - locations are stored relative to the start of the source file and
+//     astLocation() adds the file's current start
+// A cache file is tied to the exact source text by its hash and length, and
+// carries a hash of its own contents: loading checks it, and that every node
+// kind, child, list and symbol number lies in range, before the tree is used.
+
+#define AST_CACHE_VERSION 2
+
+// An open cache file. Keeps the mapping alive for the Ast that uses it
+typedef struct {
+    void *mapping;             // mmap()ed file
+    size_t size;
+    uint32_t *symbolMap;       // File symbol number -> SymbolId
+    uint64_t sourceHash;
+} AstCache;
+
+// Hash of a source text (64-bit FNV-1a over its characters)
+uint64_t hashSource(const wchar_t *text, size_t length);
+
+// Write ast for a source with the given hash and length. fileStart is the
+// location of the source's first character (NO_LOCATION if locations are unset).
+// Returns 1 on success
+int saveAstCache(const char *path, const Ast *ast, uint64_t sourceHash, uint32_t sourceLength,
+                 SourceLocation fileStart);
+
+// Map a cache file and make ast use it. Fails (returning 0) if the file is missing,
+// damaged, from another format version or for different source text. fileStart is
+// where the source file now starts in the location space (NO_LOCATION if unknown).
+// The tree is read-only and stays valid until closeAstCache()
+int loadAstCache(const char *path, uint64_t sourceHash, uint32_t sourceLength, SourceLocation fileStart,
+                 Ast *ast, AstCache *cache);
+
+// Unmap a cache file; the Ast that used it must not be used afterwards
+void closeAstCache(AstCache *cache);
+
+// Name of the cache file for a source hash inside directory (e.g. "dir/9f2c...e1.skast").
+// Returns 1 if it fitted into buffer
+int astCachePath(const char *directory, uint64_t sourceHash, char *buffer, size_t bufferSize);
+
+// Parse a source file, or load its tree from cacheDirectory if the text has not
+// changed since it was cached. Trees with syntax errors are reported to
+// diagnostics and not cached. Returns the source file, or NO_FILE on failure.
+// If a cache was used, cache->mapping is set and must be closed after the tree
+SourceFileId parseFileCached(const char *sourcePath, const char *cacheDirectory, Ast *ast,
+                             AstCache *cache, DiagnosticBuffer *diagnostics);
+
+#endif // AST_CACHE_H
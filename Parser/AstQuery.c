@@ -0,0 +1,558 @@
+#include "AstQuery.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "WorkPool.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wctype.h>
+
+#define MAX_PATTERN_DEPTH 64
+
+_Static_assert(AST_KIND_COUNT <= 64, "AstPattern.kinds has one bit per AstKind");
+
+// Every kind but AST_NONE
+#define ALL_KINDS ((((uint64_t)1 << (AST_KIND_COUNT - 1)) - 1) << 1)
+
+// Compiler state: the query being built and the text being read
+typedef struct {
+    AstQuery *query;
+    const wchar_t *text;
+    uint32_t pos;
+} PatternReader;
+
+static int patternError(PatternReader *reader, const char *message) {
+    if (!reader->query->error) {
+        reader->query->error = message;
+        reader->query->errorOffset = reader->pos;
+    }
+    return 0;
+}
+
+static void skipSpace(PatternReader *reader) {
+    while (iswspace((wint_t)reader->text[reader->pos])) {
+        reader->pos++;
+    }
+}
+
+static int isDelimiter(wchar_t c) {
+    return c == L'\0' || c == L'(' || c == L')' || c == L'"' || iswspace((wint_t)c);
+}
+
+// Grow an array of uint32_t by one entry
+static int pushIndex(uint32_t **items, uint32_t *count, uint32_t *capacity, uint32_t value) {
+    if (*count == *capacity) {
+        uint32_t newCapacity = *capacity ? *capacity * 2 : 16;
+        uint32_t *grown = realloc(*items, newCapacity * sizeof(uint32_t));
+        if (!grown) {
+            fprintf(stderr, "Memory allocation failed for the query!\n");
+            return 0;
+        }
+        *items = grown;
+        *capacity = newCapacity;
+    }
+    (*items)[(*count)++] = value;
+    return 1;
+}
+
+static int addPattern(PatternReader *reader, const AstPattern *pattern, uint32_t *index) {
+    AstQuery *query = reader->query;
+    if (query->patternCount == query->patternCapacity) {
+        uint32_t capacity = query->patternCapacity ? query->patternCapacity * 2 : 16;
+        AstPattern *grown = realloc(query->patterns, capacity * sizeof(AstPattern));
+        if (!grown) {
+            fprintf(stderr, "Memory allocation failed for the query!\n");
+            return patternError(reader, "Out of memory");
+        }
+        query->patterns = grown;
+        query->patternCapacity = capacity;
+    }
+    *index = query->patternCount;
+    AstPattern *added = &query->patterns[query->patternCount++];
+    *added = *pattern;
+    added->kindCount = 0;
+    for (int kind = 0; kind < AST_KIND_COUNT; kind++) {
+        added->kindCount += (uint32_t)(added->kinds >> kind & 1);
+    }
+    return 1;
+}
+
+// Does the word [start, end) of the text name an AstKind? Returns it, AST_NONE if not
+static AstKind kindNamed(const wchar_t *word, uint32_t length) {
+    for (int kind = AST_PROGRAM; kind < AST_KIND_COUNT; kind++) {
+        const char *name = astLayouts[kind].name;
+        uint32_t i = 0;
+        while (i < length && name[i] != '\0' && (wchar_t)name[i] == word[i]) {
+            i++;
+        }
+        if (i == length && name[i] == '\0') {
+            return (AstKind)kind;
+        }
+    }
+    return AST_NONE;
+}
+
+static int wordIs(const wchar_t *word, uint32_t length, const wchar_t *expected) {
+    return wcslen(expected) == length && wmemcmp(word, expected, length) == 0;
+}
+
+static int readPattern(PatternReader *reader, uint32_t depth, uint32_t *index);
+
+// Sub-patterns up to the closing ')' (which is skipped). They are collected on
+// the pending stack, above those of the enclosing patterns, and moved to the
+// operand array together so that they stay contiguous
+static int readOperands(PatternReader *reader, uint32_t depth, AstPattern *pattern) {
+    AstQuery *query = reader->query;
+    uint32_t base = query->pendingCount;
+    for (;;) {
+        skipSpace(reader);
+        if (reader->text[reader->pos] == L')') {
+            reader->pos++;
+            break;
+        }
+        if (reader->text[reader->pos] == L'\0') {
+            return patternError(reader, "Expected ')'");
+        }
+        uint32_t operand;
+        if (!readPattern(reader, depth + 1, &operand) ||
+            !pushIndex(&query->pending, &query->pendingCount, &query->pendingCapacity, operand)) {
+            return patternError(reader, "Out of memory");
+        }
+    }
+    pattern->first = query->operandCount;
+    pattern->count = query->pendingCount - base;
+    for (uint32_t i = base; i < query->pendingCount; i++) {
+        if (!pushIndex(&query->operands, &query->operandCount, &query->operandCapacity, query->pending[i])) {
+            return patternError(reader, "Out of memory");
+        }
+    }
+    query->pendingCount = base;
+    return 1;
+}
+
+// The quoted text of (Kind "text" ...): a name or an operator
+static int readText(PatternReader *reader, AstPattern *pattern) {
+    uint32_t start = ++reader->pos;  // Skip the opening quote
+    while (reader->text[reader->pos] != L'"') {
+        if (reader->text[reader->pos] == L'\0') {
+            return patternError(reader, "Unterminated text");
+        }
+        reader->pos++;
+    }
+    uint32_t length = reader->pos - start;
+    reader->pos++;
+    wchar_t *text = malloc((length + 1) * sizeof(wchar_t));
+    if (!text) {
+        fprintf(stderr, "Memory allocation failed for the query!\n");
+        return patternError(reader, "Out of memory");
+    }
+    wmemcpy(text, reader->text + start, length);
+    text[length] = L'\0';
+    int op = operatorIndex(text);
+    free(text);
+
+    int operatorKind = pattern->kind == AST_UNARY || pattern->kind == AST_BINARY || pattern->kind == AST_ASSIGN;
+    if (operatorKind && op < 0) {
+        return patternError(reader, "Unknown operator");
+    }
+    if (op >= 0) {
+        pattern->operatorId = (uint8_t)op;
+    }
+    if (!operatorKind) {
+        pattern->name = internSymbol(reader->text + start, length);
+        if (pattern->name == NO_SYMBOL) {
+            return patternError(reader, "Out of memory");
+        }
+    }
+    return 1;
+}
+
+// One pattern and everything inside it
+static int readPattern(PatternReader *reader, uint32_t depth, uint32_t *index) {
+    AstPattern pattern;
+    memset(&pattern, 0, sizeof(pattern));
+    pattern.operatorId = OPERATOR_COUNT;
+    pattern.kinds = ALL_KINDS;
+    if (depth > MAX_PATTERN_DEPTH) {
+        return patternError(reader, "Pattern nested too deeply");
+    }
+    skipSpace(reader);
+    const wchar_t *text = reader->text;
+    if (text[reader->pos] == L'_' && isDelimiter(text[reader->pos + 1])) {
+        reader->pos++;
+        pattern.op = PATTERN_ANY;
+        return addPattern(reader, &pattern, index);
+    }
+    if (text[reader->pos] != L'(') {
+        return patternError(reader, "Expected '(' or '_'");
+    }
+    reader->pos++;
+    skipSpace(reader);
+    uint32_t start = reader->pos;
+    while (!isDelimiter(text[reader->pos])) {
+        reader->pos++;
+    }
+    const wchar_t *word = text + start;
+    uint32_t length = reader->pos - start;
+
+    if (wordIs(word, length, L"has") || wordIs(word, length, L"not") || wordIs(word, length, L"or")) {
+        pattern.op = word[0] == L'h' ? PATTERN_HAS : word[0] == L'n' ? PATTERN_NOT : PATTERN_OR;
+        if (!readOperands(reader, depth, &pattern)) return 0;
+        if (pattern.count == 0 || (pattern.op != PATTERN_OR && pattern.count != 1)) {
+            return patternError(reader, pattern.op == PATTERN_OR ? "Expected alternatives after or"
+                                                                 : "Expected exactly one pattern");
+        }
+        if (pattern.op == PATTERN_OR) {
+            pattern.kinds = 0;
+            for (uint32_t i = 0; i < pattern.count; i++) {
+                pattern.kinds |= reader->query->patterns[reader->query->operands[pattern.first + i]].kinds;
+            }
+        }
+        return addPattern(reader, &pattern, index);
+    }
+
+    pattern.op = PATTERN_NODE;
+    if (wordIs(word, length, L"_")) {
+        pattern.kind = AST_KIND_COUNT;
+    } else {
+        AstKind kind = kindNamed(word, length);
+        if (kind == AST_NONE) {
+            reader->pos = start;
+            return patternError(reader, length ? "Unknown node kind" : "Expected a node kind");
+        }
+        pattern.kind = (uint8_t)kind;
+        pattern.kinds = (uint64_t)1 << kind;
+    }
+    skipSpace(reader);
+    if (text[reader->pos] == L'"' && !readText(reader, &pattern)) {
+        return 0;
+    }
+    return readOperands(reader, depth, &pattern) && addPattern(reader, &pattern, index);
+}
+
+// Compile a query
+int compileAstQuery(AstQuery *query, const wchar_t *text) {
+    memset(query, 0, sizeof(*query));
+    PatternReader reader = {query, text, 0};
+    if (!readPattern(&reader, 0, &query->root)) {
+        return 0;
+    }
+    skipSpace(&reader);
+    if (text[reader.pos] != L'\0') {
+        return patternError(&reader, "Unexpected text after the pattern");
+    }
+    return 1;
+}
+
+void freeAstQuery(AstQuery *query) {
+    free(query->patterns);
+    free(query->operands);
+    free(query->pending);
+    memset(query, 0, sizeof(*query));
+}
+
+// Bucket the nodes of order by kind (a counting sort, which keeps pre-order)
+int buildAstIndex(const Ast *ast, const AstOrder *order, AstIndex *index) {
+    memset(index, 0, sizeof(*index));
+    index->order = order;
+    index->nodeCount = ast->nodeCount;
+    index->nodes = malloc((order->count ? order->count : 1) * sizeof(uint32_t));
+    index->positions = malloc((order->count ? order->count : 1) * sizeof(uint32_t));
+    index->nodePositions = malloc((ast->nodeCount ? ast->nodeCount : 1) * sizeof(uint32_t));
+    if (!index->nodes || !index->positions || !index->nodePositions) {
+        fprintf(stderr, "Memory allocation failed for the AST index!\n");
+        freeAstIndex(index);
+        return 0;
+    }
+    memset(index->nodePositions, 0xff, ast->nodeCount * sizeof(uint32_t));
+
+    uint32_t *starts = index->starts;
+    for (uint32_t i = 0; i < order->count; i++) {
+        starts[ast->nodes[order->preorder[i]].kind + 1]++;
+    }
+    for (int kind = 0; kind < AST_KIND_COUNT; kind++) {
+        starts[kind + 1] += starts[kind];
+    }
+    uint32_t next[AST_KIND_COUNT];
+    memcpy(next, starts, sizeof(next));
+    for (uint32_t i = 0; i < order->count; i++) {
+        uint32_t node = order->preorder[i];
+        uint32_t slot = next[ast->nodes[node].kind]++;
+        index->nodes[slot] = node;
+        index->positions[slot] = i;
+        index->nodePositions[node] = i;
+    }
+    return 1;
+}
+
+void freeAstIndex(AstIndex *index) {
+    free(index->nodes);
+    free(index->positions);
+    free(index->nodePositions);
+    memset(index, 0, sizeof(*index));
+}
+
+// Name a pattern's quoted text is compared with
+static SymbolId nodeName(const Ast *ast, const AstNode *node) {
+    switch (node->kind) {
+        case AST_VAR_DECL:
+        case AST_FUNC_DECL:
+        case AST_CLASS_DECL:
+        case AST_IDENT:
+        case AST_STRING:
+            return astSymbol(ast, node->a);
+        case AST_CALL:
+            return astSymbol(ast, node->c);
+        default:
+            return NO_SYMBOL;
+    }
+}
+
+static int matchPattern(const AstQuery *query, const Ast *ast, const AstIndex *index, uint32_t pattern,
+                        uint32_t node);
+
+// Is there a node matching pattern below node? Only P's kinds are looked at,
+// and only the part of each bucket that lies inside node's subtree
+static int hasDescendant(const AstQuery *query, const Ast *ast, const AstIndex *index, uint32_t pattern,
+                         uint32_t node) {
+    uint32_t position = node < index->nodeCount ? index->nodePositions[node] : UINT32_MAX;
+    if (position == UINT32_MAX) {
+        return 0;
+    }
+    uint32_t end = index->order->subtreeEnd[position];
+    uint64_t kinds = query->patterns[pattern].kinds;
+
+    // A small subtree is cheaper to scan than to search a bucket per kind
+    if (end - position - 1 <= 16 * query->patterns[pattern].kindCount) {
+        for (uint32_t i = position + 1; i < end; i++) {
+            uint32_t descendant = index->order->preorder[i];
+            if ((kinds >> ast->nodes[descendant].kind & 1) &&
+                matchPattern(query, ast, index, pattern, descendant)) {
+                return 1;
+            }
+        }
+        return 0;
+    }
+    for (int kind = AST_PROGRAM; kind < AST_KIND_COUNT; kind++) {
+        if (!(kinds >> kind & 1)) continue;
+        // First entry of the bucket after position
+        uint32_t low = index->starts[kind], high = index->starts[kind + 1];
+        while (low < high) {
+            uint32_t middle = low + (high - low) / 2;
+            if (index->positions[middle] <= position) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        for (uint32_t i = low; i < index->starts[kind + 1] && index->positions[i] < end; i++) {
+            if (matchPattern(query, ast, index, pattern, index->nodes[i])) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int matchPattern(const AstQuery *query, const Ast *ast, const AstIndex *index, uint32_t pattern,
+                        uint32_t node) {
+    const AstPattern *p = &query->patterns[pattern];
+    const AstNode *n = &ast->nodes[node];
+    if (node == 0 || !(p->kinds >> n->kind & 1)) {
+        return 0;
+    }
+    const uint32_t *operands = query->operands + p->first;
+    switch (p->op) {
+        case PATTERN_ANY:
+            return 1;
+        case PATTERN_HAS:
+            return hasDescendant(query, ast, index, operands[0], node);
+        case PATTERN_NOT:
+            return !matchPattern(query, ast, index, operands[0], node);
+        case PATTERN_OR:
+            for (uint32_t i = 0; i < p->count; i++) {
+                if (matchPattern(query, ast, index, operands[i], node)) return 1;
+            }
+            return 0;
+        default:
+            break;
+    }
+
+    // PATTERN_NODE
+    int operatorKind = n->kind == AST_UNARY || n->kind == AST_BINARY || n->kind == AST_ASSIGN;
+    if (p->name != NO_SYMBOL || p->operatorId != OPERATOR_COUNT) {
+        if (operatorKind ? n->op != p->operatorId : nodeName(ast, n) != p->name || p->name == NO_SYMBOL) {
+            return 0;
+        }
+    }
+    if (p->count > 0 && astChildCount(ast, node) < p->count) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < p->count; i++) {
+        if (!matchPattern(query, ast, index, operands[i], astChild(ast, node, i))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int astQueryMatches(const AstQuery *query, const Ast *ast, const AstIndex *index, uint32_t node) {
+    return query->patternCount > 0 && node < ast->nodeCount && matchPattern(query, ast, index, query->root, node);
+}
+
+static int comparePositions(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Try the nodes of the query's kinds, then put the matches in source order
+uint32_t runAstQuery(const AstQuery *query, const Ast *ast, const AstIndex *index, uint32_t **matches) {
+    *matches = NULL;
+    if (query->patternCount == 0) {
+        return 0;
+    }
+    uint64_t kinds = query->patterns[query->root].kinds;
+    uint32_t *found = NULL;
+    uint32_t count = 0, capacity = 0;
+    for (int kind = AST_PROGRAM; kind < AST_KIND_COUNT; kind++) {
+        if (!(kinds >> kind & 1)) continue;
+        for (uint32_t i = index->starts[kind]; i < index->starts[kind + 1]; i++) {
+            if (matchPattern(query, ast, index, query->root, index->nodes[i]) &&
+                !pushIndex(&found, &count, &capacity, index->positions[i])) {
+                free(found);
+                return UINT32_MAX;
+            }
+        }
+    }
+    if (count > 0) {
+        qsort(found, count, sizeof(uint32_t), comparePositions);
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        found[i] = index->order->preorder[found[i]];
+    }
+    *matches = found;
+    return count;
+}
+
+// Running a query over files
+
+// Per-thread state, reused from file to file
+typedef struct {
+    Ast ast;
+} QueryWorker;
+
+// What one file produced
+typedef struct {
+    AstQueryHit *hits;
+    uint32_t count;
+    uint32_t syntaxErrors;
+    uint8_t failed;
+} FileResult;
+
+typedef struct {
+    const AstQuery *query;
+    const char *const *paths;
+    QueryWorker *workers;
+    FileResult *results;
+} FileJob;
+
+static void queryFile(void *context, uint32_t task, uint32_t worker) {
+    FileJob *job = context;
+    FileResult *result = &job->results[task];
+    Ast *ast = &job->workers[worker].ast;
+    result->failed = 1;
+    SourceFileId file = loadSourceFile(job->paths[task]);
+    if (file == NO_FILE) {
+        return;
+    }
+    TokenCollector tokens = tokenizeSourceFile(file);
+    resetAst(ast);
+    ast->failed = 0;
+    Parser parser;
+    initParser(&parser, &tokens, ast);
+    uint32_t root = parseProgram(&parser);
+    result->syntaxErrors = parser.errorCount;
+    freeParser(&parser);
+
+    AstOrder order;
+    AstIndex index;
+    if (!ast->failed && buildAstOrder(ast, root, &order)) {
+        if (buildAstIndex(ast, &order, &index)) {
+            uint32_t *matches;
+            uint32_t count = runAstQuery(job->query, ast, &index, &matches);
+            if (count != UINT32_MAX) {
+                result->hits = malloc((count ? count : 1) * sizeof(AstQueryHit));
+                if (result->hits) {
+                    for (uint32_t i = 0; i < count; i++) {
+                        uint32_t node = matches[i];
+                        result->hits[i] = (AstQueryHit){task, ast->nodes[node].kind, astLocation(ast, node),
+                                                         ast->spans[node].first, ast->spans[node].end};
+                    }
+                    result->count = count;
+                    result->failed = 0;
+                }
+                free(matches);
+            }
+            freeAstIndex(&index);
+        }
+        freeAstOrder(&order);
+    }
+    freeTokenCollector(&tokens);
+}
+
+// Query every file on the work pool, then concatenate the hits in file order
+int queryFiles(const AstQuery *query, const char *const *paths, uint32_t pathCount, uint32_t threadCount,
+               AstQueryHits *hits) {
+    memset(hits, 0, sizeof(*hits));
+    if (threadCount == 0) {
+        threadCount = defaultThreadCount();
+    }
+    if (threadCount > pathCount) {
+        threadCount = pathCount ? pathCount : 1;
+    }
+    QueryWorker *workers = calloc(threadCount, sizeof(QueryWorker));
+    FileResult *results = calloc(pathCount ? pathCount : 1, sizeof(FileResult));
+    if (!workers || !results) {
+        fprintf(stderr, "Memory allocation failed for the query!\n");
+        free(workers);
+        free(results);
+        return 0;
+    }
+    for (uint32_t w = 0; w < threadCount; w++) {
+        initAst(&workers[w].ast, 1024);
+    }
+    FileJob job = {query, paths, workers, results};
+    runWorkPool(pathCount, threadCount, queryFile, &job);
+
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < pathCount; i++) {
+        total += results[i].count;
+    }
+    hits->items = malloc((total ? total : 1) * sizeof(AstQueryHit));
+    int ok = hits->items != NULL;
+    for (uint32_t i = 0; i < pathCount; i++) {
+        if (ok && results[i].count > 0) {
+            memcpy(hits->items + hits->count, results[i].hits, results[i].count * sizeof(AstQueryHit));
+            hits->count += results[i].count;
+        }
+        hits->filesSearched += !results[i].failed;
+        hits->filesFailed += results[i].failed;
+        hits->syntaxErrors += results[i].syntaxErrors;
+        free(results[i].hits);
+    }
+    for (uint32_t w = 0; w < threadCount; w++) {
+        freeAst(&workers[w].ast);
+    }
+    free(workers);
+    free(results);
+    if (!ok) {
+        fprintf(stderr, "Memory allocation failed for the query!\n");
+    }
+    return ok;
+}
+
+void freeAstQueryHits(AstQueryHits *hits) {
+    free(hits->items);
+    memset(hits, 0, sizeof(*hits));
+}
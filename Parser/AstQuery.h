@@ -0,0 +1,126 @@
+#ifndef AST_QUERY_H
+#define AST_QUERY_H
+
+#include <stdint.h>
+#include <wchar.h>
+#include "Ast.h"
+#include "Interner.h"
+#include "Traversal.h"
+
+// Structural queries
+// A query is a tree pattern, written as an S-expression over the node names
+// printAst() shows, for finding code by its shape:
+//
+//   (LoopStatement _ _ (has (PrintStatement)))     counting चक्र loops whose body prints
+//   (or (WhileStatement _ (has (Call "फल")))
+//       (LoopStatement _ _ (has (Call "फल"))))     loops that call फल
+//   (Assignment "+=" (Identifier "क"))             every क += ...
+//   (FunctionDeclaration (Parameters _ _ _ _))     functions with four parameters or more
+//
+// Patterns:
+//   _                 any node
+//   (Kind args...)    a node of that kind (_ for any kind). An optional quoted
+//                     text first must equal the node's name (variable, function,
+//                     class, identifier, callee or string) or its operator; the
+//                     patterns after it match the node's first children in order
+//                     (astChild() order), so the node needs at least that many.
+//                     Children past the last pattern are not checked
+//   (has P)           a node with a descendant (below itself) that matches P
+//   (or P Q ...)      a node matching any of the alternatives
+//   (not P)           a node not matching P
+//
+// Queries run against an AstIndex: the reachable nodes of a tree bucketed by
+// kind, each bucket in pre-order. Only nodes of the kinds the pattern can match
+// are tried, and (has P) looks for P's kinds inside the subtree's pre-order
+// range with a binary search per bucket (or scans the range itself when the
+// subtree is smaller than that), so a query never walks the whole tree.
+// Matching recurses only as deep as the pattern is nested.
+
+typedef enum {
+    PATTERN_ANY,               // _
+    PATTERN_NODE,              // (Kind ...)
+    PATTERN_HAS,               // (has P)
+    PATTERN_OR,                // (or P ...)
+    PATTERN_NOT                // (not P)
+} PatternOp;
+
+// One pattern of a compiled query
+typedef struct {
+    uint8_t op;                // PatternOp
+    uint8_t kind;              // PATTERN_NODE: AstKind, AST_KIND_COUNT for any kind
+    uint8_t operatorId;        // PATTERN_NODE: required OperatorId (OPERATOR_COUNT = any)
+    SymbolId name;             // PATTERN_NODE: required name (NO_SYMBOL = any)
+    uint32_t first;            // Sub-patterns: operands[first .. first + count)
+    uint32_t count;
+    uint64_t kinds;            // Bit per AstKind a matching node can have
+    uint32_t kindCount;        // Bits set in kinds
+} AstPattern;
+
+typedef struct {
+    AstPattern *patterns;
+    uint32_t patternCount;
+    uint32_t patternCapacity;
+    uint32_t *operands;        // Sub-pattern indices, each pattern's contiguous
+    uint32_t operandCount;
+    uint32_t operandCapacity;
+    uint32_t *pending;         // Sub-patterns of unfinished patterns while compiling
+    uint32_t pendingCount;
+    uint32_t pendingCapacity;
+    uint32_t root;             // The whole query
+    const char *error;         // Why the text did not compile (NULL if it did)
+    uint32_t errorOffset;      // Character of the text where it was found
+} AstQuery;
+
+// Reachable nodes of a tree by kind, for running queries on it
+typedef struct {
+    const AstOrder *order;     // Order the index was built from (not owned)
+    uint32_t *nodes;           // Nodes bucketed by kind, each bucket in pre-order
+    uint32_t *positions;       // Pre-order position of each bucket entry
+    uint32_t starts[AST_KIND_COUNT + 1]; // Bucket of kind k: [starts[k], starts[k + 1])
+    uint32_t *nodePositions;   // By node: pre-order position (UINT32_MAX if unreachable)
+    uint32_t nodeCount;
+} AstIndex;
+
+// One match of a query over files
+typedef struct {
+    uint32_t file;             // Index of the file in the caller's list
+    uint8_t kind;              // AstKind of the matching node
+    SourceLocation location;   // Where the node starts (NO_LOCATION if unknown)
+    uint32_t firstToken;       // Its tokens [firstToken, endToken)
+    uint32_t endToken;
+} AstQueryHit;
+
+typedef struct {
+    AstQueryHit *items;        // In file order, each file's in source order
+    uint32_t count;
+    uint32_t filesSearched;
+    uint32_t filesFailed;      // Files that could not be read or parsed
+    uint32_t syntaxErrors;     // In the files searched (their trees are still queried)
+} AstQueryHits;
+
+// Compile the pattern text. Returns 1 on success; otherwise 0 with query->error
+// and query->errorOffset set. The query must be freed either way
+int compileAstQuery(AstQuery *query, const wchar_t *text);
+
+void freeAstQuery(AstQuery *query);
+
+// Index the nodes reachable in order. Returns 1 on success, 0 if out of memory
+int buildAstIndex(const Ast *ast, const AstOrder *order, AstIndex *index);
+
+void freeAstIndex(AstIndex *index);
+
+// Does node match the whole query?
+int astQueryMatches(const AstQuery *query, const Ast *ast, const AstIndex *index, uint32_t node);
+
+// Find every matching node, in source order. Stores a malloc'd array in *matches
+// (NULL if there are none) and returns the count; UINT32_MAX if out of memory
+uint32_t runAstQuery(const AstQuery *query, const Ast *ast, const AstIndex *index, uint32_t **matches);
+
+// Load, parse and query every file of paths on threadCount threads (0 = one per
+// CPU). Fills hits (free with freeAstQueryHits). Returns 1 on success, 0 if out of memory
+int queryFiles(const AstQuery *query, const char *const *paths, uint32_t pathCount, uint32_t threadCount,
+               AstQueryHits *hits);
+
+void freeAstQueryHits(AstQueryHits *hits);
+
+#endif // AST_QUERY_H
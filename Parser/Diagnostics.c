@@ -0,0 +1,70 @@
+#include "Diagnostics.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *severityNames[] = {"error", "warning", "note"};
+
+// Prepare an empty buffer
+void initDiagnostics(DiagnosticBuffer *buffer) {
+    memset(buffer, 0, sizeof(*buffer));
+}
+
+// Free the buffer's memory
+void freeDiagnostics(DiagnosticBuffer *buffer) {
+    free(buffer->items);
+    memset(buffer, 0, sizeof(*buffer));
+}
+
+// Forget every entry but keep the memory
+void clearDiagnostics(DiagnosticBuffer *buffer) {
+    buffer->count = 0;
+    buffer->errorCount = 0;
+    buffer->dropped = 0;
+}
+
+// Append an entry. Returns 1 if it was recorded, 0 if dropped
+int addDiagnostic(DiagnosticBuffer *buffer, DiagnosticSeverity severity, SourceLocation location,
+                  uint32_t token, SymbolId symbol, const char *message) {
+    if (severity == DIAGNOSTIC_ERROR) {
+        buffer->errorCount++;
+    }
+    if (buffer->limit > 0 && buffer->count >= buffer->limit) {
+        buffer->dropped++;
+        return 0;
+    }
+    if (buffer->count == buffer->capacity) {
+        uint32_t newCapacity = buffer->capacity ? buffer->capacity * 2 : 16;
+        Diagnostic *grown = realloc(buffer->items, newCapacity * sizeof(Diagnostic));
+        if (!grown) {
+            fprintf(stderr, "Memory allocation failed for diagnostics!\n");
+            buffer->dropped++;
+            return 0;
+        }
+        buffer->items = grown;
+        buffer->capacity = newCapacity;
+    }
+    buffer->items[buffer->count++] = (Diagnostic){(uint8_t)severity, location, token, symbol, message};
+    return 1;
+}
+
+// Print every entry as "file:line:column: error: message", one per line.
+// Entries without a known location are printed with their token index instead
+void printDiagnostics(const DiagnosticBuffer *buffer, FILE *out) {
+    for (uint32_t i = 0; i < buffer->count; i++) {
+        const Diagnostic *d = &buffer->items[i];
+        DecodedLocation where;
+        if (decodeLocation(d->location, &where)) {
+            fprintf(out, "%s:%u:%u: ", where.name, where.line, where.column);
+        } else {
+            fprintf(out, "token %u: ", d->token);
+        }
+        fprintf(out, "%s: %s", severityNames[d->severity], d->message);
+        if (d->symbol != NO_SYMBOL) {
+            fprintf(out, " '%ls'", symbolText(d->symbol));
+        }
+        fputc('\n', out);
+    }
+    if (buffer->dropped > 0) {
+        fprintf(out, "... %u more not shown\n", buffer->dropped);
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "SourceManager.h"  // For SourceLocation
+#include "Interner.h"       // For SymbolId
+
+// Diagnostics buffer
+// Passes append errors and warnings here instead of printing them, so one run
+// over a file collects every problem and the caller decides how to report them.
+// Messages are not copied: they must be string literals (or otherwise outlive
+// the buffer). A name can be attached as a SymbolId and is printed after the message.
+
+typedef enum {
+    DIAGNOSTIC_ERROR,
+    DIAGNOSTIC_WARNING,
+    DIAGNOSTIC_NOTE
+} DiagnosticSeverity;
+
+typedef struct {
+    uint8_t severity;          // DiagnosticSeverity
+    SourceLocation location;   // Where the problem is (NO_LOCATION if unknown)
+    uint32_t token;            // Index of the token in its TokenCollector
+    SymbolId symbol;           // Name the message is about (NO_SYMBOL if none)
+    const char *message;       // Static description of the problem
+} Diagnostic;
+
+typedef struct {
+    Diagnostic *items;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t errorCount;       // Entries with DIAGNOSTIC_ERROR
+    uint32_t limit;            // Stop recording after this many entries (0 = no limit)
+    uint32_t dropped;          // Entries not recorded because of the limit
+} DiagnosticBuffer;
+
+// Prepare an empty buffer
+void initDiagnostics(DiagnosticBuffer *buffer);
+
+// Free the buffer's memory
+void freeDiagnostics(DiagnosticBuffer *buffer);
+
+// Forget every entry but keep the memory
+void clearDiagnostics(DiagnosticBuffer *buffer);
+
+// Append an entry. Returns 1 if it was recorded, 0 if dropped
+int addDiagnostic(DiagnosticBuffer *buffer, DiagnosticSeverity severity, SourceLocation location,
+                  uint32_t token, SymbolId symbol, const char *message);
+
+// Print every entry as "file:line:column: error: message", one per line
+void printDiagnostics(const DiagnosticBuffer *buffer, FILE *out);
+
+#endif // DIAGNOSTICS_H
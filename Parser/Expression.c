@@ -0,0 +1,308 @@
+#include "Parser.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Expression parser
+// Operator precedence is resolved with an operand stack and an operator stack
+// (precedence climbing without recursion): every token is shifted or reduced
+// exactly once, so a chain of n operators is parsed in O(n) time and constant
+// C stack, however long the chain or deep the parentheses.
+
+// Binding powers, weakest to strongest
+enum {
+    POWER_NONE = 0,
+    POWER_ASSIGNMENT = 2,      // = += -= *= /=   (right-associative)
+    POWER_CONDITIONAL = 4,     // ? :             (right-associative)
+    POWER_AND = 6,             // &&
+    POWER_EQUALITY = 8,        // == !=
+    POWER_RELATIONAL = 10,     // < > <= >=
+    POWER_ADDITIVE = 12,       // + -
+    POWER_MULTIPLICATIVE = 14, // * /
+    POWER_PREFIX = 16          // ! - + न
+};
+
+// How an operator binds, indexed by OperatorId (the order of operators[] in utils.c).
+//   left:   power towards the operand on its left (0 = not a binary operator)
+//   right:  power towards the operand on its right; left + 1 makes the operator
+//           left-associative, right == left makes it right-associative
+//   prefix: can also be used as a prefix operator
+typedef struct {
+    uint8_t left;
+    uint8_t right;
+    uint8_t prefix;
+} OperatorPower;
+
+static const OperatorPower operatorPowers[] = {
+    [OPERATOR_PLUS]          = {POWER_ADDITIVE, POWER_ADDITIVE + 1, 1},
+    [OPERATOR_MINUS]         = {POWER_ADDITIVE, POWER_ADDITIVE + 1, 1},
+    [OPERATOR_STAR]          = {POWER_MULTIPLICATIVE, POWER_MULTIPLICATIVE + 1, 0},
+    [OPERATOR_SLASH]         = {POWER_MULTIPLICATIVE, POWER_MULTIPLICATIVE + 1, 0},
+    [OPERATOR_ASSIGN]        = {POWER_ASSIGNMENT, POWER_ASSIGNMENT, 0},
+    [OPERATOR_GREATER]       = {POWER_RELATIONAL, POWER_RELATIONAL + 1, 0},
+    [OPERATOR_LESS]          = {POWER_RELATIONAL, POWER_RELATIONAL + 1, 0},
+    [OPERATOR_GREATER_EQUAL] = {POWER_RELATIONAL, POWER_RELATIONAL + 1, 0},
+    [OPERATOR_LESS_EQUAL]    = {POWER_RELATIONAL, POWER_RELATIONAL + 1, 0},
+    [OPERATOR_EQUAL]         = {POWER_EQUALITY, POWER_EQUALITY + 1, 0},
+    [OPERATOR_NOT_EQUAL]     = {POWER_EQUALITY, POWER_EQUALITY + 1, 0},
+    [OPERATOR_AND]           = {POWER_AND, POWER_AND + 1, 0},
+    [OPERATOR_SEMICOLON]     = {POWER_NONE, POWER_NONE, 0},   // Ends a statement
+    [OPERATOR_NOT]           = {POWER_NONE, POWER_NONE, 1},
+    [OPERATOR_QUESTION]      = {POWER_CONDITIONAL, POWER_CONDITIONAL, 0},
+    [OPERATOR_PLUS_ASSIGN]   = {POWER_ASSIGNMENT, POWER_ASSIGNMENT, 0},
+    [OPERATOR_MINUS_ASSIGN]  = {POWER_ASSIGNMENT, POWER_ASSIGNMENT, 0},
+    [OPERATOR_STAR_ASSIGN]   = {POWER_ASSIGNMENT, POWER_ASSIGNMENT, 0},
+    [OPERATOR_SLASH_ASSIGN]  = {POWER_ASSIGNMENT, POWER_ASSIGNMENT, 0},
+};
+
+// Every entry of operators[] must have a binding power
+_Static_assert(sizeof(operatorPowers) / sizeof(operatorPowers[0]) == OPERATOR_COUNT,
+               "operatorPowers must have one entry per operator in operators[]");
+
+// Kinds of entries on the operator stack
+enum {
+    FRAME_PREFIX,          // Prefix operator waiting for its operand
+    FRAME_BINARY,          // Binary operator waiting for its right operand
+    FRAME_THEN,            // "cond ?" waiting for the value and ':'
+    FRAME_ELSE,            // "cond ? value :" waiting for the last value
+    FRAME_GROUP,           // '(' waiting for ')'
+    FRAME_CALL             // "name(" waiting for arguments and ')'
+};
+
+// Is the operator an assignment (= += -= *= /=)?
+static int isAssignment(uint8_t op) {
+    return op == OPERATOR_ASSIGN || op == OPERATOR_PLUS_ASSIGN || op == OPERATOR_MINUS_ASSIGN ||
+           op == OPERATOR_STAR_ASSIGN || op == OPERATOR_SLASH_ASSIGN;
+}
+
+// Push a node onto the operand stack
+static int pushOperand(Parser *parser, uint32_t node) {
+    if (parser->operandCount == parser->operandCapacity) {
+        uint32_t newCapacity = parser->operandCapacity ? parser->operandCapacity * 2 : 64;
+        uint32_t *grown = realloc(parser->operands, newCapacity * sizeof(uint32_t));
+        if (!grown) {
+            fprintf(stderr, "Memory allocation failed for expression stack!\n");
+            return 0;
+        }
+        parser->operands = grown;
+        parser->operandCapacity = newCapacity;
+    }
+    parser->operands[parser->operandCount++] = node;
+    return 1;
+}
+
+// Push an entry onto the operator stack
+static int pushFrame(Parser *parser, ExprFrame frame) {
+    if (parser->frameCount == parser->frameCapacity) {
+        uint32_t newCapacity = parser->frameCapacity ? parser->frameCapacity * 2 : 32;
+        ExprFrame *grown = realloc(parser->frames, newCapacity * sizeof(ExprFrame));
+        if (!grown) {
+            fprintf(stderr, "Memory allocation failed for expression stack!\n");
+            return 0;
+        }
+        parser->frames = grown;
+        parser->frameCapacity = newCapacity;
+    }
+    parser->frames[parser->frameCount++] = frame;
+    return 1;
+}
+
+// Create a leaf node for the current token and push it
+static int shiftLeaf(Parser *parser, AstKind kind, uint32_t a, uint32_t b) {
+    uint32_t node = astAddNode(parser->ast, kind, 0, currentLocation(parser), a, b, 0);
+    astSetSpan(parser->ast, node, parser->pos, parser->pos + 1);
+    advanceToken(parser);
+    return node != 0 && pushOperand(parser, node);
+}
+
+// Pop the operator on top of the stack together with its operands and push the result
+static int reduceOperator(Parser *parser) {
+    ExprFrame frame = parser->frames[--parser->frameCount];
+    Ast *ast = parser->ast;
+    uint32_t node;
+
+    if (frame.kind == FRAME_PREFIX) {
+        uint32_t operand = parser->operands[--parser->operandCount];
+        node = astAddNode(ast, AST_UNARY, frame.op, frame.location, operand, 0, 0);
+        astSetSpan(ast, node, frame.firstToken, ast->spans[operand].end);
+    } else if (frame.kind == FRAME_BINARY) {
+        uint32_t right = parser->operands[--parser->operandCount];
+        uint32_t left = parser->operands[--parser->operandCount];
+        if (isAssignment(frame.op) && ast->nodes[left].kind != AST_IDENT) {
+            parserReport(parser, ast->spans[left].first, "Left side of an assignment must be a variable");
+        }
+        node = astAddNode(ast, isAssignment(frame.op) ? AST_ASSIGN : AST_BINARY, frame.op,
+                          frame.location, left, right, 0);
+        astSetSpan(ast, node, ast->spans[left].first, ast->spans[right].end);
+    } else {
+        // FRAME_ELSE: condition, value if true, value if false
+        uint32_t otherwise = parser->operands[--parser->operandCount];
+        uint32_t then = parser->operands[--parser->operandCount];
+        uint32_t condition = parser->operands[--parser->operandCount];
+        node = astAddNode(ast, AST_TERNARY, 0, frame.location, condition, then, otherwise);
+        astSetSpan(ast, node, ast->spans[condition].first, ast->spans[otherwise].end);
+    }
+    return node != 0 && pushOperand(parser, node);
+}
+
+// Reduce operators above frameBase that bind tighter than power.
+// Groups, calls and an open '?' stop the reduction
+static int reduceWhileStronger(Parser *parser, uint32_t frameBase, uint8_t power) {
+    while (parser->frameCount > frameBase) {
+        const ExprFrame *top = &parser->frames[parser->frameCount - 1];
+        if (top->kind != FRAME_PREFIX && top->kind != FRAME_BINARY && top->kind != FRAME_ELSE) {
+            break;
+        }
+        if (top->power <= power) {
+            break;
+        }
+        if (!reduceOperator(parser)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Turn an open call frame and its arguments into an AST_CALL node
+static int finishCall(Parser *parser) {
+    ExprFrame frame = parser->frames[--parser->frameCount];
+    uint32_t argumentCount = parser->operandCount - frame.operandBase;
+    uint32_t list = astAddList(parser->ast, &parser->operands[frame.operandBase], argumentCount);
+    parser->operandCount = frame.operandBase;
+
+    uint32_t node = astAddNode(parser->ast, AST_CALL, 0, frame.location, list, argumentCount, frame.symbol);
+    astSetSpan(parser->ast, node, frame.firstToken, parser->pos + 1);
+    advanceToken(parser);  // Skip ')'
+    return node != 0 && pushOperand(parser, node);
+}
+
+// Parse one expression starting at the current token
+uint32_t parseExpression(Parser *parser) {
+    uint32_t operandBase = parser->operandCount;
+    uint32_t frameBase = parser->frameCount;
+    uint32_t firstToken = parser->pos;
+    int expectOperand = 1;  // Alternates between operands and operators
+    int ok = 1;
+
+    while (ok) {
+        TokenType type = peekType(parser, 0);
+        uint32_t payload = peekPayload(parser, 0);
+
+        if (expectOperand) {
+            // Operand position: a literal, a name, a call, '(' or a prefix operator
+            if (type == TOKEN_NUMBER) {
+                int64_t value = numberValue(parser, payload);
+                ok = shiftLeaf(parser, AST_NUMBER, (uint32_t)((uint64_t)value & 0xFFFFFFFFu),
+                               (uint32_t)((uint64_t)value >> 32));
+                expectOperand = 0;
+            } else if (type == TOKEN_STRING) {
+                ok = shiftLeaf(parser, AST_STRING, payload, 0);
+                expectOperand = 0;
+            } else if (type == TOKEN_BOOLEAN) {
+                ok = shiftLeaf(parser, AST_BOOL, payload, 0);
+                expectOperand = 0;
+            } else if (type == TOKEN_wchar_t) {
+                ok = shiftLeaf(parser, AST_CHAR, payload, 0);
+                expectOperand = 0;
+            } else if (isNameToken(type) && peekType(parser, 1) == TOKEN_SPECIAL_SYMBOL &&
+                       peekPayload(parser, 1) == SPECIAL_LPAREN) {
+                // name( starts a call; its arguments are parsed as operands above operandBase
+                ExprFrame frame = {FRAME_CALL, 0, POWER_NONE, currentLocation(parser), parser->pos,
+                                   parser->operandCount, payload};
+                ok = pushFrame(parser, frame);
+                advanceToken(parser);
+                advanceToken(parser);
+                if (ok && atSpecial(parser, SPECIAL_RPAREN)) {
+                    ok = finishCall(parser);  // No arguments
+                    expectOperand = 0;
+                }
+            } else if (isNameToken(type)) {
+                ok = shiftLeaf(parser, AST_IDENT, payload, 0);
+                expectOperand = 0;
+            } else if (type == TOKEN_SPECIAL_SYMBOL && payload == SPECIAL_LPAREN) {
+                ExprFrame frame = {FRAME_GROUP, 0, POWER_NONE, currentLocation(parser), parser->pos, 0, 0};
+                ok = pushFrame(parser, frame);
+                advanceToken(parser);
+            } else if ((type == TOKEN_OPERATOR && payload < OPERATOR_COUNT && operatorPowers[payload].prefix) ||
+                       (type == TOKEN_KEYWORD && payload == KEYWORD_NA)) {
+                // न is the Sanskrit spelling of !
+                uint8_t op = type == TOKEN_KEYWORD ? OPERATOR_NOT : (uint8_t)payload;
+                ExprFrame frame = {FRAME_PREFIX, op, POWER_PREFIX, currentLocation(parser), parser->pos, 0, 0};
+                ok = pushFrame(parser, frame);
+                advanceToken(parser);
+            } else {
+                parserError(parser, "Expected an expression");
+                ok = 0;
+            }
+            continue;
+        }
+
+        // Operator position: a binary operator, '?', ':', ',' or ')' - or the end
+        if (type == TOKEN_OPERATOR && payload == OPERATOR_QUESTION) {
+            ok = reduceWhileStronger(parser, frameBase, POWER_CONDITIONAL);
+            ExprFrame frame = {FRAME_THEN, 0, POWER_NONE, currentLocation(parser), parser->pos, 0, 0};
+            ok = ok && pushFrame(parser, frame);
+            advanceToken(parser);
+            expectOperand = 1;
+        } else if (type == TOKEN_OPERATOR && payload < OPERATOR_COUNT && operatorPowers[payload].left > 0) {
+            const OperatorPower *power = &operatorPowers[payload];
+            ok = reduceWhileStronger(parser, frameBase, power->left);
+            ExprFrame frame = {FRAME_BINARY, (uint8_t)payload, power->right, currentLocation(parser), parser->pos, 0, 0};
+            ok = ok && pushFrame(parser, frame);
+            advanceToken(parser);
+            expectOperand = 1;
+        } else if (type == TOKEN_SPECIAL_SYMBOL && payload == SPECIAL_COLON) {
+            // ':' continues the innermost "cond ?", otherwise it ends the expression
+            ok = reduceWhileStronger(parser, frameBase, POWER_NONE);
+            if (!ok || parser->frameCount == frameBase || parser->frames[parser->frameCount - 1].kind != FRAME_THEN) {
+                break;
+            }
+            ExprFrame *frame = &parser->frames[parser->frameCount - 1];
+            frame->kind = FRAME_ELSE;
+            frame->power = POWER_CONDITIONAL;
+            advanceToken(parser);
+            expectOperand = 1;
+        } else if (type == TOKEN_SPECIAL_SYMBOL && (payload == SPECIAL_COMMA || payload == SPECIAL_RPAREN)) {
+            // ',' separates call arguments, ')' closes a group or a call;
+            // if neither is open the token belongs to the enclosing statement
+            ok = reduceWhileStronger(parser, frameBase, POWER_NONE);
+            if (!ok || parser->frameCount == frameBase) {
+                break;
+            }
+            uint8_t open = parser->frames[parser->frameCount - 1].kind;
+            if (payload == SPECIAL_COMMA && open == FRAME_CALL) {
+                advanceToken(parser);
+                expectOperand = 1;
+            } else if (payload == SPECIAL_RPAREN && open == FRAME_GROUP) {
+                parser->frameCount--;
+                advanceToken(parser);
+            } else if (payload == SPECIAL_RPAREN && open == FRAME_CALL) {
+                ok = finishCall(parser);
+            } else {
+                break;
+            }
+        } else {
+            break;  // Anything else ends the expression
+        }
+    }
+
+    // Reduce what is left; an open group, call or '?' is an error
+    if (ok) {
+        ok = reduceWhileStronger(parser, frameBase, POWER_NONE);
+        if (ok && parser->frameCount > frameBase) {
+            uint8_t open = parser->frames[parser->frameCount - 1].kind;
+            parserError(parser, open == FRAME_THEN ? "Expected ':' in conditional expression" : "Expected ')'");
+            ok = 0;
+        }
+    }
+
+    uint32_t result;
+    if (ok && parser->operandCount == operandBase + 1) {
+        result = parser->operands[operandBase];
+    } else {
+        result = astAddNode(parser->ast, AST_ERROR, 0, parserTokenLocation(parser, firstToken), 0, 0, 0);
+        astSetSpan(parser->ast, result, firstToken, parser->pos > firstToken ? parser->pos : firstToken + 1);
+    }
+    parser->operandCount = operandBase;
+    parser->frameCount = frameBase;
+    return result;
+}
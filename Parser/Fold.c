@@ -0,0 +1,223 @@
+#include "Fold.h"
+#include "utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Set on statements that folded away to nothing; their block drops them
+#define FOLD_REMOVED 1
+
+typedef struct {
+    Ast *ast;
+    FoldStats stats;
+} Folder;
+
+// Replace a node by a number
+static void makeNumber(AstNode *n, int64_t value) {
+    n->kind = AST_NUMBER;
+    n->op = 0;
+    astSetNumberValue(n, value);
+    n->c = 0;
+}
+
+// Replace a node by सत्य or असत्य
+static void makeBool(AstNode *n, int value) {
+    n->kind = AST_BOOL;
+    n->op = 0;
+    n->a = value != 0;
+    n->b = n->c = 0;
+}
+
+// Replace a node by one of its children
+static void replaceByChild(Folder *folder, uint32_t node, uint32_t child) {
+    Ast *ast = folder->ast;
+    ast->nodes[node] = ast->nodes[child];
+    if (ast->spans) {
+        ast->spans[node] = ast->spans[child];
+    }
+}
+
+// Replace a statement by nothing
+static void removeStatement(Ast *ast, uint32_t node) {
+    AstNode *n = &ast->nodes[node];
+    n->kind = AST_BLOCK;
+    n->op = 0;
+    n->flags |= FOLD_REMOVED;
+    n->a = n->b = n->c = 0;
+}
+
+// Wrapping arithmetic without signed overflow
+static int64_t wrapping(uint64_t value) {
+    return (int64_t)value;
+}
+
+// Fold an operator over two numbers. Returns 0 if it cannot be folded
+static int foldNumbers(AstNode *n, int64_t left, int64_t right) {
+    switch (n->op) {
+        case OPERATOR_PLUS:          makeNumber(n, wrapping((uint64_t)left + (uint64_t)right)); return 1;
+        case OPERATOR_MINUS:         makeNumber(n, wrapping((uint64_t)left - (uint64_t)right)); return 1;
+        case OPERATOR_STAR:          makeNumber(n, wrapping((uint64_t)left * (uint64_t)right)); return 1;
+        case OPERATOR_SLASH:
+            if (right == 0 || (left == INT64_MIN && right == -1)) {
+                return 0;  // Fails at run time
+            }
+            makeNumber(n, left / right);
+            return 1;
+        case OPERATOR_GREATER:       makeBool(n, left > right); return 1;
+        case OPERATOR_LESS:          makeBool(n, left < right); return 1;
+        case OPERATOR_GREATER_EQUAL: makeBool(n, left >= right); return 1;
+        case OPERATOR_LESS_EQUAL:    makeBool(n, left <= right); return 1;
+        case OPERATOR_EQUAL:         makeBool(n, left == right); return 1;
+        case OPERATOR_NOT_EQUAL:     makeBool(n, left != right); return 1;
+        default:                     return 0;
+    }
+}
+
+// Fold an operator over two literals of the same kind. Returns 1 if folded
+static int foldBinary(AstNode *n, const AstNode *left, const AstNode *right) {
+    if (left->kind != right->kind) {
+        return 0;  // Mismatched types are the type checker's to report
+    }
+    switch (left->kind) {
+        case AST_NUMBER:
+            return foldNumbers(n, astNumberValue(left), astNumberValue(right));
+        case AST_CHAR:
+            if (n->op == OPERATOR_PLUS || n->op == OPERATOR_MINUS ||
+                n->op == OPERATOR_STAR || n->op == OPERATOR_SLASH) {
+                return 0;
+            }
+            return foldNumbers(n, left->a, right->a);
+        case AST_BOOL:
+        case AST_STRING:
+            if (n->op == OPERATOR_AND && left->kind == AST_BOOL) {
+                makeBool(n, left->a && right->a);
+                return 1;
+            }
+            // Interned strings are equal exactly when their symbols are
+            if (n->op == OPERATOR_EQUAL || n->op == OPERATOR_NOT_EQUAL) {
+                int equal = left->a == right->a;
+                makeBool(n, n->op == OPERATOR_EQUAL ? equal : !equal);
+                return 1;
+            }
+            return 0;
+        default:
+            return 0;
+    }
+}
+
+// Drop removed statements from a statement list
+static void compactList(Folder *folder, AstNode *n) {
+    Ast *ast = folder->ast;
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < n->b; i++) {
+        uint32_t item = ast->lists[n->a + i];
+        if (ast->nodes[item].flags & FOLD_REMOVED) {
+            folder->stats.removed++;
+            continue;
+        }
+        ast->lists[n->a + kept++] = item;
+    }
+    n->b = kept;
+}
+
+// Visitor functions: each folds a node whose children are already folded
+static int foldUnary(void *context, uint32_t node) {
+    Folder *folder = context;
+    AstNode *n = &folder->ast->nodes[node];
+    const AstNode *operand = &folder->ast->nodes[n->a];
+    if (n->op == OPERATOR_MINUS && operand->kind == AST_NUMBER) {
+        makeNumber(n, wrapping(0 - (uint64_t)astNumberValue(operand)));
+        folder->stats.expressions++;
+    } else if (n->op == OPERATOR_NOT && operand->kind == AST_BOOL) {
+        makeBool(n, !operand->a);
+        folder->stats.expressions++;
+    }
+    return 1;
+}
+
+static int foldBinaryNode(void *context, uint32_t node) {
+    Folder *folder = context;
+    AstNode *n = &folder->ast->nodes[node];
+    if (foldBinary(n, &folder->ast->nodes[n->a], &folder->ast->nodes[n->b])) {
+        folder->stats.expressions++;
+    }
+    return 1;
+}
+
+static int foldTernary(void *context, uint32_t node) {
+    Folder *folder = context;
+    const AstNode *n = &folder->ast->nodes[node];
+    const AstNode *condition = &folder->ast->nodes[n->a];
+    if (condition->kind == AST_BOOL) {
+        replaceByChild(folder, node, condition->a ? n->b : n->c);
+        folder->stats.branches++;
+    }
+    return 1;
+}
+
+static int foldIf(void *context, uint32_t node) {
+    Folder *folder = context;
+    const AstNode *n = &folder->ast->nodes[node];
+    const AstNode *condition = &folder->ast->nodes[n->a];
+    if (condition->kind == AST_BOOL) {
+        uint32_t taken = condition->a ? n->b : n->c;
+        if (taken) {
+            // The then block, the else block or the next यदि of the chain
+            replaceByChild(folder, node, taken);
+        } else {
+            removeStatement(folder->ast, node);
+        }
+        folder->stats.branches++;
+    }
+    return 1;
+}
+
+static int foldWhile(void *context, uint32_t node) {
+    Folder *folder = context;
+    const AstNode *condition = &folder->ast->nodes[folder->ast->nodes[node].a];
+    if (condition->kind == AST_BOOL && !condition->a) {
+        removeStatement(folder->ast, node);
+        folder->stats.branches++;
+    }
+    return 1;
+}
+
+static int foldList(void *context, uint32_t node) {
+    Folder *folder = context;
+    compactList(folder, &folder->ast->nodes[node]);
+    return 1;
+}
+
+// A fold only rewrites the node being left, whose subtree has been visited
+// already, so the order stays good for the rest of the walk
+static const AstVisitor foldVisitor = {
+    .leave = {
+        [AST_UNARY] = foldUnary,
+        [AST_BINARY] = foldBinaryNode,
+        [AST_TERNARY] = foldTernary,
+        [AST_IF] = foldIf,
+        [AST_WHILE] = foldWhile,
+        [AST_PROGRAM] = foldList,
+        [AST_BLOCK] = foldList,
+    },
+};
+
+// Fold every constant expression and dead branch below ast->root
+uint32_t foldConstants(Ast *ast, const AstOrder *order, FoldStats *stats) {
+    Folder folder;
+    memset(&folder, 0, sizeof(folder));
+    folder.ast = ast;
+    AstOrder ownOrder;
+    if (ast->readOnly) {
+        fprintf(stderr, "Cannot fold a read-only tree\n");
+    } else if (order) {
+        // Post-order: operands are folded before the operators that use them
+        visitPostorder(ast, order, &foldVisitor, &folder);
+    } else if (buildAstOrder(ast, ast->root, &ownOrder)) {
+        visitPostorder(ast, &ownOrder, &foldVisitor, &folder);
+        freeAstOrder(&ownOrder);
+    }
+    if (stats) {
+        *stats = folder.stats;
+    }
+    return folder.stats.expressions + folder.stats.branches;
+}
@@ -0,0 +1,38 @@
+#ifndef FOLD_H
+#define FOLD_H
+
+#include <stdint.h>
+#include "Ast.h"
+#include "Traversal.h"
+
+// Constant folding
+// Rewrites a tree in place, after it has been resolved and type checked:
+// operators whose operands are all literals become the literal they evaluate
+// to, whatever digits the numbers were written in (५ + ३ and 5 + 3 both become
+// 8), and branches that can never run are cut off:
+//   यदि (सत्य) A अन्यथा B      becomes A
+//   यदि (असत्य) A अन्यथा B     becomes B (or disappears without an अन्यथा)
+//   चक्र (असत्य) A             disappears
+//   सत्य ? x : y              becomes x
+// Removed code is never compiled, but it was checked: folding first would let
+// a program with an error in a dead branch (सत्य ? 1 : "दो") compile. Resolutions
+// and types are per node, so the folded tree has to be resolved and checked again.
+//
+// A node is folded by overwriting it, so the parent's reference stays valid; the
+// operands left behind are unreachable. Operations that would fail at run time
+// (division by zero) are left for the VM to report. Integer arithmetic wraps
+// around like the machine's.
+
+typedef struct {
+    uint32_t expressions;      // Operators replaced by their value
+    uint32_t branches;         // यदि / चक्र / ?: decided at compile time
+    uint32_t removed;          // Statements dropped from their block
+} FoldStats;
+
+// Fold every constant expression and dead branch below ast->root, visiting the
+// nodes in order (NULL: build one for the call). Folding changes the tree's
+// shape, so the order is stale afterwards. stats may be NULL. Returns the number
+// of nodes rewritten (0 for read-only trees)
+uint32_t foldConstants(Ast *ast, const AstOrder *order, FoldStats *stats);
+
+#endif // FOLD_H
@@ -0,0 +1,278 @@
+#include "Interner.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The top bits of a symbol's hash pick one of these shards
+#define SHARD_BITS 6
+#define SHARD_COUNT (1u << SHARD_BITS)
+
+// Entries are stored in fixed-size chunks that never move once allocated,
+// so symbolText() can read them without taking the shard lock
+#define CHUNK_BITS 10
+#define CHUNK_SIZE (1u << CHUNK_BITS)
+#define MAX_CHUNKS 4096
+
+// Symbol text is copied into large blocks instead of one malloc per symbol
+#define TEXT_BLOCK_SIZE 65536
+
+// One interned symbol
+typedef struct {
+    const wchar_t *text;   // Null-terminated copy of the text
+    uint32_t length;       // Length in characters
+    uint32_t hash;         // Full hash, compared before the text
+} SymbolEntry;
+
+// A block of symbol text storage
+typedef struct TextBlock {
+    struct TextBlock *next;
+    size_t used;
+    size_t size;
+    wchar_t data[];
+} TextBlock;
+
+// One independently locked part of the interner
+typedef struct {
+    pthread_mutex_t lock;
+    uint32_t *slots;                      // Open-addressing table of (local index + 1), 0 = empty
+    uint32_t slotCapacity;                // Power of two
+    atomic_uint count;                    // Entries in this shard
+    SymbolEntry *chunks[MAX_CHUNKS];      // Entry storage, indexed by local index
+    TextBlock *text;                      // Newest text block first
+} InternerShard;
+
+static InternerShard shards[SHARD_COUNT];
+static pthread_once_t shardsOnce = PTHREAD_ONCE_INIT;
+
+// Create the shard locks (runs once per process)
+static void initShards(void) {
+    for (uint32_t s = 0; s < SHARD_COUNT; s++) {
+        pthread_mutex_init(&shards[s].lock, NULL);
+    }
+}
+
+// FNV-1a over the characters of the text
+static uint32_t hashText(const wchar_t *text, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (uint32_t)text[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// A SymbolId packs the shard into the low bits so that IDs from all shards
+// interleave into one dense range
+static SymbolId makeSymbolId(uint32_t shard, uint32_t local) {
+    return ((local << SHARD_BITS) | shard) + 1;
+}
+
+// Find an entry by its ID (NULL for invalid IDs)
+static const SymbolEntry *entryOf(SymbolId id) {
+    if (id == NO_SYMBOL) {
+        return NULL;
+    }
+    uint32_t shard = (id - 1) & (SHARD_COUNT - 1);
+    uint32_t local = (id - 1) >> SHARD_BITS;
+    if (local >= atomic_load_explicit(&shards[shard].count, memory_order_acquire)) {
+        return NULL;
+    }
+    return &shards[shard].chunks[local >> CHUNK_BITS][local & (CHUNK_SIZE - 1)];
+}
+
+// Probe the shard's table for the text. Returns the slot holding it, or the
+// empty slot where it would go. Caller holds the shard lock
+static uint32_t probeShard(const InternerShard *shard, const wchar_t *text, size_t length, uint32_t hash) {
+    uint32_t mask = shard->slotCapacity - 1;
+    uint32_t slot = hash & mask;
+    while (shard->slots[slot] != 0) {
+        uint32_t local = shard->slots[slot] - 1;
+        const SymbolEntry *entry = &shard->chunks[local >> CHUNK_BITS][local & (CHUNK_SIZE - 1)];
+        if (entry->hash == hash && entry->length == length &&
+            wmemcmp(entry->text, text, length) == 0) {
+            return slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+// Double the shard's table once it is more than half full
+static int growShardTable(InternerShard *shard) {
+    uint32_t newCapacity = shard->slotCapacity ? shard->slotCapacity * 2 : 256;
+    uint32_t *newSlots = calloc(newCapacity, sizeof(uint32_t));
+    if (!newSlots) {
+        return 0;
+    }
+    uint32_t count = atomic_load_explicit(&shard->count, memory_order_relaxed);
+    for (uint32_t local = 0; local < count; local++) {
+        const SymbolEntry *entry = &shard->chunks[local >> CHUNK_BITS][local & (CHUNK_SIZE - 1)];
+        uint32_t slot = entry->hash & (newCapacity - 1);
+        while (newSlots[slot] != 0) {
+            slot = (slot + 1) & (newCapacity - 1);
+        }
+        newSlots[slot] = local + 1;
+    }
+    free(shard->slots);
+    shard->slots = newSlots;
+    shard->slotCapacity = newCapacity;
+    return 1;
+}
+
+// Copy text into the shard's text blocks
+static const wchar_t *storeText(InternerShard *shard, const wchar_t *text, size_t length) {
+    size_t needed = length + 1;
+    if (!shard->text || shard->text->size - shard->text->used < needed) {
+        size_t size = needed > TEXT_BLOCK_SIZE ? needed : TEXT_BLOCK_SIZE;
+        TextBlock *block = malloc(sizeof(TextBlock) + size * sizeof(wchar_t));
+        if (!block) {
+            return NULL;
+        }
+        block->used = 0;
+        block->size = size;
+        block->next = shard->text;
+        shard->text = block;
+    }
+    wchar_t *copy = shard->text->data + shard->text->used;
+    wmemcpy(copy, text, length);
+    copy[length] = L'\0';
+    shard->text->used += needed;
+    return copy;
+}
+
+// Intern the first length characters of text and return its stable ID
+SymbolId internSymbol(const wchar_t *text, size_t length) {
+    pthread_once(&shardsOnce, initShards);
+
+    uint32_t hash = hashText(text, length);
+    uint32_t shardIndex = hash >> (32 - SHARD_BITS);
+    InternerShard *shard = &shards[shardIndex];
+    SymbolId id = NO_SYMBOL;
+
+    pthread_mutex_lock(&shard->lock);
+    uint32_t count = atomic_load_explicit(&shard->count, memory_order_relaxed);
+    if ((count + 1) * 2 > shard->slotCapacity && !growShardTable(shard)) {
+        goto out_of_memory;
+    }
+
+    uint32_t slot = probeShard(shard, text, length, hash);
+    if (shard->slots[slot] != 0) {
+        // Already interned by this or another thread
+        id = makeSymbolId(shardIndex, shard->slots[slot] - 1);
+        pthread_mutex_unlock(&shard->lock);
+        return id;
+    }
+
+    // New symbol: make sure its chunk exists, then publish the entry
+    if ((count >> CHUNK_BITS) >= MAX_CHUNKS) {
+        fprintf(stderr, "Error: Too many symbols interned!\n");
+        pthread_mutex_unlock(&shard->lock);
+        return NO_SYMBOL;
+    }
+    if (!shard->chunks[count >> CHUNK_BITS]) {
+        shard->chunks[count >> CHUNK_BITS] = malloc(CHUNK_SIZE * sizeof(SymbolEntry));
+        if (!shard->chunks[count >> CHUNK_BITS]) {
+            goto out_of_memory;
+        }
+    }
+    const wchar_t *copy = storeText(shard, text, length);
+    if (!copy) {
+        goto out_of_memory;
+    }
+    SymbolEntry *entry = &shard->chunks[count >> CHUNK_BITS][count & (CHUNK_SIZE - 1)];
+    entry->text = copy;
+    entry->length = (uint32_t)length;
+    entry->hash = hash;
+    shard->slots[slot] = count + 1;
+
+    // Release so that lock-free readers that see the new count also see the entry
+    atomic_store_explicit(&shard->count, count + 1, memory_order_release);
+    id = makeSymbolId(shardIndex, count);
+    pthread_mutex_unlock(&shard->lock);
+    return id;
+
+out_of_memory:
+    fprintf(stderr, "Memory allocation failed in interner!\n");
+    pthread_mutex_unlock(&shard->lock);
+    return NO_SYMBOL;
+}
+
+// Intern a null-terminated string
+SymbolId internString(const wchar_t *text) {
+    return internSymbol(text, wcslen(text));
+}
+
+// Look up text without inserting it
+SymbolId findSymbol(const wchar_t *text, size_t length) {
+    pthread_once(&shardsOnce, initShards);
+
+    uint32_t hash = hashText(text, length);
+    uint32_t shardIndex = hash >> (32 - SHARD_BITS);
+    InternerShard *shard = &shards[shardIndex];
+    SymbolId id = NO_SYMBOL;
+
+    pthread_mutex_lock(&shard->lock);
+    if (shard->slotCapacity > 0) {
+        uint32_t slot = probeShard(shard, text, length, hash);
+        if (shard->slots[slot] != 0) {
+            id = makeSymbolId(shardIndex, shard->slots[slot] - 1);
+        }
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return id;
+}
+
+// Text of a symbol
+const wchar_t *symbolText(SymbolId id) {
+    const SymbolEntry *entry = entryOf(id);
+    return entry ? entry->text : L"";
+}
+
+// Length of a symbol's text in characters
+uint32_t symbolLength(SymbolId id) {
+    const SymbolEntry *entry = entryOf(id);
+    return entry ? entry->length : 0;
+}
+
+// Number of distinct symbols interned so far
+uint32_t symbolCount(void) {
+    uint32_t total = 0;
+    for (uint32_t s = 0; s < SHARD_COUNT; s++) {
+        total += atomic_load_explicit(&shards[s].count, memory_order_acquire);
+    }
+    return total;
+}
+
+// Upper bound (exclusive) on every SymbolId handed out so far
+SymbolId symbolIdLimit(void) {
+    uint32_t largest = 0;
+    for (uint32_t s = 0; s < SHARD_COUNT; s++) {
+        uint32_t count = atomic_load_explicit(&shards[s].count, memory_order_acquire);
+        if (count > largest) {
+            largest = count;
+        }
+    }
+    return makeSymbolId(0, largest);
+}
+
+// Free all symbols
+void resetInterner(void) {
+    for (uint32_t s = 0; s < SHARD_COUNT; s++) {
+        InternerShard *shard = &shards[s];
+        free(shard->slots);
+        shard->slots = NULL;
+        shard->slotCapacity = 0;
+        for (uint32_t c = 0; c < MAX_CHUNKS && shard->chunks[c]; c++) {
+            free(shard->chunks[c]);
+            shard->chunks[c] = NULL;
+        }
+        while (shard->text) {
+            TextBlock *next = shard->text->next;
+            free(shard->text);
+            shard->text = next;
+        }
+        atomic_store(&shard->count, 0);
+    }
+}
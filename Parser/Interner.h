@@ -0,0 +1,46 @@
+#ifndef INTERNER_H
+#define INTERNER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <wchar.h>
+
+// Process-wide identifier interner
+// Every distinct identifier (or string) gets one SymbolId for the lifetime of the
+// process, no matter which file or thread produced it, so later stages can compare
+// names with a single integer compare. The table is split into independently
+// locked shards so that many lexer threads can intern at the same time.
+
+typedef uint32_t SymbolId;
+
+// SymbolId 0 is never handed out and means "no symbol"
+#define NO_SYMBOL ((SymbolId)0)
+
+// Intern the first length characters of text and return its stable ID.
+// Safe to call from any number of threads at once. Returns NO_SYMBOL if out of memory
+SymbolId internSymbol(const wchar_t *text, size_t length);
+
+// Intern a null-terminated string
+SymbolId internString(const wchar_t *text);
+
+// Look up text without inserting it. Returns NO_SYMBOL if it was never interned
+SymbolId findSymbol(const wchar_t *text, size_t length);
+
+// Text of a symbol (null-terminated, valid until resetInterner). Lock-free
+const wchar_t *symbolText(SymbolId id);
+
+// Length of a symbol's text in characters. Lock-free
+uint32_t symbolLength(SymbolId id);
+
+// Number of distinct symbols interned so far
+uint32_t symbolCount(void);
+
+// Upper bound (exclusive) on every SymbolId handed out so far. IDs are dense
+// enough that arrays indexed directly by SymbolId stay small
+SymbolId symbolIdLimit(void);
+
+// Free all symbols. Not thread-safe: no other thread may use the interner,
+// and every SymbolId handed out before becomes invalid
+void resetInterner(void);
+
+#endif // INTERNER_H
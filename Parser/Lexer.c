@@ -0,0 +1,522 @@
+#include "Lexer.h"
+#include "Tokens.h"
+#include "utils.h"
+#include <wctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Global arrays to track declared identifiers
+// These help determine token types for identifiers based on previous declarations.
+// They are per thread so that several files can be lexed in parallel
+_Thread_local wchar_t variables[100][100];       // Regular variables
+_Thread_local int variable_count = 0;            // Count of declared variables
+_Thread_local wchar_t functions[100][100];       // Function names
+_Thread_local int function_count = 0;            // Count of declared functions
+_Thread_local wchar_t class_variables[100][100]; // Class variables
+_Thread_local int class_variable_count = 0;      // Count of declared class variables
+
+// Collector receiving the tokens of the current tokenize_and_collect() call.
+// When it is NULL the handlers print tokens instead, like the standalone lexer
+static _Thread_local TokenCollector *collector = NULL;
+
+// Check if a function name has been previously declared
+// Returns 1 if found, 0 otherwise
+int isFunctionDeclared(const wchar_t *word) {
+    for (int i = 0; i < function_count; i++) {
+        if (wcscmp(functions[i], word) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Check if a variable name has been previously declared
+// Returns 1 if found, 0 otherwise
+int isVariableDeclared(const wchar_t *word) {
+    for (int i = 0; i < variable_count; i++) {
+        if (wcscmp(variables[i], word) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Check if a class variable has been previously declared
+// Returns 1 if found, 0 otherwise
+int isClassVariableDeclared(const wchar_t *word) {
+    for (int i = 0; i < class_variable_count; i++) {
+        if (wcscmp(class_variables[i], word) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Print input[start..end) with a printf format taking the text as %ls
+// (a %.*ls precision would count bytes of output, not characters)
+static void printSlice(const char *format, const wchar_t *input, int start, int end) {
+    wchar_t small[256];
+    wchar_t *text = small;
+    size_t length = (size_t)(end - start);
+    if (length >= sizeof(small) / sizeof(wchar_t)) {
+        text = malloc((length + 1) * sizeof(wchar_t));
+        if (!text) {
+            fprintf(stderr, "Memory allocation failed!\n");
+            return;
+        }
+    }
+    wmemcpy(text, input + start, length);
+    text[length] = L'\0';
+    printf(format, text);
+    if (text != small) {
+        free(text);
+    }
+}
+
+// Hand a finished token to the collector, or print it when not collecting
+// Parameters:
+//   - type: Token type
+//   - format: printf format used in print mode (takes the text as %ls)
+//   - input, start, end: The token's text is input[start..end)
+//   - payload: Value stored in the collector (see TokenCollector.h)
+static void emitToken(TokenType type, const char *format, const wchar_t *input, int start, int end, uint32_t payload) {
+    if (collector) {
+        appendToken(collector, type, (uint32_t)start, (uint32_t)(end - start), payload);
+    } else {
+        printSlice(format, input, start, end);
+    }
+}
+
+// Run the lexer over the whole input, emitting every token through emitToken()
+static void lexInput(const wchar_t *input) {
+    int i = 0;                                  // Current position in input
+    int isVariable = 0, isClassVariable = 0, isFunction = 0;  // Context flags
+    variable_count = function_count = class_variable_count = 0;
+
+    while (input[i] != L'\0') {                 // Process until end of input
+        wchar_t c = input[i];                   // Current character
+
+        // Skip whitespace characters
+        if (iswspace(c)) {
+            i++;
+            continue;
+        }
+
+        // Handle single-line comments (// style)
+        if (c == L'/' && input[i + 1] == L'/') {
+            handleComment(input, &i, 0);
+            continue;
+        }
+
+        // Handle multi-line comments (/* */ style)
+        if (c == L'/' && input[i + 1] == L'*') {
+            handleComment(input, &i, 1);
+            continue;
+        }
+
+        // Handle operators (+, -, *, /, etc.)
+        if (wcschr(L"+-*/=><!&;?", c)) {
+            handleOperator(input, &i);
+            continue;
+        }
+
+        // Handle special symbols (parentheses, brackets, etc.)
+        if (wcschr(L"(){}[],:|", c)) {
+            handleSpecialSymbol(input, &i);
+            continue;
+        }
+
+        // Handle identifiers starting with underscore
+        if (c == L'_') {
+            handleIdentifier(input, &i, &isVariable, &isClassVariable, &isFunction);
+            continue;
+        }
+
+        // Handle numeric literals (including Devanagari digits)
+        if (iswdigit(c) || isDevanagariDigit(c)) {
+            handleNumber(input, &i);
+            continue;
+        }
+
+        // Handle string literals (enclosed in double quotes)
+        if (c == L'"') {
+            handleString(input, &i);
+            continue;
+        }
+
+        // Handle character literals (enclosed in single quotes)
+        if (c == L'\'') {
+            handleCharLiteral(input, &i);
+            continue;
+        }
+
+        // Handle identifiers (including Sanskrit/Devanagari characters)
+        // The high bit check (c & 0x80) helps catch Unicode characters
+        if (isSanskritAlpha(c) || (c & 0x80)) {
+            handleIdentifier(input, &i, &isVariable, &isClassVariable, &isFunction);
+            continue;
+        }
+
+        // Handle unknown characters that don't match any pattern
+        emitToken(TOKEN_UNKNOWN, "Unknown: %ls\n", input, i, i + 1, NO_PAYLOAD);
+        i++;
+    }
+
+    // Create and output the end-of-file token
+    // The collector always ends with it, so the parser never runs off the arrays
+    if (collector) {
+        appendToken(collector, TOKEN_EOF, (uint32_t)i, 0, NO_PAYLOAD);
+    } else {
+        printf("End of Input: EOF\n");
+    }
+}
+
+// Main tokenization function - processes the input text and prints its tokens
+void tokenize(const wchar_t *input) {
+    TokenCollector *previous = collector;
+    collector = NULL;
+    printf("\nLexical Analysis:\n");
+    lexInput(input);
+    collector = previous;
+}
+
+// Tokenize the input into a TokenCollector instead of printing the tokens
+// Everything is done in one pass and comments are dropped
+TokenCollector tokenize_and_collect(const wchar_t *input) {
+    TokenCollector tokens;
+    // Roughly one token per six characters of typical source
+    initTokenCollector(&tokens, (uint32_t)(wcslen(input) / 6 + 16));
+
+    TokenCollector *previous = collector;
+    collector = &tokens;
+    lexInput(input);
+    collector = previous;
+    return tokens;
+}
+
+// Tokenize a file registered with the SourceManager, so that token locations
+// can be turned into file/line/column later
+TokenCollector tokenizeSourceFile(SourceFileId file) {
+    const wchar_t *input = sourceBuffer(file);
+    if (!input) {
+        TokenCollector empty;
+        initTokenCollector(&empty, 0);
+        appendToken(&empty, TOKEN_EOF, 0, 0, NO_PAYLOAD);
+        return empty;
+    }
+    TokenCollector tokens = tokenize_and_collect(input);
+    tokens.base = sourceFileStart(file);
+    return tokens;
+}
+
+// Tokenize a registered file into a caller's collector, which may stream the
+// tokens away through its flush hook while the file is being read
+void tokenizeSourceFileInto(SourceFileId file, TokenCollector *tokens) {
+    tokens->base = sourceFileStart(file);
+    const wchar_t *input = sourceBuffer(file);
+    if (!input) {
+        appendToken(tokens, TOKEN_EOF, 0, 0, NO_PAYLOAD);
+        return;
+    }
+    TokenCollector *previous = collector;
+    collector = tokens;
+    lexInput(input);
+    collector = previous;
+}
+
+// Process character literals ('x')
+void handleCharLiteral(const wchar_t *input, int *i) {
+    int start = *i;
+
+    // A well-formed literal is exactly one character between single quotes
+    if (input[start + 1] != L'\0' && input[start + 1] != L'\n' && input[start + 2] == L'\'') {
+        *i = start + 3;
+        emitToken(TOKEN_wchar_t, "Character Literal: %ls\n", input, start, *i, (uint32_t)input[start + 1]);
+        return;
+    }
+
+    // Anything else is a stray quote
+    (*i)++;
+    emitToken(TOKEN_UNKNOWN, "Unknown: %ls\n", input, start, *i, NO_PAYLOAD);
+}
+
+// Process comments (both single-line and multi-line)
+// Parameters:
+//   - input: The input text
+//   - i: Pointer to current position (will be updated)
+//   - isMultiLine: 0 for single-line comments, 1 for multi-line comments
+void handleComment(const wchar_t *input, int *i, int isMultiLine) {
+    int nestedCommentCount = 0;        // Track nested comments (for multi-line)
+    *i += 2;                           // Skip the comment start characters (// or /*)
+    int start = *i;
+    int end;
+
+    while (1) {
+        wchar_t c = input[*i];
+
+        if (isMultiLine) {
+            // Handle nested comments (/* inside another */)
+            if (c == L'/' && input[*i + 1] == L'*') {
+                nestedCommentCount++;
+                *i += 2;
+                continue;
+            }
+
+            // Check for unterminated comment
+            if (c == L'\0') {
+                fprintf(stderr, "Error: Unterminated multi-line comment!\n");
+                end = *i;
+                break;
+            }
+            // Check for comment end
+            else if (c == L'*' && input[*i + 1] == L'/') {
+                end = *i;
+                *i += 2;
+                if (nestedCommentCount > 0) {
+                    // Close a nested comment
+                    nestedCommentCount--;
+                    continue;
+                }
+                break;  // Close the main comment
+            }
+        }
+        // For single-line comments, end at newline or EOF
+        else if (c == L'\n' || c == L'\0') {
+            end = *i;
+            break;
+        }
+        (*i)++;
+    }
+
+    // The parser has no use for comments, so they are only printed
+    if (!collector) {
+        printSlice(isMultiLine ? "Multi-line Comment: %ls\n" : "Single-line Comment: %ls\n", input, start, end);
+    }
+}
+
+// Process operators (+, -, *, /, ==, !=, etc.)
+// Handles both single-character and two-character operators
+void handleOperator(const wchar_t *input, int *i) {
+    // Initialize with the first character
+    wchar_t operatorStr[3] = {input[*i], L'\0', L'\0'};
+    int start = *i;
+
+    // Check for two-character operators (==, +=, etc.)
+    if (input[*i + 1] == L'=' || input[*i + 1] == operatorStr[0]) {
+        operatorStr[1] = input[++(*i)];
+    }
+    (*i)++;
+
+    int index = collector ? operatorIndex(operatorStr) : -1;
+    emitToken(TOKEN_OPERATOR, "Operator: %ls\n", input, start, *i, index >= 0 ? (uint32_t)index : NO_PAYLOAD);
+}
+
+// Process special symbols (parentheses, brackets, etc.)
+void handleSpecialSymbol(const wchar_t *input, int *i) {
+    wchar_t symbol[2] = {input[*i], L'\0'};
+    int start = (*i)++;
+    uint32_t index = (uint32_t)specialSymbolIndex(symbol);
+
+    // Special case: | is treated as end-of-line
+    if (symbol[0] == L'|') {
+        emitToken(TOKEN_EOL, "End of Line: %ls\n", input, start, *i, index);
+    } else {
+        emitToken(TOKEN_SPECIAL_SYMBOL, "Special Symbol: %ls\n", input, start, *i, index);
+    }
+}
+
+// Process string literals (text enclosed in double quotes)
+void handleString(const wchar_t *input, int *i) {
+    int start = (*i)++;  // Skip the opening quote
+    int hasEscapes = 0;
+
+    // Find the closing quote
+    while (input[*i] != L'"' && input[*i] != L'\0') {
+        if (wcsncmp(&input[*i], L"\\नव", 3) == 0) {
+            hasEscapes = 1;
+            *i += 3;
+        } else {
+            (*i)++;
+        }
+    }
+
+    // Check for unterminated string
+    if (input[*i] == L'\0') {
+        fprintf(stderr, "Error: Unterminated string\n");
+        emitToken(TOKEN_UNKNOWN, "Unknown: %ls\n", input, start, *i, NO_PAYLOAD);
+        return;
+    }
+    (*i)++;  // Skip the closing quote
+
+    if (!collector) {
+        printSlice("String: %ls\n", input, start, *i);
+        return;
+    }
+
+    // Intern the text between the quotes, applying the Sanskrit newline escape (\नव)
+    const wchar_t *text = input + start + 1;
+    int length = *i - start - 2;
+    SymbolId symbol;
+    if (!hasEscapes) {
+        symbol = internSymbol(text, (size_t)length);
+    } else {
+        wchar_t *buffer = malloc((size_t)length * sizeof(wchar_t) + sizeof(wchar_t));
+        int bufferIndex = 0;
+        if (!buffer) {
+            fprintf(stderr, "Memory allocation failed for string!\n");
+            collector->failed = 1;
+            return;
+        }
+        for (int j = 0; j < length; ) {
+            if (wcsncmp(&text[j], L"\\नव", 3) == 0) {
+                buffer[bufferIndex++] = L'\n';
+                j += 3;
+            } else {
+                buffer[bufferIndex++] = text[j++];
+            }
+        }
+        symbol = internSymbol(buffer, (size_t)bufferIndex);
+        free(buffer);
+    }
+    appendToken(collector, TOKEN_STRING, (uint32_t)start, (uint32_t)(*i - start), symbol);
+}
+
+// Process numeric literals (including Devanagari digits)
+// Also handles the case where a number is followed by letters (treated as unknown)
+void handleNumber(const wchar_t *input, int *i) {
+    int start = *i;
+    int64_t value = 0;
+    int overflow = 0;
+
+    // First, collect all digits (including Devanagari digits ०-९)
+    while (iswdigit(input[*i]) || isDevanagariDigit(input[*i])) {
+        int digit = isDevanagariDigit(input[*i]) ? input[*i] - L'०' : input[*i] - L'0';
+        if (value > (INT64_MAX - digit) / 10) {
+            overflow = 1;
+        } else {
+            value = value * 10 + digit;
+        }
+        (*i)++;
+    }
+
+    // Check if this is actually an identifier (number followed by letters)
+    // This handles cases like "123abc" which are not valid numbers
+    if (isSanskritAlpha(input[*i]) || input[*i] == L'_' || (input[*i] & 0x80)) {
+        while (isSanskritAlpha(input[*i]) || iswdigit(input[*i]) ||
+               isDevanagariDigit(input[*i]) || input[*i] == L'_' || (input[*i] & 0x80)) {
+            (*i)++;
+        }
+        emitToken(TOKEN_UNKNOWN, "Unknown: %ls\n", input, start, *i, NO_PAYLOAD);
+        return;
+    }
+
+    if (overflow) {
+        fprintf(stderr, "Error: Number is too large\n");
+        value = INT64_MAX;
+    }
+    uint32_t index = collector ? addNumber(collector, value) : NO_PAYLOAD;
+    emitToken(TOKEN_NUMBER, "Number: %ls\n", input, start, *i, index);
+}
+
+// Process identifiers (variable names, function names, keywords, etc.)
+// This is the most complex handler as it needs to track context
+void handleIdentifier(const wchar_t *input, int *i, int *isVariable, int *isClassVariable, int *isFunction) {
+    wchar_t buffer[100];
+    int start = *i;
+
+    // Collect characters that can be part of an identifier
+    // This includes Sanskrit characters, digits, Devanagari digits, underscores,
+    // and any Unicode character (high bit set)
+    while (isSanskritAlpha(input[*i]) || iswdigit(input[*i]) ||
+           isDevanagariDigit(input[*i]) || input[*i] == L'_' || (input[*i] & 0x80)) {
+        (*i)++;
+    }
+    int length = *i - start;
+
+    // Names longer than the declaration tables can hold are never keywords
+    // and are compared by their first 99 characters only
+    int copied = length < 99 ? length : 99;
+    wmemcpy(buffer, input + start, (size_t)copied);
+    buffer[copied] = L'\0';
+
+    // Check if it's a keyword (like पूर्ण, यदि, etc.)
+    int keyword = keywordIndex(buffer);
+    if (keyword >= 0) {
+        emitToken(TOKEN_KEYWORD, "Keyword: %ls\n", input, start, *i, (uint32_t)keyword);
+
+        // Set context flags based on specific keywords
+        // These flags affect how subsequent identifiers are processed
+        if (keyword == KEYWORD_PURNA) {
+            *isVariable = 1;  // Next identifier will be a variable
+        } else if (keyword == KEYWORD_KAKSHA) {
+            *isClassVariable = 1;  // Next identifier will be a class variable
+        } else if (keyword == KEYWORD_KARMA) {
+            *isFunction = 1;  // Next identifier will be a function
+        }
+        return;
+    }
+
+    // Check if it's a boolean literal (सत्य or असत्य)
+    if (isBooleanLiteral(buffer)) {
+        emitToken(TOKEN_BOOLEAN, "Boolean: %ls\n", input, start, *i, wcscmp(buffer, L"सत्य") == 0);
+        return;
+    }
+
+    // Everything else is a name; the collector stores its interned ID.
+    // Collected names are all TOKEN_IDENTIFIER: what a name refers to is worked
+    // out with proper scoping by the resolver (Resolver.h), so the declaration
+    // lists below are only used for the printed token listing
+    if (collector) {
+        *isFunction = *isClassVariable = *isVariable = 0;
+        emitToken(TOKEN_IDENTIFIER, NULL, input, start, *i, internSymbol(input + start, (size_t)length));
+        return;
+    }
+    TokenType type = TOKEN_IDENTIFIER;
+    const char *format = "Identifier: %ls\n";
+
+    if (isVariableDeclared(buffer)) {
+        // A previously declared variable
+        type = TOKEN_VARIABLE;
+        format = "Variable: %ls\n";
+    } else if (isClassVariableDeclared(buffer)) {
+        // A previously declared class variable
+        type = TOKEN_CLASSED_VARIABLE;
+        format = "Class Variable: %ls\n";
+    } else if (isFunctionDeclared(buffer)) {
+        // A previously declared function
+        type = TOKEN_FUNCTION;
+        format = "Function: %ls\n";
+    } else if (*isFunction) {
+        // Function name after कर्म keyword
+        if (function_count < 100) {
+            wcscpy(functions[function_count++], buffer);
+        } else {
+            fprintf(stderr, "Error: Too many functions declared!\n");
+        }
+        type = TOKEN_FUNCTION;
+        format = "Function: %ls\n";
+    } else if (*isClassVariable) {
+        // Class variable name after कक्षा keyword
+        if (class_variable_count < 100) {
+            wcscpy(class_variables[class_variable_count++], buffer);
+        } else {
+            fprintf(stderr, "Error: Too many class variables declared!\n");
+        }
+        type = TOKEN_CLASSED_VARIABLE;
+        format = "Class Variable: %ls\n";
+    } else if (*isVariable) {
+        // Variable name after पूर्ण keyword
+        if (variable_count < 100) {
+            wcscpy(variables[variable_count++], buffer);
+        } else {
+            fprintf(stderr, "Error: Too many variables!\n");
+        }
+        type = TOKEN_VARIABLE;
+        format = "Variable: %ls\n";
+    }
+
+    // Any name consumes a pending declaration context
+    *isFunction = *isClassVariable = *isVariable = 0;
+    emitToken(type, format, input, start, *i, NO_PAYLOAD);
+}
@@ -11,6 +11,12 @@ void tokenize(const wchar_t *input);
 // New function to tokenize and collect tokens for the parser
 TokenCollector tokenize_and_collect(const wchar_t *input);
 
+// Tokenize a file registered with the SourceManager (token locations are set)
+TokenCollector tokenizeSourceFile(SourceFileId file);
+
+// Tokenize a registered file into an existing collector (appending, EOF included)
+void tokenizeSourceFileInto(SourceFileId file, TokenCollector *tokens);
+
 // Helper function prototypes (used internally in lexer.c)
 // These handle specific token types during lexical analysis
 void handleComment(const wchar_t *input, int *i, int isMultiLine);
@@ -21,14 +27,14 @@ void handleCharLiteral(const wchar_t *input, int *i);
 void handleNumber(const wchar_t *input, int *i);
 void handleIdentifier(const wchar_t *input, int *i, int *isVariable, int *isClassVariable, int *isFunction);
 
-// Global arrays to track declared identifiers (extern declarations)
+// Per-thread arrays to track declared identifiers (extern declarations)
 // These are defined in lexer.c and used to determine token types
-extern wchar_t variables[100][100];       // Regular variables
-extern int variable_count;                // Count of declared variables
-extern wchar_t functions[100][100];       // Function names
-extern int function_count;                // Count of declared functions
-extern wchar_t class_variables[100][100]; // Class variables
-extern int class_variable_count;          // Count of declared class variables
+extern _Thread_local wchar_t variables[100][100];       // Regular variables
+extern _Thread_local int variable_count;                // Count of declared variables
+extern _Thread_local wchar_t functions[100][100];       // Function names
+extern _Thread_local int function_count;                // Count of declared functions
+extern _Thread_local wchar_t class_variables[100][100]; // Class variables
+extern _Thread_local int class_variable_count;          // Count of declared class variables
 
 // Declaration of utility functions used in lexer.c
 int isFunctionDeclared(const wchar_t *word);
@@ -0,0 +1,247 @@
+#include "ParallelParser.h"
+#include "WorkPool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// State of one worker thread: its own tree, diagnostics and parser stacks
+typedef struct {
+    Ast ast;
+    DiagnosticBuffer diagnostics;
+    Parser parser;
+} ParseWorker;
+
+// Where the result of one chunk ended up
+typedef struct {
+    uint32_t worker;           // Worker that parsed it
+    uint32_t program;          // Its AST_PROGRAM node in the worker's tree
+} ChunkResult;
+
+typedef struct {
+    const TopLevelChunk *chunks;
+    ChunkResult *results;
+    ParseWorker *workers;
+} ParseJob;
+
+static inline int isSpecial(const TokenCollector *tokens, uint32_t i, SpecialSymbolId symbol) {
+    return (tokens->types[i] == TOKEN_SPECIAL_SYMBOL || tokens->types[i] == TOKEN_EOL) &&
+           tokens->payloads[i] == (uint32_t)symbol;
+}
+
+static inline int isTerminator(const TokenCollector *tokens, uint32_t i) {
+    return isSpecial(tokens, i, SPECIAL_PIPE) ||
+           (tokens->types[i] == TOKEN_OPERATOR && tokens->payloads[i] == OPERATOR_SEMICOLON);
+}
+
+// Does token i end a statement ('|', ';' or the '}' of a block)? A chunk may
+// only start after one: otherwise the statement before it would end at the
+// chunk's end, where a missing '|' goes unreported
+static inline int endsStatement(const TokenCollector *tokens, uint32_t i) {
+    return isTerminator(tokens, i) || isSpecial(tokens, i, SPECIAL_RBRACE);
+}
+
+// Append a chunk, growing the array as needed
+static int addChunk(TopLevelChunk **chunks, uint32_t *count, uint32_t *capacity,
+                    uint32_t first, uint32_t end, uint8_t isDeclaration) {
+    if (*count == *capacity) {
+        uint32_t newCapacity = *capacity ? *capacity * 2 : 64;
+        TopLevelChunk *grown = realloc(*chunks, newCapacity * sizeof(TopLevelChunk));
+        if (!grown) {
+            return 0;
+        }
+        *chunks = grown;
+        *capacity = newCapacity;
+    }
+    (*chunks)[(*count)++] = (TopLevelChunk){first, end, isDeclaration};
+    return 1;
+}
+
+// Split all tokens into chunks, in order
+uint32_t scanTopLevel(const TokenCollector *tokens, TopLevelChunk **chunks) {
+    uint32_t end = (tokens->count > 0 && tokens->types[tokens->count - 1] == TOKEN_EOF)
+                       ? tokens->count - 1 : tokens->count;
+    uint32_t count = 0, capacity = 0, gapStart = 0, depth = 0;
+    int ok = 1;
+    *chunks = NULL;
+
+    uint32_t i = 0;
+    while (i < end && ok) {
+        if (depth == 0 && tokens->types[i] == TOKEN_KEYWORD &&
+            (tokens->payloads[i] == KEYWORD_KARMA || tokens->payloads[i] == KEYWORD_KAKSHA) &&
+            (i == gapStart || endsStatement(tokens, i - 1))) {
+            // The header runs up to the body's '{'; a '|' or '}' first means it is broken
+            uint32_t j = i + 1;
+            while (j < end && !isSpecial(tokens, j, SPECIAL_LBRACE) &&
+                   !isSpecial(tokens, j, SPECIAL_RBRACE) && !isTerminator(tokens, j)) {
+                j++;
+            }
+            if (j < end && isSpecial(tokens, j, SPECIAL_LBRACE)) {
+                // Find the matching '}' (an unclosed body runs to the end)
+                uint32_t bodyDepth = 0;
+                for (; j < end; j++) {
+                    if (isSpecial(tokens, j, SPECIAL_LBRACE)) {
+                        bodyDepth++;
+                    } else if (isSpecial(tokens, j, SPECIAL_RBRACE) && --bodyDepth == 0) {
+                        j++;
+                        break;
+                    }
+                }
+                if (j < end && isSpecial(tokens, j, SPECIAL_PIPE)) {
+                    j++;  // A '|' after the declaration belongs to it
+                }
+                if (gapStart < i) {
+                    ok = addChunk(chunks, &count, &capacity, gapStart, i, 0);
+                }
+                ok = ok && addChunk(chunks, &count, &capacity, i, j, 1);
+                gapStart = i = j;
+                continue;
+            }
+        }
+        if (isSpecial(tokens, i, SPECIAL_LBRACE)) {
+            depth++;
+        } else if (isSpecial(tokens, i, SPECIAL_RBRACE) && depth > 0) {
+            depth--;
+        }
+        i++;
+    }
+    if (ok && (gapStart < end || count == 0)) {
+        ok = addChunk(chunks, &count, &capacity, gapStart, end, 0);
+    }
+    if (!ok) {
+        fprintf(stderr, "Memory allocation failed for top-level chunks!\n");
+        free(*chunks);
+        *chunks = NULL;
+        return 0;
+    }
+    return count;
+}
+
+// Task: parse one chunk into the tree of the worker running it
+static void parseChunk(void *context, uint32_t task, uint32_t worker) {
+    ParseJob *job = context;
+    ParseWorker *state = &job->workers[worker];
+    Parser *parser = &state->parser;
+    ChunkResult *result = &job->results[task];
+
+    parser->pos = job->chunks[task].first;
+    parser->end = job->chunks[task].end;
+    parser->panicking = 0;
+    result->worker = worker;
+    result->program = parseProgram(parser);
+}
+
+// Parse all tokens on this thread straight into the result
+static uint32_t parseSequential(const TokenCollector *tokens, Ast *ast, DiagnosticBuffer *diagnostics) {
+    Parser parser;
+    initParser(&parser, tokens, ast);
+    parser.diagnostics = diagnostics;
+    uint32_t root = parseProgram(&parser);
+    freeParser(&parser);
+    return root;
+}
+
+// Free the workers' state
+static void freeWorkers(ParseWorker *workers, uint32_t threadCount) {
+    for (uint32_t w = 0; w < threadCount; w++) {
+        freeParser(&workers[w].parser);
+        freeDiagnostics(&workers[w].diagnostics);
+        freeAst(&workers[w].ast);
+    }
+    free(workers);
+}
+
+// Parse all tokens like parseProgram() using threadCount threads
+uint32_t parseParallel(const TokenCollector *tokens, Ast *ast, DiagnosticBuffer *diagnostics,
+                       uint32_t threadCount) {
+    if (threadCount == 0) {
+        threadCount = defaultThreadCount();
+    }
+    TopLevelChunk *chunks = NULL;
+    uint32_t chunkCount = threadCount > 1 ? scanTopLevel(tokens, &chunks) : 0;
+
+    // Nothing to split
+    if (chunkCount < 2) {
+        free(chunks);
+        return parseSequential(tokens, ast, diagnostics);
+    }
+    if (threadCount > chunkCount) {
+        threadCount = chunkCount;
+    }
+
+    ParseWorker *workers = calloc(threadCount, sizeof(ParseWorker));
+    ChunkResult *results = calloc(chunkCount, sizeof(ChunkResult));
+    uint32_t *shifts = calloc(threadCount, sizeof(uint32_t));
+    if (!workers || !results || !shifts) {
+        fprintf(stderr, "Memory allocation failed for parallel parsing!\n");
+        free(workers);
+        free(results);
+        free(shifts);
+        free(chunks);
+        ast->failed = 1;
+        return 0;
+    }
+    for (uint32_t w = 0; w < threadCount; w++) {
+        initAst(&workers[w].ast, tokens->count / threadCount / 2 + 16);
+        initDiagnostics(&workers[w].diagnostics);
+        initParser(&workers[w].parser, tokens, &workers[w].ast);
+        workers[w].parser.diagnostics = &workers[w].diagnostics;
+    }
+
+    ParseJob job = {chunks, results, workers};
+    runWorkPool(chunkCount, threadCount, parseChunk, &job);
+
+    // A chunk with errors may have recovered differently from how the whole file
+    // would (panic mode can run past a chunk's end), so parse it again in one go
+    for (uint32_t w = 0; w < threadCount; w++) {
+        if (workers[w].diagnostics.count > 0) {
+            freeWorkers(workers, threadCount);
+            free(results);
+            free(shifts);
+            free(chunks);
+            return parseSequential(tokens, ast, diagnostics);
+        }
+    }
+
+    // Append every worker's tree; node n of worker w becomes n + shifts[w]
+    for (uint32_t w = 0; w < threadCount; w++) {
+        uint32_t listShift;
+        if (!astAppend(ast, &workers[w].ast, &shifts[w], &listShift)) {
+            ast->failed = 1;
+        }
+        if (workers[w].ast.failed) {
+            ast->failed = 1;
+        }
+    }
+
+    // Concatenate the statements of the chunk programs in source order
+    uint32_t statementCount = 0;
+    for (uint32_t c = 0; c < chunkCount && !ast->failed; c++) {
+        statementCount += ast->nodes[results[c].program + shifts[results[c].worker]].b;
+    }
+    uint32_t *statements = ast->failed ? NULL : malloc((statementCount + 1) * sizeof(uint32_t));
+    uint32_t root = 0;
+    if (statements) {
+        uint32_t n = 0;
+        for (uint32_t c = 0; c < chunkCount; c++) {
+            const AstNode *program = &ast->nodes[results[c].program + shifts[results[c].worker]];
+            if (program->b > 0) {
+                memcpy(&statements[n], &ast->lists[program->a], program->b * sizeof(uint32_t));
+            }
+            n += program->b;
+        }
+        uint32_t list = astAddList(ast, statements, statementCount);
+        SourceLocation location = tokens->count > 0 ? tokenLocation(tokens, 0) : NO_LOCATION;
+        root = astAddNode(ast, AST_PROGRAM, 0, location, list, statementCount, 0);
+        astSetSpan(ast, root, 0, chunks[chunkCount - 1].end);
+        ast->root = root;
+        free(statements);
+    } else {
+        ast->failed = 1;
+    }
+
+    freeWorkers(workers, threadCount);
+    free(results);
+    free(shifts);
+    free(chunks);
+    return root;
+}
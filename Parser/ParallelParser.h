@@ -0,0 +1,34 @@
+#ifndef PARALLEL_PARSER_H
+#define PARALLEL_PARSER_H
+
+#include <stdint.h>
+#include "Parser.h"
+
+// Parallel parsing
+// A brace-matching scan over the token arrays splits a file into chunks: every
+// top-level कर्म or कक्षा declaration that follows a finished statement is a chunk
+// of its own, and the statements between them form the chunks in between.
+// Top-level declarations cannot see into each other's syntax, so the chunks are
+// parsed independently on a work-stealing pool, each worker into its own Ast, and
+// the trees are appended into one at the end. If any chunk reports an error the
+// file is parsed again on one thread, so broken input gets exactly the recovery
+// and diagnostics of parseProgram(). The result matches parseProgram() except for
+// a few unreachable nodes left over from the per-chunk programs.
+
+// A run of top-level tokens parsed as one task
+typedef struct {
+    uint32_t first;            // First token
+    uint32_t end;              // One past the last token
+    uint8_t isDeclaration;     // A whole कर्म or कक्षा declaration (otherwise plain statements)
+} TopLevelChunk;
+
+// Split all tokens into chunks, in order. Returns the number of chunks and stores
+// a malloc'd array in *chunks (NULL and 0 if out of memory)
+uint32_t scanTopLevel(const TokenCollector *tokens, TopLevelChunk **chunks);
+
+// Parse all tokens like parseProgram() using threadCount threads (0 = one per CPU).
+// Errors are added to diagnostics (may be NULL) in source order. Sets ast->root and returns it
+uint32_t parseParallel(const TokenCollector *tokens, Ast *ast, DiagnosticBuffer *diagnostics,
+                       uint32_t threadCount);
+
+#endif // PARALLEL_PARSER_H
@@ -0,0 +1,797 @@
+#include "Parser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Statement parser
+// Grammar (statements end with '|' or ';', which may be left out before '}'
+// and at the end of the input; statements ending in a block need none):
+//   पूर्ण name [= expr]                   Integer variable
+//   Class name [= expr]                  Variable of a class type
+//   यदि (expr) block [अन्यथा (block | यदि ...)]
+//   चक्र (पूर्ण name से expr तक expr) block  Counting loop (both ends included)
+//   चक्र (expr) block                     Loop while the condition holds
+//   लेख(expr, ...)                        Print
+//   प्रवे(name)                           Read input
+//   कर्म name(पूर्ण a, Class b, ...) block  Function
+//   कक्षा name block                      Class
+//   { statements }
+//   expr
+//
+// Blocks nest without recursion: a statement that ends in a block is parsed up
+// to its '{' and left on the block stack (Parser.blocks) with whatever it has
+// parsed so far, the block's statements are parsed by the same loop, and the
+// statement is finished when its '}' turns up. Only memory limits the nesting.
+
+// Prepare a parser over all tokens of a collector, building into ast
+void initParser(Parser *parser, const TokenCollector *tokens, Ast *ast) {
+    memset(parser, 0, sizeof(*parser));
+    parser->tokens = tokens;
+    parser->ast = ast;
+    // The final TOKEN_EOF is left out: peekType() reports it for anything past the end
+    parser->end = (tokens->count > 0 && tokens->types[tokens->count - 1] == TOKEN_EOF)
+                      ? tokens->count - 1 : tokens->count;
+}
+
+// Free the parser's stacks (the tokens and the tree are not touched)
+void freeParser(Parser *parser) {
+    free(parser->operands);
+    free(parser->frames);
+    free(parser->items);
+    free(parser->blocks);
+    parser->operands = NULL;
+    parser->frames = NULL;
+    parser->items = NULL;
+    parser->blocks = NULL;
+    parser->operandCount = parser->operandCapacity = 0;
+    parser->frameCount = parser->frameCapacity = 0;
+    parser->itemCount = parser->itemCapacity = 0;
+    parser->blockCount = parser->blockCapacity = 0;
+}
+
+// Report an error at a token without entering panic mode
+void parserReport(Parser *parser, uint32_t token, const char *message) {
+    if (!parser->error) {
+        parser->error = message;
+        parser->errorToken = token;
+    }
+    parser->errorCount++;
+    if (parser->diagnostics) {
+        uint32_t at = token < parser->end ? token : parser->end;
+        SourceLocation location = parserTokenLocation(parser, at);
+        addDiagnostic(parser->diagnostics, DIAGNOSTIC_ERROR, location, at, NO_SYMBOL, message);
+    }
+}
+
+// Report a syntax error at the current token and enter panic mode.
+// Errors found while already panicking are not reported
+void parserError(Parser *parser, const char *message) {
+    if (parser->panicking) {
+        return;
+    }
+    parserReport(parser, parser->pos, message);
+    parser->panicking = 1;
+}
+
+// Push a finished statement or argument while its list is being built
+static int pushItem(Parser *parser, uint32_t node) {
+    if (parser->itemCount == parser->itemCapacity) {
+        uint32_t newCapacity = parser->itemCapacity ? parser->itemCapacity * 2 : 64;
+        uint32_t *grown = realloc(parser->items, newCapacity * sizeof(uint32_t));
+        if (!grown) {
+            fprintf(stderr, "Memory allocation failed for parser lists!\n");
+            return 0;
+        }
+        parser->items = grown;
+        parser->itemCapacity = newCapacity;
+    }
+    parser->items[parser->itemCount++] = node;
+    return 1;
+}
+
+// Turn the items pushed since base into a list node
+static uint32_t finishList(Parser *parser, AstKind kind, uint32_t base, SourceLocation location, uint32_t firstToken) {
+    uint32_t count = parser->itemCount - base;
+    uint32_t list = astAddList(parser->ast, &parser->items[base], count);
+    parser->itemCount = base;
+    uint32_t node = astAddNode(parser->ast, kind, 0, location, list, count, 0);
+    astSetSpan(parser->ast, node, firstToken, parser->pos);
+    return node;
+}
+
+// Consume the given special symbol, or report that it is missing
+static int expectSpecial(Parser *parser, SpecialSymbolId symbol, const char *message) {
+    if (atSpecial(parser, symbol)) {
+        advanceToken(parser);
+        return 1;
+    }
+    parserError(parser, message);
+    return 0;
+}
+
+// Consume a name token and return its symbol, or report that it is missing
+static SymbolId expectName(Parser *parser, const char *message) {
+    if (isNameToken(peekType(parser, 0))) {
+        SymbolId symbol = peekPayload(parser, 0);
+        advanceToken(parser);
+        return symbol;
+    }
+    parserError(parser, message);
+    return NO_SYMBOL;
+}
+
+// Is the current token '|' or ';'?
+static int atTerminator(Parser *parser) {
+    return atSpecial(parser, SPECIAL_PIPE) || atOperator(parser, OPERATOR_SEMICOLON);
+}
+
+// Skip the rest of a broken statement: up to and including the next '|' or ';',
+// up to the '}' closing the block the statement is in, or past a whole { ... }
+// block opened while skipping (the block was the end of the broken statement)
+static void synchronize(Parser *parser) {
+    uint32_t depth = 0;
+    for (;;) {
+        TokenType type = peekType(parser, 0);
+        if (type == TOKEN_EOF) {
+            break;
+        }
+        if (atSpecial(parser, SPECIAL_LBRACE)) {
+            depth++;
+        } else if (atSpecial(parser, SPECIAL_RBRACE)) {
+            if (depth == 0) {
+                break;
+            }
+            if (--depth == 0) {
+                advanceToken(parser);
+                if (atSpecial(parser, SPECIAL_PIPE)) {
+                    advanceToken(parser);
+                }
+                break;
+            }
+        } else if (depth == 0 && atTerminator(parser)) {
+            advanceToken(parser);
+            break;
+        }
+        advanceToken(parser);
+    }
+    parser->panicking = 0;
+}
+
+// Require the end of a simple statement. A missing '|' is reported but does not
+// start panic mode: the next token is taken to start the next statement
+static void expectTerminator(Parser *parser) {
+    if (atTerminator(parser)) {
+        advanceToken(parser);
+    } else if (!atSpecial(parser, SPECIAL_RBRACE) && peekType(parser, 0) != TOKEN_EOF && !parser->panicking) {
+        parserReport(parser, parser->pos, "Expected '|' at end of statement");
+    }
+}
+
+// Parse an expression and give up on the statement if it was malformed
+static uint32_t expectExpression(Parser *parser) {
+    uint32_t node = parseExpression(parser);
+    return parser->panicking ? 0 : node;
+}
+
+// Variable declaration after its type: name [= expr]
+static uint32_t parseVariable(Parser *parser, uint32_t first, SourceLocation location, SymbolId classType) {
+    SymbolId name = expectName(parser, "Expected a variable name");
+    if (name == NO_SYMBOL) {
+        return 0;
+    }
+    uint32_t init = 0;
+    if (atOperator(parser, OPERATOR_ASSIGN)) {
+        advanceToken(parser);
+        if (!(init = expectExpression(parser))) {
+            return 0;
+        }
+    }
+    uint32_t node = astAddNode(parser->ast, AST_VAR_DECL, 0, location, name, init, classType);
+    astSetSpan(parser->ast, node, first, parser->pos);
+    return node;
+}
+
+// लेख(expr, ...)
+static uint32_t parsePrint(Parser *parser) {
+    uint32_t first = parser->pos;
+    SourceLocation location = currentLocation(parser);
+    advanceToken(parser);  // Skip लेख
+    if (!expectSpecial(parser, SPECIAL_LPAREN, "Expected '(' after लेख")) return 0;
+    uint32_t base = parser->itemCount;
+    if (!atSpecial(parser, SPECIAL_RPAREN)) {
+        for (;;) {
+            uint32_t argument = expectExpression(parser);
+            if (!argument) {
+                parser->itemCount = base;
+                return 0;
+            }
+            pushItem(parser, argument);
+            if (!atSpecial(parser, SPECIAL_COMMA)) break;
+            advanceToken(parser);
+        }
+    }
+    if (!expectSpecial(parser, SPECIAL_RPAREN, "Expected ')' after the values to print")) {
+        parser->itemCount = base;
+        return 0;
+    }
+    return finishList(parser, AST_PRINT, base, location, first);
+}
+
+// प्रवे(name)
+static uint32_t parseInput(Parser *parser) {
+    uint32_t first = parser->pos;
+    SourceLocation location = currentLocation(parser);
+    advanceToken(parser);  // Skip प्रवे
+    if (!expectSpecial(parser, SPECIAL_LPAREN, "Expected '(' after प्रवे")) return 0;
+    uint32_t targetToken = parser->pos;
+    SourceLocation targetLocation = currentLocation(parser);
+    SymbolId name = expectName(parser, "Expected the variable to read into");
+    if (name == NO_SYMBOL || !expectSpecial(parser, SPECIAL_RPAREN, "Expected ')' after the variable")) return 0;
+    uint32_t target = astAddNode(parser->ast, AST_IDENT, 0, targetLocation, name, 0, 0);
+    astSetSpan(parser->ast, target, targetToken, targetToken + 1);
+    uint32_t node = astAddNode(parser->ast, AST_INPUT, 0, location, target, 0, 0);
+    astSetSpan(parser->ast, node, first, parser->pos);
+    return node;
+}
+
+// Open the block at the current token for a construct. frame holds what the
+// construct has parsed so far. Returns 0 if there is no '{' (or no memory)
+static int openBlock(Parser *parser, const BlockFrame *frame) {
+    uint32_t first = parser->pos;
+    SourceLocation location = currentLocation(parser);
+    if (!expectSpecial(parser, SPECIAL_LBRACE, "Expected '{'")) {
+        return 0;
+    }
+    if (parser->blockCount == parser->blockCapacity) {
+        uint32_t newCapacity = parser->blockCapacity ? parser->blockCapacity * 2 : 32;
+        BlockFrame *grown = realloc(parser->blocks, newCapacity * sizeof(BlockFrame));
+        if (!grown) {
+            fprintf(stderr, "Memory allocation failed for parser blocks!\n");
+            parser->ast->failed = 1;
+            return 0;
+        }
+        parser->blocks = grown;
+        parser->blockCapacity = newCapacity;
+    }
+    BlockFrame *open = &parser->blocks[parser->blockCount++];
+    *open = *frame;
+    open->blockFirst = first;
+    open->blockLocation = location;
+    open->base = parser->itemCount;
+    return 1;
+}
+
+// Node for a construct whose block has just been closed
+static uint32_t addConstruct(Parser *parser, const BlockFrame *frame, AstKind kind,
+                             uint32_t a, uint32_t b, uint32_t c) {
+    uint32_t node = astAddNode(parser->ast, kind, 0, frame->location, a, b, c);
+    astSetSpan(parser->ast, node, frame->first, parser->pos);
+    return node;
+}
+
+// End a यदि chain. Every if of the chain ends where the whole chain ends
+static uint32_t finishIf(Parser *parser, const BlockFrame *chain) {
+    for (uint32_t i = chain->chainBase; i < parser->itemCount; i++) {
+        parser->ast->spans[parser->items[i]].end = parser->pos;
+    }
+    parser->itemCount = chain->chainBase;
+    return parser->panicking ? 0 : chain->head;
+}
+
+// यदि (expr) of a chain (the first one or an else-if): opens its then block.
+// Returns 1 if the block was opened, otherwise ends the chain
+static int beginIf(Parser *parser, BlockFrame *chain) {
+    chain->first = parser->pos;
+    chain->location = currentLocation(parser);
+    advanceToken(parser);  // Skip यदि (or वा यदि)
+    if (expectSpecial(parser, SPECIAL_LPAREN, "Expected '(' after यदि")) {
+        uint32_t condition = expectExpression(parser);
+        if (condition && expectSpecial(parser, SPECIAL_RPAREN, "Expected ')' after the condition")) {
+            chain->kind = BLOCK_IF_THEN;
+            chain->a = condition;
+            if (openBlock(parser, chain)) {
+                return 1;
+            }
+        }
+    }
+    finishIf(parser, chain);
+    return 0;
+}
+
+// A then block is done: link its AST_IF into the chain and go on with अन्यथा.
+// Returns 1 if another block was opened, otherwise ends the chain into *node
+static int continueIf(Parser *parser, BlockFrame *chain, uint32_t then, uint32_t *node) {
+    if (then) {
+        uint32_t added = addConstruct(parser, chain, AST_IF, chain->a, then, 0);
+        if (chain->previous) {
+            parser->ast->nodes[chain->previous].c = added;
+        } else {
+            chain->head = added;
+        }
+        chain->previous = added;
+        pushItem(parser, added);
+
+        if (atElseIf(parser)) {
+            advanceToken(parser);  // Skip वा
+            return beginIf(parser, chain);
+        }
+        if (atKeyword(parser, KEYWORD_ANYATHA)) {
+            advanceToken(parser);
+            if (atKeyword(parser, KEYWORD_YADI)) {
+                return beginIf(parser, chain);
+            }
+            chain->kind = BLOCK_IF_ELSE;
+            if (openBlock(parser, chain)) {
+                return 1;
+            }
+        }
+    }
+    *node = finishIf(parser, chain);
+    return 0;
+}
+
+// चक्र (पूर्ण name से expr तक expr) or चक्र (expr): opens the body.
+// Returns 1 if the body was opened
+static int beginLoop(Parser *parser, BlockFrame *frame) {
+    advanceToken(parser);  // Skip चक्र
+    if (!expectSpecial(parser, SPECIAL_LPAREN, "Expected '(' after चक्र")) return 0;
+
+    int counting = atKeyword(parser, KEYWORD_PURNA) ||
+                   (isNameToken(peekType(parser, 0)) && peekType(parser, 1) == TOKEN_KEYWORD &&
+                    peekPayload(parser, 1) == KEYWORD_SE);
+    if (!counting) {
+        uint32_t condition = expectExpression(parser);
+        if (!condition || !expectSpecial(parser, SPECIAL_RPAREN, "Expected ')' after the condition")) return 0;
+        frame->kind = BLOCK_WHILE;
+        frame->a = condition;
+        return openBlock(parser, frame);
+    }
+
+    // The loop variable is declared with the start value as its initializer
+    uint32_t declFirst = parser->pos;
+    SourceLocation declLocation = currentLocation(parser);
+    if (atKeyword(parser, KEYWORD_PURNA)) {
+        advanceToken(parser);
+    }
+    SymbolId name = expectName(parser, "Expected the loop variable");
+    if (name == NO_SYMBOL) return 0;
+    if (!atKeyword(parser, KEYWORD_SE)) {
+        parserError(parser, "Expected से after the loop variable");
+        return 0;
+    }
+    advanceToken(parser);
+    uint32_t start = expectExpression(parser);
+    if (!start) return 0;
+    uint32_t decl = astAddNode(parser->ast, AST_VAR_DECL, 0, declLocation, name, start, 0);
+    astSetSpan(parser->ast, decl, declFirst, parser->pos);
+    if (!atKeyword(parser, KEYWORD_TAK)) {
+        parserError(parser, "Expected तक after the start value");
+        return 0;
+    }
+    advanceToken(parser);
+    uint32_t end = expectExpression(parser);
+    if (!end || !expectSpecial(parser, SPECIAL_RPAREN, "Expected ')' after the loop range")) return 0;
+    frame->kind = BLOCK_LOOP;
+    frame->a = decl;
+    frame->b = end;
+    return openBlock(parser, frame);
+}
+
+// Preparse the body at the current '{': skip to its matching '}' without
+// building nodes. Returns an AST_LAZY_BODY node for it, or 0 if the body is not
+// closed (it is then parsed in full, which reports the error)
+static uint32_t skipBody(Parser *parser) {
+    const TokenCollector *tokens = parser->tokens;
+    uint32_t first = parser->pos;
+    uint32_t depth = 0;
+    for (uint32_t i = first; i < parser->end; i++) {
+        uint32_t t = i - parser->tokenBase;
+        if (tokens->types[t] != TOKEN_SPECIAL_SYMBOL && tokens->types[t] != TOKEN_EOL) {
+            continue;
+        }
+        if (tokens->payloads[t] == SPECIAL_LBRACE) {
+            depth++;
+        } else if (tokens->payloads[t] == SPECIAL_RBRACE && --depth == 0) {
+            uint32_t node = astAddNode(parser->ast, AST_LAZY_BODY, 0, currentLocation(parser), first, i + 1, 0);
+            astSetSpan(parser->ast, node, first, i + 1);
+            parser->pos = i + 1;
+            return node;
+        }
+    }
+    return 0;
+}
+
+// कर्म name(पूर्ण a, Class b, ...): opens the body. Returns 1 if it was opened.
+// A preparsed body is not opened: the declaration is finished into *node instead
+static int beginFunction(Parser *parser, BlockFrame *frame, uint32_t *node) {
+    advanceToken(parser);  // Skip कर्म
+    SymbolId name = expectName(parser, "Expected a function name after कर्म");
+    if (name == NO_SYMBOL) return 0;
+
+    uint32_t paramsFirst = parser->pos;
+    SourceLocation paramsLocation = currentLocation(parser);
+    if (!expectSpecial(parser, SPECIAL_LPAREN, "Expected '(' after the function name")) return 0;
+    uint32_t base = parser->itemCount;
+    if (!atSpecial(parser, SPECIAL_RPAREN)) {
+        for (;;) {
+            uint32_t paramFirst = parser->pos;
+            SourceLocation paramLocation = currentLocation(parser);
+            SymbolId classType = NO_SYMBOL;
+            if (atKeyword(parser, KEYWORD_PURNA)) {
+                advanceToken(parser);
+            } else if (isNameToken(peekType(parser, 0)) && isNameToken(peekType(parser, 1))) {
+                classType = peekPayload(parser, 0);
+                advanceToken(parser);
+            } else {
+                parserError(parser, "Expected a parameter type (पूर्ण or a class name)");
+                parser->itemCount = base;
+                return 0;
+            }
+            uint32_t param = parseVariable(parser, paramFirst, paramLocation, classType);
+            if (!param) {
+                parser->itemCount = base;
+                return 0;
+            }
+            pushItem(parser, param);
+            if (!atSpecial(parser, SPECIAL_COMMA)) break;
+            advanceToken(parser);
+        }
+    }
+    if (!expectSpecial(parser, SPECIAL_RPAREN, "Expected ')' after the parameters")) {
+        parser->itemCount = base;
+        return 0;
+    }
+    frame->kind = BLOCK_FUNCTION;
+    frame->a = name;
+    frame->b = finishList(parser, AST_PARAMS, base, paramsLocation, paramsFirst);
+    if (parser->lazyBodies && !parser->refill && atSpecial(parser, SPECIAL_LBRACE)) {
+        uint32_t body = skipBody(parser);
+        if (body) {
+            *node = addConstruct(parser, frame, AST_FUNC_DECL, frame->a, frame->b, body);
+            if (atSpecial(parser, SPECIAL_PIPE)) {
+                advanceToken(parser);
+            }
+            return 0;
+        }
+    }
+    return openBlock(parser, frame);
+}
+
+// कक्षा name: opens the body. Returns 1 if it was opened
+static int beginClass(Parser *parser, BlockFrame *frame) {
+    advanceToken(parser);  // Skip कक्षा
+    SymbolId name = expectName(parser, "Expected a class name after कक्षा");
+    if (name == NO_SYMBOL) return 0;
+    frame->kind = BLOCK_CLASS;
+    frame->a = name;
+    return openBlock(parser, frame);
+}
+
+// Start one statement (with its '|' or ';'). A statement that ends in a block
+// only gets as far as the block's '{' and sets *opened; it is finished by
+// closeBlock(). Otherwise returns the statement, or 0 for an empty or broken one
+static uint32_t beginStatement(Parser *parser, int *opened) {
+    uint32_t first = parser->pos;
+    SourceLocation location = currentLocation(parser);
+    TokenType type = peekType(parser, 0);
+    uint32_t node;
+
+    *opened = 0;
+    if (atTerminator(parser)) {
+        advanceToken(parser);  // Empty statement
+        return 0;
+    }
+    if (atSpecial(parser, SPECIAL_RBRACE)) {
+        parserReport(parser, parser->pos, "Unexpected '}'");
+        advanceToken(parser);
+        return 0;
+    }
+
+    // Statements ending in a block
+    if (atSpecial(parser, SPECIAL_LBRACE) || (type == TOKEN_KEYWORD &&
+        (peekPayload(parser, 0) == KEYWORD_YADI || peekPayload(parser, 0) == KEYWORD_CHAKRA ||
+         peekPayload(parser, 0) == KEYWORD_KARMA || peekPayload(parser, 0) == KEYWORD_KAKSHA))) {
+        BlockFrame frame;
+        memset(&frame, 0, sizeof(frame));
+        frame.statement = first;
+        frame.first = first;
+        frame.location = location;
+        if (atSpecial(parser, SPECIAL_LBRACE)) {
+            frame.kind = BLOCK_STATEMENT;
+            *opened = openBlock(parser, &frame);
+        } else if (atKeyword(parser, KEYWORD_YADI)) {
+            frame.chainBase = parser->itemCount;
+            *opened = beginIf(parser, &frame);
+        } else if (atKeyword(parser, KEYWORD_CHAKRA)) {
+            *opened = beginLoop(parser, &frame);
+        } else if (atKeyword(parser, KEYWORD_KARMA)) {
+            uint32_t preparsed = 0;
+            *opened = beginFunction(parser, &frame, &preparsed);
+            return preparsed;
+        } else {
+            *opened = beginClass(parser, &frame);
+        }
+        return 0;
+    }
+
+    if (atKeyword(parser, KEYWORD_PURNA)) {
+        advanceToken(parser);
+        node = parseVariable(parser, first, location, NO_SYMBOL);
+    } else if (isNameToken(type) && isNameToken(peekType(parser, 1))) {
+        // Two names in a row declare a variable of a class type
+        SymbolId classType = peekPayload(parser, 0);
+        advanceToken(parser);
+        node = parseVariable(parser, first, location, classType);
+    } else if (atKeyword(parser, KEYWORD_LEKH)) {
+        node = parsePrint(parser);
+    } else if (atKeyword(parser, KEYWORD_PRAVE)) {
+        node = parseInput(parser);
+    } else if (type == TOKEN_KEYWORD && !atKeyword(parser, KEYWORD_NA)) {
+        parserError(parser, "Unexpected keyword at the start of a statement");
+        return 0;
+    } else {
+        uint32_t expression = expectExpression(parser);
+        if (!expression) return 0;
+        node = astAddNode(parser->ast, AST_EXPR_STMT, 0, location, expression, 0, 0);
+        astSetSpan(parser->ast, node, first, parser->pos);
+    }
+
+    if (!node) return 0;
+    expectTerminator(parser);
+    return node;
+}
+
+// Close the innermost block at its '}' (or report that it is missing) and
+// finish the construct that owns it. Sets *opened if the construct goes on with
+// another block (an अन्यथा); otherwise returns the finished statement (0 if broken)
+static uint32_t closeBlock(Parser *parser, int *opened) {
+    BlockFrame frame = parser->blocks[--parser->blockCount];
+    uint32_t block = 0;
+    if (atSpecial(parser, SPECIAL_RBRACE)) {
+        advanceToken(parser);
+        block = finishList(parser, AST_BLOCK, frame.base, frame.blockLocation, frame.blockFirst);
+    } else {
+        parser->itemCount = frame.base;
+        parserError(parser, "Expected '}' to close the block");
+    }
+
+    *opened = 0;
+    uint32_t node = 0;
+    switch (frame.kind) {
+        case BLOCK_ALONE:
+            return block;
+        case BLOCK_STATEMENT:
+            node = block;
+            break;
+        case BLOCK_IF_THEN:
+            *opened = continueIf(parser, &frame, block, &node);
+            break;
+        case BLOCK_IF_ELSE:
+            if (block) {
+                parser->ast->nodes[frame.previous].c = block;
+            }
+            node = finishIf(parser, &frame);
+            break;
+        case BLOCK_WHILE:
+            node = block ? addConstruct(parser, &frame, AST_WHILE, frame.a, block, 0) : 0;
+            break;
+        case BLOCK_LOOP:
+            node = block ? addConstruct(parser, &frame, AST_LOOP, frame.a, frame.b, block) : 0;
+            break;
+        case BLOCK_FUNCTION:
+            node = block ? addConstruct(parser, &frame, AST_FUNC_DECL, frame.a, frame.b, block) : 0;
+            break;
+        case BLOCK_CLASS:
+            node = block ? addConstruct(parser, &frame, AST_CLASS_DECL, frame.a, block, 0) : 0;
+            break;
+    }
+    // Statements ending in a block need no terminator (a '|' after them is allowed)
+    if (node && atSpecial(parser, SPECIAL_PIPE)) {
+        advanceToken(parser);
+    }
+    return node;
+}
+
+// Finish a statement of the list being parsed: a broken statement is skipped up
+// to its end and becomes one AST_ERROR node. Returns 0 if out of memory
+static int endStatement(Parser *parser, uint32_t statement, uint32_t start) {
+    if (parser->panicking) {
+        synchronize(parser);
+        if (parser->pos == start) {
+            advanceToken(parser);  // Always make progress
+        }
+        statement = astAddNode(parser->ast, AST_ERROR, 0, parserTokenLocation(parser, start), 0, 0, 0);
+        astSetSpan(parser->ast, statement, start, parser->pos);
+    }
+    if (statement && !pushItem(parser, statement)) {
+        parser->ast->failed = 1;
+        return 0;
+    }
+    return 1;
+}
+
+// Parse statements onto the item stack with one loop instead of recursion: a
+// statement that ends in a block pushes the block onto the block stack, the
+// statements inside are parsed by the same loop, and the statement is finished
+// when the block's '}' is reached. The caller's own list (blocks[bottom] and up
+// are nested in it) ends at '}' if inBlock is set, or at the end of the input.
+// If single is set, the first statement finished in the caller's list is
+// returned instead of being pushed
+static uint32_t runStatements(Parser *parser, uint32_t bottom, int inBlock, int single) {
+    for (;;) {
+        int nested = parser->blockCount > bottom;
+        uint32_t start, statement;
+        int opened;
+        if ((nested || !single) && (peekType(parser, 0) == TOKEN_EOF ||
+                                    ((nested || inBlock) && atSpecial(parser, SPECIAL_RBRACE)))) {
+            if (!nested) {
+                return 0;
+            }
+            start = parser->blocks[parser->blockCount - 1].statement;
+            statement = closeBlock(parser, &opened);
+        } else {
+            start = parser->pos;
+            if (!nested && !inBlock) {
+                parser->mark = start;  // Nothing before this is looked at again
+            }
+            statement = beginStatement(parser, &opened);
+        }
+        if (opened) {
+            continue;
+        }
+        if (single && parser->blockCount == bottom) {
+            return statement;
+        }
+        if (!endStatement(parser, statement, start)) {
+            if (parser->blockCount > bottom) {
+                parser->itemCount = parser->blocks[bottom].base;
+                parser->blockCount = bottom;
+            }
+            return 0;
+        }
+    }
+}
+
+// Parse one statement (with its '|' or ';'). Returns 0 for an empty statement
+uint32_t parseStatement(Parser *parser) {
+    return runStatements(parser, parser->blockCount, 1, 1);
+}
+
+// Parse a { ... } block
+uint32_t parseBlock(Parser *parser) {
+    BlockFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.kind = BLOCK_ALONE;
+    frame.statement = frame.first = parser->pos;
+    frame.location = currentLocation(parser);
+    if (!openBlock(parser, &frame)) {
+        return 0;
+    }
+    return runStatements(parser, parser->blockCount - 1, 1, 1);
+}
+
+// Parse every statement from the current token to the end into an AST_PROGRAM node
+uint32_t parseProgram(Parser *parser) {
+    uint32_t base = parser->itemCount;
+    uint32_t first = parser->pos;
+    SourceLocation location = currentLocation(parser);
+    runStatements(parser, parser->blockCount, 0, 0);
+    uint32_t root = finishList(parser, AST_PROGRAM, base, location, first);
+    parser->ast->root = root;
+    return root;
+}
+
+// Parse a lazy function body and link it into its declaration
+uint32_t ensureFunctionBody(Ast *ast, const TokenCollector *tokens, uint32_t function,
+                            DiagnosticBuffer *diagnostics) {
+    if (function == 0 || function >= ast->nodeCount || ast->nodes[function].kind != AST_FUNC_DECL) {
+        return 0;
+    }
+    uint32_t body = ast->nodes[function].c;
+    if (ast->nodes[body].kind != AST_LAZY_BODY) {
+        return body;
+    }
+    if (ast->readOnly) {
+        return 0;
+    }
+    Parser parser;
+    initParser(&parser, tokens, ast);
+    parser.pos = ast->nodes[body].a;
+    parser.end = ast->nodes[body].b;
+    parser.diagnostics = diagnostics;
+    parser.lazyBodies = 1;
+    uint32_t block = parseBlock(&parser);
+    freeParser(&parser);
+    if (!block || ast->failed) {
+        return 0;
+    }
+    ast->nodes[function].c = block;
+    return block;
+}
+
+// Append a node to a growable array. Returns 0 if out of memory
+static int pushNode(uint32_t **nodes, uint32_t *count, uint32_t *capacity, uint32_t node) {
+    if (*count == *capacity) {
+        uint32_t grown = *capacity ? *capacity * 2 : 64;
+        uint32_t *moved = realloc(*nodes, grown * sizeof(uint32_t));
+        if (!moved) {
+            return 0;
+        }
+        *nodes = moved;
+        *capacity = grown;
+    }
+    (*nodes)[(*count)++] = node;
+    return 1;
+}
+
+// Parse the lazy bodies of called functions. New nodes are scanned in order:
+// a call marks its name as called and makes the declarations of that name that
+// wait in its list ready, and a declaration is ready at once if its name was
+// already called, or else waits. Parsing a ready body appends its nodes, which
+// the scan then reaches in turn
+uint32_t expandCalledBodies(Ast *ast, const TokenCollector *tokens, DiagnosticBuffer *diagnostics) {
+    SymbolId limit = symbolIdLimit();
+    uint8_t *called = calloc(limit, 1);
+    uint32_t *waiting = calloc(limit, sizeof(uint32_t));  // Last waiting declaration of each name (0 = none)
+    uint32_t *previous = NULL;                             // The one of the same name before it, per node
+    uint32_t *ready = NULL;                                // Declarations to parse
+    uint32_t previousCount = 0, previousCapacity = 0, readyCount = 0, readyCapacity = 0, parsed = 0;
+    int ok = called && waiting;
+
+    uint32_t scanned = 1;
+    while (ok) {
+        for (; scanned < ast->nodeCount && ok; scanned++) {
+            const AstNode *n = &ast->nodes[scanned];
+            // previous[] follows the nodes
+            while (ok && previousCount <= scanned) {
+                ok = pushNode(&previous, &previousCount, &previousCapacity, 0);
+            }
+            if (!ok) {
+                break;
+            }
+            if (n->kind == AST_FUNC_DECL && ast->nodes[n->c].kind == AST_LAZY_BODY && n->a < limit) {
+                if (called[n->a]) {
+                    ok = pushNode(&ready, &readyCount, &readyCapacity, scanned);
+                } else {
+                    previous[scanned] = waiting[n->a];
+                    waiting[n->a] = scanned;
+                }
+            } else if (n->kind == AST_CALL && n->c < limit && !called[n->c]) {
+                called[n->c] = 1;
+                for (uint32_t d = waiting[n->c]; d && ok; d = previous[d]) {
+                    ok = pushNode(&ready, &readyCount, &readyCapacity, d);
+                }
+                waiting[n->c] = 0;
+            }
+        }
+        if (!ok || readyCount == 0) {
+            break;
+        }
+        if (ensureFunctionBody(ast, tokens, ready[--readyCount], diagnostics)) {
+            parsed++;
+        }
+        ok = !ast->failed;
+    }
+    if (!ok && !ast->failed) {
+        fprintf(stderr, "Memory allocation failed for function bodies!\n");
+        ast->failed = 1;
+    }
+    free(called);
+    free(waiting);
+    free(previous);
+    free(ready);
+    return parsed;
+}
+
+// Parse every lazy body. Bodies found inside parsed ones are appended after
+// them and reached by the same loop
+uint32_t expandFunctionBodies(Ast *ast, const TokenCollector *tokens, DiagnosticBuffer *diagnostics) {
+    uint32_t parsed = 0;
+    for (uint32_t i = 1; i < ast->nodeCount && !ast->failed; i++) {
+        if (ast->nodes[i].kind == AST_FUNC_DECL && ast->nodes[ast->nodes[i].c].kind == AST_LAZY_BODY &&
+            ensureFunctionBody(ast, tokens, i, diagnostics)) {
+            parsed++;
+        }
+    }
+    return parsed;
+}
@@ -0,0 +1,232 @@
+#ifndef PARSER_H
+#define PARSER_H
+
+#include <stdint.h>
+#include "TokenCollector.h"  // Input: the lexer's token arrays
+#include "Ast.h"             // Output: the flat AST
+#include "utils.h"           // For KeywordId, OperatorId and SpecialSymbolId
+#include "Diagnostics.h"     // Where syntax errors are reported
+
+// An entry of the expression parser's operator stack
+typedef struct {
+    uint8_t kind;              // What was opened (operator, group, call, ...)
+    uint8_t op;                // OperatorId for operators
+    uint8_t power;             // Binding power towards the right
+    SourceLocation location;   // Location of the operator or opening token
+    uint32_t firstToken;       // First token of the construct
+    uint32_t operandBase;      // Operand stack depth when a call was opened
+    uint32_t symbol;           // Callee of a call
+} ExprFrame;
+
+// What an open block belongs to
+typedef enum {
+    BLOCK_STATEMENT,           // { ... } used as a statement
+    BLOCK_ALONE,               // Block parsed by parseBlock() itself
+    BLOCK_IF_THEN,             // Block after यदि (...)
+    BLOCK_IF_ELSE,             // Block after अन्यथा
+    BLOCK_WHILE,               // Body of चक्र (condition)
+    BLOCK_LOOP,                // Body of चक्र (पूर्ण name से ... तक ...)
+    BLOCK_FUNCTION,            // Body of a कर्म
+    BLOCK_CLASS                // Body of a कक्षा
+} BlockKind;
+
+// An entry of the statement parser's block stack: a block whose '}' has not been
+// reached yet, and what is needed to finish the statement around it afterwards
+typedef struct {
+    uint8_t kind;              // BlockKind
+    uint32_t statement;        // First token of the statement in the enclosing list
+    uint32_t first;            // First token of the construct that owns the block
+    SourceLocation location;   // Its location
+    uint32_t blockFirst;       // The '{'
+    SourceLocation blockLocation;
+    uint32_t base;             // Item stack depth when the block was opened
+    uint32_t a, b;             // Parts parsed before the block (condition, name, ...)
+    uint32_t head;             // यदि chains: first AST_IF,
+    uint32_t previous;         //   the latest one,
+    uint32_t chainBase;        //   and the item stack depth before the chain
+} BlockFrame;
+
+// Parser state
+// The parser reads tokens[pos .. end) of a TokenCollector and appends nodes to an Ast.
+// Expressions are parsed with explicit operand and operator stacks, and statements
+// with an explicit stack of open blocks, so the C stack does not grow with the
+// length of an expression or the nesting depth of blocks; only memory limits them.
+//
+// Syntax errors do not stop the parse. The first error of a statement is reported
+// and the parser enters panic mode: the rest of the statement is skipped up to the
+// next '|' or ';' (or the '}' closing the enclosing block) and replaced by an
+// AST_ERROR node, then parsing resumes. One pass reports every broken statement.
+//
+// Token indices are absolute. Normally the collector holds every token; when the
+// tokens are streamed in (see Pipeline.h) it holds only a window starting at token
+// tokenBase, refill() appends more when the parser reaches end, and the tokens
+// before mark (the current top-level statement) may be dropped.
+//
+// With lazyBodies set the parser only preparses function bodies: the name and
+// parameters of a कर्म are parsed as usual, but its body is just brace-matched
+// and becomes an AST_LAZY_BODY node recording the body's tokens. Declarations
+// stay visible to the rest of the program, and ensureFunctionBody() parses a
+// body when it is first needed, so a large program costs parse time only for
+// the functions it uses. Syntax errors inside a body are found when it is
+// parsed. Bodies are parsed in full while tokens are streamed in, since their
+// tokens would not be kept.
+typedef struct Parser Parser;
+
+// Make token index available by loading more tokens. Returns 0 at the end of the input
+typedef int (*ParserRefill)(Parser *parser, uint32_t index);
+
+struct Parser {
+    const TokenCollector *tokens;  // Token arrays from the lexer
+    uint32_t pos;                  // Index of the current token
+    uint32_t end;                  // Tokens from here on read as TOKEN_EOF
+    Ast *ast;                      // Tree being built
+
+    uint32_t tokenBase;            // Index of the collector's first token
+    uint32_t numberBase;           // Number payload of the collector's first number
+    uint32_t mark;                 // First token of the current top-level statement
+    ParserRefill refill;           // Loads tokens past end (NULL: all tokens are loaded)
+    void *refillContext;
+
+    const char *error;             // First syntax error (NULL if none)
+    uint32_t errorToken;           // Token where it was found
+    uint32_t errorCount;           // Syntax errors found so far
+    int panicking;                 // Skipping tokens until the statement ends
+    DiagnosticBuffer *diagnostics; // Where errors are reported (NULL = keep only the first)
+    int lazyBodies;                // Preparse कर्म bodies into AST_LAZY_BODY nodes
+
+    uint32_t *operands;            // Operand stack (node indices)
+    uint32_t operandCount;
+    uint32_t operandCapacity;
+    ExprFrame *frames;             // Operator stack
+    uint32_t frameCount;
+    uint32_t frameCapacity;
+    uint32_t *items;               // Statements and arguments of unfinished lists
+    uint32_t itemCount;
+    uint32_t itemCapacity;
+    BlockFrame *blocks;            // Open blocks, innermost last
+    uint32_t blockCount;
+    uint32_t blockCapacity;
+};
+
+// Prepare a parser over all tokens of a collector, building into ast
+void initParser(Parser *parser, const TokenCollector *tokens, Ast *ast);
+
+// Free the parser's stacks (the tokens and the tree are not touched)
+void freeParser(Parser *parser);
+
+// Report a syntax error at the current token and enter panic mode.
+// Errors found while already panicking are not reported
+void parserError(Parser *parser, const char *message);
+
+// Report an error at a token without entering panic mode
+// (for mistakes that do not derail the parse, like a missing '|')
+void parserReport(Parser *parser, uint32_t token, const char *message);
+
+// Parse every statement from the current token up to parser->end into an
+// AST_PROGRAM node. Sets ast->root and returns it
+uint32_t parseProgram(Parser *parser);
+
+// Parse one statement (with its '|' or ';'). Returns 0 for an empty statement
+uint32_t parseStatement(Parser *parser);
+
+// Parse a { ... } block
+uint32_t parseBlock(Parser *parser);
+
+// Parse one expression starting at the current token. Returns its node,
+// or an AST_ERROR node if the expression is malformed
+uint32_t parseExpression(Parser *parser);
+
+// Parse the body of a function declaration if it is still an AST_LAZY_BODY,
+// from the tokens the tree was parsed from, and link it into the declaration.
+// Functions declared inside stay lazy. Errors go to diagnostics (may be NULL).
+// The new nodes are appended to the tree, so every AstOrder, Resolution and
+// TypeCheck of it (all sized by nodeCount) must be built again afterwards.
+// Returns the body block, 0 if there is none or out of memory
+uint32_t ensureFunctionBody(Ast *ast, const TokenCollector *tokens, uint32_t function,
+                            DiagnosticBuffer *diagnostics);
+
+// Parse every lazy body of a tree, including those of functions declared in
+// other lazy bodies. Returns the number of bodies parsed
+uint32_t expandFunctionBodies(Ast *ast, const TokenCollector *tokens, DiagnosticBuffer *diagnostics);
+
+// Parse the lazy bodies of the functions the parsed code calls by name, then
+// those the new bodies call, until no new body is parsed. A body left lazy
+// belongs to a function that no code which can run calls, and its syntax errors
+// are not reported. Returns the number of bodies parsed (sets ast->failed if out of memory)
+uint32_t expandCalledBodies(Ast *ast, const TokenCollector *tokens, DiagnosticBuffer *diagnostics);
+
+// Token access helpers
+// Is token i loaded? Asks refill() for more tokens when streaming
+static inline int haveToken(Parser *parser, uint32_t i) {
+    return i < parser->end || (parser->refill && parser->refill(parser, i));
+}
+
+// Type of the token k positions ahead (TOKEN_EOF past the end)
+static inline TokenType peekType(Parser *parser, uint32_t k) {
+    uint32_t i = parser->pos + k;
+    return haveToken(parser, i) ? (TokenType)parser->tokens->types[i - parser->tokenBase] : TOKEN_EOF;
+}
+
+// Payload of the token k positions ahead (NO_PAYLOAD past the end)
+static inline uint32_t peekPayload(Parser *parser, uint32_t k) {
+    uint32_t i = parser->pos + k;
+    return haveToken(parser, i) ? parser->tokens->payloads[i - parser->tokenBase] : NO_PAYLOAD;
+}
+
+// Value of a TOKEN_NUMBER payload
+static inline int64_t numberValue(const Parser *parser, uint32_t payload) {
+    return parser->tokens->numbers[payload - parser->numberBase];
+}
+
+// Location of token i (NO_LOCATION if it is not held)
+static inline SourceLocation parserTokenLocation(const Parser *parser, uint32_t i) {
+    return (i >= parser->tokenBase && i - parser->tokenBase < parser->tokens->count)
+               ? tokenLocation(parser->tokens, i - parser->tokenBase) : NO_LOCATION;
+}
+
+// Location of the current token
+static inline SourceLocation currentLocation(Parser *parser) {
+    uint32_t i = haveToken(parser, parser->pos) ? parser->pos : parser->end - 1;
+    return parser->end > 0 ? parserTokenLocation(parser, i) : NO_LOCATION;
+}
+
+// Move to the next token (never past the end)
+static inline void advanceToken(Parser *parser) {
+    if (haveToken(parser, parser->pos)) {
+        parser->pos++;
+    }
+}
+
+// Is the current token the given special symbol, operator or keyword?
+static inline int atSpecial(Parser *parser, SpecialSymbolId symbol) {
+    TokenType type = peekType(parser, 0);
+    return (type == TOKEN_SPECIAL_SYMBOL || type == TOKEN_EOL) && peekPayload(parser, 0) == (uint32_t)symbol;
+}
+
+static inline int atOperator(Parser *parser, OperatorId op) {
+    return peekType(parser, 0) == TOKEN_OPERATOR && peekPayload(parser, 0) == (uint32_t)op;
+}
+
+static inline int atKeyword(Parser *parser, KeywordId keyword) {
+    return peekType(parser, 0) == TOKEN_KEYWORD && peekPayload(parser, 0) == (uint32_t)keyword;
+}
+
+// Is the token type one of the identifier types the lexer produces?
+static inline int isNameToken(TokenType type) {
+    return type == TOKEN_IDENTIFIER || type == TOKEN_VARIABLE ||
+           type == TOKEN_FUNCTION || type == TOKEN_CLASSED_VARIABLE;
+}
+
+// Is the token a name spelled वा? The lexer splits "वा यदि" (else-if) at the
+// space, so the parser sees the name वा and then the keyword यदि
+static inline int isVaToken(TokenType type, uint32_t payload) {
+    return isNameToken(type) && payload != NO_PAYLOAD && wcscmp(symbolText(payload), L"वा") == 0;
+}
+
+// Is the current token the वा of वा यदि?
+static inline int atElseIf(Parser *parser) {
+    return isVaToken(peekType(parser, 0), peekPayload(parser, 0)) &&
+           peekType(parser, 1) == TOKEN_KEYWORD && peekPayload(parser, 1) == KEYWORD_YADI;
+}
+
+#endif // PARSER_H
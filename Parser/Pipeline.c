@@ -0,0 +1,327 @@
+#include "Pipeline.h"
+#include "Lexer.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_BATCH_TOKENS 4096
+#define DEFAULT_RING_BATCHES 8
+#define SPIN_LIMIT 64          // Polls before a waiting thread yields its CPU
+
+// Lock-free ring of batch pointers between exactly one producer and one consumer.
+// Only the consumer writes head and only the producer writes tail; each publishes
+// its move with a release store that the other side reads with acquire, which
+// also makes the batch's contents visible. The two counters live on separate
+// cache lines so the threads do not keep stealing one line from each other
+typedef struct {
+    TokenCollector **slots;
+    uint32_t mask;                       // Capacity - 1 (capacity is a power of two)
+    _Alignas(64) atomic_uint head;       // Next slot to read
+    _Alignas(64) atomic_uint tail;       // Next slot to write
+} BatchRing;
+
+typedef struct {
+    BatchRing full;            // Lexer -> parser: batches of tokens
+    BatchRing free;            // Parser -> lexer: emptied batches
+    TokenCollector *batches;   // Every batch
+    uint32_t batchCount;
+    TokenCollector lexing;     // The lexer's collector; its arrays move into a batch on each flush
+    SourceFileId file;
+    atomic_int done;           // Set by the lexer after its last batch was pushed
+
+    TokenCollector window;     // Tokens the parser can see
+    uint32_t numbersSeen;      // Numbers in all batches taken so far
+    int sawEnd;                // The batch with TOKEN_EOF was taken
+    PipelineStats stats;       // lexerWaits is written by the lexer, the rest by the parser
+} Pipeline;
+
+static int initRing(BatchRing *ring, uint32_t minCapacity) {
+    uint32_t capacity = 1;
+    while (capacity < minCapacity) {
+        capacity *= 2;
+    }
+    ring->slots = malloc(capacity * sizeof(TokenCollector *));
+    ring->mask = capacity - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    return ring->slots != NULL;
+}
+
+// Add a batch. Returns 0 if the ring is full
+static int ringPush(BatchRing *ring, TokenCollector *batch) {
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (tail - head > ring->mask) {
+        return 0;
+    }
+    ring->slots[tail & ring->mask] = batch;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+// Take the oldest batch. Returns NULL if the ring is empty
+static TokenCollector *ringPop(BatchRing *ring) {
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head == tail) {
+        return NULL;
+    }
+    TokenCollector *batch = ring->slots[head & ring->mask];
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return batch;
+}
+
+// Wait a little for the other thread: poll for a while, then give up the CPU
+static void backOff(unsigned *spins) {
+    if (++*spins >= SPIN_LIMIT) {
+        sched_yield();
+    }
+}
+
+// Lexer side, called through the collector's flush hook: move the collected
+// tokens into a free batch and publish it
+static void handOver(TokenCollector *lexing, void *context) {
+    Pipeline *pipeline = context;
+    if (lexing->count == 0) {
+        return;
+    }
+    TokenCollector *batch;
+    unsigned spins = 0;
+    if (!(batch = ringPop(&pipeline->free))) {
+        pipeline->stats.lexerWaits++;
+        while (!(batch = ringPop(&pipeline->free))) {
+            backOff(&spins);
+        }
+    }
+
+    // Swap arrays instead of copying: the batch takes the tokens and the lexer
+    // carries on in the batch's emptied arrays
+    TokenCollector emptied = *batch;
+    *batch = *lexing;
+    batch->flush = NULL;
+    lexing->types = emptied.types;
+    lexing->offsets = emptied.offsets;
+    lexing->lengths = emptied.lengths;
+    lexing->payloads = emptied.payloads;
+    lexing->capacity = emptied.capacity;
+    lexing->numbers = emptied.numbers;
+    lexing->numberCapacity = emptied.numberCapacity;
+    clearTokenCollector(lexing);
+
+    // Never waits: there are no more batches than slots
+    while (!ringPush(&pipeline->full, batch)) {
+        backOff(&spins);
+    }
+}
+
+static void *lexerThread(void *argument) {
+    Pipeline *pipeline = argument;
+    tokenizeSourceFileInto(pipeline->file, &pipeline->lexing);
+    handOver(&pipeline->lexing, pipeline);  // The rest, ending with TOKEN_EOF
+    atomic_store_explicit(&pipeline->done, 1, memory_order_release);
+    return NULL;
+}
+
+// Forget the window's tokens before the current top-level statement, and the
+// numbers only they used
+static void dropOldTokens(Pipeline *pipeline, Parser *parser) {
+    TokenCollector *window = &pipeline->window;
+    uint32_t drop = parser->mark - parser->tokenBase;
+    if (drop == 0) {
+        return;
+    }
+    uint32_t keep = window->count - drop;
+    if (keep > 0) {
+        memmove(window->types, window->types + drop, keep * sizeof(uint8_t));
+        memmove(window->offsets, window->offsets + drop, keep * sizeof(uint32_t));
+        memmove(window->lengths, window->lengths + drop, keep * sizeof(uint32_t));
+        memmove(window->payloads, window->payloads + drop, keep * sizeof(uint32_t));
+    }
+    window->count = keep;
+    parser->tokenBase += drop;
+
+    // Numbers are stored in token order, so the first number token left marks
+    // the first value still needed
+    uint32_t dropNumbers = window->numberCount;
+    for (uint32_t i = 0; i < keep; i++) {
+        if (window->types[i] == TOKEN_NUMBER && window->payloads[i] != NO_PAYLOAD) {
+            dropNumbers = window->payloads[i] - parser->numberBase;
+            break;
+        }
+    }
+    if (window->numbers && dropNumbers < window->numberCount) {
+        memmove(window->numbers, window->numbers + dropNumbers,
+                (window->numberCount - dropNumbers) * sizeof(int64_t));
+    }
+    window->numberCount -= dropNumbers;
+    parser->numberBase += dropNumbers;
+}
+
+// Copy a batch to the end of the window. Number payloads are renumbered so they
+// count numbers from the start of the file
+static void takeBatch(Pipeline *pipeline, Parser *parser, const TokenCollector *batch) {
+    TokenCollector *window = &pipeline->window;
+    if (window->count + batch->count > window->capacity) {
+        dropOldTokens(pipeline, parser);
+    }
+    window->base = batch->base;
+    if (batch->failed) {
+        window->failed = 1;
+    }
+    for (uint32_t n = 0; n < batch->numberCount; n++) {
+        addNumber(window, batch->numbers[n]);
+    }
+    for (uint32_t i = 0; i < batch->count; i++) {
+        uint32_t payload = batch->payloads[i];
+        if (batch->types[i] == TOKEN_NUMBER && payload != NO_PAYLOAD) {
+            payload += pipeline->numbersSeen;
+        } else if (batch->types[i] == TOKEN_EOF) {
+            pipeline->sawEnd = 1;
+        }
+        appendToken(window, (TokenType)batch->types[i], batch->offsets[i], batch->lengths[i], payload);
+    }
+    pipeline->numbersSeen += batch->numberCount;
+    pipeline->stats.tokens += batch->count;
+    pipeline->stats.batches++;
+    if (window->count > pipeline->stats.peakWindow) {
+        pipeline->stats.peakWindow = window->count;
+    }
+
+    // As in initParser(), the final TOKEN_EOF stays behind end
+    parser->end = parser->tokenBase + window->count;
+    if (pipeline->sawEnd && window->count > 0 && window->types[window->count - 1] == TOKEN_EOF) {
+        parser->end--;
+    }
+}
+
+// Parser side: take batches until token index is loaded or the input ends
+static int refillTokens(Parser *parser, uint32_t index) {
+    Pipeline *pipeline = parser->refillContext;
+    while (index >= parser->end) {
+        if (pipeline->sawEnd) {
+            return 0;
+        }
+        TokenCollector *batch = ringPop(&pipeline->full);
+        if (!batch) {
+            unsigned spins = 0;
+            pipeline->stats.parserWaits++;
+            while (!(batch = ringPop(&pipeline->full))) {
+                if (atomic_load_explicit(&pipeline->done, memory_order_acquire)) {
+                    // The last push happened before done was set
+                    batch = ringPop(&pipeline->full);
+                    break;
+                }
+                backOff(&spins);
+            }
+            if (!batch) {
+                pipeline->sawEnd = 1;
+                return 0;
+            }
+        }
+        takeBatch(pipeline, parser, batch);
+        clearTokenCollector(batch);
+        ringPush(&pipeline->free, batch);  // Never full, see handOver()
+    }
+    return 1;
+}
+
+// Throw away the remaining batches so the lexer can finish (the parser stopped early)
+static void drainBatches(Pipeline *pipeline) {
+    unsigned spins = 0;
+    for (;;) {
+        int done = atomic_load_explicit(&pipeline->done, memory_order_acquire);
+        TokenCollector *batch;
+        while ((batch = ringPop(&pipeline->full))) {
+            clearTokenCollector(batch);
+            ringPush(&pipeline->free, batch);
+        }
+        if (done) {
+            return;
+        }
+        backOff(&spins);
+    }
+}
+
+static void freePipeline(Pipeline *pipeline) {
+    for (uint32_t b = 0; pipeline->batches && b < pipeline->batchCount; b++) {
+        freeTokenCollector(&pipeline->batches[b]);
+    }
+    free(pipeline->batches);
+    free(pipeline->full.slots);
+    free(pipeline->free.slots);
+    freeTokenCollector(&pipeline->lexing);
+    freeTokenCollector(&pipeline->window);
+}
+
+// Lex and parse a registered file concurrently into ast
+uint32_t parsePipelined(SourceFileId file, Ast *ast, DiagnosticBuffer *diagnostics,
+                        const PipelineOptions *options, PipelineStats *stats) {
+    uint32_t batchTokens = options && options->batchTokens ? options->batchTokens : DEFAULT_BATCH_TOKENS;
+    uint32_t ringBatches = options && options->ringBatches ? options->ringBatches : DEFAULT_RING_BATCHES;
+    if (ringBatches < 2) {
+        ringBatches = 2;
+    }
+
+    Pipeline pipeline;
+    memset(&pipeline, 0, sizeof(pipeline));
+    pipeline.file = file;
+    atomic_init(&pipeline.done, 0);
+    initTokenCollector(&pipeline.lexing, batchTokens);
+    initTokenCollector(&pipeline.window, batchTokens * 2);
+    pipeline.batches = calloc(ringBatches, sizeof(TokenCollector));
+    pipeline.batchCount = ringBatches;
+    int ready = pipeline.batches && pipeline.lexing.capacity && pipeline.window.capacity &&
+                initRing(&pipeline.full, ringBatches) && initRing(&pipeline.free, ringBatches);
+    for (uint32_t b = 0; ready && b < ringBatches; b++) {
+        initTokenCollector(&pipeline.batches[b], batchTokens);
+        ready = pipeline.batches[b].capacity != 0;
+        ringPush(&pipeline.free, &pipeline.batches[b]);
+    }
+    if (!ready) {
+        fprintf(stderr, "Memory allocation failed for the token pipeline!\n");
+        freePipeline(&pipeline);
+        ast->failed = 1;
+        return 0;
+    }
+    pipeline.lexing.flush = handOver;
+    pipeline.lexing.flushContext = &pipeline;
+    pipeline.lexing.flushAt = batchTokens;
+
+    Parser parser;
+    initParser(&parser, &pipeline.window, ast);
+    parser.diagnostics = diagnostics;
+
+    pthread_t lexer;
+    int threaded = pthread_create(&lexer, NULL, lexerThread, &pipeline) == 0;
+    if (threaded) {
+        parser.refill = refillTokens;
+        parser.refillContext = &pipeline;
+    } else {
+        // No second thread: lex everything, then parse it
+        tokenizeSourceFileInto(file, &pipeline.window);
+        initParser(&parser, &pipeline.window, ast);
+        parser.diagnostics = diagnostics;
+        pipeline.stats.tokens = pipeline.window.count;
+        pipeline.stats.peakWindow = pipeline.window.count;
+    }
+
+    uint32_t root = parseProgram(&parser);
+    if (threaded) {
+        if (!pipeline.sawEnd) {
+            drainBatches(&pipeline);
+        }
+        pthread_join(lexer, NULL);
+    }
+    if (pipeline.window.failed) {
+        ast->failed = 1;
+    }
+    if (stats) {
+        *stats = pipeline.stats;
+    }
+    freeParser(&parser);
+    freePipeline(&pipeline);
+    return root;
+}
@@ -0,0 +1,42 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdint.h>
+#include "Parser.h"
+#include "SourceManager.h"
+
+// Pipelined lexing and parsing
+// The lexer runs on a thread of its own and hands its tokens over in fixed-size
+// batches through a lock-free single-producer/single-consumer ring, while the
+// calling thread parses them. Batches the parser is done with go back to the
+// lexer through a second ring, so only ringBatches batches ever exist and the
+// lexer waits when it gets that far ahead.
+//
+// The parser copies each batch into a token window that starts at the current
+// top-level statement; older tokens are dropped when the window fills up. Memory
+// for tokens is therefore bounded by the batches plus the longest top-level
+// statement rather than by the size of the file. The tree is the same as
+// parseProgram() builds from tokenizeSourceFile().
+
+// Sizes (0 picks the default)
+typedef struct {
+    uint32_t batchTokens;      // Tokens per batch
+    uint32_t ringBatches;      // Batches in flight between the two threads
+} PipelineOptions;
+
+// What happened during a run
+typedef struct {
+    uint64_t tokens;           // Tokens lexed (EOF included)
+    uint32_t batches;          // Batches handed over
+    uint32_t peakWindow;       // Most tokens the parser held at once
+    uint64_t lexerWaits;       // Times the lexer found no free batch
+    uint64_t parserWaits;      // Times the parser found no full batch
+} PipelineStats;
+
+// Lex and parse a registered file concurrently into ast. Errors go to diagnostics
+// (may be NULL); options and stats may be NULL. Sets ast->root and returns it.
+// If no thread can be started the file is lexed first and then parsed
+uint32_t parsePipelined(SourceFileId file, Ast *ast, DiagnosticBuffer *diagnostics,
+                        const PipelineOptions *options, PipelineStats *stats);
+
+#endif // PIPELINE_H
@@ -0,0 +1,603 @@
+#include "QueryDb.h"
+#include "Lexer.h"
+#include "ParallelParser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+#define NO_ANCHOR UINT32_MAX
+
+// Queries each kind reads (besides the file's own earlier results, none)
+static const uint8_t queryInputs[QUERY_KIND_COUNT][2] = {
+    [QUERY_TEXT] = {QUERY_KIND_COUNT, QUERY_KIND_COUNT},
+    [QUERY_TOKENS] = {QUERY_TEXT, QUERY_KIND_COUNT},
+    [QUERY_TREE] = {QUERY_TOKENS, QUERY_KIND_COUNT},
+    [QUERY_NAMES] = {QUERY_TREE, QUERY_KIND_COUNT},
+    [QUERY_TYPES] = {QUERY_TREE, QUERY_NAMES},
+};
+
+// FNV-1a step over the bytes of a 64-bit value
+static uint64_t mixHash(uint64_t hash, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        hash = (hash ^ (value & 0xff)) * FNV_PRIME;
+        value >>= 8;
+    }
+    return hash;
+}
+
+static uint64_t mixArray(uint64_t hash, const void *data, size_t size) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+void initQueryDb(QueryDb *db) {
+    memset(db, 0, sizeof(*db));
+    db->revision = 1;
+}
+
+static void freeItem(QueryItem *item) {
+    freeAst(&item->ast);
+    freeDiagnostics(&item->diagnostics);
+}
+
+static void freeFile(QueryFile *file) {
+    free(file->name);
+    freeTokenCollector(&file->tokens);
+    freeAst(&file->tree);
+    freeAstOrder(&file->order);
+    free(file->items);
+    freeDiagnostics(&file->syntax);
+    freeResolution(&file->names);
+    freeDiagnostics(&file->nameDiagnostics);
+    free(file->nameAnchors);
+    freeTypeCheck(&file->types);
+    freeDiagnostics(&file->typeDiagnostics);
+    free(file->typeAnchors);
+}
+
+void freeQueryDb(QueryDb *db) {
+    for (uint32_t i = 0; i < db->fileCount; i++) {
+        freeFile(&db->files[i]);
+    }
+    for (uint32_t i = 0; i < db->itemCount; i++) {
+        freeItem(&db->items[i]);
+    }
+    free(db->files);
+    free(db->items);
+    free(db->itemBuckets);
+    memset(db, 0, sizeof(*db));
+}
+
+static QueryFile *fileOf(QueryDb *db, QueryFileId id) {
+    return (id != NO_QUERY_FILE && id <= db->fileCount) ? &db->files[id - 1] : NULL;
+}
+
+// Set the text of a file, starting a new revision if it changed
+QueryFileId setQueryFileText(QueryDb *db, const char *name, const wchar_t *text, size_t length) {
+    QueryFileId id = NO_QUERY_FILE;
+    for (uint32_t i = 0; i < db->fileCount; i++) {
+        if (strcmp(db->files[i].name, name) == 0) {
+            id = i + 1;
+            break;
+        }
+    }
+    QueryFile *file = fileOf(db, id);
+    if (file && sourceLength(file->source) == length &&
+        wmemcmp(sourceBuffer(file->source), text, length) == 0) {
+        return id;  // Same text: every result stays valid
+    }
+
+    if (!file) {
+        if (db->fileCount == db->fileCapacity) {
+            uint32_t capacity = db->fileCapacity ? db->fileCapacity * 2 : 8;
+            QueryFile *grown = realloc(db->files, capacity * sizeof(QueryFile));
+            if (!grown) {
+                fprintf(stderr, "Memory allocation failed for the query database!\n");
+                return NO_QUERY_FILE;
+            }
+            db->files = grown;
+            db->fileCapacity = capacity;
+        }
+        file = &db->files[db->fileCount];
+        memset(file, 0, sizeof(*file));
+        file->name = malloc(strlen(name) + 1);
+        if (!file->name) {
+            fprintf(stderr, "Memory allocation failed for the query database!\n");
+            return NO_QUERY_FILE;
+        }
+        strcpy(file->name, name);
+        initAst(&file->tree, 64);
+        initDiagnostics(&file->syntax);
+        initDiagnostics(&file->nameDiagnostics);
+        initDiagnostics(&file->typeDiagnostics);
+        id = ++db->fileCount;
+    }
+
+    // Each text is registered anew so locations of older results stay meaningful
+    wchar_t *copy = malloc((length + 1) * sizeof(wchar_t));
+    if (!copy) {
+        fprintf(stderr, "Memory allocation failed for the query database!\n");
+        return NO_QUERY_FILE;
+    }
+    wmemcpy(copy, text, length);
+    copy[length] = L'\0';
+    SourceFileId source = addSourceBuffer(name, copy, length);
+    if (source == NO_FILE) {
+        return NO_QUERY_FILE;
+    }
+    file->source = source;
+    db->revision++;
+    file->memos[QUERY_TEXT] = (QueryMemo){0, db->revision, db->revision, 1};
+    return id;
+}
+
+// Token whose location is exactly location (NO_ANCHOR if none). Tokens are in
+// order of their offsets, so this is a binary search
+static uint32_t findAnchor(const TokenCollector *tokens, SourceLocation location) {
+    if (location == NO_LOCATION || tokens->base == NO_LOCATION || location < tokens->base) {
+        return NO_ANCHOR;
+    }
+    uint32_t offset = location - tokens->base;
+    uint32_t low = 0, high = tokens->count;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (tokens->offsets[middle] < offset) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return (low < tokens->count && tokens->offsets[low] == offset) ? low : NO_ANCHOR;
+}
+
+// Remember which token each diagnostic is located at. Returns the new anchor array
+static uint32_t *anchorDiagnostics(const TokenCollector *tokens, const DiagnosticBuffer *diagnostics,
+                                   uint32_t *anchors) {
+    uint32_t *grown = realloc(anchors, (diagnostics->count ? diagnostics->count : 1) * sizeof(uint32_t));
+    if (!grown) {
+        fprintf(stderr, "Memory allocation failed for the query database!\n");
+        free(anchors);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < diagnostics->count; i++) {
+        grown[i] = findAnchor(tokens, diagnostics->items[i].location);
+    }
+    return grown;
+}
+
+// Hash of diagnostics without their positions
+static uint64_t hashDiagnostics(uint64_t hash, const DiagnosticBuffer *diagnostics, const uint32_t *anchors) {
+    for (uint32_t i = 0; i < diagnostics->count; i++) {
+        const Diagnostic *entry = &diagnostics->items[i];
+        hash = mixHash(hash, (uint64_t)(uintptr_t)entry->message);
+        hash = mixHash(hash, ((uint64_t)entry->symbol << 32) | entry->token);
+        hash = mixHash(hash, anchors ? anchors[i] : NO_ANCHOR);
+    }
+    return hash;
+}
+
+static uint64_t computeTokens(QueryFile *file) {
+    freeTokenCollector(&file->tokens);
+    file->tokens = tokenizeSourceFile(file->source);
+    const TokenCollector *tokens = &file->tokens;
+    uint64_t hash = mixHash(FNV_OFFSET, tokens->base);
+    hash = mixArray(hash, tokens->types, tokens->count * sizeof(uint8_t));
+    hash = mixArray(hash, tokens->offsets, tokens->count * sizeof(uint32_t));
+    hash = mixArray(hash, tokens->payloads, tokens->count * sizeof(uint32_t));
+    return mixArray(hash, tokens->numbers, tokens->numberCount * sizeof(int64_t));
+}
+
+// Hash the tokens of a chunk: shape covers what the parser reads, key also the
+// offsets relative to the chunk (including that of the token after it, where
+// errors at the end of the chunk are located)
+static void hashChunk(const TokenCollector *tokens, const TopLevelChunk *chunk, uint64_t *key, uint64_t *shape) {
+    uint32_t start = tokens->offsets[chunk->first];
+    uint64_t shapeHash = mixHash(FNV_OFFSET, chunk->end - chunk->first);
+    uint64_t offsetHash = FNV_OFFSET;
+    for (uint32_t i = chunk->first; i < chunk->end; i++) {
+        uint64_t payload = tokens->types[i] == TOKEN_NUMBER ? (uint64_t)tokens->numbers[tokens->payloads[i]]
+                                                            : tokens->payloads[i];
+        shapeHash = mixHash(shapeHash, ((uint64_t)tokens->types[i] << 56) ^ payload);
+        offsetHash = mixHash(offsetHash, tokens->offsets[i] - start);
+    }
+    if (chunk->end < tokens->count) {
+        offsetHash = mixHash(offsetHash, tokens->offsets[chunk->end] - start);
+    }
+    *shape = shapeHash;
+    *key = mixHash(shapeHash, offsetHash);
+}
+
+static int growItemIndex(QueryDb *db);
+
+static QueryItem *findItem(QueryDb *db, uint64_t key) {
+    if (db->bucketCount == 0) {
+        return NULL;
+    }
+    uint32_t mask = db->bucketCount - 1;
+    for (uint32_t b = (uint32_t)key & mask; db->itemBuckets[b] != 0; b = (b + 1) & mask) {
+        QueryItem *item = &db->items[db->itemBuckets[b] - 1];
+        if (item->key == key) {
+            return item;
+        }
+    }
+    return NULL;
+}
+
+static void indexItem(QueryDb *db, uint32_t index) {
+    uint32_t mask = db->bucketCount - 1;
+    uint32_t b = (uint32_t)db->items[index].key & mask;
+    while (db->itemBuckets[b] != 0) {
+        b = (b + 1) & mask;
+    }
+    db->itemBuckets[b] = index + 1;
+}
+
+// Keep the index at most half full
+static int growItemIndex(QueryDb *db) {
+    if ((db->itemCount + 1) * 2 <= db->bucketCount) {
+        return 1;
+    }
+    uint32_t count = db->bucketCount ? db->bucketCount * 2 : 256;
+    while ((db->itemCount + 1) * 2 > count) {
+        count *= 2;
+    }
+    uint32_t *buckets = calloc(count, sizeof(uint32_t));
+    if (!buckets) {
+        return 0;
+    }
+    free(db->itemBuckets);
+    db->itemBuckets = buckets;
+    db->bucketCount = count;
+    for (uint32_t i = 0; i < db->itemCount; i++) {
+        indexItem(db, i);
+    }
+    return 1;
+}
+
+// Parse a chunk into a new item. Returns NULL if out of memory
+static QueryItem *parseItem(QueryDb *db, const TokenCollector *tokens, const TopLevelChunk *chunk,
+                            uint64_t key, uint64_t shape) {
+    if (!growItemIndex(db)) {
+        fprintf(stderr, "Memory allocation failed for the query database!\n");
+        return NULL;
+    }
+    if (db->itemCount == db->itemCapacity) {
+        uint32_t capacity = db->itemCapacity ? db->itemCapacity * 2 : 64;
+        QueryItem *grown = realloc(db->items, capacity * sizeof(QueryItem));
+        if (!grown) {
+            fprintf(stderr, "Memory allocation failed for the query database!\n");
+            return NULL;
+        }
+        db->items = grown;
+        db->itemCapacity = capacity;
+    }
+    QueryItem *item = &db->items[db->itemCount];
+    memset(item, 0, sizeof(*item));
+    item->key = key;
+    item->shape = shape;
+    item->tokenCount = chunk->end - chunk->first;
+    initAst(&item->ast, item->tokenCount / 2 + 16);
+    initDiagnostics(&item->diagnostics);
+
+    Parser parser;
+    initParser(&parser, tokens, &item->ast);
+    parser.pos = chunk->first;
+    parser.end = chunk->end;
+    parser.diagnostics = &item->diagnostics;
+    item->program = parseProgram(&parser);
+    freeParser(&parser);
+    if (item->ast.failed) {
+        freeItem(item);
+        return NULL;
+    }
+
+    // Make the item independent of where it is
+    SourceLocation base = tokenLocation(tokens, chunk->first);
+    for (uint32_t i = 1; i < item->ast.nodeCount; i++) {
+        if (base != NO_LOCATION && item->ast.nodes[i].location != NO_LOCATION) {
+            item->ast.nodes[i].location = item->ast.nodes[i].location - base + 1;  // 0 stays unknown
+        }
+        item->ast.spans[i].first -= chunk->first;
+        item->ast.spans[i].end -= chunk->first;
+    }
+    for (uint32_t i = 0; i < item->diagnostics.count; i++) {
+        item->diagnostics.items[i].token -= chunk->first;
+        item->diagnostics.items[i].location = NO_LOCATION;
+    }
+    indexItem(db, db->itemCount++);
+    db->stats.itemsParsed++;
+    return item;
+}
+
+// Drop the items that no file's tree is made of
+static void sweepItems(QueryDb *db) {
+    for (uint32_t i = 0; i < db->itemCount; i++) {
+        db->items[i].marked = 0;
+    }
+    for (uint32_t f = 0; f < db->fileCount; f++) {
+        const QueryFile *file = &db->files[f];
+        for (uint32_t i = 0; i < file->itemCount; i++) {
+            QueryItem *item = findItem(db, file->items[i]);
+            if (item) {
+                item->marked = 1;
+            }
+        }
+    }
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < db->itemCount; i++) {
+        if (db->items[i].marked) {
+            db->items[kept++] = db->items[i];
+        } else {
+            freeItem(&db->items[i]);
+        }
+    }
+    db->itemCount = kept;
+    db->liveItems = kept;
+    memset(db->itemBuckets, 0, db->bucketCount * sizeof(uint32_t));
+    for (uint32_t i = 0; i < db->itemCount; i++) {
+        indexItem(db, i);
+    }
+}
+
+static int rememberItem(QueryFile *file, uint64_t key) {
+    if (file->itemCount == file->itemCapacity) {
+        uint32_t capacity = file->itemCapacity ? file->itemCapacity * 2 : 16;
+        uint64_t *grown = realloc(file->items, capacity * sizeof(uint64_t));
+        if (!grown) {
+            fprintf(stderr, "Memory allocation failed for the query database!\n");
+            return 0;
+        }
+        file->items = grown;
+        file->itemCapacity = capacity;
+    }
+    file->items[file->itemCount++] = key;
+    return 1;
+}
+
+// Add an item's nodes and syntax errors to the file's tree at chunk.
+// Returns the item's AST_PROGRAM in the tree, 0 if out of memory
+static uint32_t appendItem(QueryFile *file, QueryItem *item, const TopLevelChunk *chunk) {
+    const TokenCollector *tokens = &file->tokens;
+    Ast *tree = &file->tree;
+    uint32_t shift, listShift;
+    item->ast.locationBase = tokenLocation(tokens, chunk->first) - 1;  // astAppend() adds it to locations
+    int ok = astAppend(tree, &item->ast, &shift, &listShift);
+    item->ast.locationBase = 0;
+    if (!ok) {
+        return 0;
+    }
+    for (uint32_t i = 1 + shift; i < tree->nodeCount; i++) {
+        tree->spans[i].first += chunk->first;
+        tree->spans[i].end += chunk->first;
+    }
+    for (uint32_t i = 0; i < item->diagnostics.count; i++) {
+        const Diagnostic *entry = &item->diagnostics.items[i];
+        uint32_t token = entry->token + chunk->first;
+        SourceLocation location = token < tokens->count ? tokenLocation(tokens, token) : NO_LOCATION;
+        addDiagnostic(&file->syntax, (DiagnosticSeverity)entry->severity, location, token,
+                      entry->symbol, entry->message);
+    }
+    return item->program + shift;
+}
+
+// Start the file's tree over
+static void clearTree(QueryFile *file) {
+    resetAst(&file->tree);
+    file->tree.failed = 0;
+    clearDiagnostics(&file->syntax);
+    file->itemCount = 0;
+}
+
+// Add the items of chunks to the file's tree, parsing only new ones, and store
+// their AST_PROGRAMs in programs. Returns 0 if out of memory
+static int addItems(QueryDb *db, QueryFile *file, const TopLevelChunk *chunks, uint32_t chunkCount,
+                    uint32_t *programs, uint32_t *statementCount, uint64_t *fingerprint) {
+    const TokenCollector *tokens = &file->tokens;
+    *statementCount = 0;
+    *fingerprint = FNV_OFFSET;
+    for (uint32_t c = 0; c < chunkCount; c++) {
+        uint64_t key, shape;
+        hashChunk(tokens, &chunks[c], &key, &shape);
+        QueryItem *item = findItem(db, key);
+        if (item && item->tokenCount == chunks[c].end - chunks[c].first && item->shape == shape) {
+            db->stats.itemsReused++;
+        } else {
+            item = parseItem(db, tokens, &chunks[c], key, shape);
+        }
+        if (!item || !rememberItem(file, key) || (programs[c] = appendItem(file, item, &chunks[c])) == 0) {
+            return 0;
+        }
+        *statementCount += file->tree.nodes[programs[c]].b;
+        *fingerprint = mixHash(*fingerprint, shape);
+    }
+    return 1;
+}
+
+// Build the tree from the file's top-level items, parsing only new ones.
+// The fingerprint covers the items' tokens but not where they are
+static uint64_t computeTree(QueryDb *db, QueryFile *file) {
+    const TokenCollector *tokens = &file->tokens;
+    Ast *tree = &file->tree;
+    clearTree(file);
+    freeAstOrder(&file->order);
+
+    TopLevelChunk *chunks = NULL;
+    uint32_t chunkCount = scanTopLevel(tokens, &chunks);
+    uint32_t *programs = malloc((chunkCount ? chunkCount : 1) * sizeof(uint32_t));
+    uint64_t fingerprint = FNV_OFFSET;
+    uint32_t statementCount = 0;
+    int ok = programs != NULL && (chunkCount > 0 || tokens->count == 0) &&
+             addItems(db, file, chunks, chunkCount, programs, &statementCount, &fingerprint);
+
+    // An item with syntax errors may have recovered differently from how the whole
+    // file would, so like parseParallel() a broken file is parsed as one item
+    if (ok && file->syntax.count > 0 && chunkCount > 1) {
+        clearTree(file);
+        chunks[0] = (TopLevelChunk){chunks[0].first, chunks[chunkCount - 1].end, 0};
+        chunkCount = 1;
+        ok = addItems(db, file, chunks, chunkCount, programs, &statementCount, &fingerprint);
+    }
+
+    // One program holding the statements of every item, as parseParallel() builds it
+    uint32_t *statements = ok ? malloc((statementCount + 1) * sizeof(uint32_t)) : NULL;
+    if (statements) {
+        uint32_t n = 0;
+        for (uint32_t c = 0; c < chunkCount; c++) {
+            const AstNode *program = &tree->nodes[programs[c]];
+            if (program->b > 0) {
+                memcpy(&statements[n], &tree->lists[program->a], program->b * sizeof(uint32_t));
+            }
+            n += program->b;
+        }
+        uint32_t list = astAddList(tree, statements, statementCount);
+        SourceLocation location = tokens->count > 0 ? tokenLocation(tokens, 0) : NO_LOCATION;
+        tree->root = astAddNode(tree, AST_PROGRAM, 0, location, list, statementCount, 0);
+        astSetSpan(tree, tree->root, 0, chunkCount ? chunks[chunkCount - 1].end : 0);
+        free(statements);
+    } else {
+        tree->failed = 1;
+    }
+    free(programs);
+    free(chunks);
+    if (tree->failed || !buildAstOrder(tree, tree->root, &file->order)) {
+        return mixHash(fingerprint, db->revision);  // Never equal to a good tree
+    }
+    if (db->itemCount > 2 * db->liveItems + 64) {
+        sweepItems(db);
+    }
+    return fingerprint;
+}
+
+static uint64_t computeNames(QueryFile *file) {
+    freeResolution(&file->names);
+    clearDiagnostics(&file->nameDiagnostics);
+    resolveNames(&file->tree, &file->order, &file->names, &file->nameDiagnostics);
+    file->nameAnchors = anchorDiagnostics(&file->tokens, &file->nameDiagnostics, file->nameAnchors);
+    const Resolution *names = &file->names;
+    uint64_t hash = mixHash(FNV_OFFSET, names->nodeCount);
+    if (names->declarations) {
+        hash = mixArray(hash, names->declarations, names->nodeCount * sizeof(uint32_t));
+        hash = mixArray(hash, names->slots, names->nodeCount * sizeof(uint32_t));
+        hash = mixArray(hash, names->storage, names->nodeCount * sizeof(uint8_t));
+    }
+    return hashDiagnostics(hash, &file->nameDiagnostics, file->nameAnchors);
+}
+
+static uint64_t computeTypes(QueryFile *file) {
+    freeTypeCheck(&file->types);
+    clearDiagnostics(&file->typeDiagnostics);
+    checkTypes(&file->tree, &file->order, &file->names, &file->types, &file->typeDiagnostics);
+    file->typeAnchors = anchorDiagnostics(&file->tokens, &file->typeDiagnostics, file->typeAnchors);
+    const TypeCheck *check = &file->types;
+    uint64_t hash = mixHash(FNV_OFFSET, check->nodeCount);
+    if (check->types) {
+        hash = mixArray(hash, check->types, check->nodeCount * sizeof(TypeId));
+    }
+    return hashDiagnostics(hash, &file->typeDiagnostics, file->typeAnchors);
+}
+
+// Bring a query up to date: verify it against its inputs and rerun it only if
+// one of them changed since it was last verified
+static void updateQuery(QueryDb *db, QueryFile *file, QueryKind kind) {
+    QueryMemo *memo = &file->memos[kind];
+    if (kind == QUERY_TEXT || memo->verifiedAt == db->revision) {
+        return;
+    }
+    int stale = !memo->computed;
+    for (int i = 0; i < 2 && queryInputs[kind][i] != QUERY_KIND_COUNT; i++) {
+        QueryKind input = (QueryKind)queryInputs[kind][i];
+        updateQuery(db, file, input);
+        if (file->memos[input].changedAt > memo->verifiedAt) {
+            stale = 1;
+        }
+    }
+    if (!stale) {
+        memo->verifiedAt = db->revision;
+        db->stats.verified++;
+        return;
+    }
+
+    uint64_t fingerprint = 0;
+    switch (kind) {
+        case QUERY_TOKENS: fingerprint = computeTokens(file); break;
+        case QUERY_TREE:   fingerprint = computeTree(db, file); break;
+        case QUERY_NAMES:  fingerprint = computeNames(file); break;
+        case QUERY_TYPES:  fingerprint = computeTypes(file); break;
+        default: break;
+    }
+    db->stats.runs[kind]++;
+    if (memo->computed && fingerprint == memo->fingerprint) {
+        db->stats.cutoffs++;  // Same result: what reads it need not rerun
+    } else {
+        memo->changedAt = db->revision;
+    }
+    memo->fingerprint = fingerprint;
+    memo->computed = 1;
+    memo->verifiedAt = db->revision;
+}
+
+const TokenCollector *queryTokens(QueryDb *db, QueryFileId id) {
+    QueryFile *file = fileOf(db, id);
+    if (!file) return NULL;
+    updateQuery(db, file, QUERY_TOKENS);
+    return &file->tokens;
+}
+
+const Ast *queryTree(QueryDb *db, QueryFileId id) {
+    QueryFile *file = fileOf(db, id);
+    if (!file) return NULL;
+    updateQuery(db, file, QUERY_TREE);
+    return &file->tree;
+}
+
+const AstOrder *queryTreeOrder(QueryDb *db, QueryFileId id) {
+    QueryFile *file = fileOf(db, id);
+    if (!file) return NULL;
+    updateQuery(db, file, QUERY_TREE);
+    return &file->order;
+}
+
+const Resolution *queryNames(QueryDb *db, QueryFileId id) {
+    QueryFile *file = fileOf(db, id);
+    if (!file) return NULL;
+    updateQuery(db, file, QUERY_NAMES);
+    return &file->names;
+}
+
+const TypeCheck *queryTypes(QueryDb *db, QueryFileId id) {
+    QueryFile *file = fileOf(db, id);
+    if (!file) return NULL;
+    updateQuery(db, file, QUERY_TYPES);
+    return &file->types;
+}
+
+// Copy diagnostics, moving each to where its token is now
+static void copyAnchored(const TokenCollector *tokens, const DiagnosticBuffer *from, const uint32_t *anchors,
+                         DiagnosticBuffer *out) {
+    for (uint32_t i = 0; i < from->count; i++) {
+        const Diagnostic *entry = &from->items[i];
+        SourceLocation location = entry->location;
+        if (anchors && anchors[i] != NO_ANCHOR && anchors[i] < tokens->count) {
+            location = tokenLocation(tokens, anchors[i]);
+        }
+        addDiagnostic(out, (DiagnosticSeverity)entry->severity, location, entry->token, entry->symbol,
+                      entry->message);
+    }
+}
+
+// Append every error of a file to out
+uint32_t queryDiagnostics(QueryDb *db, QueryFileId id, DiagnosticBuffer *out) {
+    QueryFile *file = fileOf(db, id);
+    if (!file) return 0;
+    updateQuery(db, file, QUERY_TYPES);
+    uint32_t before = out->errorCount;
+    copyAnchored(&file->tokens, &file->syntax, NULL, out);
+    copyAnchored(&file->tokens, &file->nameDiagnostics, file->nameAnchors, out);
+    copyAnchored(&file->tokens, &file->typeDiagnostics, file->typeAnchors, out);
+    return out->errorCount - before;
+}
@@ -0,0 +1,137 @@
+#ifndef QUERY_DB_H
+#define QUERY_DB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <wchar.h>
+#include "Parser.h"
+#include "Resolver.h"
+#include "TypeChecker.h"
+#include "Traversal.h"
+
+// Query database
+// A long-lived front end (an editor checker, a REPL) keeps its files here and asks
+// for results instead of running the passes itself. Every result is a query on
+// one file - its tokens, its tree, its name resolution, its types - that is
+// computed on demand and memoized together with the revision it last changed in.
+//
+// Editing a file starts a new revision. Nothing is recomputed until a result is
+// asked for; then each query first brings the queries it reads up to date and
+// reruns only if one of them changed since it was last verified. A query whose
+// new result equals the old one keeps its old revision (early cutoff), so the
+// queries after it are not rerun either: reformatting a file relexes it and
+// rebuilds its tree, but its names and types are reused.
+//
+// Trees are built from top-level items (a कर्म, a कक्षा, or the statements
+// between them), each parsed once and shared by content: an item whose tokens
+// are unchanged is taken over from the item table rather than parsed again, so
+// an edit inside one function reparses that function alone. The tree is the one
+// parseParallel() builds from the same chunks; a file with syntax errors is one
+// item, as parseParallel() then parses it in one go. Name resolution and type
+// checking need the whole file's scope and run per file.
+//
+// Results stay valid until the next call that changes or queries the database.
+// Every text set is registered with the source manager, which keeps it for the
+// life of the process. The database is not thread-safe.
+
+// Index of a file in the database (0 = none)
+typedef uint32_t QueryFileId;
+
+#define NO_QUERY_FILE ((QueryFileId)0)
+
+typedef enum {
+    QUERY_TEXT,                // The file's text (an input, set by setQueryFileText)
+    QUERY_TOKENS,              // tokenizeSourceFile()
+    QUERY_TREE,                // Tree assembled from top-level items, with its AstOrder
+    QUERY_NAMES,               // resolveNames()
+    QUERY_TYPES,               // checkTypes()
+    QUERY_KIND_COUNT
+} QueryKind;
+
+// Memo of one query
+typedef struct {
+    uint64_t fingerprint;      // Hash of the result, without source positions
+    uint32_t changedAt;        // Revision the result last changed in
+    uint32_t verifiedAt;       // Revision it was last known to be up to date in
+    uint8_t computed;
+} QueryMemo;
+
+// A parsed top-level item, keyed by its tokens. Locations are stored as offsets
+// from the item's first character plus one (as in the AST cache) and spans and
+// diagnostics relative to its first token, so one item serves wherever the same
+// tokens appear
+typedef struct {
+    uint64_t key;              // Hash of the tokens with their relative offsets
+    uint64_t shape;            // Hash of the tokens alone
+    uint32_t tokenCount;
+    Ast ast;
+    uint32_t program;          // AST_PROGRAM holding the item's statements
+    DiagnosticBuffer diagnostics;
+    uint8_t marked;            // Used while unused items are swept
+} QueryItem;
+
+typedef struct {
+    char *name;
+    SourceFileId source;       // Current text, registered with the source manager
+    QueryMemo memos[QUERY_KIND_COUNT];
+
+    TokenCollector tokens;     // QUERY_TOKENS
+    Ast tree;                  // QUERY_TREE
+    AstOrder order;
+    uint64_t *items;           // Keys of the items the tree was built from
+    uint32_t itemCount;
+    uint32_t itemCapacity;
+    DiagnosticBuffer syntax;   // Syntax errors of the tree
+    Resolution names;          // QUERY_NAMES
+    DiagnosticBuffer nameDiagnostics;
+    uint32_t *nameAnchors;     // Token each entry is located at (see queryDiagnostics)
+    TypeCheck types;           // QUERY_TYPES
+    DiagnosticBuffer typeDiagnostics;
+    uint32_t *typeAnchors;
+} QueryFile;
+
+// Work done since the database was created
+typedef struct {
+    uint32_t runs[QUERY_KIND_COUNT]; // Times each kind of query was computed
+    uint32_t verified;         // Times a memo was found up to date without rerunning
+    uint32_t cutoffs;          // Reruns that produced an unchanged result
+    uint32_t itemsParsed;      // Top-level items parsed
+    uint32_t itemsReused;      // Top-level items taken from the item table
+} QueryStats;
+
+typedef struct {
+    QueryFile *files;
+    uint32_t fileCount;
+    uint32_t fileCapacity;
+    QueryItem *items;
+    uint32_t itemCount;
+    uint32_t itemCapacity;
+    uint32_t *itemBuckets;     // Open-addressing index: item + 1, 0 = empty
+    uint32_t bucketCount;
+    uint32_t liveItems;        // Items left by the last sweep
+    uint32_t revision;         // Bumped by every change to an input
+    QueryStats stats;
+} QueryDb;
+
+void initQueryDb(QueryDb *db);
+
+// Free every file, item and result
+void freeQueryDb(QueryDb *db);
+
+// Set the text of the file called name (added if new; text is copied). Starts a
+// new revision unless the text is unchanged. Returns the file, NO_QUERY_FILE on failure
+QueryFileId setQueryFileText(QueryDb *db, const char *name, const wchar_t *text, size_t length);
+
+// Results of a file, brought up to date first. NULL for an unknown file
+const TokenCollector *queryTokens(QueryDb *db, QueryFileId file);
+const Ast *queryTree(QueryDb *db, QueryFileId file);
+const AstOrder *queryTreeOrder(QueryDb *db, QueryFileId file);
+const Resolution *queryNames(QueryDb *db, QueryFileId file);
+const TypeCheck *queryTypes(QueryDb *db, QueryFileId file);
+
+// Append the syntax, name and type errors of a file to out, located in its
+// current text (entries of reused results are moved along with their tokens).
+// Returns the number of errors
+uint32_t queryDiagnostics(QueryDb *db, QueryFileId file, DiagnosticBuffer *out);
+
+#endif // QUERY_DB_H
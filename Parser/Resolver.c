@@ -0,0 +1,347 @@
+#include "Resolver.h"
+#include "Interner.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Innermost declaration of a name
+typedef struct {
+    uint32_t declaration;      // Declaring node (0 = not declared)
+    uint32_t scope;            // Serial number of the scope that declared it
+    uint32_t frame;            // Frame the declaration belongs to (index into frames)
+} Binding;
+
+// Undo log entry: the binding a declaration hid
+typedef struct {
+    SymbolId symbol;
+    Binding previous;
+} HiddenBinding;
+
+typedef struct {
+    uint32_t serial;           // Tells scopes apart, even at the same depth
+    uint32_t undoMark;         // Undo log length when the scope was opened
+    uint32_t slotMark;         // Slots in use in the frame when the scope was opened
+} Scope;
+
+// Where variables get their slots: the program, a function or a class
+typedef struct {
+    uint32_t node;
+    uint8_t storage;           // StorageKind of its variables
+    uint32_t used;             // Slots in use
+    uint32_t size;             // Most slots in use at once
+} Frame;
+
+typedef struct {
+    const Ast *ast;
+    Resolution *result;
+    DiagnosticBuffer *diagnostics;
+    Binding *bindings;         // Indexed by SymbolId
+    uint32_t bindingCount;
+    HiddenBinding *undo;
+    uint32_t undoCount;
+    uint32_t undoCapacity;
+    Scope *scopes;
+    uint32_t scopeCount;
+    uint32_t scopeCapacity;
+    uint32_t nextSerial;
+    Frame *frames;
+    uint32_t frameCount;
+    uint32_t frameCapacity;
+    int failed;
+} Resolver;
+
+// Double a growable array. Returns the new block, or NULL (and marks the
+// resolver failed) if out of memory
+static void *growArray(Resolver *resolver, void *array, uint32_t *capacity, size_t size) {
+    uint32_t newCapacity = *capacity ? *capacity * 2 : 64;
+    void *grown = realloc(array, newCapacity * size);
+    if (!grown) {
+        fprintf(stderr, "Memory allocation failed for name resolution!\n");
+        resolver->failed = 1;
+        return NULL;
+    }
+    *capacity = newCapacity;
+    return grown;
+}
+
+// Report a name that cannot be resolved
+static void reportName(Resolver *resolver, uint32_t node, SymbolId symbol, const char *message) {
+    const Ast *ast = resolver->ast;
+    resolver->result->errorCount++;
+    if (resolver->diagnostics) {
+        uint32_t token = ast->spans ? ast->spans[node].first : 0;
+        addDiagnostic(resolver->diagnostics, DIAGNOSTIC_ERROR, astLocation(ast, node), token, symbol, message);
+    }
+}
+
+// Current binding of a name (NULL if it has none)
+static const Binding *lookupName(const Resolver *resolver, SymbolId symbol) {
+    if (symbol >= resolver->bindingCount || resolver->bindings[symbol].declaration == 0) {
+        return NULL;
+    }
+    return &resolver->bindings[symbol];
+}
+
+// Bind a name to a declaration in the innermost scope
+static void declareName(Resolver *resolver, SymbolId symbol, uint32_t node) {
+    if (symbol >= resolver->bindingCount) {
+        // Interned after the table was sized (cannot happen for a finished tree)
+        uint32_t count = symbol + 1;
+        Binding *grown = realloc(resolver->bindings, count * sizeof(Binding));
+        if (!grown) {
+            resolver->failed = 1;
+            return;
+        }
+        memset(grown + resolver->bindingCount, 0, (count - resolver->bindingCount) * sizeof(Binding));
+        resolver->bindings = grown;
+        resolver->bindingCount = count;
+    }
+    Binding *binding = &resolver->bindings[symbol];
+    const Scope *scope = &resolver->scopes[resolver->scopeCount - 1];
+    if (binding->declaration != 0 && binding->scope == scope->serial) {
+        reportName(resolver, node, symbol, "Name is already declared in this scope");
+        return;
+    }
+    if (resolver->undoCount == resolver->undoCapacity) {
+        HiddenBinding *grown = growArray(resolver, resolver->undo, &resolver->undoCapacity, sizeof(HiddenBinding));
+        if (!grown) return;
+        resolver->undo = grown;
+    }
+    resolver->undo[resolver->undoCount++] = (HiddenBinding){symbol, *binding};
+    *binding = (Binding){node, scope->serial, resolver->frameCount - 1};
+}
+
+static void openScope(Resolver *resolver) {
+    if (resolver->scopeCount == resolver->scopeCapacity) {
+        Scope *grown = growArray(resolver, resolver->scopes, &resolver->scopeCapacity, sizeof(Scope));
+        if (!grown) return;
+        resolver->scopes = grown;
+    }
+    resolver->scopes[resolver->scopeCount++] = (Scope){
+        ++resolver->nextSerial, resolver->undoCount, resolver->frames[resolver->frameCount - 1].used};
+}
+
+// Close the innermost scope: its names go back to what they meant before, and
+// the slots of a function's block are free again
+static void closeScope(Resolver *resolver) {
+    const Scope *scope = &resolver->scopes[--resolver->scopeCount];
+    while (resolver->undoCount > scope->undoMark) {
+        const HiddenBinding *hidden = &resolver->undo[--resolver->undoCount];
+        resolver->bindings[hidden->symbol] = hidden->previous;
+    }
+    Frame *frame = &resolver->frames[resolver->frameCount - 1];
+    if (frame->storage == STORAGE_LOCAL) {
+        frame->used = scope->slotMark;
+    }
+}
+
+static void openFrame(Resolver *resolver, uint32_t node, StorageKind storage) {
+    if (resolver->frameCount == resolver->frameCapacity) {
+        Frame *grown = growArray(resolver, resolver->frames, &resolver->frameCapacity, sizeof(Frame));
+        if (!grown) return;
+        resolver->frames = grown;
+    }
+    resolver->frames[resolver->frameCount++] = (Frame){node, (uint8_t)storage, 0, 0};
+}
+
+static void closeFrame(Resolver *resolver) {
+    const Frame *frame = &resolver->frames[--resolver->frameCount];
+    resolver->result->slots[frame->node] = frame->size;
+}
+
+// Give a variable its slot and bind its name
+static void declareVariable(Resolver *resolver, uint32_t node) {
+    Frame *frame = &resolver->frames[resolver->frameCount - 1];
+    resolver->result->slots[node] = frame->used++;
+    resolver->result->storage[node] = frame->storage;
+    if (frame->used > frame->size) {
+        frame->size = frame->used;
+    }
+    declareName(resolver, astSymbol(resolver->ast, resolver->ast->nodes[node].a), node);
+}
+
+// Functions and classes are visible in the whole scope that declares them
+static void hoistDeclarations(Resolver *resolver, uint32_t list) {
+    const Ast *ast = resolver->ast;
+    const AstNode *n = &ast->nodes[list];
+    for (uint32_t i = 0; i < n->b; i++) {
+        uint32_t item = ast->lists[n->a + i];
+        uint8_t kind = ast->nodes[item].kind;
+        if (kind == AST_FUNC_DECL || kind == AST_CLASS_DECL) {
+            declareName(resolver, astSymbol(ast, ast->nodes[item].a), item);
+        }
+    }
+}
+
+// Bind a use of a name to a declaration of the expected kind
+static void resolveUse(Resolver *resolver, uint32_t node, SymbolId symbol, AstKind expected) {
+    const Binding *binding = lookupName(resolver, symbol);
+    if (!binding) {
+        reportName(resolver, node, symbol, expected == AST_FUNC_DECL ? "Undeclared function" :
+                                           expected == AST_CLASS_DECL ? "Unknown class" : "Undeclared name");
+        return;
+    }
+    uint8_t kind = resolver->ast->nodes[binding->declaration].kind;
+    if (kind != expected) {
+        reportName(resolver, node, symbol, expected == AST_FUNC_DECL ? "Not a function" :
+                                           expected == AST_CLASS_DECL ? "Not a class" : "Not a variable");
+        return;
+    }
+    // Functions cannot reach the variables of an enclosing function or class
+    if (kind == AST_VAR_DECL && resolver->frames[binding->frame].storage != STORAGE_GLOBAL &&
+        binding->frame != resolver->frameCount - 1) {
+        reportName(resolver, node, symbol, "Variable of an enclosing function or class cannot be used here");
+        return;
+    }
+    resolver->result->declarations[node] = binding->declaration;
+}
+
+// Visitor functions. Each returns 0 to stop the walk once memory ran out
+static int enterProgram(void *context, uint32_t node) {
+    Resolver *resolver = context;
+    openFrame(resolver, node, STORAGE_GLOBAL);
+    openScope(resolver);
+    hoistDeclarations(resolver, node);
+    return !resolver->failed;
+}
+
+static int enterBlock(void *context, uint32_t node) {
+    Resolver *resolver = context;
+    openScope(resolver);
+    hoistDeclarations(resolver, node);
+    return !resolver->failed;
+}
+
+static int enterFunction(void *context, uint32_t node) {
+    Resolver *resolver = context;
+    openFrame(resolver, node, STORAGE_LOCAL);
+    openScope(resolver);
+    return !resolver->failed;
+}
+
+static int enterClass(void *context, uint32_t node) {
+    Resolver *resolver = context;
+    openFrame(resolver, node, STORAGE_FIELD);
+    openScope(resolver);
+    return !resolver->failed;
+}
+
+static int enterLoop(void *context, uint32_t node) {
+    (void)node;
+    Resolver *resolver = context;
+    openScope(resolver);
+    return !resolver->failed;
+}
+
+static int enterVariable(void *context, uint32_t node) {
+    Resolver *resolver = context;
+    const AstNode *n = &resolver->ast->nodes[node];
+    if (n->c != 0) {
+        resolveUse(resolver, node, astSymbol(resolver->ast, n->c), AST_CLASS_DECL);
+    }
+    return 1;
+}
+
+static int enterIdentifier(void *context, uint32_t node) {
+    Resolver *resolver = context;
+    resolveUse(resolver, node, astSymbol(resolver->ast, resolver->ast->nodes[node].a), AST_VAR_DECL);
+    return 1;
+}
+
+static int enterCall(void *context, uint32_t node) {
+    Resolver *resolver = context;
+    resolveUse(resolver, node, astSymbol(resolver->ast, resolver->ast->nodes[node].c), AST_FUNC_DECL);
+    return 1;
+}
+
+static int leaveFrame(void *context, uint32_t node) {
+    (void)node;
+    Resolver *resolver = context;
+    closeScope(resolver);
+    closeFrame(resolver);
+    return 1;
+}
+
+static int leaveScope(void *context, uint32_t node) {
+    (void)node;
+    closeScope(context);
+    return 1;
+}
+
+// Declared after its initializer: "पूर्ण क = क" reads the outer क
+static int leaveVariable(void *context, uint32_t node) {
+    Resolver *resolver = context;
+    declareVariable(resolver, node);
+    return !resolver->failed;
+}
+
+static const AstVisitor resolveVisitor = {
+    .enter = {
+        [AST_PROGRAM] = enterProgram,
+        [AST_BLOCK] = enterBlock,
+        [AST_FUNC_DECL] = enterFunction,
+        [AST_CLASS_DECL] = enterClass,
+        [AST_LOOP] = enterLoop,
+        [AST_VAR_DECL] = enterVariable,
+        [AST_IDENT] = enterIdentifier,
+        [AST_CALL] = enterCall,
+    },
+    .leave = {
+        [AST_PROGRAM] = leaveFrame,
+        [AST_FUNC_DECL] = leaveFrame,
+        [AST_CLASS_DECL] = leaveFrame,
+        [AST_BLOCK] = leaveScope,
+        [AST_LOOP] = leaveScope,
+        [AST_VAR_DECL] = leaveVariable,
+    },
+};
+
+// Resolve every name below ast->root
+int resolveNames(const Ast *ast, const AstOrder *order, Resolution *resolution, DiagnosticBuffer *diagnostics) {
+    memset(resolution, 0, sizeof(*resolution));
+    resolution->nodeCount = ast->nodeCount;
+    resolution->declarations = calloc(ast->nodeCount ? ast->nodeCount : 1, sizeof(uint32_t));
+    resolution->slots = calloc(ast->nodeCount ? ast->nodeCount : 1, sizeof(uint32_t));
+    resolution->storage = calloc(ast->nodeCount ? ast->nodeCount : 1, sizeof(uint8_t));
+
+    Resolver resolver;
+    memset(&resolver, 0, sizeof(resolver));
+    resolver.ast = ast;
+    resolver.result = resolution;
+    resolver.diagnostics = diagnostics;
+    resolver.bindingCount = symbolIdLimit();
+    resolver.bindings = calloc(resolver.bindingCount ? resolver.bindingCount : 1, sizeof(Binding));
+    AstOrder ownOrder;
+    if (!order && buildAstOrder(ast, ast->root, &ownOrder)) {
+        order = &ownOrder;
+    }
+    if (!resolution->declarations || !resolution->slots || !resolution->storage || !resolver.bindings || !order) {
+        fprintf(stderr, "Memory allocation failed for name resolution!\n");
+        free(resolver.bindings);
+        freeResolution(resolution);
+        if (order == &ownOrder) freeAstOrder(&ownOrder);
+        return 0;
+    }
+
+    // Outermost frame and scope, for trees whose root is not a program
+    openFrame(&resolver, 0, STORAGE_GLOBAL);
+    openScope(&resolver);
+    int ok = !resolver.failed && visitTree(ast, order, &resolveVisitor, &resolver);
+
+    free(resolver.bindings);
+    free(resolver.undo);
+    free(resolver.scopes);
+    free(resolver.frames);
+    if (order == &ownOrder) {
+        freeAstOrder(&ownOrder);
+    }
+    return ok && resolution->errorCount == 0;
+}
+
+// Free a resolution's arrays
+void freeResolution(Resolution *resolution) {
+    free(resolution->declarations);
+    free(resolution->slots);
+    free(resolution->storage);
+    memset(resolution, 0, sizeof(*resolution));
+}
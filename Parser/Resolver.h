@@ -0,0 +1,63 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include <stdint.h>
+#include "Ast.h"
+#include "Diagnostics.h"
+#include "Traversal.h"
+
+// Name resolution
+// One pass over a parsed tree binds every use of a name to the node that declares
+// it, following the language's scopes: the program, every { } block, a function
+// (its parameters), a class body and a चक्र loop (its loop variable) each open a
+// scope, and an inner declaration hides an outer one until its scope ends.
+// Functions and classes can be used anywhere in the scope that declares them;
+// variables only after their declaration.
+//
+// Scopes are kept in one flat table indexed by SymbolId that holds the innermost
+// declaration of each name, plus an undo log of the entries a scope has hidden.
+// Looking a name up is one array access, and closing a scope puts back exactly
+// the entries it changed.
+//
+// Every variable also gets a slot: globals are numbered across the program,
+// locals within their function (slots of finished blocks are reused) and fields
+// within their class, so later stages can keep variables in plain arrays.
+
+// Where a variable lives
+typedef enum {
+    STORAGE_NONE,              // Not a variable
+    STORAGE_GLOBAL,            // Program-level variable
+    STORAGE_LOCAL,             // Parameter or variable of a function
+    STORAGE_FIELD              // Variable in a class body
+} StorageKind;
+
+// Result of resolving one tree. Arrays are indexed by node
+typedef struct {
+    uint32_t *declarations;    // AST_IDENT, AST_CALL and class-typed AST_VAR_DECL:
+                               // the declaring node (the class for a VAR_DECL), 0 if unresolved
+    uint32_t *slots;           // AST_VAR_DECL: its slot. AST_PROGRAM, AST_FUNC_DECL and
+                               // AST_CLASS_DECL: number of slots their variables need
+    uint8_t *storage;          // AST_VAR_DECL: StorageKind
+    uint32_t nodeCount;
+    uint32_t errorCount;       // Names that could not be resolved
+} Resolution;
+
+// Resolve every name below ast->root, visiting the nodes in order (NULL: build
+// one for the call). Errors go to diagnostics (may be NULL).
+// Returns 1 if every name was resolved, 0 on errors or if out of memory
+int resolveNames(const Ast *ast, const AstOrder *order, Resolution *resolution, DiagnosticBuffer *diagnostics);
+
+// Free a resolution's arrays
+void freeResolution(Resolution *resolution);
+
+// Declaration a use refers to (0 if none)
+static inline uint32_t declarationOf(const Resolution *resolution, uint32_t node) {
+    return node < resolution->nodeCount ? resolution->declarations[node] : 0;
+}
+
+// Slot of a variable declaration
+static inline uint32_t slotOf(const Resolution *resolution, uint32_t declaration) {
+    return resolution->slots[declaration];
+}
+
+#endif // RESOLVER_H
@@ -0,0 +1,236 @@
+#include "SourceManager.h"
+#include "file_io.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Everything the source manager knows about one file
+typedef struct {
+    char *name;                 // Copy of the file name
+    wchar_t *buffer;            // Owned, null-terminated contents
+    uint32_t length;            // Length in characters
+    SourceLocation start;       // First location of the file's range
+    uint32_t *lineStarts;       // Offset of each line start, built on first decode
+    uint32_t lineCount;         // Entries in lineStarts
+} SourceFile;
+
+// Files in the order they were added, which is also increasing start location
+static SourceFile **files = NULL;
+static uint32_t fileCount = 0;
+static uint32_t fileCapacity = 0;
+
+// Next unassigned location (0 is reserved for "unknown")
+static SourceLocation nextLocation = 1;
+
+// Files may be loaded and decoded from several threads
+static pthread_mutex_t managerLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Look up a file by ID. Caller holds managerLock
+static SourceFile *fileById(SourceFileId file) {
+    return (file == NO_FILE || file > fileCount) ? NULL : files[file - 1];
+}
+
+// Read a file with readFile() and register it
+SourceFileId loadSourceFile(const char *path) {
+    wchar_t *buffer = readFile(path);
+    if (!buffer) {
+        return NO_FILE;
+    }
+    return addSourceBuffer(path, buffer, wcslen(buffer));
+}
+
+// Register a malloc'd buffer and assign it the next free range of locations
+SourceFileId addSourceBuffer(const char *name, wchar_t *buffer, size_t length) {
+    SourceFile *file = calloc(1, sizeof(SourceFile));
+    char *nameCopy = malloc(strlen(name) + 1);
+    if (!file || !nameCopy) {
+        fprintf(stderr, "Memory allocation failed!\n");
+        free(file);
+        free(nameCopy);
+        free(buffer);
+        return NO_FILE;
+    }
+    strcpy(nameCopy, name);
+    file->name = nameCopy;
+    file->buffer = buffer;
+    file->length = (uint32_t)length;
+
+    pthread_mutex_lock(&managerLock);
+
+    // The file needs length + 1 locations (the extra one is its end-of-file position)
+    if (length >= UINT32_MAX || (uint64_t)nextLocation + length + 1 > UINT32_MAX) {
+        pthread_mutex_unlock(&managerLock);
+        fprintf(stderr, "Error: Source location space exhausted by %s\n", name);
+        free(nameCopy);
+        free(buffer);
+        free(file);
+        return NO_FILE;
+    }
+    if (fileCount == fileCapacity) {
+        uint32_t newCapacity = fileCapacity ? fileCapacity * 2 : 16;
+        SourceFile **grown = realloc(files, newCapacity * sizeof(SourceFile *));
+        if (!grown) {
+            pthread_mutex_unlock(&managerLock);
+            fprintf(stderr, "Memory allocation failed!\n");
+            free(nameCopy);
+            free(buffer);
+            free(file);
+            return NO_FILE;
+        }
+        files = grown;
+        fileCapacity = newCapacity;
+    }
+
+    file->start = nextLocation;
+    nextLocation += (uint32_t)length + 1;
+    files[fileCount++] = file;
+    SourceFileId id = fileCount;
+
+    pthread_mutex_unlock(&managerLock);
+    return id;
+}
+
+// Contents of a registered file
+const wchar_t *sourceBuffer(SourceFileId file) {
+    pthread_mutex_lock(&managerLock);
+    SourceFile *entry = fileById(file);
+    const wchar_t *buffer = entry ? entry->buffer : NULL;
+    pthread_mutex_unlock(&managerLock);
+    return buffer;
+}
+
+// Length of a registered file in characters
+uint32_t sourceLength(SourceFileId file) {
+    pthread_mutex_lock(&managerLock);
+    SourceFile *entry = fileById(file);
+    uint32_t length = entry ? entry->length : 0;
+    pthread_mutex_unlock(&managerLock);
+    return length;
+}
+
+// Name of a registered file
+const char *sourceFileName(SourceFileId file) {
+    pthread_mutex_lock(&managerLock);
+    SourceFile *entry = fileById(file);
+    const char *name = entry ? entry->name : "<unknown>";
+    pthread_mutex_unlock(&managerLock);
+    return name;
+}
+
+// First location of a file
+SourceLocation sourceFileStart(SourceFileId file) {
+    pthread_mutex_lock(&managerLock);
+    SourceFile *entry = fileById(file);
+    SourceLocation start = entry ? entry->start : NO_LOCATION;
+    pthread_mutex_unlock(&managerLock);
+    return start;
+}
+
+// Location of a character offset inside a file
+SourceLocation makeLocation(SourceFileId file, uint32_t offset) {
+    SourceLocation start = sourceFileStart(file);
+    return start == NO_LOCATION ? NO_LOCATION : start + offset;
+}
+
+// Binary search for the file whose range contains location. Caller holds managerLock
+static SourceFileId findFile(SourceLocation location) {
+    if (location == NO_LOCATION || location >= nextLocation) {
+        return NO_FILE;
+    }
+    uint32_t low = 0, high = fileCount;
+    while (high - low > 1) {
+        uint32_t mid = low + (high - low) / 2;
+        if (files[mid]->start <= location) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    return fileCount > 0 ? low + 1 : NO_FILE;
+}
+
+// File containing a location
+SourceFileId sourceFileOf(SourceLocation location) {
+    pthread_mutex_lock(&managerLock);
+    SourceFileId file = findFile(location);
+    pthread_mutex_unlock(&managerLock);
+    return file;
+}
+
+// Record where every line of the file starts. Caller holds managerLock
+static int buildLineStarts(SourceFile *file) {
+    uint32_t lines = 1;
+    for (uint32_t i = 0; i < file->length; i++) {
+        if (file->buffer[i] == L'\n') {
+            lines++;
+        }
+    }
+    file->lineStarts = malloc(lines * sizeof(uint32_t));
+    if (!file->lineStarts) {
+        fprintf(stderr, "Memory allocation failed for line table!\n");
+        return 0;
+    }
+    file->lineStarts[0] = 0;
+    file->lineCount = 1;
+    for (uint32_t i = 0; i < file->length; i++) {
+        if (file->buffer[i] == L'\n') {
+            file->lineStarts[file->lineCount++] = i + 1;
+        }
+    }
+    return 1;
+}
+
+// Work out file, line and column of a location
+int decodeLocation(SourceLocation location, DecodedLocation *decoded) {
+    pthread_mutex_lock(&managerLock);
+    SourceFileId id = findFile(location);
+    SourceFile *file = fileById(id);
+    if (!file || (!file->lineStarts && !buildLineStarts(file))) {
+        pthread_mutex_unlock(&managerLock);
+        return 0;
+    }
+
+    // Binary search for the last line starting at or before the offset
+    uint32_t offset = location - file->start;
+    uint32_t low = 0, high = file->lineCount;
+    while (high - low > 1) {
+        uint32_t mid = low + (high - low) / 2;
+        if (file->lineStarts[mid] <= offset) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+
+    decoded->file = id;
+    decoded->name = file->name;
+    decoded->offset = offset;
+    decoded->line = low + 1;
+    decoded->column = offset - file->lineStarts[low] + 1;
+    pthread_mutex_unlock(&managerLock);
+    return 1;
+}
+
+// Number of registered files
+uint32_t sourceFileCount(void) {
+    pthread_mutex_lock(&managerLock);
+    uint32_t count = fileCount;
+    pthread_mutex_unlock(&managerLock);
+    return count;
+}
+
+// Free every buffer and forget all files
+void resetSourceManager(void) {
+    for (uint32_t i = 0; i < fileCount; i++) {
+        free(files[i]->name);
+        free(files[i]->buffer);
+        free(files[i]->lineStarts);
+        free(files[i]);
+    }
+    free(files);
+    files = NULL;
+    fileCount = 0;
+    fileCapacity = 0;
+    nextLocation = 1;
+}
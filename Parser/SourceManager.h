@@ -0,0 +1,61 @@
+#ifndef SOURCE_MANAGER_H
+#define SOURCE_MANAGER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <wchar.h>
+
+// Global source manager
+// Owns the wide-character buffers of every loaded file and gives each file its own
+// range in one 32-bit location space. A SourceLocation is just a number in that
+// space, so tokens and AST nodes need 4 bytes to remember where they came from;
+// the file, line and column are only worked out when a location is decoded.
+
+typedef uint32_t SourceLocation;
+typedef uint32_t SourceFileId;
+
+// Location 0 and file 0 are never assigned and mean "unknown"
+#define NO_LOCATION ((SourceLocation)0)
+#define NO_FILE ((SourceFileId)0)
+
+// A location decoded back into human-readable form
+typedef struct {
+    SourceFileId file;     // File containing the location
+    const char *name;      // Name of that file
+    uint32_t offset;       // Character offset in the file
+    uint32_t line;         // 1-based line
+    uint32_t column;       // 1-based column (in characters)
+} DecodedLocation;
+
+// Read a file with readFile() and register it. Returns NO_FILE on failure
+SourceFileId loadSourceFile(const char *path);
+
+// Register a malloc'd, null-terminated buffer of length characters under name.
+// The source manager takes ownership of the buffer. Returns NO_FILE on failure
+SourceFileId addSourceBuffer(const char *name, wchar_t *buffer, size_t length);
+
+// Contents, length (in characters) and name of a registered file
+const wchar_t *sourceBuffer(SourceFileId file);
+uint32_t sourceLength(SourceFileId file);
+const char *sourceFileName(SourceFileId file);
+
+// First location of a file; offset i of the file is at sourceFileStart(file) + i.
+// The range also contains one location for the end of the file
+SourceLocation sourceFileStart(SourceFileId file);
+
+// Location of a character offset inside a file
+SourceLocation makeLocation(SourceFileId file, uint32_t offset);
+
+// File containing a location (NO_FILE if the location is unknown)
+SourceFileId sourceFileOf(SourceLocation location);
+
+// Work out file, line and column of a location. Returns 1 on success, 0 if unknown
+int decodeLocation(SourceLocation location, DecodedLocation *decoded);
+
+// Number of registered files
+uint32_t sourceFileCount(void);
+
+// Free every buffer and forget all files. Not thread-safe
+void resetSourceManager(void);
+
+#endif // SOURCE_MANAGER_H
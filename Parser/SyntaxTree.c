@@ -0,0 +1,667 @@
+#include "SyntaxTree.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Number of child slots of a flat node: its list entries, or one per child field
+static uint32_t slotCount(const AstNode *node) {
+    const AstLayout *layout = &astLayouts[node->kind];
+    if (layout->hasList) {
+        return node->b;
+    }
+    return !!(layout->nodeFields & AST_FIELD_A) + !!(layout->nodeFields & AST_FIELD_B) +
+           !!(layout->nodeFields & AST_FIELD_C);
+}
+
+// The i-th child slot of a flat node (0 if the child is absent)
+static uint32_t slotChild(const Ast *ast, const AstNode *node, uint32_t i) {
+    const AstLayout *layout = &astLayouts[node->kind];
+    if (layout->hasList) {
+        return ast->lists[node->a + i];
+    }
+    const uint32_t fields[3] = {node->a, node->b, node->c};
+    for (int f = 0; f < 3; f++) {
+        if ((layout->nodeFields & (1 << f)) && i-- == 0) {
+            return fields[f];
+        }
+    }
+    return 0;
+}
+
+// Can a node of this kind contain a block? Expressions cannot, so the search for
+// the block around an edit never walks down an expression
+static int canContainBlock(uint8_t kind) {
+    return kind == AST_PROGRAM || kind == AST_BLOCK || kind == AST_FUNC_DECL || kind == AST_CLASS_DECL ||
+           kind == AST_IF || kind == AST_LOOP || kind == AST_WHILE;
+}
+
+static GreenNode *allocGreen(uint32_t childCount) {
+    GreenNode *node = malloc(sizeof(GreenNode) + childCount * sizeof(GreenChild));
+    if (!node) {
+        fprintf(stderr, "Memory allocation failed for syntax tree!\n");
+        return NULL;
+    }
+    node->refCount = 1;
+    node->childCount = childCount;
+    return node;
+}
+
+void retainGreen(GreenNode *node) {
+    if (node) {
+        node->refCount++;
+    }
+}
+
+// Drop a reference. Subtrees that become unreferenced are freed with an explicit
+// stack, so long expression chains cannot overflow the C stack
+void releaseGreen(GreenNode *node) {
+    if (!node || --node->refCount > 0) {
+        return;
+    }
+    uint32_t top = 0, capacity = 64;
+    GreenNode **stack = malloc(capacity * sizeof(GreenNode *));
+    if (!stack) {
+        fprintf(stderr, "Memory allocation failed for syntax tree!\n");
+        return;
+    }
+    stack[top++] = node;
+    while (top > 0) {
+        GreenNode *dead = stack[--top];
+        for (uint32_t i = 0; i < dead->childCount; i++) {
+            GreenNode *child = dead->children[i].node;
+            if (child && --child->refCount == 0) {
+                if (top == capacity) {
+                    GreenNode **grown = realloc(stack, capacity * 2 * sizeof(GreenNode *));
+                    if (!grown) {
+                        continue;  // Leak the subtree rather than crash
+                    }
+                    stack = grown;
+                    capacity *= 2;
+                }
+                stack[top++] = child;
+            }
+        }
+        free(dead);
+    }
+    free(stack);
+}
+
+// Token in [first, end) whose location is location (offsets are sorted, so binary search).
+// Returned relative to first; 0 if unknown
+static uint32_t findAnchor(const TokenCollector *tokens, SourceLocation location, uint32_t first, uint32_t end) {
+    if (location == NO_LOCATION || tokens->base == NO_LOCATION || location < tokens->base) {
+        return 0;
+    }
+    uint32_t target = location - tokens->base;
+    uint32_t lo = first, hi = end;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (tokens->offsets[mid] < target) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return (lo < end && tokens->offsets[lo] == target) ? lo - first : 0;
+}
+
+// Build green nodes for the subtree of a flat Ast, in post-order with explicit stacks
+GreenNode *greenFromAst(const Ast *ast, uint32_t root, const TokenCollector *tokens) {
+    typedef struct {
+        uint32_t node;
+        uint32_t next;         // Next slot to visit
+        uint32_t slots;
+    } BuildFrame;
+    typedef struct {
+        GreenNode *green;
+        uint32_t first;
+    } Built;
+
+    uint32_t frameCount = 0, frameCapacity = 64, builtCount = 0, builtCapacity = 64;
+    BuildFrame *frames = malloc(frameCapacity * sizeof(BuildFrame));
+    Built *built = malloc(builtCapacity * sizeof(Built));
+    int ok = frames && built;
+    if (ok) {
+        frames[frameCount++] = (BuildFrame){root, 0, slotCount(&ast->nodes[root])};
+    }
+
+    while (ok && frameCount > 0) {
+        BuildFrame *frame = &frames[frameCount - 1];
+        if (builtCount == builtCapacity) {
+            Built *grown = realloc(built, builtCapacity * 2 * sizeof(Built));
+            if (!grown) { ok = 0; break; }
+            built = grown;
+            builtCapacity *= 2;
+        }
+
+        if (frame->next < frame->slots) {
+            uint32_t child = slotChild(ast, &ast->nodes[frame->node], frame->next++);
+            if (child == 0) {
+                built[builtCount++] = (Built){NULL, 0};
+            } else {
+                if (frameCount == frameCapacity) {
+                    BuildFrame *grown = realloc(frames, frameCapacity * 2 * sizeof(BuildFrame));
+                    if (!grown) { ok = 0; break; }
+                    frames = grown;
+                    frameCapacity *= 2;
+                }
+                frames[frameCount++] = (BuildFrame){child, 0, slotCount(&ast->nodes[child])};
+            }
+            continue;
+        }
+
+        // Every child is built: make the node itself
+        const AstNode *node = &ast->nodes[frame->node];
+        const AstSpan *span = &ast->spans[frame->node];
+        const AstLayout *layout = &astLayouts[node->kind];
+        GreenNode *green = allocGreen(frame->slots);
+        if (!green) { ok = 0; break; }
+        green->kind = node->kind;
+        green->op = node->op;
+        green->flags = node->flags;
+        green->width = span->end - span->first;
+        green->anchor = findAnchor(tokens, astLocation(ast, frame->node), span->first, span->end);
+        green->a = (layout->hasList || (layout->nodeFields & AST_FIELD_A)) ? 0 : node->a;
+        green->b = (layout->hasList || (layout->nodeFields & AST_FIELD_B)) ? 0 : node->b;
+        green->c = (layout->nodeFields & AST_FIELD_C) ? 0 : node->c;
+        if (layout->symbolFields & AST_FIELD_A) green->a = astSymbol(ast, green->a);
+        if (layout->symbolFields & AST_FIELD_B) green->b = astSymbol(ast, green->b);
+        if (layout->symbolFields & AST_FIELD_C) green->c = astSymbol(ast, green->c);
+
+        builtCount -= frame->slots;
+        for (uint32_t i = 0; i < frame->slots; i++) {
+            const Built *child = &built[builtCount + i];
+            green->children[i].node = child->green;
+            green->children[i].offset = child->green ? child->first - span->first : 0;
+        }
+        built[builtCount++] = (Built){green, span->first};
+        frameCount--;
+    }
+
+    GreenNode *result = NULL;
+    if (ok) {
+        result = built[0].green;
+    } else {
+        fprintf(stderr, "Memory allocation failed for syntax tree!\n");
+        for (uint32_t i = 0; built && i < builtCount; i++) {
+            releaseGreen(built[i].green);
+        }
+    }
+    free(frames);
+    free(built);
+    return result;
+}
+
+// Index of the last child starting at or before token (relative to the node), or
+// childCount if there is none. List children are sorted and never absent, so they
+// are binary searched; the few slots of other nodes are scanned
+static uint32_t childAtOrBefore(const GreenNode *node, uint32_t relative) {
+    if (astLayouts[node->kind].hasList) {
+        uint32_t lo = 0, hi = node->childCount;
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (node->children[mid].offset <= relative) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo > 0 ? lo - 1 : node->childCount;
+    }
+    uint32_t found = node->childCount;
+    for (uint32_t i = 0; i < node->childCount; i++) {
+        if (node->children[i].node && node->children[i].offset <= relative) {
+            found = i;
+        }
+    }
+    return found;
+}
+
+// Innermost node whose tokens contain token
+RedNode redNodeAt(RedNode root, uint32_t token) {
+    RedNode node = root;
+    while (token >= node.first && token < redEnd(node)) {
+        uint32_t i = childAtOrBefore(node.green, token - node.first);
+        if (i == node.green->childCount) {
+            break;
+        }
+        RedNode child = redChild(node, i);
+        if (token >= redEnd(child)) {
+            break;
+        }
+        node = child;
+    }
+    return node;
+}
+
+// Point the tree's parser at a range of tokens, keeping its stacks
+static void resetTreeParser(SyntaxTree *tree, const TokenCollector *tokens, uint32_t first, uint32_t end,
+                            DiagnosticBuffer *diagnostics) {
+    Parser *parser = &tree->parser;
+    parser->tokens = tokens;
+    parser->ast = &tree->scratch;
+    parser->pos = first;
+    parser->end = end;
+    parser->error = NULL;
+    parser->errorCount = 0;
+    parser->panicking = 0;
+    parser->diagnostics = diagnostics;
+    resetAst(&tree->scratch);
+}
+
+// Parse all of tokens into a fresh green root
+static GreenNode *parseWhole(SyntaxTree *tree, const TokenCollector *tokens, DiagnosticBuffer *diagnostics) {
+    uint32_t end = (tokens->count > 0 && tokens->types[tokens->count - 1] == TOKEN_EOF)
+                       ? tokens->count - 1 : tokens->count;
+    resetTreeParser(tree, tokens, 0, end, diagnostics);
+    uint32_t program = parseProgram(&tree->parser);
+    if (tree->scratch.failed) {
+        return NULL;
+    }
+    tree->reparsedFirst = 0;
+    tree->reparsedEnd = end;
+    return greenFromAst(&tree->scratch, program, tokens);
+}
+
+// Parse all tokens into a new tree
+int initSyntaxTree(SyntaxTree *tree, const TokenCollector *tokens, DiagnosticBuffer *diagnostics) {
+    memset(tree, 0, sizeof(*tree));
+    initAst(&tree->scratch, 1024);
+    initParser(&tree->parser, tokens, &tree->scratch);
+    tree->tokens = tokens;
+    tree->root = parseWhole(tree, tokens, diagnostics);
+    return tree->root != NULL;
+}
+
+// Release the tree (the tokens are not touched)
+void freeSyntaxTree(SyntaxTree *tree) {
+    releaseGreen(tree->root);
+    freeParser(&tree->parser);
+    freeAst(&tree->scratch);
+    memset(tree, 0, sizeof(*tree));
+}
+
+// Do two tokens read the same? Number payloads are indices into each collector's
+// own numbers array, so their values are compared instead
+static int sameToken(const TokenCollector *x, uint32_t i, const TokenCollector *y, uint32_t j) {
+    if (x->types[i] != y->types[j] || x->lengths[i] != y->lengths[j]) {
+        return 0;
+    }
+    if (x->types[i] == TOKEN_NUMBER && x->payloads[i] != NO_PAYLOAD && y->payloads[j] != NO_PAYLOAD) {
+        return x->numbers[x->payloads[i]] == y->numbers[y->payloads[j]];
+    }
+    return x->payloads[i] == y->payloads[j];
+}
+
+// Find the tokens that differ between two token arrays
+int findTokenEdit(const TokenCollector *oldTokens, const TokenCollector *newTokens, TokenEdit *edit) {
+    uint32_t oldEnd = (oldTokens->count > 0 && oldTokens->types[oldTokens->count - 1] == TOKEN_EOF)
+                          ? oldTokens->count - 1 : oldTokens->count;
+    uint32_t newEnd = (newTokens->count > 0 && newTokens->types[newTokens->count - 1] == TOKEN_EOF)
+                          ? newTokens->count - 1 : newTokens->count;
+    uint32_t prefix = 0;
+    while (prefix < oldEnd && prefix < newEnd && sameToken(oldTokens, prefix, newTokens, prefix)) {
+        prefix++;
+    }
+    uint32_t suffix = 0;
+    while (suffix < oldEnd - prefix && suffix < newEnd - prefix &&
+           sameToken(oldTokens, oldEnd - 1 - suffix, newTokens, newEnd - 1 - suffix)) {
+        suffix++;
+    }
+    edit->first = prefix;
+    edit->oldEnd = oldEnd - suffix;
+    edit->newEnd = newEnd - suffix;
+    return !(edit->first == edit->oldEnd && edit->first == edit->newEnd);
+}
+
+// A node on the way from the root to the edit
+typedef struct {
+    GreenNode *node;
+    uint32_t first;            // Its first token (old numbering)
+    uint32_t child;            // Which child leads further down
+    uint32_t childEnd;         // Where that child ended, relative to first
+} PathStep;
+
+static inline int isSpecialToken(const TokenCollector *tokens, uint32_t i, SpecialSymbolId symbol) {
+    return (tokens->types[i] == TOKEN_SPECIAL_SYMBOL || tokens->types[i] == TOKEN_EOL) &&
+           tokens->payloads[i] == (uint32_t)symbol;
+}
+
+// Can token i continue the statement before it (अन्यथा, or the वा of वा यदि)?
+static int continuesStatement(const TokenCollector *tokens, uint32_t i) {
+    if (i >= tokens->count) {
+        return 0;
+    }
+    return (tokens->types[i] == TOKEN_KEYWORD && tokens->payloads[i] == KEYWORD_ANYATHA) ||
+           isVaToken((TokenType)tokens->types[i], tokens->payloads[i]);
+}
+
+// Replace child step->child by replacement, move the children after it by delta
+// tokens and grow the width by delta. A node nobody else refers to is updated in
+// place; otherwise it is copied and the children it shares are retained.
+// childInPlace tells whether replacement is the old child updated in place
+static GreenNode *replaceChild(const PathStep *step, GreenNode *replacement, int64_t delta, int inPlace,
+                               int childInPlace) {
+    GreenNode *node = step->node;
+    uint32_t i = step->child;
+    if (inPlace && !childInPlace) {
+        releaseGreen(node->children[i].node);
+    }
+    if (!inPlace) {
+        GreenNode *copy = allocGreen(node->childCount);
+        if (!copy) {
+            return NULL;
+        }
+        memcpy(copy, node, sizeof(GreenNode) + node->childCount * sizeof(GreenChild));
+        copy->refCount = 1;
+        for (uint32_t k = 0; k < copy->childCount; k++) {
+            if (k != i) {
+                retainGreen(copy->children[k].node);
+            }
+        }
+        node = copy;
+    }
+    node->width = (uint32_t)(node->width + delta);
+    if (node->anchor >= step->childEnd) {
+        node->anchor = (uint32_t)(node->anchor + delta);
+    }
+    node->children[i].node = replacement;
+    for (uint32_t k = i + 1; k < node->childCount; k++) {
+        if (node->children[k].node) {
+            node->children[k].offset = (uint32_t)(node->children[k].offset + delta);
+        }
+    }
+    return node;
+}
+
+// Try to reparse only the statements of a block (or the program) around the edit.
+// Returns the updated node, or NULL if the edit reaches beyond those statements.
+// With inPlace the node is changed directly (it must not be shared)
+static GreenNode *reparseStatements(SyntaxTree *tree, const PathStep *step, const TokenCollector *newTokens,
+                                    const TokenEdit *edit, int64_t delta, int inPlace,
+                                    DiagnosticBuffer *diagnostics) {
+    const GreenNode *list = step->node;
+    int isBlock = list->kind == AST_BLOCK;
+    uint32_t interiorFirst = step->first + (isBlock ? 1 : 0);
+    uint32_t interiorEnd = step->first + list->width - (isBlock ? 1 : 0);
+    if (edit->first < interiorFirst || edit->oldEnd > interiorEnd) {
+        return NULL;
+    }
+
+    // Statements i .. j touch the edit; the region runs from the end of the statement
+    // before them to the start of the one after them, so gaps are reparsed too
+    uint32_t n = list->childCount, lo = 0, hi = n;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        const GreenChild *child = &list->children[mid];
+        if (step->first + child->offset + child->node->width < edit->first) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    uint32_t i = lo, j;
+    uint32_t after = childAtOrBefore(list, edit->oldEnd - step->first);
+    j = after == n ? 0 : after + 1;  // j is one past the last touching statement
+    if (j < i) {
+        j = i;
+    }
+    uint32_t regionFirst = i > 0 ? step->first + list->children[i - 1].offset + list->children[i - 1].node->width
+                                 : interiorFirst;
+    uint32_t regionEnd = j < n ? step->first + list->children[j].offset : interiorEnd;
+    uint32_t newRegionEnd = (uint32_t)(regionEnd + delta);
+    int atListEnd = j >= n;
+
+    // The new tokens must not open or close blocks outside the region, the region
+    // must neither continue the statement before it nor end with an incomplete
+    // one, and what follows must not continue it
+    int64_t depth = 0;
+    for (uint32_t t = regionFirst; t < newRegionEnd; t++) {
+        if (isSpecialToken(newTokens, t, SPECIAL_LBRACE)) {
+            depth++;
+        } else if (isSpecialToken(newTokens, t, SPECIAL_RBRACE) && --depth < 0) {
+            if (isBlock || !atListEnd) return NULL;
+        }
+    }
+    if (depth != 0 && (isBlock || !atListEnd)) {
+        return NULL;
+    }
+    if (i > 0 && continuesStatement(newTokens, regionFirst)) {
+        return NULL;
+    }
+    if (!atListEnd && newRegionEnd > regionFirst) {
+        uint32_t last = newRegionEnd - 1;
+        int closed = isSpecialToken(newTokens, last, SPECIAL_PIPE) || isSpecialToken(newTokens, last, SPECIAL_RBRACE) ||
+                     (newTokens->types[last] == TOKEN_OPERATOR && newTokens->payloads[last] == OPERATOR_SEMICOLON);
+        if (!closed || continuesStatement(newTokens, newRegionEnd)) {
+            return NULL;
+        }
+    }
+
+    resetTreeParser(tree, newTokens, regionFirst, newRegionEnd, diagnostics);
+    uint32_t program = parseProgram(&tree->parser);
+    if (tree->scratch.failed) {
+        return NULL;
+    }
+    const AstNode *parsed = &tree->scratch.nodes[program];
+    uint32_t added = parsed->b;
+    GreenChild *fresh = malloc((added + 1) * sizeof(GreenChild));
+    if (!fresh) {
+        return NULL;
+    }
+    for (uint32_t s = 0; s < added; s++) {
+        uint32_t statement = tree->scratch.lists[parsed->a + s];
+        fresh[s].node = greenFromAst(&tree->scratch, statement, newTokens);
+        fresh[s].offset = tree->scratch.spans[statement].first - step->first;
+        if (!fresh[s].node) {
+            while (s-- > 0) releaseGreen(fresh[s].node);
+            free(fresh);
+            return NULL;
+        }
+    }
+
+    uint32_t newCount = i + added + (n - j);
+    uint32_t newWidth = (uint32_t)(list->width + delta);
+    GreenNode *result;
+    if (inPlace) {
+        // Nobody else sees this node: splice the new statements into it
+        result = step->node;
+        if (newCount > n) {
+            result = realloc(result, sizeof(GreenNode) + newCount * sizeof(GreenChild));
+            if (!result) {
+                for (uint32_t s = 0; s < added; s++) releaseGreen(fresh[s].node);
+                free(fresh);
+                return NULL;
+            }
+        }
+        for (uint32_t s = i; s < j; s++) {
+            releaseGreen(result->children[s].node);
+        }
+        memmove(&result->children[i + added], &result->children[j], (n - j) * sizeof(GreenChild));
+        for (uint32_t s = i + added; s < newCount; s++) {
+            result->children[s].offset = (uint32_t)(result->children[s].offset + delta);
+        }
+    } else {
+        result = allocGreen(newCount);
+        if (!result) {
+            for (uint32_t s = 0; s < added; s++) releaseGreen(fresh[s].node);
+            free(fresh);
+            return NULL;
+        }
+        uint32_t refCount = result->refCount;
+        memcpy(result, list, sizeof(GreenNode));
+        result->refCount = refCount;
+        for (uint32_t s = 0; s < i; s++) {
+            result->children[s] = list->children[s];
+            retainGreen(list->children[s].node);
+        }
+        for (uint32_t s = j; s < n; s++) {
+            result->children[s - j + i + added].node = list->children[s].node;
+            result->children[s - j + i + added].offset = (uint32_t)(list->children[s].offset + delta);
+            retainGreen(list->children[s].node);
+        }
+    }
+    memcpy(&result->children[i], fresh, added * sizeof(GreenChild));
+    result->childCount = newCount;
+    result->width = newWidth;
+    free(fresh);
+
+    tree->reparsedFirst = regionFirst;
+    tree->reparsedEnd = newRegionEnd;
+    return result;
+}
+
+// Update the tree for newTokens, which differ from the tree's tokens only in the edited range
+uint32_t reparseEdit(SyntaxTree *tree, const TokenCollector *newTokens, const TokenEdit *edit,
+                     DiagnosticBuffer *diagnostics) {
+    int64_t delta = (int64_t)edit->newEnd - (int64_t)edit->oldEnd;
+
+    // Walk down through statements and blocks to the innermost node containing the edit
+    uint32_t depth = 0, capacity = 32;
+    PathStep *path = malloc(capacity * sizeof(PathStep));
+    GreenNode *node = tree->root;
+    uint32_t first = 0;
+    while (path && node) {
+        if (depth == capacity) {
+            PathStep *grown = realloc(path, capacity * 2 * sizeof(PathStep));
+            if (!grown) break;
+            path = grown;
+            capacity *= 2;
+        }
+        path[depth++] = (PathStep){node, first, 0, 0};
+        if (!canContainBlock(node->kind)) {
+            break;
+        }
+        uint32_t i = childAtOrBefore(node, edit->first - first);
+        if (i == node->childCount) {
+            break;
+        }
+        GreenChild *child = &node->children[i];
+        if (first + child->offset + child->node->width < edit->oldEnd) {
+            break;
+        }
+        path[depth - 1].child = i;
+        path[depth - 1].childEnd = child->offset + child->node->width;
+        first += child->offset;
+        node = child->node;
+    }
+
+    // Nodes that only this tree refers to can be updated in place: that holds for
+    // the path from the root down to the first shared node
+    uint32_t unique = 0;
+    while (path && unique < depth && path[unique].node->refCount == 1) {
+        unique++;
+    }
+
+    // Reparse the statements of the innermost block that can take the edit,
+    // then update or copy the path above it
+    GreenNode *replacement = NULL;
+    uint32_t level = depth;
+    while (path && level > 0 && !replacement) {
+        level--;
+        if (path[level].node->kind == AST_BLOCK || path[level].node->kind == AST_PROGRAM) {
+            replacement = reparseStatements(tree, &path[level], newTokens, edit, delta, level < unique, diagnostics);
+        }
+    }
+    int rootInPlace = replacement && unique > 0;
+    while (replacement && level > 0) {
+        level--;
+        GreenNode *parent = replaceChild(&path[level], replacement, delta, level < unique, level + 1 < unique);
+        if (!parent) {
+            releaseGreen(replacement);
+            replacement = NULL;
+            rootInPlace = 0;
+            break;
+        }
+        replacement = parent;
+    }
+    free(path);
+
+    if (!replacement) {
+        replacement = parseWhole(tree, newTokens, diagnostics);  // Nothing smaller could take the edit
+    }
+    if (replacement) {
+        if (!rootInPlace) {
+            releaseGreen(tree->root);
+        }
+        tree->root = replacement;
+        tree->tokens = newTokens;
+    }
+    return tree->reparsedEnd - tree->reparsedFirst;
+}
+
+// Flatten the tree into ast (which is reset first). Returns the root node
+uint32_t syntaxTreeToAst(const SyntaxTree *tree, Ast *ast) {
+    typedef struct {
+        RedNode red;
+        uint32_t next;
+    } FlattenFrame;
+
+    resetAst(ast);
+    if (!tree->root) {
+        return 0;
+    }
+    uint32_t frameCount = 0, frameCapacity = 64, builtCount = 0, builtCapacity = 64;
+    FlattenFrame *frames = malloc(frameCapacity * sizeof(FlattenFrame));
+    uint32_t *built = malloc(builtCapacity * sizeof(uint32_t));
+    int ok = frames && built;
+    if (ok) {
+        frames[frameCount++] = (FlattenFrame){redRoot(tree), 0};
+    }
+
+    while (ok && frameCount > 0) {
+        FlattenFrame *frame = &frames[frameCount - 1];
+        const GreenNode *green = frame->red.green;
+        if (builtCount == builtCapacity) {
+            uint32_t *grown = realloc(built, builtCapacity * 2 * sizeof(uint32_t));
+            if (!grown) { ok = 0; break; }
+            built = grown;
+            builtCapacity *= 2;
+        }
+
+        if (frame->next < green->childCount) {
+            RedNode child = redChild(frame->red, frame->next++);
+            if (!child.green) {
+                built[builtCount++] = 0;
+            } else {
+                if (frameCount == frameCapacity) {
+                    FlattenFrame *grown = realloc(frames, frameCapacity * 2 * sizeof(FlattenFrame));
+                    if (!grown) { ok = 0; break; }
+                    frames = grown;
+                    frameCapacity *= 2;
+                }
+                frames[frameCount++] = (FlattenFrame){child, 0};
+            }
+            continue;
+        }
+
+        const AstLayout *layout = &astLayouts[green->kind];
+        uint32_t fields[3] = {green->a, green->b, green->c};
+        builtCount -= green->childCount;
+        if (layout->hasList) {
+            fields[0] = astAddList(ast, &built[builtCount], green->childCount);
+            fields[1] = green->childCount;
+        } else {
+            uint32_t slot = 0;
+            for (int f = 0; f < 3; f++) {
+                if (layout->nodeFields & (1 << f)) {
+                    fields[f] = built[builtCount + slot++];
+                }
+            }
+        }
+        uint32_t anchor = frame->red.first + green->anchor;
+        SourceLocation location = anchor < tree->tokens->count ? tokenLocation(tree->tokens, anchor) : NO_LOCATION;
+        uint32_t index = astAddNode(ast, (AstKind)green->kind, green->op, location, fields[0], fields[1], fields[2]);
+        ast->nodes[index].flags = green->flags;
+        astSetSpan(ast, index, frame->red.first, redEnd(frame->red));
+        built[builtCount++] = index;
+        frameCount--;
+        ok = !ast->failed;
+    }
+
+    uint32_t root = ok ? built[0] : 0;
+    ast->root = root;
+    free(frames);
+    free(built);
+    return root;
+}
@@ -0,0 +1,107 @@
+#ifndef SYNTAX_TREE_H
+#define SYNTAX_TREE_H
+
+#include <stdint.h>
+#include "Parser.h"
+
+// Incremental syntax tree
+// The tree is kept as immutable, reference-counted "green" nodes that know only
+// their width in tokens and where each child starts relative to themselves, so a
+// subtree does not change when text before it is edited and can be shared by the
+// old and the new tree. Absolute token positions are worked out on the way down
+// by a thin "red" layer (RedNode), which is just a green node plus its first token.
+//
+// After an edit, only the statements around the changed tokens are reparsed: the
+// innermost block containing the edit has those statements replaced, and the
+// blocks and declarations on the path up to the root are copied with adjusted
+// widths. Everything else is reused as is.
+
+typedef struct GreenNode GreenNode;
+
+// A child reference: where the child starts relative to its parent's first token
+typedef struct {
+    uint32_t offset;
+    GreenNode *node;           // NULL for an absent optional child
+} GreenChild;
+
+// Immutable node. Shared between trees, freed when the last reference goes
+struct GreenNode {
+    uint8_t kind;              // AstKind
+    uint8_t op;                // Operator of unary/binary/assignment nodes
+    uint16_t flags;
+    uint32_t width;            // Tokens covered
+    uint32_t anchor;           // Token holding the node's location, relative to its first
+    uint32_t a, b, c;          // Fields of the AstNode that are not children (symbols, values)
+    uint32_t refCount;
+    uint32_t childCount;       // List entries, or one slot per child field of the kind
+    GreenChild children[];
+};
+
+// Red view of a node: the green node and the absolute index of its first token
+typedef struct {
+    const GreenNode *green;
+    uint32_t first;
+} RedNode;
+
+// Tokens replaced by an edit: old tokens [first, oldEnd) became new tokens [first, newEnd)
+typedef struct {
+    uint32_t first;
+    uint32_t oldEnd;
+    uint32_t newEnd;
+} TokenEdit;
+
+// A tree plus the tokens it was parsed from
+typedef struct {
+    GreenNode *root;           // AST_PROGRAM
+    const TokenCollector *tokens;
+    Ast scratch;               // Reused for the statements of each reparse
+    Parser parser;             // Reused parser stacks
+    uint32_t reparsedFirst;    // New tokens [reparsedFirst, reparsedEnd) reparsed by the last edit
+    uint32_t reparsedEnd;
+} SyntaxTree;
+
+// Reference counting
+void retainGreen(GreenNode *node);
+void releaseGreen(GreenNode *node);
+
+// Build green nodes for the subtree of a flat Ast (tokens give each node's anchor)
+GreenNode *greenFromAst(const Ast *ast, uint32_t node, const TokenCollector *tokens);
+
+// Red layer
+static inline RedNode redRoot(const SyntaxTree *tree) {
+    return (RedNode){tree->root, 0};
+}
+
+static inline uint32_t redEnd(RedNode node) {
+    return node.first + node.green->width;
+}
+
+// The i-th child (green == NULL if the slot is empty)
+static inline RedNode redChild(RedNode node, uint32_t i) {
+    const GreenChild *child = &node.green->children[i];
+    return (RedNode){child->node, node.first + child->offset};
+}
+
+// Innermost node whose tokens contain token
+RedNode redNodeAt(RedNode root, uint32_t token);
+
+// Parse all tokens into a new tree. Returns 1 on success
+int initSyntaxTree(SyntaxTree *tree, const TokenCollector *tokens, DiagnosticBuffer *diagnostics);
+
+// Release the tree (the tokens are not touched)
+void freeSyntaxTree(SyntaxTree *tree);
+
+// Find the tokens that differ between two token arrays (compared from both ends).
+// Returns 0 if the arrays are identical
+int findTokenEdit(const TokenCollector *oldTokens, const TokenCollector *newTokens, TokenEdit *edit);
+
+// Update the tree for newTokens, which differ from the tree's tokens only in the
+// edited range. Errors in the reparsed statements go to diagnostics (may be NULL).
+// Returns the number of tokens that were reparsed
+uint32_t reparseEdit(SyntaxTree *tree, const TokenCollector *newTokens, const TokenEdit *edit,
+                     DiagnosticBuffer *diagnostics);
+
+// Flatten the tree into a fresh Ast for later passes. Returns the root node
+uint32_t syntaxTreeToAst(const SyntaxTree *tree, Ast *ast);
+
+#endif // SYNTAX_TREE_H
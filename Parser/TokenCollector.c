@@ -0,0 +1,94 @@
+#include "TokenCollector.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Prepare an empty collector with room for about capacityHint tokens
+void initTokenCollector(TokenCollector *collector, uint32_t capacityHint) {
+    memset(collector, 0, sizeof(*collector));
+    if (capacityHint == 0) {
+        return;  // Arrays are allocated on the first append
+    }
+    collector->types = malloc(capacityHint * sizeof(uint8_t));
+    collector->offsets = malloc(capacityHint * sizeof(uint32_t));
+    collector->lengths = malloc(capacityHint * sizeof(uint32_t));
+    collector->payloads = malloc(capacityHint * sizeof(uint32_t));
+    if (!collector->types || !collector->offsets || !collector->lengths || !collector->payloads) {
+        freeTokenCollector(collector);
+        return;
+    }
+    collector->capacity = capacityHint;
+}
+
+// Free all arrays of a collector
+void freeTokenCollector(TokenCollector *collector) {
+    free(collector->types);
+    free(collector->offsets);
+    free(collector->lengths);
+    free(collector->payloads);
+    free(collector->numbers);
+    SourceLocation base = collector->base;
+    memset(collector, 0, sizeof(*collector));
+    collector->base = base;
+}
+
+// Forget all tokens but keep the allocated arrays
+void clearTokenCollector(TokenCollector *collector) {
+    collector->count = 0;
+    collector->numberCount = 0;
+    collector->failed = 0;
+}
+
+// Grow every token array to newCapacity
+static int growTokens(TokenCollector *collector, uint32_t newCapacity) {
+    uint8_t *types = realloc(collector->types, newCapacity * sizeof(uint8_t));
+    if (types) collector->types = types;
+    uint32_t *offsets = realloc(collector->offsets, newCapacity * sizeof(uint32_t));
+    if (offsets) collector->offsets = offsets;
+    uint32_t *lengths = realloc(collector->lengths, newCapacity * sizeof(uint32_t));
+    if (lengths) collector->lengths = lengths;
+    uint32_t *payloads = realloc(collector->payloads, newCapacity * sizeof(uint32_t));
+    if (payloads) collector->payloads = payloads;
+
+    if (!types || !offsets || !lengths || !payloads) {
+        fprintf(stderr, "Memory allocation failed for tokens!\n");
+        collector->failed = 1;
+        return 0;
+    }
+    collector->capacity = newCapacity;
+    return 1;
+}
+
+// Append a token, doubling the arrays when they are full
+int appendToken(TokenCollector *collector, TokenType type, uint32_t offset, uint32_t length, uint32_t payload) {
+    if (collector->count == collector->capacity &&
+        !growTokens(collector, collector->capacity ? collector->capacity * 2 : 1024)) {
+        return 0;
+    }
+    uint32_t i = collector->count++;
+    collector->types[i] = (uint8_t)type;
+    collector->offsets[i] = offset;
+    collector->lengths[i] = length;
+    collector->payloads[i] = payload;
+    if (collector->flush && collector->count >= collector->flushAt) {
+        collector->flush(collector, collector->flushContext);
+    }
+    return 1;
+}
+
+// Store a numeric literal's value and return its index
+uint32_t addNumber(TokenCollector *collector, int64_t value) {
+    if (collector->numberCount == collector->numberCapacity) {
+        uint32_t newCapacity = collector->numberCapacity ? collector->numberCapacity * 2 : 256;
+        int64_t *numbers = realloc(collector->numbers, newCapacity * sizeof(int64_t));
+        if (!numbers) {
+            fprintf(stderr, "Memory allocation failed for numbers!\n");
+            collector->failed = 1;
+            return NO_PAYLOAD;
+        }
+        collector->numbers = numbers;
+        collector->numberCapacity = newCapacity;
+    }
+    collector->numbers[collector->numberCount] = value;
+    return collector->numberCount++;
+}
@@ -0,0 +1,75 @@
+#ifndef TOKEN_COLLECTOR_H
+#define TOKEN_COLLECTOR_H
+
+#include <stdint.h>
+#include "Tokens.h"         // For TokenType
+#include "Interner.h"       // For SymbolId payloads
+#include "SourceManager.h"  // For SourceLocation
+
+// Payload of tokens that carry no extra information
+#define NO_PAYLOAD UINT32_MAX
+
+// TokenCollector - the lexer's output for the parser
+// Tokens are stored as parallel arrays (structure of arrays) instead of an array
+// of Token structs, so the parser walks a few dense arrays and never copies text.
+// Token i is described by types[i], offsets[i], lengths[i] and payloads[i].
+//
+// Meaning of the payload by token type:
+//   TOKEN_KEYWORD          KeywordId (index into keywords[])
+//   TOKEN_OPERATOR         OperatorId (index into operators[]), NO_PAYLOAD if unknown
+//   TOKEN_SPECIAL_SYMBOL,
+//   TOKEN_EOL              SpecialSymbolId (index into special_symbols[])
+//   TOKEN_NUMBER           Index into numbers[]
+//   TOKEN_BOOLEAN          1 for सत्य, 0 for असत्य
+//   TOKEN_wchar_t          The character's code point
+//   TOKEN_STRING           SymbolId of the string's text (escapes already applied)
+//   TOKEN_IDENTIFIER       SymbolId of the name (collected names are never
+//                          TOKEN_VARIABLE/FUNCTION/CLASSED_VARIABLE; see Resolver.h)
+//   anything else          NO_PAYLOAD
+typedef struct TokenCollector TokenCollector;
+
+// Called by appendToken() once a collector holds flushAt tokens, so a streaming
+// consumer can take them away (see Pipeline.h). It must leave room to append
+typedef void (*TokenFlush)(TokenCollector *collector, void *context);
+
+struct TokenCollector {
+    uint8_t *types;          // TokenType of each token
+    uint32_t *offsets;       // Character offset of each token in the source buffer
+    uint32_t *lengths;       // Length of each token in characters
+    uint32_t *payloads;      // Per-type payload, see above
+    uint32_t count;          // Number of tokens
+    uint32_t capacity;       // Allocated slots in the token arrays
+
+    int64_t *numbers;        // Values of numeric literals
+    uint32_t numberCount;    // Number of values
+    uint32_t numberCapacity; // Allocated slots in numbers
+
+    SourceLocation base;     // Location of offset 0 (NO_LOCATION if not registered)
+    int failed;              // Set if an allocation failed and tokens were lost
+
+    TokenFlush flush;        // Streaming hook (NULL: keep every token)
+    void *flushContext;
+    uint32_t flushAt;        // Token count that triggers flush
+};
+
+// Prepare an empty collector with room for about capacityHint tokens
+void initTokenCollector(TokenCollector *collector, uint32_t capacityHint);
+
+// Free all arrays of a collector
+void freeTokenCollector(TokenCollector *collector);
+
+// Forget all tokens but keep the allocated arrays
+void clearTokenCollector(TokenCollector *collector);
+
+// Append a token. Arrays grow geometrically. Returns 1 on success, 0 on failure
+int appendToken(TokenCollector *collector, TokenType type, uint32_t offset, uint32_t length, uint32_t payload);
+
+// Store a numeric literal's value. Returns its index, or NO_PAYLOAD on failure
+uint32_t addNumber(TokenCollector *collector, int64_t value);
+
+// Location of token i in the SourceManager's location space
+static inline SourceLocation tokenLocation(const TokenCollector *collector, uint32_t i) {
+    return collector->base == NO_LOCATION ? NO_LOCATION : collector->base + collector->offsets[i];
+}
+
+#endif // TOKEN_COLLECTOR_H
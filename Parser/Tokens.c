@@ -6,8 +6,19 @@
 //   - value: Wide character string containing the token's text
 // Returns: A new Token structure with the provided values
 Token createToken(TokenType type, const wchar_t *value) {
+    return createTokenAt(type, value, NO_LOCATION);
+}
+
+// Create a token that also remembers where it starts in the source
+// Parameters:
+//   - type: The token type from TokenType enum
+//   - value: Wide character string containing the token's text
+//   - location: Packed source location from the SourceManager
+// Returns: A new Token structure with the provided values
+Token createTokenAt(TokenType type, const wchar_t *value, SourceLocation location) {
     Token token;
     token.type = type;
+    token.location = location;
     
     // Copy the value to the token, ensuring it doesn't exceed buffer size
     // wcsncpy is the wide character version of strncpy
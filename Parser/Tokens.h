@@ -2,6 +2,7 @@
 #define TOKENS_H
 
 #include <wchar.h>
+#include "SourceManager.h"  // For SourceLocation
 
 // Token types - Enumeration of all possible token categories our lexer can identify
 typedef enum {
@@ -22,14 +23,16 @@ typedef enum {
     TOKEN_UNKNOWN          // Unrecognized tokens
 } TokenType;
 
-// Token structure - Stores the type and value of each token
+// Token structure - Stores the type, value and position of each token
 // Uses wchar_t array to support Unicode/Devanagari characters
 typedef struct {
-    TokenType type;        // The category of this token
-    wchar_t value[100];    // The actual text content (using wide chars for Unicode support)
+    TokenType type;            // The category of this token
+    wchar_t value[100];        // The actual text content (using wide chars for Unicode support)
+    SourceLocation location;   // Where the token starts (NO_LOCATION if unknown)
 } Token;
 
 // Function prototypes
 Token createToken(TokenType type, const wchar_t *value);
+Token createTokenAt(TokenType type, const wchar_t *value, SourceLocation location);
 
 #endif // TOKENS_H
\ No newline at end of file
@@ -0,0 +1,146 @@
+#include "Traversal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Node waiting on the stack while the pre-order is built
+typedef struct {
+    uint32_t node;
+    uint32_t depth;
+} OrderItem;
+
+// Compute the orders of the subtree below root
+int buildAstOrder(const Ast *ast, uint32_t root, AstOrder *order) {
+    memset(order, 0, sizeof(*order));
+    order->nodeCount = ast->nodeCount;
+    uint32_t slots = ast->nodeCount ? ast->nodeCount : 1;
+    order->preorder = malloc(slots * sizeof(uint32_t));
+    order->postorder = malloc(slots * sizeof(uint32_t));
+    order->subtreeEnd = malloc(slots * sizeof(uint32_t));
+    order->parents = calloc(slots, sizeof(uint32_t));
+    OrderItem *pending = malloc(slots * sizeof(OrderItem));
+    uint32_t *depths = malloc(slots * sizeof(uint32_t));   // By pre-order position
+    uint32_t *open = malloc(slots * sizeof(uint32_t));     // Positions of unfinished subtrees
+    if (!order->preorder || !order->postorder || !order->subtreeEnd || !order->parents ||
+        !pending || !depths || !open) {
+        fprintf(stderr, "Memory allocation failed for the tree order!\n");
+        free(pending);
+        free(depths);
+        free(open);
+        freeAstOrder(order);
+        return 0;
+    }
+
+    // Pre-order: children are pushed last first so they come off in source order
+    uint32_t top = 0;
+    uint32_t count = 0;
+    if (root != 0 && root < ast->nodeCount) {
+        pending[top++] = (OrderItem){root, 1};
+    }
+    while (top > 0 && count < slots) {
+        OrderItem item = pending[--top];
+        depths[count] = item.depth;
+        order->preorder[count++] = item.node;
+        if (item.depth > order->maxDepth) {
+            order->maxDepth = item.depth;
+        }
+        uint32_t children = astChildCount(ast, item.node);
+        for (uint32_t i = children; i > 0 && top < slots; i--) {
+            uint32_t child = astChild(ast, item.node, i - 1);
+            order->parents[child] = item.node;
+            pending[top++] = (OrderItem){child, item.depth + 1};
+        }
+    }
+    order->count = count;
+
+    // A subtree ends at the next position that is not deeper than its root.
+    // Subtrees are finished in the order a recursive walk leaves them, which is
+    // the post-order
+    uint32_t next = 0;
+    top = 0;
+    for (uint32_t p = 0; p < count; p++) {
+        while (top > 0 && depths[open[top - 1]] >= depths[p]) {
+            uint32_t finished = open[--top];
+            order->subtreeEnd[finished] = p;
+            order->postorder[next++] = order->preorder[finished];
+        }
+        open[top++] = p;
+    }
+    while (top > 0) {
+        uint32_t finished = open[--top];
+        order->subtreeEnd[finished] = count;
+        order->postorder[next++] = order->preorder[finished];
+    }
+
+    free(pending);
+    free(depths);
+    free(open);
+    return 1;
+}
+
+void freeAstOrder(AstOrder *order) {
+    free(order->preorder);
+    free(order->postorder);
+    free(order->subtreeEnd);
+    free(order->parents);
+    memset(order, 0, sizeof(*order));
+}
+
+// Call visitor->enter for every node in pre-order
+int visitPreorder(const Ast *ast, const AstOrder *order, const AstVisitor *visitor, void *context) {
+    for (uint32_t p = 0; p < order->count; p++) {
+        uint32_t node = order->preorder[p];
+        AstVisitFunction enter = visitor->enter[ast->nodes[node].kind];
+        if (enter && !enter(context, node)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Call visitor->leave for every node in post-order
+int visitPostorder(const Ast *ast, const AstOrder *order, const AstVisitor *visitor, void *context) {
+    for (uint32_t p = 0; p < order->count; p++) {
+        uint32_t node = order->postorder[p];
+        AstVisitFunction leave = visitor->leave[ast->nodes[node].kind];
+        if (leave && !leave(context, node)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Leave a node (its kind is read now, in case entering it changed the node)
+static int leaveNode(const Ast *ast, const AstVisitor *visitor, void *context, uint32_t node) {
+    AstVisitFunction leave = visitor->leave[ast->nodes[node].kind];
+    return !leave || leave(context, node);
+}
+
+// Call visitor->enter on the way down and visitor->leave on the way up
+int visitTree(const Ast *ast, const AstOrder *order, const AstVisitor *visitor, void *context) {
+    // Pre-order positions of the nodes entered but not yet left
+    uint32_t *open = malloc((order->maxDepth ? order->maxDepth : 1) * sizeof(uint32_t));
+    if (!open) {
+        fprintf(stderr, "Memory allocation failed for the tree walk!\n");
+        return 0;
+    }
+    uint32_t top = 0;
+    int ok = 1;
+    for (uint32_t p = 0; p < order->count && ok; p++) {
+        while (ok && top > 0 && order->subtreeEnd[open[top - 1]] <= p) {
+            ok = leaveNode(ast, visitor, context, order->preorder[open[--top]]);
+        }
+        if (!ok) {
+            break;
+        }
+        uint32_t node = order->preorder[p];
+        AstVisitFunction enter = visitor->enter[ast->nodes[node].kind];
+        ok = !enter || enter(context, node);
+        open[top++] = p;
+    }
+    while (ok && top > 0) {
+        ok = leaveNode(ast, visitor, context, order->preorder[open[--top]]);
+    }
+    free(open);
+    return ok;
+}
@@ -0,0 +1,52 @@
+#ifndef TRAVERSAL_H
+#define TRAVERSAL_H
+
+#include <stdint.h>
+#include "Ast.h"
+
+// Tree traversal
+// The order in which a pass visits the nodes of a tree is worked out once, into
+// plain arrays of node indices, so a pass is a loop over contiguous memory
+// instead of a walk with its own stack. Several passes can share one AstOrder as
+// long as none of them changes the tree's shape; after a pass that does (such as
+// foldConstants), build a new one.
+//
+// What a pass does with each kind of node is given by a visitor: a table of
+// functions indexed by AstKind, one for entering a node (before its children)
+// and one for leaving it (after them). Kinds without a function are skipped.
+
+typedef struct {
+    uint32_t *preorder;        // Nodes with every parent before its children, in source order
+    uint32_t *postorder;       // Nodes with every parent after its children, in source order
+    uint32_t *subtreeEnd;      // By pre-order position: one past the last position of the subtree
+    uint32_t *parents;         // By node: its parent (0 for the root and unreachable nodes)
+    uint32_t count;            // Nodes reachable from the root
+    uint32_t nodeCount;        // Size of the tree the order was built for
+    uint32_t maxDepth;         // Deepest node (the root has depth 1)
+} AstOrder;
+
+// Called for one node. Returns 1 to go on, 0 to stop the traversal
+typedef int (*AstVisitFunction)(void *context, uint32_t node);
+
+typedef struct {
+    AstVisitFunction enter[AST_KIND_COUNT];  // Before the node's children (NULL = nothing)
+    AstVisitFunction leave[AST_KIND_COUNT];  // After them
+} AstVisitor;
+
+// Compute the orders of the subtree below root. Returns 1 on success, 0 if out of memory
+int buildAstOrder(const Ast *ast, uint32_t root, AstOrder *order);
+
+void freeAstOrder(AstOrder *order);
+
+// Call visitor->enter for every node in pre-order. Returns 0 if a visit stopped it
+int visitPreorder(const Ast *ast, const AstOrder *order, const AstVisitor *visitor, void *context);
+
+// Call visitor->leave for every node in post-order. Returns 0 if a visit stopped it
+int visitPostorder(const Ast *ast, const AstOrder *order, const AstVisitor *visitor, void *context);
+
+// Call visitor->enter on the way down and visitor->leave on the way up, as a
+// recursive walk would (for passes that keep scopes). Returns 0 if a visit
+// stopped it or if out of memory
+int visitTree(const Ast *ast, const AstOrder *order, const AstVisitor *visitor, void *context);
+
+#endif // TRAVERSAL_H
@@ -0,0 +1,518 @@
+#include "TypeChecker.h"
+#include "Interner.h"
+#include "utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const Ast *ast;
+    const Resolution *resolution;
+    TypeCheck *check;
+    DiagnosticBuffer *diagnostics;
+    int failed;
+} TypeChecker;
+
+static const char *const builtinNames[TYPE_BUILTIN_COUNT] = {
+    "<error>", "<void>", "पूर्ण", "सत्य/असत्य", "<string>", "<char>"
+};
+
+// Prepare a table holding only the built-in types
+void initTypeTable(TypeTable *table) {
+    memset(table, 0, sizeof(*table));
+    table->types = calloc(64, sizeof(TypeInfo));
+    table->buckets = calloc(64, sizeof(TypeId));
+    if (!table->types || !table->buckets) {
+        fprintf(stderr, "Memory allocation failed for the type table!\n");
+        freeTypeTable(table);
+        return;
+    }
+    table->capacity = 64;
+    table->bucketCount = 64;
+    table->count = TYPE_BUILTIN_COUNT;
+}
+
+void freeTypeTable(TypeTable *table) {
+    free(table->types);
+    free(table->params);
+    free(table->buckets);
+    memset(table, 0, sizeof(*table));
+}
+
+// FNV-1a over the parts of a type that make it unique
+static uint32_t hashType(uint8_t kind, uint32_t declaration, const TypeId *params, uint32_t paramCount) {
+    uint32_t hash = 2166136261u;
+    hash = (hash ^ kind) * 16777619u;
+    hash = (hash ^ declaration) * 16777619u;
+    for (uint32_t i = 0; i < paramCount; i++) {
+        hash = (hash ^ params[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static int sameType(const TypeTable *table, TypeId type, uint8_t kind, uint32_t declaration,
+                    const TypeId *params, uint32_t paramCount) {
+    const TypeInfo *info = &table->types[type];
+    if (info->kind != kind) {
+        return 0;
+    }
+    if (kind == TYPE_KIND_CLASS) {
+        return info->declaration == declaration;
+    }
+    return info->paramCount == paramCount &&
+           memcmp(&table->params[info->firstParam], params, paramCount * sizeof(TypeId)) == 0;
+}
+
+// Double the bucket array and re-insert every type
+static int growBuckets(TypeTable *table) {
+    uint32_t bucketCount = table->bucketCount * 2;
+    TypeId *buckets = calloc(bucketCount, sizeof(TypeId));
+    if (!buckets) {
+        return 0;
+    }
+    for (TypeId type = TYPE_BUILTIN_COUNT; type < table->count; type++) {
+        const TypeInfo *info = &table->types[type];
+        uint32_t hash = hashType(info->kind, info->declaration,
+                                 info->kind == TYPE_KIND_FUNCTION ? &table->params[info->firstParam] : NULL,
+                                 info->paramCount);
+        uint32_t i = hash & (bucketCount - 1);
+        while (buckets[i] != 0) {
+            i = (i + 1) & (bucketCount - 1);
+        }
+        buckets[i] = type;
+    }
+    free(table->buckets);
+    table->buckets = buckets;
+    table->bucketCount = bucketCount;
+    return 1;
+}
+
+// Find a type or add it
+static TypeId internType(TypeTable *table, uint8_t kind, SymbolId name, uint32_t declaration,
+                         const TypeId *params, uint32_t paramCount) {
+    if (!table->types) {
+        return TYPE_ERROR;
+    }
+    uint32_t hash = hashType(kind, declaration, params, paramCount);
+    uint32_t i = hash & (table->bucketCount - 1);
+    while (table->buckets[i] != 0) {
+        if (sameType(table, table->buckets[i], kind, declaration, params, paramCount)) {
+            return table->buckets[i];
+        }
+        i = (i + 1) & (table->bucketCount - 1);
+    }
+
+    // Keep the index at most half full
+    if ((table->count - TYPE_BUILTIN_COUNT + 1) * 2 > table->bucketCount) {
+        if (!growBuckets(table)) {
+            fprintf(stderr, "Memory allocation failed for the type table!\n");
+            return TYPE_ERROR;
+        }
+        return internType(table, kind, name, declaration, params, paramCount);
+    }
+    if (table->count == table->capacity) {
+        TypeInfo *types = realloc(table->types, table->capacity * 2 * sizeof(TypeInfo));
+        if (!types) {
+            fprintf(stderr, "Memory allocation failed for the type table!\n");
+            return TYPE_ERROR;
+        }
+        table->types = types;
+        table->capacity *= 2;
+    }
+    if (table->paramCount + paramCount > table->paramCapacity) {
+        uint32_t capacity = table->paramCapacity ? table->paramCapacity : 64;
+        while (table->paramCount + paramCount > capacity) {
+            capacity *= 2;
+        }
+        TypeId *grown = realloc(table->params, capacity * sizeof(TypeId));
+        if (!grown) {
+            fprintf(stderr, "Memory allocation failed for the type table!\n");
+            return TYPE_ERROR;
+        }
+        table->params = grown;
+        table->paramCapacity = capacity;
+    }
+
+    TypeId type = table->count++;
+    if (paramCount > 0) {
+        memcpy(&table->params[table->paramCount], params, paramCount * sizeof(TypeId));
+    }
+    table->types[type] = (TypeInfo){(uint8_t)kind, name, declaration, table->paramCount, paramCount};
+    table->paramCount += paramCount;
+    table->buckets[i] = type;
+    return type;
+}
+
+// The type of a class declaration
+TypeId internClassType(TypeTable *table, uint32_t declaration, SymbolId name) {
+    return internType(table, TYPE_KIND_CLASS, name, declaration, NULL, 0);
+}
+
+// The type of a function with these parameter types
+TypeId internFunctionType(TypeTable *table, const TypeId *params, uint32_t paramCount) {
+    return internType(table, TYPE_KIND_FUNCTION, NO_SYMBOL, 0, params, paramCount);
+}
+
+// Print a type the way it is written in source
+void printType(const TypeTable *table, TypeId type, FILE *out) {
+    const TypeInfo *info = &table->types[type];
+    if (info->kind == TYPE_KIND_BUILTIN) {
+        fputs(builtinNames[type], out);
+    } else if (info->kind == TYPE_KIND_CLASS) {
+        const wchar_t *name = symbolText(info->name);
+        fprintf(out, "%ls", name ? name : L"?");
+    } else {
+        fputs("कर्म(", out);
+        for (uint32_t i = 0; i < info->paramCount; i++) {
+            if (i > 0) fputs(", ", out);
+            printType(table, table->params[info->firstParam + i], out);
+        }
+        fputc(')', out);
+    }
+}
+
+static void reportType(TypeChecker *checker, uint32_t node, SymbolId symbol, const char *message) {
+    const Ast *ast = checker->ast;
+    checker->check->errorCount++;
+    if (checker->diagnostics) {
+        uint32_t token = ast->spans ? ast->spans[node].first : 0;
+        addDiagnostic(checker->diagnostics, DIAGNOSTIC_ERROR, astLocation(ast, node), token, symbol, message);
+    }
+}
+
+// Type a declaration gives to its name. Computed on first use, since a call can
+// come before the function it calls
+static TypeId declaredType(TypeChecker *checker, uint32_t declaration) {
+    TypeId *types = checker->check->types;
+    if (types[declaration] != TYPE_ERROR) {
+        return types[declaration];
+    }
+    const Ast *ast = checker->ast;
+    const AstNode *n = &ast->nodes[declaration];
+    TypeId type = TYPE_ERROR;
+    if (n->kind == AST_VAR_DECL) {
+        uint32_t class = n->c ? declarationOf(checker->resolution, declaration) : 0;
+        type = n->c == 0 ? TYPE_INT : class ? declaredType(checker, class) : TYPE_ERROR;
+    } else if (n->kind == AST_CLASS_DECL) {
+        type = internClassType(&checker->check->table, declaration, astSymbol(ast, n->a));
+    } else if (n->kind == AST_FUNC_DECL) {
+        const AstNode *params = &ast->nodes[n->b];
+        TypeId stackParams[16] = {0};
+        TypeId *paramTypes = params->b <= 16 ? stackParams : malloc(params->b * sizeof(TypeId));
+        if (!paramTypes) {
+            checker->failed = 1;
+            return TYPE_ERROR;
+        }
+        for (uint32_t i = 0; i < params->b; i++) {
+            paramTypes[i] = declaredType(checker, ast->lists[params->a + i]);
+        }
+        type = internFunctionType(&checker->check->table, paramTypes, params->b);
+        if (paramTypes != stackParams) {
+            free(paramTypes);
+        }
+    }
+    types[declaration] = type;
+    return type;
+}
+
+// Require a type. TYPE_ERROR operands were reported already and pass silently
+static void expectType(TypeChecker *checker, uint32_t node, TypeId expected, const char *message) {
+    TypeId type = checker->check->types[node];
+    if (type != expected && type != TYPE_ERROR) {
+        reportType(checker, node, NO_SYMBOL, message);
+    }
+}
+
+// Require an expression that has a value
+static void expectValue(TypeChecker *checker, uint32_t node) {
+    if (checker->check->types[node] == TYPE_VOID) {
+        reportType(checker, node, NO_SYMBOL, "Expression has no value");
+    }
+}
+
+static TypeId checkBinary(TypeChecker *checker, const AstNode *n) {
+    TypeId left = checker->check->types[n->a];
+    TypeId right = checker->check->types[n->b];
+    int known = left != TYPE_ERROR && right != TYPE_ERROR;
+    switch (n->op) {
+        case OPERATOR_PLUS:
+            if (left == TYPE_STRING && right == TYPE_STRING) {
+                return TYPE_STRING;
+            }
+            if (known && (left != TYPE_INT || right != TYPE_INT)) {
+                reportType(checker, n->a, NO_SYMBOL, "Operands of '+' must both be पूर्ण or both be strings");
+            }
+            return TYPE_INT;
+        case OPERATOR_MINUS:
+        case OPERATOR_STAR:
+        case OPERATOR_SLASH:
+            expectType(checker, n->a, TYPE_INT, "Operands of an arithmetic operator must be पूर्ण");
+            expectType(checker, n->b, TYPE_INT, "Operands of an arithmetic operator must be पूर्ण");
+            return TYPE_INT;
+        case OPERATOR_GREATER:
+        case OPERATOR_LESS:
+        case OPERATOR_GREATER_EQUAL:
+        case OPERATOR_LESS_EQUAL:
+            if (known && !(left == right && (left == TYPE_INT || left == TYPE_CHAR))) {
+                reportType(checker, n->a, NO_SYMBOL, "Comparison needs two पूर्ण or two characters");
+            }
+            return TYPE_BOOL;
+        case OPERATOR_EQUAL:
+        case OPERATOR_NOT_EQUAL:
+            expectValue(checker, n->a);
+            expectValue(checker, n->b);
+            if (known && left != right) {
+                reportType(checker, n->a, NO_SYMBOL, "Compared values must have the same type");
+            }
+            return TYPE_BOOL;
+        case OPERATOR_AND:
+            expectType(checker, n->a, TYPE_BOOL, "Operands of '&&' must be boolean");
+            expectType(checker, n->b, TYPE_BOOL, "Operands of '&&' must be boolean");
+            return TYPE_BOOL;
+        default:
+            return TYPE_ERROR;
+    }
+}
+
+static TypeId checkAssignment(TypeChecker *checker, const AstNode *n) {
+    TypeId target = checker->check->types[n->a];
+    TypeId value = checker->check->types[n->b];
+    if (target == TYPE_ERROR || value == TYPE_ERROR) {
+        return target;
+    }
+    if (n->op == OPERATOR_ASSIGN) {
+        if (value != target) {
+            reportType(checker, n->b, NO_SYMBOL, "Assigned value does not match the variable's type");
+        }
+    } else if (n->op == OPERATOR_PLUS_ASSIGN && target == TYPE_STRING && value == TYPE_STRING) {
+        // Appending to a string
+    } else if (target != TYPE_INT || value != TYPE_INT) {
+        reportType(checker, n->a, NO_SYMBOL, "Compound assignment needs a पूर्ण variable and value");
+    }
+    return target;
+}
+
+static TypeId checkCall(TypeChecker *checker, uint32_t node) {
+    const Ast *ast = checker->ast;
+    const AstNode *n = &ast->nodes[node];
+    uint32_t function = declarationOf(checker->resolution, node);
+    if (function == 0) {
+        return TYPE_VOID;  // Unresolved; reported by the resolver
+    }
+    const TypeTable *table = &checker->check->table;
+    TypeId type = declaredType(checker, function);
+    if (type == TYPE_ERROR) {
+        return TYPE_VOID;
+    }
+    const TypeInfo *info = typeInfo(table, type);
+    if (info->paramCount != n->b) {
+        reportType(checker, node, astSymbol(ast, n->c), "Wrong number of arguments");
+        return TYPE_VOID;
+    }
+    for (uint32_t i = 0; i < n->b; i++) {
+        uint32_t argument = ast->lists[n->a + i];
+        TypeId argumentType = checker->check->types[argument];
+        if (argumentType != TYPE_ERROR && argumentType != table->params[info->firstParam + i]) {
+            reportType(checker, argument, NO_SYMBOL, "Argument does not match the parameter's type");
+        }
+    }
+    return TYPE_VOID;
+}
+
+// Visitor functions: each types a node whose children are all typed
+static int typeNumber(void *context, uint32_t node) {
+    ((TypeChecker *)context)->check->types[node] = TYPE_INT;
+    return 1;
+}
+
+static int typeString(void *context, uint32_t node) {
+    ((TypeChecker *)context)->check->types[node] = TYPE_STRING;
+    return 1;
+}
+
+static int typeChar(void *context, uint32_t node) {
+    ((TypeChecker *)context)->check->types[node] = TYPE_CHAR;
+    return 1;
+}
+
+static int typeBool(void *context, uint32_t node) {
+    ((TypeChecker *)context)->check->types[node] = TYPE_BOOL;
+    return 1;
+}
+
+static int typeIdentifier(void *context, uint32_t node) {
+    TypeChecker *checker = context;
+    uint32_t declaration = declarationOf(checker->resolution, node);
+    checker->check->types[node] = declaration ? declaredType(checker, declaration) : TYPE_ERROR;
+    return !checker->failed;
+}
+
+static int typeUnary(void *context, uint32_t node) {
+    TypeChecker *checker = context;
+    const AstNode *n = &checker->ast->nodes[node];
+    if (n->op == OPERATOR_NOT) {
+        expectType(checker, n->a, TYPE_BOOL, "Operand of न must be boolean");
+        checker->check->types[node] = TYPE_BOOL;
+    } else {
+        expectType(checker, n->a, TYPE_INT, "Operand of '-' must be पूर्ण");
+        checker->check->types[node] = TYPE_INT;
+    }
+    return 1;
+}
+
+static int typeBinary(void *context, uint32_t node) {
+    TypeChecker *checker = context;
+    checker->check->types[node] = checkBinary(checker, &checker->ast->nodes[node]);
+    return 1;
+}
+
+static int typeAssignment(void *context, uint32_t node) {
+    TypeChecker *checker = context;
+    checker->check->types[node] = checkAssignment(checker, &checker->ast->nodes[node]);
+    return 1;
+}
+
+static int typeTernary(void *context, uint32_t node) {
+    TypeChecker *checker = context;
+    const AstNode *n = &checker->ast->nodes[node];
+    TypeId *types = checker->check->types;
+    expectType(checker, n->a, TYPE_BOOL, "Condition must be boolean");
+    if (types[n->b] != types[n->c] && types[n->b] != TYPE_ERROR && types[n->c] != TYPE_ERROR) {
+        reportType(checker, n->c, NO_SYMBOL, "Both branches of '?' must have the same type");
+        types[node] = TYPE_ERROR;
+    } else {
+        types[node] = types[n->b] != TYPE_ERROR ? types[n->b] : types[n->c];
+    }
+    return 1;
+}
+
+static int typeCall(void *context, uint32_t node) {
+    TypeChecker *checker = context;
+    checker->check->types[node] = checkCall(checker, node);
+    return !checker->failed;
+}
+
+static int typeVariable(void *context, uint32_t node) {
+    TypeChecker *checker = context;
+    const AstNode *n = &checker->ast->nodes[node];
+    TypeId type = declaredType(checker, node);
+    if (n->b != 0 && type != TYPE_ERROR) {
+        expectType(checker, n->b, type, "Initializer does not match the variable's type");
+    }
+    checker->check->types[node] = type;
+    return !checker->failed;
+}
+
+// Functions and classes
+static int typeDeclaration(void *context, uint32_t node) {
+    TypeChecker *checker = context;
+    checker->check->types[node] = declaredType(checker, node);
+    return !checker->failed;
+}
+
+// यदि and जबतक
+static int typeCondition(void *context, uint32_t node) {
+    TypeChecker *checker = context;
+    expectType(checker, checker->ast->nodes[node].a, TYPE_BOOL, "Condition must be boolean");
+    checker->check->types[node] = TYPE_VOID;
+    return 1;
+}
+
+static int typeLoop(void *context, uint32_t node) {
+    TypeChecker *checker = context;
+    const AstNode *n = &checker->ast->nodes[node];
+    if (checker->ast->nodes[n->a].c != 0) {
+        reportType(checker, n->a, NO_SYMBOL, "Loop variable must be पूर्ण");
+    }
+    expectType(checker, n->b, TYPE_INT, "Loop bounds must be पूर्ण");
+    checker->check->types[node] = TYPE_VOID;
+    return 1;
+}
+
+static int typePrint(void *context, uint32_t node) {
+    TypeChecker *checker = context;
+    const Ast *ast = checker->ast;
+    const AstNode *n = &ast->nodes[node];
+    for (uint32_t i = 0; i < n->b; i++) {
+        expectValue(checker, ast->lists[n->a + i]);
+    }
+    checker->check->types[node] = TYPE_VOID;
+    return 1;
+}
+
+static int typeInput(void *context, uint32_t node) {
+    TypeChecker *checker = context;
+    const AstNode *n = &checker->ast->nodes[node];
+    TypeId *types = checker->check->types;
+    if (types[n->a] != TYPE_INT && types[n->a] != TYPE_STRING && types[n->a] != TYPE_ERROR) {
+        reportType(checker, n->a, NO_SYMBOL, "प्रवे needs a पूर्ण or string variable");
+    }
+    types[node] = TYPE_VOID;
+    return 1;
+}
+
+static int typeVoid(void *context, uint32_t node) {
+    ((TypeChecker *)context)->check->types[node] = TYPE_VOID;
+    return 1;
+}
+
+// AST_ERROR has no function and stays TYPE_ERROR
+static const AstVisitor typeVisitor = {
+    .leave = {
+        [AST_PROGRAM] = typeVoid,
+        [AST_BLOCK] = typeVoid,
+        [AST_PARAMS] = typeVoid,
+        [AST_LAZY_BODY] = typeVoid,
+        [AST_EXPR_STMT] = typeVoid,
+        [AST_NUMBER] = typeNumber,
+        [AST_STRING] = typeString,
+        [AST_CHAR] = typeChar,
+        [AST_BOOL] = typeBool,
+        [AST_IDENT] = typeIdentifier,
+        [AST_UNARY] = typeUnary,
+        [AST_BINARY] = typeBinary,
+        [AST_ASSIGN] = typeAssignment,
+        [AST_TERNARY] = typeTernary,
+        [AST_CALL] = typeCall,
+        [AST_VAR_DECL] = typeVariable,
+        [AST_FUNC_DECL] = typeDeclaration,
+        [AST_CLASS_DECL] = typeDeclaration,
+        [AST_IF] = typeCondition,
+        [AST_WHILE] = typeCondition,
+        [AST_LOOP] = typeLoop,
+        [AST_PRINT] = typePrint,
+        [AST_INPUT] = typeInput,
+    },
+};
+
+// Check the types of every node below ast->root
+int checkTypes(const Ast *ast, const AstOrder *order, const Resolution *resolution, TypeCheck *check,
+               DiagnosticBuffer *diagnostics) {
+    memset(check, 0, sizeof(*check));
+    initTypeTable(&check->table);
+    check->nodeCount = ast->nodeCount;
+    check->types = calloc(ast->nodeCount ? ast->nodeCount : 1, sizeof(TypeId));
+    AstOrder ownOrder;
+    if (!order && buildAstOrder(ast, ast->root, &ownOrder)) {
+        order = &ownOrder;
+    }
+    if (!check->types || !check->table.types || !order) {
+        fprintf(stderr, "Memory allocation failed for type checking!\n");
+        freeTypeCheck(check);
+        if (order == &ownOrder) freeAstOrder(&ownOrder);
+        return 0;
+    }
+
+    // Post-order: a node is typed after all of its children
+    TypeChecker checker = {ast, resolution, check, diagnostics, 0};
+    int ok = visitPostorder(ast, order, &typeVisitor, &checker);
+    if (order == &ownOrder) {
+        freeAstOrder(&ownOrder);
+    }
+    return ok && check->errorCount == 0;
+}
+
+void freeTypeCheck(TypeCheck *check) {
+    freeTypeTable(&check->table);
+    free(check->types);
+    memset(check, 0, sizeof(*check));
+}
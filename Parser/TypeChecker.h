@@ -0,0 +1,104 @@
+#ifndef TYPE_CHECKER_H
+#define TYPE_CHECKER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "Ast.h"
+#include "Resolver.h"       // Types follow names to their declarations
+#include "Diagnostics.h"
+
+// Type checking
+// Every type is interned once into a TypeTable and named by a small TypeId, so two
+// types are equal exactly when their IDs are. The built-in types have fixed IDs;
+// class types (one per कक्षा declaration) and function types (by parameter types)
+// are added as the checker meets them.
+//
+// The checker walks a resolved tree bottom-up and records the type of every node
+// in a side array. Later stages use it to tell integer-only operations, which can
+// work on plain machine integers, from the rest.
+//
+// Rules:
+//   पूर्ण variables, numbers, + - * /       integer (+ also joins two strings)
+//   comparisons, &&, न / !, सत्य/असत्य      boolean; < > <= >= compare integers or characters
+//   == !=                                 both sides of the same type
+//   यदि, चक्र conditions, ?: condition      boolean
+//   assignments, initializers, arguments  the value's type must equal the target's
+//   calls                                 no value (functions do not return one)
+
+typedef uint32_t TypeId;
+
+// Built-in types
+#define TYPE_ERROR  ((TypeId)0)  // Type of ill-typed code (not reported again)
+#define TYPE_VOID   ((TypeId)1)  // Statements and calls
+#define TYPE_INT    ((TypeId)2)  // पूर्ण
+#define TYPE_BOOL   ((TypeId)3)  // सत्य / असत्य
+#define TYPE_STRING ((TypeId)4)
+#define TYPE_CHAR   ((TypeId)5)
+#define TYPE_BUILTIN_COUNT 6
+
+typedef enum {
+    TYPE_KIND_BUILTIN,
+    TYPE_KIND_CLASS,
+    TYPE_KIND_FUNCTION
+} TypeKind;
+
+// One interned type
+typedef struct {
+    uint8_t kind;              // TypeKind
+    SymbolId name;             // Class name (NO_SYMBOL otherwise)
+    uint32_t declaration;      // AST_CLASS_DECL node of a class type
+    uint32_t firstParam;       // Function types: parameter types are params[firstParam ..]
+    uint32_t paramCount;
+} TypeInfo;
+
+typedef struct {
+    TypeInfo *types;           // Indexed by TypeId
+    uint32_t count;
+    uint32_t capacity;
+    TypeId *params;            // Parameter types of function types
+    uint32_t paramCount;
+    uint32_t paramCapacity;
+    TypeId *buckets;           // Open-addressing index of the non-built-in types (0 = empty)
+    uint32_t bucketCount;      // Power of two
+} TypeTable;
+
+// Result of checking one tree
+typedef struct {
+    TypeTable table;
+    TypeId *types;             // Type of each node (TYPE_VOID for statements)
+    uint32_t nodeCount;
+    uint32_t errorCount;
+} TypeCheck;
+
+// Prepare a table holding only the built-in types
+void initTypeTable(TypeTable *table);
+void freeTypeTable(TypeTable *table);
+
+// The type of a class declaration. Returns TYPE_ERROR if out of memory
+TypeId internClassType(TypeTable *table, uint32_t declaration, SymbolId name);
+
+// The type of a function with these parameter types. Returns TYPE_ERROR if out of memory
+TypeId internFunctionType(TypeTable *table, const TypeId *params, uint32_t paramCount);
+
+static inline const TypeInfo *typeInfo(const TypeTable *table, TypeId type) {
+    return &table->types[type];
+}
+
+// Print a type the way it is written in source
+void printType(const TypeTable *table, TypeId type, FILE *out);
+
+// Check the types of every node below ast->root, visiting the nodes in order
+// (NULL: build one for the call; the resolver's can be shared). Errors go to
+// diagnostics (may be NULL). Returns 1 if the tree is well typed, 0 on errors or
+// if out of memory
+int checkTypes(const Ast *ast, const AstOrder *order, const Resolution *resolution, TypeCheck *check,
+               DiagnosticBuffer *diagnostics);
+
+void freeTypeCheck(TypeCheck *check);
+
+// Type of a node
+static inline TypeId typeOfNode(const TypeCheck *check, uint32_t node) {
+    return node < check->nodeCount ? check->types[node] : TYPE_ERROR;
+}
+
+#endif // TYPE_CHECKER_H
@@ -0,0 +1,150 @@
+#include "WorkPool.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Tasks [next, end) still waiting on one worker
+typedef struct {
+    pthread_mutex_t lock;
+    uint32_t next;
+    uint32_t end;
+} WorkQueue;
+
+typedef struct {
+    WorkQueue *queues;
+    uint32_t threadCount;
+    WorkFunction function;
+    void *context;
+} WorkPool;
+
+typedef struct {
+    WorkPool *pool;
+    uint32_t worker;
+} WorkerArgs;
+
+// Number of threads to use when the caller has no preference (online CPUs)
+uint32_t defaultThreadCount(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (uint32_t)cpus : 1;
+}
+
+// Take the next task of a worker's own range. Returns 0 if it is empty
+static int takeTask(WorkQueue *queue, uint32_t *task) {
+    int found = 0;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->next < queue->end) {
+        *task = queue->next++;
+        found = 1;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+}
+
+// Move the back half of some other worker's range into our own queue.
+// Returns 0 when every queue is empty
+static int stealTasks(WorkPool *pool, uint32_t worker) {
+    for (uint32_t i = 1; i < pool->threadCount; i++) {
+        WorkQueue *victim = &pool->queues[(worker + i) % pool->threadCount];
+        uint32_t first = 0, end = 0;
+        pthread_mutex_lock(&victim->lock);
+        if (victim->next < victim->end) {
+            uint32_t remaining = victim->end - victim->next;
+            end = victim->end;
+            first = end - (remaining + 1) / 2;
+            victim->end = first;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (first < end) {
+            WorkQueue *own = &pool->queues[worker];
+            pthread_mutex_lock(&own->lock);
+            own->next = first;
+            own->end = end;
+            pthread_mutex_unlock(&own->lock);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Worker loop: run own tasks, then steal until nothing is left anywhere
+static void runWorker(WorkPool *pool, uint32_t worker) {
+    uint32_t task;
+    do {
+        while (takeTask(&pool->queues[worker], &task)) {
+            pool->function(pool->context, task, worker);
+        }
+    } while (stealTasks(pool, worker));
+}
+
+static void *workerThread(void *arg) {
+    WorkerArgs *args = arg;
+    runWorker(args->pool, args->worker);
+    return NULL;
+}
+
+// Run every task and wait for all of them. The calling thread is worker 0
+int runWorkPool(uint32_t taskCount, uint32_t threadCount, WorkFunction function, void *context) {
+    if (threadCount == 0) {
+        threadCount = defaultThreadCount();
+    }
+    if (threadCount > taskCount) {
+        threadCount = taskCount > 0 ? taskCount : 1;
+    }
+    if (threadCount == 1) {
+        for (uint32_t task = 0; task < taskCount; task++) {
+            function(context, task, 0);
+        }
+        return 1;
+    }
+
+    WorkQueue *queues = malloc(threadCount * sizeof(WorkQueue));
+    pthread_t *threads = malloc(threadCount * sizeof(pthread_t));
+    WorkerArgs *args = malloc(threadCount * sizeof(WorkerArgs));
+    if (!queues || !threads || !args) {
+        fprintf(stderr, "Memory allocation failed for the work pool!\n");
+        free(queues);
+        free(threads);
+        free(args);
+        for (uint32_t task = 0; task < taskCount; task++) {
+            function(context, task, 0);
+        }
+        return 0;
+    }
+
+    // Split the tasks into equal contiguous ranges
+    WorkPool pool = {queues, threadCount, function, context};
+    for (uint32_t w = 0; w < threadCount; w++) {
+        pthread_mutex_init(&queues[w].lock, NULL);
+        queues[w].next = (uint32_t)((uint64_t)taskCount * w / threadCount);
+        queues[w].end = (uint32_t)((uint64_t)taskCount * (w + 1) / threadCount);
+        args[w] = (WorkerArgs){&pool, w};
+    }
+
+    // Workers that fail to start simply have their range stolen by the others
+    int ok = 1;
+    uint8_t *started = calloc(threadCount, 1);
+    for (uint32_t w = 1; w < threadCount; w++) {
+        if (started && pthread_create(&threads[w], NULL, workerThread, &args[w]) == 0) {
+            started[w] = 1;
+        } else {
+            ok = 0;
+        }
+    }
+    runWorker(&pool, 0);
+    for (uint32_t w = 1; w < threadCount; w++) {
+        if (started && started[w]) {
+            pthread_join(threads[w], NULL);
+        }
+    }
+
+    for (uint32_t w = 0; w < threadCount; w++) {
+        pthread_mutex_destroy(&queues[w].lock);
+    }
+    free(started);
+    free(queues);
+    free(threads);
+    free(args);
+    return ok;
+}
@@ -0,0 +1,25 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <stdint.h>
+
+// Work-stealing thread pool
+// Runs tasks 0 .. taskCount-1 on a set of threads. Every worker starts with an
+// equal, contiguous range of tasks and takes them from the front; a worker that
+// runs dry steals the back half of the range of another worker. Uneven tasks
+// (one huge function among thousands of small ones) therefore keep every
+// thread busy without a central queue that all threads fight over.
+
+// A task: context is passed through, worker is the index (0 .. threadCount-1) of
+// the thread running it, so tasks can use per-worker state without locking
+typedef void (*WorkFunction)(void *context, uint32_t task, uint32_t worker);
+
+// Number of threads to use when the caller has no preference (online CPUs)
+uint32_t defaultThreadCount(void);
+
+// Run every task and wait for all of them. The calling thread is worker 0.
+// Returns 1 on success, 0 if threads could not be started (the tasks that
+// could not be handed to a thread are then run on the calling thread)
+int runWorkPool(uint32_t taskCount, uint32_t threadCount, WorkFunction function, void *context);
+
+#endif // WORK_POOL_H
@@ -0,0 +1,312 @@
+// Parser benchmark
+// Generates stress inputs in memory and parses each of them with every parser
+// mode, printing one JSON object per run:
+//   deep-nesting    यदि / चक्र blocks nested 10,000 levels deep
+//   long-expr       one expression of 100,000 terms
+//   wide-file       1,000,000 short statements
+//   many-functions  20,000 कर्म declarations, of which the program calls one
+// Each run is timed from source text to finished tree (lexing included, since
+// the pipelined mode overlaps the two) and happens in a child process of its own,
+// so peak RSS belongs to that run alone and a run that crashes (for instance by
+// running out of C stack) is reported instead of ending the benchmark.
+//
+// Usage: parser_bench [--scale PERCENT] [--input NAME] [--mode NAME] [--threads N]
+#define _POSIX_C_SOURCE 200809L
+#include "../Ast.h"
+#include "../Diagnostics.h"
+#include "../Lexer.h"
+#include "../ParallelParser.h"
+#include "../Parser.h"
+#include "../Pipeline.h"
+#include "../SourceManager.h"
+#include <locale.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <wchar.h>
+
+// Growable wide-character text
+typedef struct {
+    wchar_t *text;
+    size_t length;
+    size_t capacity;
+    size_t utf8Bytes;          // Size of the text as a UTF-8 file
+} Text;
+
+static int appendText(Text *text, const wchar_t *piece) {
+    size_t length = wcslen(piece);
+    if (text->length + length + 1 > text->capacity) {
+        size_t capacity = text->capacity ? text->capacity * 2 : 4096;
+        while (capacity < text->length + length + 1) {
+            capacity *= 2;
+        }
+        wchar_t *grown = realloc(text->text, capacity * sizeof(wchar_t));
+        if (!grown) {
+            fprintf(stderr, "Memory allocation failed for the benchmark input!\n");
+            return 0;
+        }
+        text->text = grown;
+        text->capacity = capacity;
+    }
+    for (size_t i = 0; i < length; i++) {
+        wchar_t c = piece[i];
+        text->utf8Bytes += c < 0x80 ? 1 : c < 0x800 ? 2 : c < 0x10000 ? 3 : 4;
+    }
+    wmemcpy(text->text + text->length, piece, length + 1);
+    text->length += length;
+    return 1;
+}
+
+// यदि and चक्र blocks nested levels deep, alternating
+static int generateDeepNesting(Text *text, uint32_t levels) {
+    int ok = appendText(text, L"पूर्ण क = 1|\n");
+    for (uint32_t i = 0; i < levels && ok; i++) {
+        ok = appendText(text, i % 2 == 0 ? L"यदि (क > 0) {\n" : L"चक्र (क < 2) {\n");
+    }
+    ok = ok && appendText(text, L"क = क + 1|\n");
+    for (uint32_t i = 0; i < levels && ok; i++) {
+        ok = appendText(text, L"}\n");
+    }
+    return ok;
+}
+
+// One assignment whose value has terms operands, mixing every precedence level
+static int generateLongExpression(Text *text, uint32_t terms) {
+    static const wchar_t *const operators[] = {L" + ", L" * ", L" - ", L" / "};
+    wchar_t term[32];
+    int ok = appendText(text, L"पूर्ण क = 1|\nक = 1");
+    for (uint32_t i = 1; i < terms && ok; i++) {
+        swprintf(term, sizeof(term) / sizeof(term[0]), L"%ls%ls%u%ls", operators[i % 4],
+                 i % 7 == 0 ? L"(क + " : L"", i % 1000 + 1, i % 7 == 0 ? L")" : L"");
+        ok = appendText(text, term);
+    }
+    return ok && appendText(text, L"|\n");
+}
+
+// Many short statements of the common kinds
+static int generateWideFile(Text *text, uint32_t statements) {
+    wchar_t line[64];
+    int ok = 1;
+    for (uint32_t i = 0; i < statements && ok; i++) {
+        switch (i % 4) {
+            case 0: swprintf(line, 64, L"पूर्ण क = %u|\n", i); break;
+            case 1: swprintf(line, 64, L"क = क * 2 + %u|\n", i % 100); break;
+            case 2: swprintf(line, 64, L"यदि (क > %u) { लेख(क) }\n", i % 100); break;
+            default: swprintf(line, 64, L"लेख(\"पंक्ति\", क)|\n"); break;
+        }
+        ok = appendText(text, line);
+    }
+    return ok;
+}
+
+// Functions with sizeable bodies, followed by a call of the first one only
+static int generateManyFunctions(Text *text, uint32_t functions) {
+    wchar_t line[64];
+    int ok = 1;
+    for (uint32_t i = 0; i < functions && ok; i++) {
+        swprintf(line, 64, L"कर्म फ%u(पूर्ण क) {\n पूर्ण ख = क * %u + 1|\n", i, i % 100);
+        ok = appendText(text, line) &&
+             appendText(text, L" यदि (ख > 10) { लेख(ख) } अन्यथा { ख = ख + 1| }\n"
+                              L" चक्र (ख < 100) { ख = ख * 2| }\n"
+                              L" चक्र (पूर्ण ग से 1 तक ख) { लेख(\"पंक्ति\", ग + ख) }\n"
+                              L"}\n");
+    }
+    return ok && appendText(text, L"फ0(1)|\n");
+}
+
+typedef struct {
+    const char *name;
+    int (*generate)(Text *text, uint32_t size);
+    uint32_t size;             // At 100% scale
+} BenchInput;
+
+static const BenchInput inputs[] = {
+    {"deep-nesting", generateDeepNesting, 10000},
+    {"long-expr", generateLongExpression, 100000},
+    {"wide-file", generateWideFile, 1000000},
+    {"many-functions", generateManyFunctions, 20000},
+};
+
+typedef enum {
+    MODE_SEQUENTIAL,
+    MODE_PARALLEL,
+    MODE_PIPELINED,
+    MODE_LAZY,                 // Sequential, parsing only the bodies of called functions
+    MODE_COUNT
+} BenchMode;
+
+static const char *const modeNames[MODE_COUNT] = {"sequential", "parallel", "pipelined", "lazy"};
+
+// What a child reports back to the benchmark
+typedef struct {
+    double seconds;
+    uint64_t tokens;
+    uint32_t nodes;
+    uint64_t astBytes;
+    uint32_t errors;
+    long peakRssKb;
+} RunResult;
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+// Parse a registered file with one mode
+static void runMode(BenchMode mode, SourceFileId file, uint32_t threads, RunResult *result) {
+    Ast ast;
+    DiagnosticBuffer diagnostics;
+    initAst(&ast, 64);
+    initDiagnostics(&diagnostics);
+    double start = now();
+    if (mode == MODE_PIPELINED) {
+        PipelineStats stats;
+        parsePipelined(file, &ast, &diagnostics, NULL, &stats);
+        result->tokens = stats.tokens;
+    } else {
+        TokenCollector tokens = tokenizeSourceFile(file);
+        if (mode == MODE_PARALLEL) {
+            parseParallel(&tokens, &ast, &diagnostics, threads);
+        } else {
+            Parser parser;
+            initParser(&parser, &tokens, &ast);
+            parser.diagnostics = &diagnostics;
+            parser.lazyBodies = mode == MODE_LAZY;
+            parseProgram(&parser);
+            freeParser(&parser);
+            if (mode == MODE_LAZY) {
+                expandCalledBodies(&ast, &tokens, &diagnostics);
+            }
+        }
+        result->tokens = tokens.count;
+        freeTokenCollector(&tokens);
+    }
+    result->seconds = now() - start;
+    result->nodes = ast.nodeCount;
+    result->astBytes = astMemoryBytes(&ast);
+    result->errors = diagnostics.errorCount;
+    freeAst(&ast);
+    freeDiagnostics(&diagnostics);
+}
+
+// Run one mode in a child process. Returns 0 on success, the signal that ended
+// the child, or -1 if it failed otherwise
+static int runIsolated(BenchMode mode, const Text *text, const char *name, uint32_t threads,
+                       RunResult *result) {
+    int channel[2];
+    if (pipe(channel) != 0) {
+        perror("pipe");
+        return -1;
+    }
+    fflush(stdout);
+    pid_t child = fork();
+    if (child < 0) {
+        perror("fork");
+        close(channel[0]);
+        close(channel[1]);
+        return -1;
+    }
+    if (child == 0) {
+        close(channel[0]);
+        RunResult own;
+        memset(&own, 0, sizeof(own));
+        // The child's copy of the text is its own to hand to the source manager
+        SourceFileId file = addSourceBuffer(name, text->text, text->length);
+        if (file == NO_FILE) {
+            _exit(1);
+        }
+        runMode(mode, file, threads, &own);
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        own.peakRssKb = usage.ru_maxrss;
+        ssize_t written = write(channel[1], &own, sizeof(own));
+        _exit(written == (ssize_t)sizeof(own) ? 0 : 1);
+    }
+    close(channel[1]);
+    ssize_t received = read(channel[0], result, sizeof(*result));
+    close(channel[0]);
+    int status = 0;
+    waitpid(child, &status, 0);
+    if (WIFSIGNALED(status)) {
+        return WTERMSIG(status);
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 && received == (ssize_t)sizeof(*result) ? 0 : -1;
+}
+
+static void printResult(const char *input, BenchMode mode, const Text *text, int status,
+                        const RunResult *result, int first) {
+    printf("%s  {\"input\": \"%s\", \"mode\": \"%s\", \"sourceBytes\": %zu, ", first ? "" : ",\n",
+           input, modeNames[mode], text->utf8Bytes);
+    if (status != 0) {
+        printf("\"status\": \"%s\", \"signal\": %d}", status > 0 ? "crashed" : "failed", status > 0 ? status : 0);
+        return;
+    }
+    double megabytes = (double)text->utf8Bytes / (1024.0 * 1024.0);
+    printf("\"status\": \"ok\", \"seconds\": %.6f, \"mbPerSecond\": %.2f, \"tokensPerSecond\": %.0f, "
+           "\"tokens\": %llu, \"nodes\": %u, \"astBytes\": %llu, \"astBytesPerSourceByte\": %.3f, "
+           "\"peakRssKb\": %ld, \"errors\": %u}",
+           result->seconds, result->seconds > 0 ? megabytes / result->seconds : 0.0,
+           result->seconds > 0 ? (double)result->tokens / result->seconds : 0.0,
+           (unsigned long long)result->tokens, result->nodes, (unsigned long long)result->astBytes,
+           text->utf8Bytes ? (double)result->astBytes / (double)text->utf8Bytes : 0.0,
+           result->peakRssKb, result->errors);
+}
+
+int main(int argc, char **argv) {
+    if (setlocale(LC_ALL, "C.UTF-8") == NULL) {
+        setlocale(LC_ALL, "");
+    }
+    uint32_t scale = 100;
+    uint32_t threads = 0;
+    const char *onlyInput = NULL;
+    const char *onlyMode = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+            scale = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            onlyInput = argv[++i];
+        } else if (strcmp(argv[i], "--mode") == 0 && i + 1 < argc) {
+            onlyMode = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--scale PERCENT] [--input NAME] [--mode NAME] [--threads N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    printf("[\n");
+    int first = 1;
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+        const BenchInput *input = &inputs[i];
+        if (onlyInput && strcmp(onlyInput, input->name) != 0) {
+            continue;
+        }
+        Text text;
+        memset(&text, 0, sizeof(text));
+        uint64_t size = (uint64_t)input->size * scale / 100;
+        if (!input->generate(&text, size ? (uint32_t)size : 1)) {
+            free(text.text);
+            return 1;
+        }
+        for (int mode = 0; mode < MODE_COUNT; mode++) {
+            if (onlyMode && strcmp(onlyMode, modeNames[mode]) != 0) {
+                continue;
+            }
+            RunResult result;
+            memset(&result, 0, sizeof(result));
+            int status = runIsolated((BenchMode)mode, &text, input->name, threads, &result);
+            printResult(input->name, (BenchMode)mode, &text, status, &result, first);
+            first = 0;
+        }
+        free(text.text);
+    }
+    printf("\n]\n");
+    return 0;
+}
@@ -0,0 +1,987 @@
+// Parser checks
+// The fast parsing paths promise the same result as a plain parseProgram() of
+// the whole file. This program parses random broken variants of a small program
+// both ways and compares the trees (kinds, values and locations) and the syntax
+// errors:
+//   parallel    parseParallel() with several threads
+//   pipelined   parsePipelined() with batches small enough that old tokens
+//               are dropped from its window
+//   querydb     the tree a QueryDb assembles from top-level items
+//   lazy        a parse with lazyBodies followed by expandFunctionBodies(): on
+//               input without syntax errors the tree must be the same, and on
+//               input with them it must report some too (and only then)
+//   incremental the SyntaxTree of the previous input updated by reparseEdit()
+//               for the tokens that changed
+// The AST cache is checked on the base program: the tree loaded back must equal
+// the one saved, and every damaged copy of the file must be refused. Structural
+// queries over it must find exactly the nodes a plain walk counts, also when
+// they find none or a file cannot be read.
+// Small programs then check the stages after parsing against what they should
+// make of them: which declaration each name resolves to and what the resolver
+// reports, which type each operator and call gets and which type errors the
+// checker reports, and what folding leaves of constant expressions and dead
+// यदि / चक्र statements.
+// Each mismatch is printed with the input that caused it; the exit status is 1
+// if there was one.
+//
+// Usage: parser_check [--count N] [--seed N]
+#define _POSIX_C_SOURCE 200809L
+#include "../Ast.h"
+#include "../AstCache.h"
+#include "../AstQuery.h"
+#include "../Diagnostics.h"
+#include "../Fold.h"
+#include "../Interner.h"
+#include "../Lexer.h"
+#include "../ParallelParser.h"
+#include "../Parser.h"
+#include "../Pipeline.h"
+#include "../QueryDb.h"
+#include "../Resolver.h"
+#include "../SourceManager.h"
+#include "../SyntaxTree.h"
+#include "../Traversal.h"
+#include "../TypeChecker.h"
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <wchar.h>
+
+// The program the variants are made from, one piece per entry. Breaking it at
+// the pieces keeps most variants close to valid code, where recovery matters
+static const wchar_t *const basePieces[] = {
+    L"पूर्ण", L"क", L"=", L"1", L"|", L"\n",
+    L"कर्म", L"फ", L"(", L"पूर्ण", L"ख", L")", L"{", L"\n",
+    L"यदि", L"(", L"ख", L">", L"2", L")", L"{", L"लेख", L"(", L"ख", L")", L"|", L"}",
+    L"वा", L"यदि", L"(", L"ख", L"==", L"1", L")", L"{", L"ख", L"+=", L"1", L"|", L"}",
+    L"अन्यथा", L"{", L"ख", L"=", L"ख", L"*", L"2", L"|", L"}", L"\n", L"}", L"\n",
+    L"क", L"=", L"(", L"क", L"+", L"2", L")", L"*", L"3", L"|", L"\n",
+    L"कक्षा", L"व", L"{", L"पूर्ण", L"म", L"=", L"4", L"|", L"}", L"\n",
+    L"चक्र", L"(", L"पूर्ण", L"इ", L"से", L"1", L"तक", L"3", L")", L"{", L"फ", L"(", L"इ", L")", L"|", L"}", L"\n",
+    L"कर्म", L"ग", L"(", L")", L"{", L"चक्र", L"(", L"क", L"<", L"10", L")", L"{", L"क", L"+=", L"1", L"|", L"}", L"}", L"\n",
+    L"लेख", L"(", L"\"अंत\"", L",", L"क", L")", L"|", L"\n",
+};
+
+// Pieces that are inserted: mostly the ones that open, close or end something
+static const wchar_t *const extraPieces[] = {
+    L"|", L"{", L"}", L"(", L")", L"कर्म", L"कक्षा", L"=", L"+", L"यदि", L"अन्यथा", L"क", L"\n",
+};
+
+#define PIECE_COUNT(array) (sizeof(array) / sizeof(array[0]))
+#define MAX_PIECES 256
+
+static uint64_t randomState = 1;
+
+// xorshift64*: the same variants on every machine for a given seed
+static uint32_t nextRandom(uint32_t bound) {
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    return (uint32_t)((randomState * 2685821657736338717ULL) >> 32) % bound;
+}
+
+// Text of a variant of the base program with one to three pieces deleted,
+// duplicated or inserted. Returns a malloc'd string (NULL if out of memory)
+static wchar_t *makeVariant(size_t *length) {
+    const wchar_t *pieces[MAX_PIECES];
+    uint32_t count = (uint32_t)PIECE_COUNT(basePieces);
+    memcpy(pieces, basePieces, sizeof(basePieces));
+    uint32_t edits = 1 + nextRandom(3);
+    for (uint32_t e = 0; e < edits; e++) {
+        uint32_t at = nextRandom(count);
+        switch (nextRandom(3)) {
+            case 0:
+                memmove(&pieces[at], &pieces[at + 1], (count - at - 1) * sizeof(pieces[0]));
+                count--;
+                break;
+            case 1:
+                memmove(&pieces[at + 1], &pieces[at], (count - at) * sizeof(pieces[0]));
+                count++;
+                break;
+            default:
+                memmove(&pieces[at + 1], &pieces[at], (count - at) * sizeof(pieces[0]));
+                pieces[at] = extraPieces[nextRandom((uint32_t)PIECE_COUNT(extraPieces))];
+                count++;
+                break;
+        }
+    }
+    size_t size = 1;
+    for (uint32_t i = 0; i < count; i++) {
+        size += wcslen(pieces[i]) + 1;
+    }
+    wchar_t *text = malloc(size * sizeof(wchar_t));
+    if (!text) {
+        fprintf(stderr, "Memory allocation failed for a test input!\n");
+        return NULL;
+    }
+    size_t n = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        size_t pieceLength = wcslen(pieces[i]);
+        wmemcpy(text + n, pieces[i], pieceLength);
+        n += pieceLength;
+        if (pieces[i][0] != L'\n') {
+            text[n++] = L' ';
+        }
+    }
+    text[n] = L'\0';
+    *length = n;
+    return text;
+}
+
+// Offset of a location in its file (locations of two registrations of the same
+// text differ, their offsets do not)
+static long long locationOffset(SourceLocation location) {
+    return location == NO_LOCATION ? -1 : (long long)(location - sourceFileStart(sourceFileOf(location)));
+}
+
+// The tree below root as printAst() draws it, followed by every node's location
+// in pre-order. Returns a malloc'd string (NULL if out of memory)
+static char *describeTree(const Ast *ast, uint32_t root) {
+    char *text = NULL;
+    size_t size = 0;
+    FILE *out = open_memstream(&text, &size);
+    if (!out) {
+        return NULL;
+    }
+    if (root == 0 || ast->failed) {
+        fputs("(no tree)\n", out);
+        fclose(out);
+        return text;
+    }
+    printAst(ast, root, out);
+    uint32_t *stack = malloc((ast->nodeCount + 1) * sizeof(uint32_t));
+    uint32_t top = 0;
+    if (stack) {
+        stack[top++] = root;
+        while (top > 0) {
+            uint32_t node = stack[--top];
+            fprintf(out, "%lld ", locationOffset(astLocation(ast, node)));
+            uint32_t count = astChildCount(ast, node);
+            for (uint32_t i = count; i > 0 && top < ast->nodeCount; i--) {
+                stack[top++] = astChild(ast, node, i - 1);
+            }
+        }
+        free(stack);
+    }
+    fputc('\n', out);
+    fclose(out);
+    return text;
+}
+
+// The diagnostics, one per line. Returns a malloc'd string (NULL if out of memory)
+static char *describeDiagnostics(const DiagnosticBuffer *diagnostics) {
+    char *text = NULL;
+    size_t size = 0;
+    FILE *out = open_memstream(&text, &size);
+    if (!out) {
+        return NULL;
+    }
+    for (uint32_t i = 0; i < diagnostics->count; i++) {
+        const Diagnostic *entry = &diagnostics->items[i];
+        fprintf(out, "%d %lld %s\n", entry->severity, locationOffset(entry->location), entry->message);
+    }
+    fclose(out);
+    return text;
+}
+
+typedef struct {
+    uint32_t checks;
+    uint32_t failures;
+} CheckStats;
+
+// Compare what a path produced with what the sequential parse did
+static void compare(CheckStats *stats, const char *path, const char *what, const char *expected,
+                    const char *actual, const wchar_t *input) {
+    stats->checks++;
+    if (expected && actual && strcmp(expected, actual) == 0) {
+        return;
+    }
+    stats->failures++;
+    printf("FAIL %s: %s differs from the sequential parse\n--- input\n%ls\n--- sequential\n%s--- %s\n%s\n",
+           path, what, input, expected ? expected : "(out of memory)\n", path,
+           actual ? actual : "(out of memory)\n");
+}
+
+// The incremental tree kept from one input to the next, and the tokens it refers to
+typedef struct {
+    SyntaxTree tree;
+    TokenCollector tokens;
+    int ready;
+} IncrementalState;
+
+// Parse text every way and compare. Returns 0 if out of memory
+static int checkInput(CheckStats *stats, QueryDb *db, IncrementalState *incremental, const wchar_t *text,
+                      size_t length) {
+    wchar_t *buffer = malloc((length + 1) * sizeof(wchar_t));
+    if (!buffer) {
+        fprintf(stderr, "Memory allocation failed for a test input!\n");
+        return 0;
+    }
+    wmemcpy(buffer, text, length + 1);
+    SourceFileId file = addSourceBuffer("check.sk", buffer, length);
+    if (file == NO_FILE) {
+        return 0;
+    }
+    TokenCollector tokens = tokenizeSourceFile(file);
+
+    Ast sequential;
+    DiagnosticBuffer sequentialErrors;
+    initAst(&sequential, 64);
+    initDiagnostics(&sequentialErrors);
+    Parser parser;
+    initParser(&parser, &tokens, &sequential);
+    parser.diagnostics = &sequentialErrors;
+    uint32_t root = parseProgram(&parser);
+    freeParser(&parser);
+    char *expectedTree = describeTree(&sequential, root);
+    char *expectedErrors = describeDiagnostics(&sequentialErrors);
+
+    Ast parallel;
+    DiagnosticBuffer parallelErrors;
+    initAst(&parallel, 64);
+    initDiagnostics(&parallelErrors);
+    root = parseParallel(&tokens, &parallel, &parallelErrors, 4);
+    char *tree = describeTree(&parallel, root);
+    char *errors = describeDiagnostics(&parallelErrors);
+    compare(stats, "parallel", "tree", expectedTree, tree, text);
+    compare(stats, "parallel", "syntax errors", expectedErrors, errors, text);
+    free(tree);
+    free(errors);
+    freeAst(&parallel);
+    freeDiagnostics(&parallelErrors);
+
+    Ast pipelined;
+    DiagnosticBuffer pipelinedErrors;
+    initAst(&pipelined, 64);
+    initDiagnostics(&pipelinedErrors);
+    PipelineOptions options = {8, 2};
+    root = parsePipelined(file, &pipelined, &pipelinedErrors, &options, NULL);
+    tree = describeTree(&pipelined, root);
+    errors = describeDiagnostics(&pipelinedErrors);
+    compare(stats, "pipelined", "tree", expectedTree, tree, text);
+    compare(stats, "pipelined", "syntax errors", expectedErrors, errors, text);
+    free(tree);
+    free(errors);
+    freeAst(&pipelined);
+    freeDiagnostics(&pipelinedErrors);
+
+    Ast lazy;
+    DiagnosticBuffer lazyErrors;
+    initAst(&lazy, 64);
+    initDiagnostics(&lazyErrors);
+    initParser(&parser, &tokens, &lazy);
+    parser.diagnostics = &lazyErrors;
+    parser.lazyBodies = 1;
+    root = parseProgram(&parser);
+    freeParser(&parser);
+    expandFunctionBodies(&lazy, &tokens, &lazyErrors);
+    compare(stats, "lazy", "whether there are syntax errors", sequentialErrors.errorCount > 0 ? "yes" : "no",
+            lazyErrors.errorCount > 0 ? "yes" : "no", text);
+    if (sequentialErrors.errorCount == 0) {
+        tree = describeTree(&lazy, root);
+        compare(stats, "lazy", "tree", expectedTree, tree, text);
+        free(tree);
+    }
+    freeAst(&lazy);
+    freeDiagnostics(&lazyErrors);
+
+    QueryFileId id = setQueryFileText(db, "check.sk", text, length);
+    const Ast *assembled = id != NO_QUERY_FILE ? queryTree(db, id) : NULL;
+    tree = assembled ? describeTree(assembled, assembled->root) : NULL;
+    compare(stats, "querydb", "tree", expectedTree, tree, text);
+    free(tree);
+
+    // Edit the previous input's tree into this one; the tree keeps the tokens
+    if (incremental->ready) {
+        TokenEdit edit;
+        if (findTokenEdit(&incremental->tokens, &tokens, &edit)) {
+            reparseEdit(&incremental->tree, &tokens, &edit, NULL);
+        } else {
+            incremental->tree.tokens = &tokens;  // Only the spacing changed
+        }
+        Ast flat;
+        initAst(&flat, 64);
+        root = syntaxTreeToAst(&incremental->tree, &flat);
+        tree = flat.failed ? NULL : describeTree(&flat, root);
+        compare(stats, "incremental", "tree", expectedTree, tree, text);
+        free(tree);
+        freeAst(&flat);
+        freeTokenCollector(&incremental->tokens);
+    } else {
+        incremental->ready = initSyntaxTree(&incremental->tree, &tokens, NULL);
+    }
+    if (incremental->ready) {
+        incremental->tokens = tokens;
+        incremental->tree.tokens = &incremental->tokens;
+    } else {
+        freeSyntaxTree(&incremental->tree);
+        freeTokenCollector(&tokens);
+    }
+
+    free(expectedTree);
+    free(expectedErrors);
+    freeAst(&sequential);
+    freeDiagnostics(&sequentialErrors);
+    return 1;
+}
+
+// Text of the base program. Returns a malloc'd string (NULL if out of memory)
+static wchar_t *baseProgram(size_t *length) {
+    size_t size = 1;
+    for (size_t i = 0; i < PIECE_COUNT(basePieces); i++) {
+        size += wcslen(basePieces[i]) + 1;
+    }
+    wchar_t *text = malloc(size * sizeof(wchar_t));
+    if (!text) {
+        fprintf(stderr, "Memory allocation failed for a test input!\n");
+        return NULL;
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < PIECE_COUNT(basePieces); i++) {
+        n += (size_t)swprintf(text + n, size - n, L"%ls ", basePieces[i]);
+    }
+    *length = n;
+    return text;
+}
+
+// Overwrite bytes [at, at + count) of a file. Returns 1 on success
+static int damageFile(const char *path, long at, size_t count) {
+    FILE *file = fopen(path, "r+b");
+    if (!file) {
+        return 0;
+    }
+    unsigned char junk[256];
+    for (size_t i = 0; i < count && i < sizeof(junk); i++) {
+        junk[i] = (unsigned char)(0xA5 ^ (i * 37));
+    }
+    int ok = fseek(file, at, SEEK_SET) == 0 && fwrite(junk, 1, count, file) == count;
+    return (fclose(file) == 0) && ok;
+}
+
+// Save the base program's tree, load it back, then damage the file in many
+// places. Returns 0 if the cache could not be written at all
+static int checkCache(CheckStats *stats) {
+    size_t length;
+    wchar_t *text = baseProgram(&length);
+    if (!text) {
+        return 0;
+    }
+    uint64_t hash = hashSource(text, length);
+    SourceFileId file = addSourceBuffer("cache.sk", text, length);
+    if (file == NO_FILE) {
+        return 0;
+    }
+    TokenCollector tokens = tokenizeSourceFile(file);
+    Ast ast;
+    initAst(&ast, 64);
+    Parser parser;
+    initParser(&parser, &tokens, &ast);
+    uint32_t root = parseProgram(&parser);
+    freeParser(&parser);
+    char *expected = describeTree(&ast, root);
+
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/parser_check%ld.skast", (long)getpid());
+    int ok = saveAstCache(path, &ast, hash, (uint32_t)length, sourceFileStart(file));
+    FILE *saved = ok ? fopen(path, "rb") : NULL;
+    long size = saved && fseek(saved, 0, SEEK_END) == 0 ? ftell(saved) : 0;
+    unsigned char *original = size > 0 ? malloc((size_t)size) : NULL;
+    ok = original && fseek(saved, 0, SEEK_SET) == 0 && fread(original, 1, (size_t)size, saved) == (size_t)size;
+    if (saved) {
+        fclose(saved);
+    }
+    if (ok) {
+        Ast loaded;
+        AstCache cache;
+        if (loadAstCache(path, hash, (uint32_t)length, sourceFileStart(file), &loaded, &cache)) {
+            char *tree = describeTree(&loaded, loaded.root);
+            compare(stats, "cache", "tree", expected, tree, text);
+            free(tree);
+            closeAstCache(&cache);
+        } else {
+            stats->checks++;
+            stats->failures++;
+            printf("FAIL cache: a freshly saved file was refused\n");
+        }
+
+        // Every 80-byte stretch of the file, damaged in turn
+        for (long at = 0; at < size; at += 40) {
+            FILE *restore = fopen(path, "wb");
+            int written = restore && fwrite(original, 1, (size_t)size, restore) == (size_t)size;
+            if (restore) {
+                fclose(restore);
+            }
+            size_t count = (size_t)(size - at < 80 ? size - at : 80);
+            if (!written || !damageFile(path, at, count)) {
+                ok = 0;
+                break;
+            }
+            stats->checks++;
+            if (loadAstCache(path, hash, (uint32_t)length, sourceFileStart(file), &loaded, &cache)) {
+                stats->failures++;
+                printf("FAIL cache: a file damaged at bytes %ld-%ld was loaded\n", at, at + (long)count);
+                closeAstCache(&cache);
+            }
+        }
+    }
+    if (!ok) {
+        fprintf(stderr, "Error: Could not write the AST cache %s\n", path);
+    }
+    remove(path);
+    free(original);
+    free(expected);
+    freeAst(&ast);
+    freeTokenCollector(&tokens);
+    return ok;
+}
+
+// Compare a count found one way with the count found another
+static void compareCount(CheckStats *stats, const char *path, const char *what, uint32_t expected,
+                         uint32_t actual) {
+    stats->checks++;
+    if (expected != actual) {
+        stats->failures++;
+        printf("FAIL %s: %s: %u instead of %u\n", path, what, actual, expected);
+    }
+}
+
+// Query the base program for its print statements and for a call that is not
+// there, in memory and through queryFiles() (with a file that does not exist).
+// Returns 0 if out of memory or the program cannot be written
+static int checkQueries(CheckStats *stats) {
+    size_t length;
+    wchar_t *text = baseProgram(&length);
+    if (!text) {
+        return 0;
+    }
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/parser_check%ld.sk", (long)getpid());
+    FILE *out = fopen(path, "w");
+    int ok = out && fprintf(out, "%ls", text) >= 0;
+    ok = out && (fclose(out) == 0) && ok;
+    SourceFileId file = addSourceBuffer("query.sk", text, length);
+    if (!ok || file == NO_FILE) {
+        fprintf(stderr, "Error: Could not write %s\n", path);
+        remove(path);
+        return 0;
+    }
+    TokenCollector tokens = tokenizeSourceFile(file);
+    Ast ast;
+    initAst(&ast, 64);
+    Parser parser;
+    initParser(&parser, &tokens, &ast);
+    uint32_t root = parseProgram(&parser);
+    freeParser(&parser);
+
+    AstOrder order;
+    AstIndex index;
+    AstQuery prints, missing;
+    memset(&index, 0, sizeof(index));
+    memset(&prints, 0, sizeof(prints));
+    memset(&missing, 0, sizeof(missing));
+    ok = buildAstOrder(&ast, root, &order) && buildAstIndex(&ast, &order, &index) &&
+         compileAstQuery(&prints, L"(PrintStatement)") && compileAstQuery(&missing, L"(Call \"नहीं\")");
+    if (ok) {
+        uint32_t printCount = 0;
+        for (uint32_t i = 0; i < order.count; i++) {
+            printCount += ast.nodes[order.preorder[i]].kind == AST_PRINT;
+        }
+        uint32_t *matches = NULL;
+        compareCount(stats, "query", "print statements found", printCount,
+                     runAstQuery(&prints, &ast, &index, &matches));
+        free(matches);
+        compareCount(stats, "query", "calls of a missing function found", 0,
+                     runAstQuery(&missing, &ast, &index, &matches));
+        free(matches);
+
+        const char *paths[] = {"/nonexistent/parser_check.sk", path};
+        AstQueryHits hits;
+        ok = queryFiles(&prints, paths, 2, 2, &hits);
+        if (ok) {
+            compareCount(stats, "queryFiles", "print statements found", printCount, hits.count);
+            compareCount(stats, "queryFiles", "files that failed", 1, hits.filesFailed);
+            freeAstQueryHits(&hits);
+        }
+        ok = ok && queryFiles(&missing, paths, 2, 2, &hits);
+        if (ok) {
+            compareCount(stats, "queryFiles", "calls of a missing function found", 0, hits.count);
+            freeAstQueryHits(&hits);
+        }
+        freeAstOrder(&order);
+    }
+    freeAstQuery(&prints);
+    freeAstQuery(&missing);
+    freeAstIndex(&index);
+    freeAst(&ast);
+    freeTokenCollector(&tokens);
+    remove(path);
+    return ok;
+}
+
+// A small program parsed for the checks of the later stages
+typedef struct {
+    TokenCollector tokens;
+    Ast ast;
+    AstOrder order;
+} StageInput;
+
+// Parse text, which must be free of syntax errors, and order its tree. Returns 0
+// if it does not parse or out of memory (nothing is left to free then)
+static int parseStageInput(StageInput *input, const wchar_t *text) {
+    size_t length = wcslen(text);
+    wchar_t *buffer = malloc((length + 1) * sizeof(wchar_t));
+    if (!buffer) {
+        fprintf(stderr, "Memory allocation failed for a test input!\n");
+        return 0;
+    }
+    wmemcpy(buffer, text, length + 1);
+    SourceFileId file = addSourceBuffer("stage.sk", buffer, length);
+    if (file == NO_FILE) {
+        return 0;
+    }
+    input->tokens = tokenizeSourceFile(file);
+    initAst(&input->ast, 64);
+    DiagnosticBuffer errors;
+    initDiagnostics(&errors);
+    Parser parser;
+    initParser(&parser, &input->tokens, &input->ast);
+    parser.diagnostics = &errors;
+    uint32_t root = parseProgram(&parser);
+    freeParser(&parser);
+    int ok = errors.errorCount == 0 && !input->ast.failed && buildAstOrder(&input->ast, root, &input->order);
+    if (errors.errorCount > 0) {
+        printf("Error: A stage check does not parse:\n%ls\n", text);
+        printDiagnostics(&errors, stdout);
+    }
+    freeDiagnostics(&errors);
+    if (!ok) {
+        freeAst(&input->ast);
+        freeTokenCollector(&input->tokens);
+    }
+    return ok;
+}
+
+static void freeStageInput(StageInput *input) {
+    freeAstOrder(&input->order);
+    freeAst(&input->ast);
+    freeTokenCollector(&input->tokens);
+}
+
+// Compare what a stage made of a program with what it should have
+static void compareStage(CheckStats *stats, const char *stage, const wchar_t *text, const char *expected,
+                         const char *actual) {
+    stats->checks++;
+    if (actual && strcmp(expected, actual) == 0) {
+        return;
+    }
+    stats->failures++;
+    printf("FAIL %s\n--- input\n%ls\n--- expected\n%s--- actual\n%s\n", stage, text, expected,
+           actual ? actual : "(out of memory)\n");
+}
+
+// Line and column of a node, as "line:column"
+static void printPosition(const Ast *ast, uint32_t node, FILE *out) {
+    DecodedLocation where;
+    if (node != 0 && decodeLocation(astLocation(ast, node), &where)) {
+        fprintf(out, "%u:%u", where.line, where.column);
+    } else {
+        fputs("none", out);
+    }
+}
+
+// Every declaration and use of a name in pre-order: a variable with its storage
+// and slot, a use with the position of its declaration. Then the diagnostics.
+// Returns a malloc'd string (NULL if out of memory)
+static char *describeResolution(const StageInput *input, const Resolution *resolution,
+                                const DiagnosticBuffer *diagnostics) {
+    static const char *const storageNames[] = {"none", "global", "local", "field"};
+    const Ast *ast = &input->ast;
+    char *text = NULL;
+    size_t size = 0;
+    FILE *out = open_memstream(&text, &size);
+    if (!out) {
+        return NULL;
+    }
+    for (uint32_t i = 0; i < input->order.count; i++) {
+        uint32_t node = input->order.preorder[i];
+        const AstNode *n = &ast->nodes[node];
+        if (n->kind == AST_VAR_DECL) {
+            fprintf(out, "%ls ", symbolText(astSymbol(ast, n->a)));
+            printPosition(ast, node, out);
+            fprintf(out, " %s %u", storageNames[resolution->storage[node]], slotOf(resolution, node));
+            if (n->c) {
+                fputs(" of ", out);
+                printPosition(ast, declarationOf(resolution, node), out);
+            }
+            fputc('\n', out);
+        } else if (n->kind == AST_IDENT || n->kind == AST_CALL) {
+            fprintf(out, "%ls ", symbolText(astSymbol(ast, n->kind == AST_IDENT ? n->a : n->c)));
+            printPosition(ast, node, out);
+            fputs(" -> ", out);
+            printPosition(ast, declarationOf(resolution, node), out);
+            fputc('\n', out);
+        }
+    }
+    printDiagnostics(diagnostics, out);
+    fclose(out);
+    return text;
+}
+
+// A program and what a stage should make of it
+typedef struct {
+    const wchar_t *text;
+    const char *expected;
+} StageCase;
+
+// Scopes: shadowing, use before declaration, function, class and loop scopes,
+// slots reused by later blocks, and the errors for names that do not resolve
+static const StageCase resolverCases[] = {
+    {L"पूर्ण क = 1|\nकर्म फ(पूर्ण क) { लेख(क)| }\nलेख(क)|\n",
+     "क 1:1 global 0\n"
+     "क 2:8 local 0\n"
+     "क 2:23 -> 2:8\n"
+     "क 3:5 -> 1:1\n"},
+    {L"पूर्ण क = 1|\nयदि (क > 0) { पूर्ण क = 2| लेख(क)| }\nलेख(क)|\n",
+     "क 1:1 global 0\n"
+     "क 2:6 -> 1:1\n"
+     "क 2:15 global 1\n"
+     "क 2:32 -> 2:15\n"
+     "क 3:5 -> 1:1\n"},
+    {L"लेख(ख)|\nपूर्ण ख = ख + 1|\nफ(ख)|\nकर्म फ(पूर्ण अ) { लेख(अ)| }\n",
+     "ख 1:5 -> none\n"
+     "ख 2:1 global 0\n"
+     "ख 2:11 -> none\n"
+     "फ 3:1 -> 4:1\n"
+     "ख 3:3 -> 2:1\n"
+     "अ 4:8 local 0\n"
+     "अ 4:23 -> 4:8\n"
+     "stage.sk:1:5: error: Undeclared name 'ख'\n"
+     "stage.sk:2:11: error: Undeclared name 'ख'\n"},
+    {L"कर्म फ() { पूर्ण अ = 1| }\nलेख(अ)|\n",
+     "अ 1:12 local 0\n"
+     "अ 2:5 -> none\n"
+     "stage.sk:2:5: error: Undeclared name 'अ'\n"},
+    {L"कर्म बाहर(पूर्ण अ) {\n    कर्म भीतर() { लेख(अ)| }\n    भीतर()|\n}\n",
+     "अ 1:11 local 0\n"
+     "अ 2:23 -> none\n"
+     "भीतर 3:5 -> 2:5\n"
+     "stage.sk:2:23: error: Variable of an enclosing function or class cannot be used here 'अ'\n"},
+    {L"कक्षा व { पूर्ण म = 1| पूर्ण प = म + 1| }\nव ओ|\nलेख(म)|\n",
+     "म 1:11 field 0\n"
+     "प 1:24 field 1\n"
+     "म 1:34 -> 1:11\n"
+     "ओ 2:1 global 0 of 1:1\n"
+     "म 3:5 -> none\n"
+     "stage.sk:3:5: error: Undeclared name 'म'\n"},
+    {L"चक्र (पूर्ण इ से 1 तक 3) { लेख(इ)| }\nलेख(इ)|\n",
+     "इ 1:7 global 0\n"
+     "इ 1:32 -> 1:7\n"
+     "इ 2:5 -> none\n"
+     "stage.sk:2:5: error: Undeclared name 'इ'\n"},
+    {L"कर्म फ(पूर्ण अ) { यदि (अ > 0) { पूर्ण ब = 1| } यदि (अ < 0) { पूर्ण स = 2| } पूर्ण द = 3| }\n",
+     "अ 1:8 local 0\n"
+     "अ 1:24 -> 1:8\n"
+     "ब 1:33 local 1\n"
+     "अ 1:53 -> 1:8\n"
+     "स 1:62 local 1\n"
+     "द 1:77 local 1\n"},
+    {L"पूर्ण क = 1|\nपूर्ण क = 2|\nक(3)|\nकर्म फ() { }\nफ = 4|\nवर्ग ओ|\n",
+     "क 1:1 global 0\n"
+     "क 2:1 global 1\n"
+     "क 3:1 -> none\n"
+     "फ 5:1 -> none\n"
+     "ओ 6:1 global 2 of none\n"
+     "stage.sk:2:1: error: Name is already declared in this scope 'क'\n"
+     "stage.sk:3:1: error: Not a function 'क'\n"
+     "stage.sk:5:1: error: Not a variable 'फ'\n"
+     "stage.sk:6:1: error: Unknown class 'वर्ग'\n"},
+};
+
+// Resolve each case and compare. Returns 0 if out of memory
+static int checkResolver(CheckStats *stats) {
+    for (size_t i = 0; i < PIECE_COUNT(resolverCases); i++) {
+        StageInput input;
+        if (!parseStageInput(&input, resolverCases[i].text)) {
+            return 0;
+        }
+        Resolution resolution;
+        DiagnosticBuffer diagnostics;
+        initDiagnostics(&diagnostics);
+        resolveNames(&input.ast, &input.order, &resolution, &diagnostics);
+        char *actual = describeResolution(&input, &resolution, &diagnostics);
+        compareStage(stats, "resolver", resolverCases[i].text, resolverCases[i].expected, actual);
+        free(actual);
+        freeResolution(&resolution);
+        freeDiagnostics(&diagnostics);
+        freeStageInput(&input);
+    }
+    return 1;
+}
+
+// Whether the tree is well typed, the type of every operator and call in
+// pre-order, then the diagnostics. Returns a malloc'd string (NULL if out of memory)
+static char *describeTypes(const StageInput *input, const TypeCheck *check, int wellTyped,
+                           const DiagnosticBuffer *diagnostics) {
+    const Ast *ast = &input->ast;
+    char *text = NULL;
+    size_t size = 0;
+    FILE *out = open_memstream(&text, &size);
+    if (!out) {
+        return NULL;
+    }
+    fputs(wellTyped ? "well typed\n" : "ill typed\n", out);
+    for (uint32_t i = 0; i < input->order.count; i++) {
+        uint32_t node = input->order.preorder[i];
+        uint8_t kind = ast->nodes[node].kind;
+        if (kind == AST_UNARY || kind == AST_BINARY || kind == AST_TERNARY || kind == AST_CALL) {
+            fprintf(out, "%s ", astLayouts[kind].name);
+            printPosition(ast, node, out);
+            fputc(' ', out);
+            printType(&check->table, typeOfNode(check, node), out);
+            fputc('\n', out);
+        }
+    }
+    printDiagnostics(diagnostics, out);
+    fclose(out);
+    return text;
+}
+
+// Well typed programs (+ on strings, comparisons of characters, calls, classes,
+// ?:) and one or more errors of each kind: mixed operands, arithmetic on
+// strings, wrong argument counts and types, non-boolean conditions, ?: branches
+// that differ, assignments and initializers of the wrong type, calls used as values
+static const StageCase typeCases[] = {
+    {L"पूर्ण क = 1 + 2 * 3|\nलेख(\"अ\" + \"ब\", क > 2 && क < 9, 'क' < 'ख', -क)|\n",
+     "well typed\n"
+     "BinaryExpression 1:13 पूर्ण\n"
+     "BinaryExpression 1:17 पूर्ण\n"
+     "BinaryExpression 2:9 <string>\n"
+     "BinaryExpression 2:22 सत्य/असत्य\n"
+     "BinaryExpression 2:18 सत्य/असत्य\n"
+     "BinaryExpression 2:27 सत्य/असत्य\n"
+     "BinaryExpression 2:36 सत्य/असत्य\n"
+     "UnaryExpression 2:43 पूर्ण\n"},
+    {L"कर्म फ(पूर्ण अ, पूर्ण ब) { लेख(अ + ब)| }\nफ(1 + 2, 3)|\n",
+     "well typed\n"
+     "BinaryExpression 1:34 पूर्ण\n"
+     "Call 2:1 <void>\n"
+     "BinaryExpression 2:5 पूर्ण\n"},
+    {L"कक्षा व { पूर्ण म = 1| }\nव ओ|\nपूर्ण क = सत्य ? 1 : 2|\nलेख(न (क == 1) ? \"हाँ\" : \"ना\")|\n",
+     "well typed\n"
+     "Conditional 3:16 पूर्ण\n"
+     "Conditional 4:16 <string>\n"
+     "UnaryExpression 4:5 सत्य/असत्य\n"
+     "BinaryExpression 4:10 सत्य/असत्य\n"},
+    {L"पूर्ण क = \"अ\" + 1|\nलेख(\"अ\" * 2, 1 == \"अ\", \"अ\" < \"ब\")|\n",
+     "ill typed\n"
+     "BinaryExpression 1:15 पूर्ण\n"
+     "BinaryExpression 2:9 पूर्ण\n"
+     "BinaryExpression 2:16 सत्य/असत्य\n"
+     "BinaryExpression 2:28 सत्य/असत्य\n"
+     "stage.sk:1:11: error: Operands of '+' must both be पूर्ण or both be strings\n"
+     "stage.sk:2:5: error: Operands of an arithmetic operator must be पूर्ण\n"
+     "stage.sk:2:14: error: Compared values must have the same type\n"
+     "stage.sk:2:24: error: Comparison needs two पूर्ण or two characters\n"},
+    {L"कर्म फ(पूर्ण अ, पूर्ण ब) { }\nफ(1)|\nफ(1, 2, 3)|\nफ(\"अ\", 2)|\n",
+     "ill typed\n"
+     "Call 2:1 <void>\n"
+     "Call 3:1 <void>\n"
+     "Call 4:1 <void>\n"
+     "stage.sk:2:1: error: Wrong number of arguments 'फ'\n"
+     "stage.sk:3:1: error: Wrong number of arguments 'फ'\n"
+     "stage.sk:4:3: error: Argument does not match the parameter's type\n"},
+    {L"यदि (1) { }\nचक्र (\"अ\") { }\nचक्र (पूर्ण इ से 1 तक \"अ\") { }\nलेख(सत्य ? 1 : \"ना\", 1 ? 2 : 3)|\n",
+     "ill typed\n"
+     "Conditional 4:10 <error>\n"
+     "Conditional 4:24 पूर्ण\n"
+     "stage.sk:1:6: error: Condition must be boolean\n"
+     "stage.sk:2:7: error: Condition must be boolean\n"
+     "stage.sk:3:23: error: Loop bounds must be पूर्ण\n"
+     "stage.sk:4:16: error: Both branches of '?' must have the same type\n"
+     "stage.sk:4:22: error: Condition must be boolean\n"},
+    {L"पूर्ण क = 1|\nक = \"अ\"|\nक += सत्य|\nकर्म फ() { }\nपूर्ण ख = फ()|\nलेख(न क, -\"अ\", क && सत्य)|\n",
+     "ill typed\n"
+     "Call 5:11 <void>\n"
+     "UnaryExpression 6:5 सत्य/असत्य\n"
+     "UnaryExpression 6:10 पूर्ण\n"
+     "BinaryExpression 6:18 सत्य/असत्य\n"
+     "stage.sk:2:5: error: Assigned value does not match the variable's type\n"
+     "stage.sk:3:1: error: Compound assignment needs a पूर्ण variable and value\n"
+     "stage.sk:5:11: error: Initializer does not match the variable's type\n"
+     "stage.sk:6:7: error: Operand of न must be boolean\n"
+     "stage.sk:6:11: error: Operand of '-' must be पूर्ण\n"
+     "stage.sk:6:16: error: Operands of '&&' must be boolean\n"},
+};
+
+// Resolve and type check each case and compare. Returns 0 if out of memory
+static int checkTypeCases(CheckStats *stats) {
+    for (size_t i = 0; i < PIECE_COUNT(typeCases); i++) {
+        StageInput input;
+        if (!parseStageInput(&input, typeCases[i].text)) {
+            return 0;
+        }
+        Resolution resolution;
+        TypeCheck check;
+        DiagnosticBuffer diagnostics;
+        initDiagnostics(&diagnostics);
+        char *actual = NULL;
+        if (resolveNames(&input.ast, &input.order, &resolution, &diagnostics)) {
+            int wellTyped = checkTypes(&input.ast, &input.order, &resolution, &check, &diagnostics);
+            actual = describeTypes(&input, &check, wellTyped, &diagnostics);
+            freeTypeCheck(&check);
+        } else {
+            printf("Error: A type check case does not resolve:\n%ls\n", typeCases[i].text);
+        }
+        compareStage(stats, "types", typeCases[i].text, typeCases[i].expected, actual);
+        free(actual);
+        freeResolution(&resolution);
+        freeDiagnostics(&diagnostics);
+        freeStageInput(&input);
+    }
+    return 1;
+}
+
+// What folding counted, then the folded tree. Returns a malloc'd string (NULL
+// if out of memory)
+static char *describeFolding(const StageInput *input, const FoldStats *folded) {
+    char *text = NULL;
+    size_t size = 0;
+    FILE *out = open_memstream(&text, &size);
+    if (!out) {
+        return NULL;
+    }
+    fprintf(out, "%u expressions, %u branches, %u removed\n", folded->expressions, folded->branches,
+            folded->removed);
+    printAst(&input->ast, input->ast.root, out);
+    fclose(out);
+    return text;
+}
+
+// Literal operands of every type (digits in either script, division by zero
+// left alone), यदि and चक्र statements decided at compile time, one of them in an
+// अन्यथा यदि chain, a block whose statements all fold away, and ?:
+static const StageCase foldCases[] = {
+    {L"लेख(५ + ३, 2 * (3 - 10), 7 / 2, 1 / 0, -(4), न सत्य, 'क' < 'ख', \"अ\" == \"अ\", सत्य && असत्य)|\n",
+     "9 expressions, 0 branches, 0 removed\n"
+     "Program\n"
+     "└── PrintStatement\n"
+     "    ├── Number(8)\n"
+     "    ├── Number(-14)\n"
+     "    ├── Number(3)\n"
+     "    ├── BinaryExpression(/)\n"
+     "    │   ├── Number(1)\n"
+     "    │   └── Number(0)\n"
+     "    ├── Number(-4)\n"
+     "    ├── Boolean(असत्य)\n"
+     "    ├── Boolean(सत्य)\n"
+     "    ├── Boolean(सत्य)\n"
+     "    └── Boolean(असत्य)\n"},
+    {L"पूर्ण क = 1|\nयदि (सत्य) { लेख(1)| } अन्यथा { लेख(2)| }\nयदि (असत्य) { लेख(3)| }\n"
+     L"यदि (1 > 2) { लेख(4)| } अन्यथा यदि (क > 0) { लेख(5)| }\n",
+     "1 expressions, 3 branches, 1 removed\n"
+     "Program\n"
+     "├── VariableDeclaration(पूर्ण क)\n"
+     "│   └── Number(1)\n"
+     "├── Block\n"
+     "│   └── PrintStatement\n"
+     "│       └── Number(1)\n"
+     "└── IfStatement\n"
+     "    ├── BinaryExpression(>)\n"
+     "    │   ├── Identifier(क)\n"
+     "    │   └── Number(0)\n"
+     "    └── Block\n"
+     "        └── PrintStatement\n"
+     "            └── Number(5)\n"},
+    {L"चक्र (असत्य) { लेख(1)| }\nचक्र (1 < 2 && असत्य) { }\nलेख(2)|\n",
+     "2 expressions, 2 branches, 2 removed\n"
+     "Program\n"
+     "└── PrintStatement\n"
+     "    └── Number(2)\n"},
+    {L"कर्म फ() { यदि (असत्य) { लेख(1)| } चक्र (2 < 1) { लेख(2)| } }\nयदि (सत्य) { यदि (असत्य) { लेख(3)| } }\nफ()|\n",
+     "1 expressions, 4 branches, 3 removed\n"
+     "Program\n"
+     "├── FunctionDeclaration(फ)\n"
+     "│   ├── Parameters\n"
+     "│   └── Block\n"
+     "├── Block\n"
+     "└── ExpressionStatement\n"
+     "    └── Call(फ)\n"},
+    {L"पूर्ण क = सत्य ? 1 + 1 : 3|\nपूर्ण ख = 2 > 3 ? क : 4|\n",
+     "2 expressions, 2 branches, 0 removed\n"
+     "Program\n"
+     "├── VariableDeclaration(पूर्ण क)\n"
+     "│   └── Number(2)\n"
+     "└── VariableDeclaration(पूर्ण ख)\n"
+     "    └── Number(4)\n"},
+};
+
+// Fold each case and compare. Returns 0 if out of memory
+static int checkFolding(CheckStats *stats) {
+    for (size_t i = 0; i < PIECE_COUNT(foldCases); i++) {
+        StageInput input;
+        if (!parseStageInput(&input, foldCases[i].text)) {
+            return 0;
+        }
+        FoldStats folded;
+        foldConstants(&input.ast, &input.order, &folded);
+        char *actual = describeFolding(&input, &folded);
+        compareStage(stats, "fold", foldCases[i].text, foldCases[i].expected, actual);
+        free(actual);
+        freeStageInput(&input);
+    }
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    if (setlocale(LC_ALL, "C.UTF-8") == NULL) {
+        setlocale(LC_ALL, "");
+    }
+    uint32_t count = 2000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+            count = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            randomState = strtoull(argv[++i], NULL, 10) | 1;
+        } else {
+            fprintf(stderr, "Usage: %s [--count N] [--seed N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // Inputs that once parsed differently, then the random variants
+    static const wchar_t *const known[] = {
+        L"पूर्ण ह = 3\nकर्म फ(पूर्ण ख) { लेख(ख)| }\nफ(ह)|\n",
+        L"क = (1 +\nकक्षा व {\n}\n",
+        L"कर्म बाहर(पूर्ण अ) {\n कर्म भीतर(पूर्ण ब) { लेख(ब)| }\n भीतर(अ + 1)|\n}\nबाहर(1)|\n",  // Nested functions
+        L"लेख(\"क\")|\nलेख(\"ख\")|\nलेख(\"ग\")|\nलेख(\"घ\")|\nलेख(\"ङ\")|\n",  // No numbers
+    };
+    CheckStats stats = {0, 0};
+    QueryDb db;
+    initQueryDb(&db);
+    IncrementalState incremental = {.ready = 0};
+    int ok = 1;
+    for (size_t i = 0; i < PIECE_COUNT(known) && ok; i++) {
+        ok = checkInput(&stats, &db, &incremental, known[i], wcslen(known[i]));
+    }
+    for (uint32_t i = 0; i < count && ok; i++) {
+        size_t length;
+        wchar_t *text = makeVariant(&length);
+        ok = text && checkInput(&stats, &db, &incremental, text, length);
+        free(text);
+    }
+    freeQueryDb(&db);
+    if (incremental.ready) {
+        freeSyntaxTree(&incremental.tree);
+        freeTokenCollector(&incremental.tokens);
+    }
+    ok = ok && checkCache(&stats);
+    ok = ok && checkQueries(&stats);
+    ok = ok && checkResolver(&stats);
+    ok = ok && checkTypeCases(&stats);
+    ok = ok && checkFolding(&stats);
+
+    printf("parser_check: %u of %u comparisons failed\n", stats.failures, stats.checks);
+    return ok && stats.failures == 0 ? 0 : 1;
+}
@@ -16,7 +16,7 @@ const wchar_t *boolean_literals[] = {
 // Operators supported by the language
 const wchar_t *operators[] = {
     L"+", L"-", L"*", L"/", L"=", L">", L"<", L">=", L"<=", L"==", L"!=", L"&&", L";", L"!",
-    L"?", L"+=", L"-=", L"*=", L"/="
+    L"?", L"+=", L"-=", L"*=", L"/=", NULL
 };
 
 // Special symbols used in the language
@@ -35,6 +35,32 @@ int isKeyword(const wchar_t *word) {
     return 0;
 }
 
+// Find a word in one of the NULL-terminated tables
+// Returns its index, or -1 if it isn't in the table
+static int tableIndex(const wchar_t **table, const wchar_t *word) {
+    for (int i = 0; table[i] != NULL; i++) {
+        if (wcscmp(word, table[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Position of a keyword in keywords[] (see KeywordId), -1 if not a keyword
+int keywordIndex(const wchar_t *word) {
+    return tableIndex(keywords, word);
+}
+
+// Position of an operator in operators[] (see OperatorId), -1 if unknown
+int operatorIndex(const wchar_t *op) {
+    return tableIndex(operators, op);
+}
+
+// Position of a special symbol in special_symbols[] (see SpecialSymbolId), -1 if unknown
+int specialSymbolIndex(const wchar_t *symbol) {
+    return tableIndex(special_symbols, symbol);
+}
+
 // Check if a string is a boolean literal (सत्य or असत्य)
 // Returns 1 if it's a boolean literal, 0 otherwise
 int isBooleanLiteral(const wchar_t *word) {
@@ -3,6 +3,66 @@
 
 #include <wchar.h>
 
+// Indices into the keywords[] table (same order)
+typedef enum {
+    KEYWORD_PURNA,         // पूर्ण - integer datatype
+    KEYWORD_YADI,          // यदि - if
+    KEYWORD_ANYATHA,       // अन्यथा - else
+    KEYWORD_CHAKRA,        // चक्र - loop
+    KEYWORD_SE,            // से - from
+    KEYWORD_TAK,           // तक - to
+    KEYWORD_LEKH,          // लेख - print
+    KEYWORD_PRAVE,         // प्रवे - input
+    KEYWORD_KAKSHA,        // कक्षा - class
+    KEYWORD_VA_YADI,       // वा यदि - else if (never lexed as one token; see atElseIf())
+    KEYWORD_NA,            // न - not
+    KEYWORD_KARMA,         // कर्म - function
+    KEYWORD_COUNT
+} KeywordId;
+
+// Indices into the operators[] table (same order)
+typedef enum {
+    OPERATOR_PLUS,             // +
+    OPERATOR_MINUS,            // -
+    OPERATOR_STAR,             // *
+    OPERATOR_SLASH,            // /
+    OPERATOR_ASSIGN,           // =
+    OPERATOR_GREATER,          // >
+    OPERATOR_LESS,             // <
+    OPERATOR_GREATER_EQUAL,    // >=
+    OPERATOR_LESS_EQUAL,       // <=
+    OPERATOR_EQUAL,            // ==
+    OPERATOR_NOT_EQUAL,        // !=
+    OPERATOR_AND,              // &&
+    OPERATOR_SEMICOLON,        // ;
+    OPERATOR_NOT,              // !
+    OPERATOR_QUESTION,         // ?
+    OPERATOR_PLUS_ASSIGN,      // +=
+    OPERATOR_MINUS_ASSIGN,     // -=
+    OPERATOR_STAR_ASSIGN,      // *=
+    OPERATOR_SLASH_ASSIGN,     // /=
+    OPERATOR_COUNT
+} OperatorId;
+
+// Indices into the special_symbols[] table (same order)
+typedef enum {
+    SPECIAL_LPAREN,        // (
+    SPECIAL_RPAREN,        // )
+    SPECIAL_LBRACE,        // {
+    SPECIAL_RBRACE,        // }
+    SPECIAL_LBRACKET,      // [
+    SPECIAL_RBRACKET,      // ]
+    SPECIAL_COMMA,         // ,
+    SPECIAL_COLON,         // :
+    SPECIAL_PIPE,          // | (end of line)
+    SPECIAL_COUNT
+} SpecialSymbolId;
+
+// The tables themselves (NULL-terminated)
+extern const wchar_t *keywords[];
+extern const wchar_t *operators[];
+extern const wchar_t *special_symbols[];
+
 // Function prototypes for utility functions
 
 // Check if a string is a keyword in the language
@@ -17,4 +77,9 @@ int isSanskritAlpha(wchar_t c);
 // Check if a character is a Devanagari digit (०-९)
 int isDevanagariDigit(wchar_t c);
 
+// Position of a word in keywords[], operators[] or special_symbols[], -1 if absent
+int keywordIndex(const wchar_t *word);
+int operatorIndex(const wchar_t *op);
+int specialSymbolIndex(const wchar_t *symbol);
+
 #endif // UTILS_H
\ No newline at end of file
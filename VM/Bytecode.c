@@ -0,0 +1,238 @@
+#include "Bytecode.h"
+#include <stdlib.h>
+#include <string.h>
+
+const OpcodeInfo opcodeInfo[OP_COUNT] = {
+    [OP_INT]           = {"INT", 1, 1},
+    [OP_CONSTANT]      = {"CONSTANT", 1, 1},
+    [OP_POP]           = {"POP", 0, -1},
+    [OP_DUP]           = {"DUP", 0, 1},
+    [OP_LOAD_GLOBAL]   = {"LOAD_GLOBAL", 1, 1},
+    [OP_STORE_GLOBAL]  = {"STORE_GLOBAL", 1, -1},
+    [OP_LOAD_LOCAL]    = {"LOAD_LOCAL", 1, 1},
+    [OP_STORE_LOCAL]   = {"STORE_LOCAL", 1, -1},
+    [OP_LOAD_FIELD]    = {"LOAD_FIELD", 1, 1},
+    [OP_STORE_FIELD]   = {"STORE_FIELD", 1, -1},
+    [OP_ADD]           = {"ADD", 0, -1},
+    [OP_SUBTRACT]      = {"SUBTRACT", 0, -1},
+    [OP_MULTIPLY]      = {"MULTIPLY", 0, -1},
+    [OP_DIVIDE]        = {"DIVIDE", 0, -1},
+    [OP_NEGATE]        = {"NEGATE", 0, 0},
+    [OP_CONCAT]        = {"CONCAT", 0, -1},
+    [OP_LESS]          = {"LESS", 0, -1},
+    [OP_LESS_EQUAL]    = {"LESS_EQUAL", 0, -1},
+    [OP_GREATER]       = {"GREATER", 0, -1},
+    [OP_GREATER_EQUAL] = {"GREATER_EQUAL", 0, -1},
+    [OP_EQUAL]         = {"EQUAL", 0, -1},
+    [OP_NOT_EQUAL]     = {"NOT_EQUAL", 0, -1},
+    [OP_NOT]           = {"NOT", 0, 0},
+    [OP_JUMP]          = {"JUMP", 1, 0},
+    [OP_JUMP_IF_FALSE] = {"JUMP_IF_FALSE", 1, -1},
+    [OP_AND]           = {"AND", 1, -1},
+    [OP_CALL]          = {"CALL", 1, 0},
+    [OP_NEW]           = {"NEW", 1, 1},
+    [OP_RETURN]        = {"RETURN", 0, 0},
+    [OP_PRINT_INT]     = {"PRINT_INT", 0, -1},
+    [OP_PRINT_BOOL]    = {"PRINT_BOOL", 0, -1},
+    [OP_PRINT_CHAR]    = {"PRINT_CHAR", 0, -1},
+    [OP_PRINT_STRING]  = {"PRINT_STRING", 0, -1},
+    [OP_PRINT_OBJECT]  = {"PRINT_OBJECT", 1, -1},
+    [OP_PRINT_LINE]    = {"PRINT_LINE", 0, 0},
+    [OP_INPUT_INT]     = {"INPUT_INT", 0, 1},
+    [OP_INPUT_STRING]  = {"INPUT_STRING", 0, 1},
+    [OP_HALT]          = {"HALT", 0, 0},
+};
+
+const OpcodeInfo registerOpcodeInfo[REG_OPCODE_COUNT] = {
+    [REG_MOVE]               = {"MOVE", 2, 0},
+    [REG_LOAD_INT]           = {"LOAD_INT", 2, 0},
+    [REG_LOAD_CONSTANT]      = {"LOAD_CONSTANT", 2, 0},
+    [REG_GET_GLOBAL]         = {"GET_GLOBAL", 2, 0},
+    [REG_SET_GLOBAL]         = {"SET_GLOBAL", 2, 0},
+    [REG_GET_FIELD]          = {"GET_FIELD", 2, 0},
+    [REG_SET_FIELD]          = {"SET_FIELD", 2, 0},
+    [REG_ADD]                = {"ADD", 3, 0},
+    [REG_ADD_INT]            = {"ADD_INT", 3, 0},
+    [REG_SUBTRACT]           = {"SUBTRACT", 3, 0},
+    [REG_MULTIPLY]           = {"MULTIPLY", 3, 0},
+    [REG_DIVIDE]             = {"DIVIDE", 3, 0},
+    [REG_CONCAT]             = {"CONCAT", 3, 0},
+    [REG_LESS]               = {"LESS", 3, 0},
+    [REG_LESS_EQUAL]         = {"LESS_EQUAL", 3, 0},
+    [REG_EQUAL]              = {"EQUAL", 3, 0},
+    [REG_NOT_EQUAL]          = {"NOT_EQUAL", 3, 0},
+    [REG_NEGATE]             = {"NEGATE", 2, 0},
+    [REG_NOT]                = {"NOT", 2, 0},
+    [REG_JUMP]               = {"JUMP", 1, 0},
+    [REG_JUMP_IF_FALSE]      = {"JUMP_IF_FALSE", 2, 0},
+    [REG_JUMP_IF_LESS]       = {"JUMP_IF_LESS", 3, 0},
+    [REG_JUMP_IF_LESS_EQUAL] = {"JUMP_IF_LESS_EQUAL", 3, 0},
+    [REG_JUMP_IF_EQUAL]      = {"JUMP_IF_EQUAL", 3, 0},
+    [REG_JUMP_IF_NOT_EQUAL]  = {"JUMP_IF_NOT_EQUAL", 3, 0},
+    [REG_CALL]               = {"CALL", 2, 0},
+    [REG_NEW]                = {"NEW", 3, 0},
+    [REG_RETURN]             = {"RETURN", 0, 0},
+    [REG_PRINT_INT]          = {"PRINT_INT", 1, 0},
+    [REG_PRINT_BOOL]         = {"PRINT_BOOL", 1, 0},
+    [REG_PRINT_CHAR]         = {"PRINT_CHAR", 1, 0},
+    [REG_PRINT_STRING]       = {"PRINT_STRING", 1, 0},
+    [REG_PRINT_OBJECT]       = {"PRINT_OBJECT", 2, 0},
+    [REG_PRINT_LINE]         = {"PRINT_LINE", 0, 0},
+    [REG_INPUT_INT]          = {"INPUT_INT", 1, 0},
+    [REG_INPUT_STRING]       = {"INPUT_STRING", 1, 0},
+    [REG_HALT]               = {"HALT", 0, 0},
+};
+
+void initBytecode(Bytecode *bytecode) {
+    memset(bytecode, 0, sizeof(*bytecode));
+    bytecode->instructionSet = opcodeInfo;
+    bytecode->opcodeCount = OP_COUNT;
+}
+
+void initRegisterCode(Bytecode *bytecode) {
+    memset(bytecode, 0, sizeof(*bytecode));
+    bytecode->instructionSet = registerOpcodeInfo;
+    bytecode->opcodeCount = REG_OPCODE_COUNT;
+}
+
+void freeBytecode(Bytecode *bytecode) {
+    free(bytecode->code);
+    free(bytecode->constants);
+    free(bytecode->functions);
+    free(bytecode->classes);
+    free(bytecode->lines);
+    const OpcodeInfo *instructionSet = bytecode->instructionSet;
+    uint32_t opcodeCount = bytecode->opcodeCount;
+    memset(bytecode, 0, sizeof(*bytecode));
+    bytecode->instructionSet = instructionSet;
+    bytecode->opcodeCount = opcodeCount;
+}
+
+// Make room for extra more items of an array. Returns 0 if out of memory
+static int reserve(void **items, uint32_t count, uint32_t *capacity, size_t size, uint32_t extra) {
+    if (count + extra <= *capacity) {
+        return 1;
+    }
+    uint32_t grown = *capacity ? *capacity * 2 : 64;
+    while (grown < count + extra) {
+        grown *= 2;
+    }
+    void *moved = realloc(*items, (size_t)grown * size);
+    if (!moved) {
+        fprintf(stderr, "Memory allocation failed for bytecode!\n");
+        return 0;
+    }
+    *items = moved;
+    *capacity = grown;
+    return 1;
+}
+
+static void writeOperand(uint8_t *at, uint32_t value) {
+    at[0] = (uint8_t)value;
+    at[1] = (uint8_t)(value >> 8);
+    at[2] = (uint8_t)(value >> 16);
+    at[3] = (uint8_t)(value >> 24);
+}
+
+// Append an instruction
+uint32_t emitInstruction(Bytecode *bytecode, uint8_t op, const uint32_t *operands, SourceLocation location) {
+    uint32_t operandCount = bytecode->instructionSet[op].operands;
+    uint32_t size = 1 + 4 * operandCount;
+    if (!reserve((void **)&bytecode->code, bytecode->codeCount, &bytecode->codeCapacity, 1, size)) {
+        return UINT32_MAX;
+    }
+    // A new line entry only where the location changes
+    if (location != NO_LOCATION &&
+        (bytecode->lineCount == 0 || bytecode->lines[bytecode->lineCount - 1].location != location)) {
+        if (!reserve((void **)&bytecode->lines, bytecode->lineCount, &bytecode->lineCapacity, sizeof(VmLine), 1)) {
+            return UINT32_MAX;
+        }
+        bytecode->lines[bytecode->lineCount++] = (VmLine){bytecode->codeCount, location};
+    }
+    uint32_t offset = bytecode->codeCount;
+    uint8_t *at = bytecode->code + offset;
+    at[0] = op;
+    for (uint32_t i = 0; i < operandCount; i++) {
+        writeOperand(at + 1 + 4 * i, operands[i]);
+    }
+    bytecode->codeCount += size;
+    return offset;
+}
+
+void patchOperand(Bytecode *bytecode, uint32_t offset, uint32_t value) {
+    uint32_t operands = bytecode->instructionSet[bytecode->code[offset]].operands;
+    writeOperand(bytecode->code + offset + 1 + 4 * (operands - 1), value);
+}
+
+void patchOperandAt(Bytecode *bytecode, uint32_t offset, uint32_t index, uint32_t value) {
+    writeOperand(bytecode->code + offset + 1 + 4 * index, value);
+}
+
+uint32_t addConstant(Bytecode *bytecode, VmValue value) {
+    if (!reserve((void **)&bytecode->constants, bytecode->constantCount, &bytecode->constantCapacity,
+                 sizeof(VmValue), 1)) {
+        return UINT32_MAX;
+    }
+    bytecode->constants[bytecode->constantCount] = value;
+    return bytecode->constantCount++;
+}
+
+uint32_t addFunction(Bytecode *bytecode, VmFunction function) {
+    if (!reserve((void **)&bytecode->functions, bytecode->functionCount, &bytecode->functionCapacity,
+                 sizeof(VmFunction), 1)) {
+        return UINT32_MAX;
+    }
+    bytecode->functions[bytecode->functionCount] = function;
+    return bytecode->functionCount++;
+}
+
+uint32_t addClass(Bytecode *bytecode, VmClass class) {
+    if (!reserve((void **)&bytecode->classes, bytecode->classCount, &bytecode->classCapacity, sizeof(VmClass), 1)) {
+        return UINT32_MAX;
+    }
+    bytecode->classes[bytecode->classCount] = class;
+    return bytecode->classCount++;
+}
+
+// Last line entry at or before offset
+SourceLocation bytecodeLocation(const Bytecode *bytecode, uint32_t offset) {
+    uint32_t low = 0;
+    uint32_t high = bytecode->lineCount;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (bytecode->lines[middle].offset <= offset) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low > 0 ? bytecode->lines[low - 1].location : NO_LOCATION;
+}
+
+void disassembleBytecode(const Bytecode *bytecode, FILE *out) {
+    // Functions are numbered in the order their code starts
+    uint32_t function = 0;
+    for (uint32_t offset = 0; offset < bytecode->codeCount;) {
+        while (function < bytecode->functionCount && bytecode->functions[function].entry <= offset) {
+            const VmFunction *f = &bytecode->functions[function];
+            fprintf(out, "function %u (%u params, %u %s):\n", function, f->paramCount, f->frameSize,
+                    bytecode->instructionSet == opcodeInfo ? "locals" : "registers");
+            function++;
+        }
+        uint8_t op = bytecode->code[offset];
+        const OpcodeInfo *info = op < bytecode->opcodeCount ? &bytecode->instructionSet[op] : NULL;
+        fprintf(out, "%6u  %s", offset, info ? info->name : "?");
+        uint32_t operands = info ? info->operands : 0;
+        for (uint32_t i = 0; i < operands; i++) {
+            uint32_t value = readOperand(bytecode->code + offset + 1 + 4 * i);
+            if (bytecode->instructionSet == opcodeInfo ? op == OP_INT
+                                                       : (op == REG_LOAD_INT || op == REG_ADD_INT) && i == operands - 1) {
+                fprintf(out, " %d", (int32_t)value);
+            } else {
+                fprintf(out, " %u", value);
+            }
+        }
+        fputc('\n', out);
+        offset += 1 + 4 * operands;
+    }
+}
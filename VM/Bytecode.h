@@ -0,0 +1,218 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "SourceManager.h"  // For SourceLocation
+
+// Bytecode
+// A compiled program is one flat array of bytes shared by all its functions. An
+// instruction is a one-byte opcode followed by its operands, each a 32-bit
+// little-endian number (a slot, a constant, a function or a code offset), so the
+// interpreter decodes it without looking anything up. Jumps name an absolute
+// offset in the array.
+//
+// Values are untyped 64-bit cells: the type checker has already decided what
+// every operation works on, so each opcode knows its operands' types (ADD adds
+// integers, CONCAT joins strings) and nothing is tagged or checked at run time.
+//   पूर्ण, characters    the number
+//   सत्य / असत्य        1 / 0
+//   strings            an interned SymbolId
+//   objects            a pointer to a VmObject
+//
+// Variables live in slots numbered by the resolver: globals in one array for the
+// whole program, locals (parameters first) in their function's frame and fields
+// in the object a class body initializes. Counting चक्र loops keep their end in
+// an extra local of the function after the resolver's slots.
+
+typedef enum {
+    OP_INT,                    // i32 value: push a small number, a character or a boolean
+    OP_CONSTANT,               // u32 index: push constants[index]
+    OP_POP,                    // Drop the top value
+    OP_DUP,                    // Push the top value again
+    OP_LOAD_GLOBAL,            // u32 slot: push a global
+    OP_STORE_GLOBAL,           // u32 slot: pop into a global
+    OP_LOAD_LOCAL,             // u32 slot: push a local of the current frame
+    OP_STORE_LOCAL,            // u32 slot: pop into a local
+    OP_LOAD_FIELD,             // u32 slot: push a field of the object being initialized
+    OP_STORE_FIELD,            // u32 slot: pop into a field
+    OP_ADD,                    // Integer arithmetic (wraps around)
+    OP_SUBTRACT,
+    OP_MULTIPLY,
+    OP_DIVIDE,                 // Fails on division by zero
+    OP_NEGATE,
+    OP_CONCAT,                 // Join two strings
+    OP_LESS,                   // Compare two numbers or characters
+    OP_LESS_EQUAL,
+    OP_GREATER,
+    OP_GREATER_EQUAL,
+    OP_EQUAL,                  // Compare two values of the same type
+    OP_NOT_EQUAL,
+    OP_NOT,
+    OP_JUMP,                   // u32 target
+    OP_JUMP_IF_FALSE,          // u32 target: pop a boolean, jump if it is असत्य
+    OP_AND,                    // u32 target: if the top is असत्य jump, keeping it; otherwise pop it
+    OP_CALL,                   // u32 function: its arguments are on the stack
+    OP_NEW,                    // u32 class: push a new object and run its class body on it
+    OP_RETURN,                 // Leave the current function
+    OP_PRINT_INT,              // Pop a value and print it (लेख)
+    OP_PRINT_BOOL,
+    OP_PRINT_CHAR,
+    OP_PRINT_STRING,
+    OP_PRINT_OBJECT,           // u32 symbol: pop an object and print its class name
+    OP_PRINT_LINE,             // End the printed line
+    OP_INPUT_INT,              // Read a line and push it as a number (प्रवे)
+    OP_INPUT_STRING,           // Read a line and push it as a string
+    OP_HALT,                   // End of the program
+    OP_COUNT
+} Opcode;
+
+// Register instruction set
+// The alternative backend (RegisterCompiler.h) works on the slots of the current
+// frame instead of a stack: operand r names register r of the frame, and an
+// instruction reads its operands and writes its result in place, so x = y + z is
+// one ADD instead of four pushes and pops. The program's frame starts with the
+// globals, so top-level code uses them as registers too; functions reach them
+// with GET_GLOBAL / SET_GLOBAL. Operands after the registers are immediates,
+// constants, slots or code offsets as noted.
+typedef enum {
+    REG_MOVE,                  // a, b: r[a] = r[b]
+    REG_LOAD_INT,              // a, i32: r[a] = value
+    REG_LOAD_CONSTANT,         // a, index: r[a] = constants[index]
+    REG_GET_GLOBAL,            // a, slot: r[a] = globals[slot]
+    REG_SET_GLOBAL,            // slot, a: globals[slot] = r[a]
+    REG_GET_FIELD,             // a, slot: r[a] = field of the object being initialized
+    REG_SET_FIELD,             // slot, a
+    REG_ADD,                   // a, b, c: r[a] = r[b] + r[c] (wraps around)
+    REG_ADD_INT,               // a, b, i32: r[a] = r[b] + value
+    REG_SUBTRACT,
+    REG_MULTIPLY,
+    REG_DIVIDE,                // Fails on division by zero
+    REG_CONCAT,
+    REG_LESS,                  // a, b, c: r[a] = r[b] < r[c] (> is < with its operands swapped)
+    REG_LESS_EQUAL,
+    REG_EQUAL,
+    REG_NOT_EQUAL,
+    REG_NEGATE,                // a, b: r[a] = -r[b]
+    REG_NOT,
+    REG_JUMP,                  // target
+    REG_JUMP_IF_FALSE,         // a, target
+    REG_JUMP_IF_LESS,          // a, b, target: jump if r[a] < r[b]
+    REG_JUMP_IF_LESS_EQUAL,
+    REG_JUMP_IF_EQUAL,
+    REG_JUMP_IF_NOT_EQUAL,
+    REG_CALL,                  // function, base: the arguments are in r[base ..], which
+                               // becomes the callee's register 0
+    REG_NEW,                   // a, class, base: r[a] = a new object, its class body
+                               // run in a frame starting at r[base]
+    REG_RETURN,
+    REG_PRINT_INT,             // a
+    REG_PRINT_BOOL,
+    REG_PRINT_CHAR,
+    REG_PRINT_STRING,
+    REG_PRINT_OBJECT,          // a, symbol
+    REG_PRINT_LINE,
+    REG_INPUT_INT,             // a: read a line into r[a]
+    REG_INPUT_STRING,
+    REG_HALT,
+    REG_OPCODE_COUNT
+} RegisterOpcode;
+
+// What an opcode looks like, for the disassembler and the compiler
+typedef struct {
+    const char *name;
+    uint8_t operands;          // Number of 32-bit operands
+    int8_t stackEffect;        // Values pushed minus values popped (OP_CALL: minus its arguments
+                               // too). 0 for register instructions
+} OpcodeInfo;
+
+extern const OpcodeInfo opcodeInfo[OP_COUNT];
+extern const OpcodeInfo registerOpcodeInfo[REG_OPCODE_COUNT];
+
+// One cell of the stack, a frame or an object
+typedef union {
+    int64_t number;
+    struct VmObject *object;
+} VmValue;
+
+// A compiled function (or class body)
+typedef struct {
+    uint32_t entry;            // Offset of its first instruction
+    uint32_t paramCount;       // Arguments it takes (its first locals)
+    uint32_t frameSize;        // Locals, parameters included (registers, temporaries included)
+    uint32_t maxStack;         // Most values it pushes on top of its locals (0 for registers)
+    uint32_t declaration;      // AST_FUNC_DECL / AST_CLASS_DECL node (0 for the program)
+} VmFunction;
+
+// A class: its objects' size and the body that initializes them
+typedef struct {
+    uint32_t fieldCount;
+    uint32_t init;             // VmFunction run on each new object
+    uint32_t declaration;      // AST_CLASS_DECL node
+} VmClass;
+
+// Start of a run of code compiled from one source location
+typedef struct {
+    uint32_t offset;
+    SourceLocation location;
+} VmLine;
+
+typedef struct {
+    const OpcodeInfo *instructionSet; // opcodeInfo or registerOpcodeInfo
+    uint32_t opcodeCount;
+    uint8_t *code;
+    uint32_t codeCount;
+    uint32_t codeCapacity;
+    VmValue *constants;
+    uint32_t constantCount;
+    uint32_t constantCapacity;
+    VmFunction *functions;     // functions[0] is the program itself
+    uint32_t functionCount;
+    uint32_t functionCapacity;
+    VmClass *classes;
+    uint32_t classCount;
+    uint32_t classCapacity;
+    VmLine *lines;             // In code order
+    uint32_t lineCount;
+    uint32_t lineCapacity;
+    uint32_t globalCount;
+} Bytecode;
+
+// Prepare an empty program in the stack instruction set
+void initBytecode(Bytecode *bytecode);
+
+// Prepare an empty program in the register instruction set
+void initRegisterCode(Bytecode *bytecode);
+
+void freeBytecode(Bytecode *bytecode);
+
+// Append an instruction of the program's instruction set with its operands
+// (as many as the set says op has), compiled from location. Returns its offset,
+// UINT32_MAX if out of memory
+uint32_t emitInstruction(Bytecode *bytecode, uint8_t op, const uint32_t *operands, SourceLocation location);
+
+// Overwrite the last operand of the instruction at offset (to fill in a jump target)
+void patchOperand(Bytecode *bytecode, uint32_t offset, uint32_t value);
+
+// Overwrite operand index of the instruction at offset
+void patchOperandAt(Bytecode *bytecode, uint32_t offset, uint32_t index, uint32_t value);
+
+// Add a value to the constant pool. Returns its index, UINT32_MAX if out of memory
+uint32_t addConstant(Bytecode *bytecode, VmValue value);
+
+// Add a function or class. Returns its index, UINT32_MAX if out of memory
+uint32_t addFunction(Bytecode *bytecode, VmFunction function);
+uint32_t addClass(Bytecode *bytecode, VmClass class);
+
+// Source location the instruction at offset was compiled from (NO_LOCATION if unknown)
+SourceLocation bytecodeLocation(const Bytecode *bytecode, uint32_t offset);
+
+// Read a 32-bit operand
+static inline uint32_t readOperand(const uint8_t *at) {
+    return (uint32_t)at[0] | (uint32_t)at[1] << 8 | (uint32_t)at[2] << 16 | (uint32_t)at[3] << 24;
+}
+
+// Print every instruction, one per line, with its offset
+void disassembleBytecode(const Bytecode *bytecode, FILE *out);
+
+#endif // BYTECODE_H
@@ -0,0 +1,534 @@
+#include "Compiler.h"
+#include "utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Code being compiled for one function, class body or the program
+typedef struct {
+    uint32_t function;         // Its VmFunction
+    uint32_t firstTemp;        // First local after the resolver's slots
+    uint32_t temps;            // Extra locals in use (ends of enclosing चक्र loops)
+    uint32_t maxTemps;
+    int32_t depth;             // Values on the stack above the locals
+    int32_t maxDepth;
+} CodeFrame;
+
+typedef struct {
+    const Ast *ast;
+    const AstOrder *order;
+    const Resolution *resolution;
+    const TypeCheck *types;
+    Bytecode *bytecode;
+    DiagnosticBuffer *diagnostics;
+    uint32_t *numbers;         // By node: VmFunction of a कर्म, VmClass of a कक्षा
+    uint32_t *jumps;           // By node: forward jump waiting for the node's code to end
+    uint32_t *labels;          // By node: start of a loop's test
+    CodeFrame *frames;         // Innermost last
+    uint32_t frameCount;
+    uint32_t frameCapacity;
+    SourceLocation runFrom;
+    uint32_t startJump;        // Jump to the first statement to run (UINT32_MAX once placed)
+    uint32_t errorCount;
+    int failed;                // Out of memory
+} Compiler;
+
+static void reportCompile(Compiler *compiler, uint32_t node, const char *message) {
+    compiler->errorCount++;
+    addDiagnostic(compiler->diagnostics, DIAGNOSTIC_ERROR, astLocation(compiler->ast, node), 0, NO_SYMBOL, message);
+}
+
+static CodeFrame *currentFrame(Compiler *compiler) {
+    return &compiler->frames[compiler->frameCount - 1];
+}
+
+// Append an instruction compiled from node that also pops popped values beyond
+// its usual effect (a call's arguments), keeping count of the stack. Returns
+// its offset, UINT32_MAX if out of memory
+static uint32_t emitPopping(Compiler *compiler, uint32_t node, Opcode op, uint32_t operand, int32_t popped) {
+    uint32_t offset = emitInstruction(compiler->bytecode, op, &operand, astLocation(compiler->ast, node));
+    if (offset == UINT32_MAX) {
+        compiler->failed = 1;
+        return offset;
+    }
+    CodeFrame *frame = currentFrame(compiler);
+    frame->depth += opcodeInfo[op].stackEffect - popped;
+    if (frame->depth > frame->maxDepth) {
+        frame->maxDepth = frame->depth;
+    }
+    return offset;
+}
+
+static uint32_t emit(Compiler *compiler, uint32_t node, Opcode op, uint32_t operand) {
+    return emitPopping(compiler, node, op, operand, 0);
+}
+
+// Point a forward jump at the next instruction
+static void patchHere(Compiler *compiler, uint32_t jump) {
+    if (jump != UINT32_MAX) {
+        patchOperand(compiler->bytecode, jump, compiler->bytecode->codeCount);
+    }
+}
+
+// Start compiling a function at the next instruction
+static int pushFrame(Compiler *compiler, uint32_t function, uint32_t firstTemp) {
+    if (compiler->frameCount == compiler->frameCapacity) {
+        uint32_t grown = compiler->frameCapacity ? compiler->frameCapacity * 2 : 16;
+        CodeFrame *frames = realloc(compiler->frames, grown * sizeof(CodeFrame));
+        if (!frames) {
+            fprintf(stderr, "Memory allocation failed for the compiler!\n");
+            compiler->failed = 1;
+            return 0;
+        }
+        compiler->frames = frames;
+        compiler->frameCapacity = grown;
+    }
+    compiler->frames[compiler->frameCount++] = (CodeFrame){function, firstTemp, 0, 0, 0, 0};
+    compiler->bytecode->functions[function].entry = compiler->bytecode->codeCount;
+    return 1;
+}
+
+// Finish the innermost function with its last instruction (a return, or the
+// program's halt) and record the room its frame needs
+static void popFrame(Compiler *compiler, uint32_t node, Opcode last) {
+    emit(compiler, node, last, 0);
+    const CodeFrame *frame = currentFrame(compiler);
+    VmFunction *function = &compiler->bytecode->functions[frame->function];
+    function->frameSize = frame->firstTemp + frame->maxTemps;
+    function->maxStack = (uint32_t)frame->maxDepth;
+    compiler->frameCount--;
+}
+
+// Load or store the variable a declaration declares
+static void emitVariable(Compiler *compiler, uint32_t node, uint32_t declaration, int store) {
+    const Resolution *resolution = compiler->resolution;
+    uint32_t slot = slotOf(resolution, declaration);
+    switch (resolution->storage[declaration]) {
+        case STORAGE_GLOBAL: emit(compiler, node, store ? OP_STORE_GLOBAL : OP_LOAD_GLOBAL, slot); break;
+        case STORAGE_LOCAL:  emit(compiler, node, store ? OP_STORE_LOCAL : OP_LOAD_LOCAL, slot); break;
+        case STORAGE_FIELD:  emit(compiler, node, store ? OP_STORE_FIELD : OP_LOAD_FIELD, slot); break;
+        default:             reportCompile(compiler, node, "Cannot compile a use of an unresolved name"); break;
+    }
+}
+
+// Instruction of a binary or compound assignment operator on values of type
+static Opcode operatorOpcode(uint8_t op, TypeId type) {
+    switch (op) {
+        case OPERATOR_PLUS:
+        case OPERATOR_PLUS_ASSIGN:   return type == TYPE_STRING ? OP_CONCAT : OP_ADD;
+        case OPERATOR_MINUS:
+        case OPERATOR_MINUS_ASSIGN:  return OP_SUBTRACT;
+        case OPERATOR_STAR:
+        case OPERATOR_STAR_ASSIGN:   return OP_MULTIPLY;
+        case OPERATOR_SLASH:
+        case OPERATOR_SLASH_ASSIGN:  return OP_DIVIDE;
+        case OPERATOR_LESS:          return OP_LESS;
+        case OPERATOR_LESS_EQUAL:    return OP_LESS_EQUAL;
+        case OPERATOR_GREATER:       return OP_GREATER;
+        case OPERATOR_GREATER_EQUAL: return OP_GREATER_EQUAL;
+        case OPERATOR_EQUAL:         return OP_EQUAL;
+        case OPERATOR_NOT_EQUAL:     return OP_NOT_EQUAL;
+        default:                     return OP_COUNT;
+    }
+}
+
+// Number every कर्म and कक्षा in pre-order, the order their code will start in,
+// and make sure nothing in the tree is left that cannot run
+static int numberDeclarations(Compiler *compiler) {
+    const Ast *ast = compiler->ast;
+    Bytecode *bytecode = compiler->bytecode;
+    if (addFunction(bytecode, (VmFunction){0, 0, 0, 0, 0}) == UINT32_MAX) {
+        return 0;
+    }
+    for (uint32_t p = 0; p < compiler->order->count; p++) {
+        uint32_t node = compiler->order->preorder[p];
+        const AstNode *n = &ast->nodes[node];
+        uint32_t number = 0;
+        if (n->kind == AST_FUNC_DECL) {
+            number = addFunction(bytecode, (VmFunction){0, ast->nodes[n->b].b, 0, 0, node});
+        } else if (n->kind == AST_CLASS_DECL) {
+            uint32_t init = addFunction(bytecode, (VmFunction){0, 0, 0, 0, node});
+            number = init == UINT32_MAX ? init
+                                        : addClass(bytecode, (VmClass){slotOf(compiler->resolution, node), init, node});
+        } else if (n->kind == AST_ERROR) {
+            reportCompile(compiler, node, "Cannot compile code with syntax errors");
+        } else if ((n->kind == AST_IDENT || n->kind == AST_CALL || (n->kind == AST_VAR_DECL && n->c != 0)) &&
+                   declarationOf(compiler->resolution, node) == 0) {
+            reportCompile(compiler, node, "Cannot compile a use of an unresolved name");
+        } else if (typeOfNode(compiler->types, node) == TYPE_ERROR) {
+            reportCompile(compiler, node, "Cannot compile code with type errors");
+        }
+        if (number == UINT32_MAX) {
+            compiler->failed = 1;
+            return 0;
+        }
+        compiler->numbers[node] = number;
+    }
+    return compiler->errorCount == 0;
+}
+
+// The program starts at the first top-level statement at or after runFrom
+static void startStatement(Compiler *compiler, uint32_t node) {
+    if (compiler->startJump != UINT32_MAX && compiler->order->parents[node] == compiler->ast->root &&
+        astLocation(compiler->ast, node) >= compiler->runFrom) {
+        patchHere(compiler, compiler->startJump);
+        compiler->startJump = UINT32_MAX;
+    }
+}
+
+// Called when any node has been compiled: code that goes between it and the
+// next child of its parent
+static int finishNode(void *context, uint32_t node) {
+    Compiler *compiler = context;
+    const Ast *ast = compiler->ast;
+    uint32_t parent = compiler->order->parents[node];
+    const AstNode *p = &ast->nodes[parent];
+    switch (p->kind) {
+        case AST_IF:
+            if (node == p->a) {
+                compiler->jumps[parent] = emit(compiler, node, OP_JUMP_IF_FALSE, 0);
+            } else if (node == p->b && p->c != 0) {
+                uint32_t skipElse = emit(compiler, node, OP_JUMP, 0);
+                patchHere(compiler, compiler->jumps[parent]);
+                compiler->jumps[parent] = skipElse;
+            }
+            break;
+        case AST_TERNARY:
+            if (node == p->a) {
+                compiler->jumps[parent] = emit(compiler, node, OP_JUMP_IF_FALSE, 0);
+            } else if (node == p->b) {
+                uint32_t skipElse = emit(compiler, node, OP_JUMP, 0);
+                patchHere(compiler, compiler->jumps[parent]);
+                compiler->jumps[parent] = skipElse;
+                currentFrame(compiler)->depth--;  // The other branch pushes its own value
+            }
+            break;
+        case AST_BINARY:
+            if (p->op == OPERATOR_AND && node == p->a) {
+                compiler->jumps[parent] = emit(compiler, node, OP_AND, 0);
+            }
+            break;
+        case AST_WHILE:
+            if (node == p->a) {
+                compiler->jumps[parent] = emit(compiler, node, OP_JUMP_IF_FALSE, 0);
+            }
+            break;
+        case AST_LOOP:
+            if (node == p->b) {
+                // Keep the end in a local, then test the loop variable against it
+                CodeFrame *frame = currentFrame(compiler);
+                uint32_t end = frame->firstTemp + frame->temps++;
+                if (frame->temps > frame->maxTemps) {
+                    frame->maxTemps = frame->temps;
+                }
+                emit(compiler, node, OP_STORE_LOCAL, end);
+                compiler->labels[parent] = compiler->bytecode->codeCount;
+                emitVariable(compiler, parent, p->a, 0);
+                emit(compiler, parent, OP_LOAD_LOCAL, end);
+                emit(compiler, parent, OP_LESS_EQUAL, 0);
+                compiler->jumps[parent] = emit(compiler, parent, OP_JUMP_IF_FALSE, 0);
+            }
+            break;
+        case AST_PRINT: {
+            TypeId type = typeOfNode(compiler->types, node);
+            if (type == TYPE_BOOL) {
+                emit(compiler, node, OP_PRINT_BOOL, 0);
+            } else if (type == TYPE_CHAR) {
+                emit(compiler, node, OP_PRINT_CHAR, 0);
+            } else if (type == TYPE_STRING) {
+                emit(compiler, node, OP_PRINT_STRING, 0);
+            } else if (type >= TYPE_BUILTIN_COUNT) {
+                emit(compiler, node, OP_PRINT_OBJECT, typeInfo(&compiler->types->table, type)->name);
+            } else {
+                emit(compiler, node, OP_PRINT_INT, 0);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    return !compiler->failed;
+}
+
+// Visitor functions. Each returns 0 to stop the walk once memory ran out
+static int enterProgram(void *context, uint32_t node) {
+    Compiler *compiler = context;
+    if (!pushFrame(compiler, 0, 0)) {
+        return 0;
+    }
+    if (compiler->runFrom != NO_LOCATION) {
+        compiler->startJump = emit(compiler, node, OP_JUMP, 0);
+    }
+    return !compiler->failed;
+}
+
+static int enterStatement(void *context, uint32_t node) {
+    startStatement(context, node);
+    return 1;
+}
+
+// A कर्म or कक्षा: its code goes here, behind a jump for the code around it
+static int enterDeclaration(void *context, uint32_t node) {
+    Compiler *compiler = context;
+    startStatement(compiler, node);
+    compiler->jumps[node] = emit(compiler, node, OP_JUMP, 0);
+    if (compiler->ast->nodes[node].kind == AST_FUNC_DECL) {
+        return pushFrame(compiler, compiler->numbers[node], slotOf(compiler->resolution, node));
+    }
+    // Fields live in the object, so a class body's frame holds only its temporaries
+    return pushFrame(compiler, compiler->bytecode->classes[compiler->numbers[node]].init, 0);
+}
+
+static int enterWhile(void *context, uint32_t node) {
+    Compiler *compiler = context;
+    startStatement(compiler, node);
+    compiler->labels[node] = compiler->bytecode->codeCount;
+    return 1;
+}
+
+static int enterIdentifier(void *context, uint32_t node) {
+    Compiler *compiler = context;
+    uint32_t parent = compiler->order->parents[node];
+    const AstNode *p = &compiler->ast->nodes[parent];
+    // The target of = and प्रवे is only stored to
+    if ((p->kind == AST_ASSIGN && p->a == node && p->op == OPERATOR_ASSIGN) || p->kind == AST_INPUT) {
+        return 1;
+    }
+    emitVariable(compiler, node, declarationOf(compiler->resolution, node), 0);
+    return !compiler->failed;
+}
+
+static int leaveProgram(void *context, uint32_t node) {
+    Compiler *compiler = context;
+    patchHere(compiler, compiler->startJump);
+    compiler->startJump = UINT32_MAX;
+    popFrame(compiler, node, OP_HALT);
+    compiler->bytecode->globalCount = slotOf(compiler->resolution, node);
+    return !compiler->failed;
+}
+
+static int leaveDeclaration(void *context, uint32_t node) {
+    Compiler *compiler = context;
+    popFrame(compiler, node, OP_RETURN);
+    patchHere(compiler, compiler->jumps[node]);
+    return finishNode(compiler, node);
+}
+
+static int leaveVariable(void *context, uint32_t node) {
+    Compiler *compiler = context;
+    const AstNode *n = &compiler->ast->nodes[node];
+    if (compiler->ast->nodes[compiler->order->parents[node]].kind == AST_PARAMS) {
+        return 1;  // Arguments are in place when the function starts
+    }
+    if (n->b == 0 && n->c != 0) {
+        uint32_t class = declarationOf(compiler->resolution, node);
+        emit(compiler, node, OP_NEW, compiler->numbers[class]);
+    } else if (n->b == 0) {
+        emit(compiler, node, OP_INT, 0);
+    }
+    emitVariable(compiler, node, node, 1);
+    return finishNode(compiler, node);
+}
+
+static int leaveJump(void *context, uint32_t node) {
+    Compiler *compiler = context;
+    patchHere(compiler, compiler->jumps[node]);
+    return finishNode(compiler, node);
+}
+
+static int leaveWhile(void *context, uint32_t node) {
+    Compiler *compiler = context;
+    emit(compiler, node, OP_JUMP, compiler->labels[node]);
+    return leaveJump(compiler, node);
+}
+
+static int leaveLoop(void *context, uint32_t node) {
+    Compiler *compiler = context;
+    uint32_t variable = compiler->ast->nodes[node].a;
+    emitVariable(compiler, node, variable, 0);
+    emit(compiler, node, OP_INT, 1);
+    emit(compiler, node, OP_ADD, 0);
+    emitVariable(compiler, node, variable, 1);
+    currentFrame(compiler)->temps--;
+    return leaveWhile(compiler, node);
+}
+
+static int leavePrint(void *context, uint32_t node) {
+    Compiler *compiler = context;
+    emit(compiler, node, OP_PRINT_LINE, 0);
+    return finishNode(compiler, node);
+}
+
+static int leaveInput(void *context, uint32_t node) {
+    Compiler *compiler = context;
+    uint32_t target = compiler->ast->nodes[node].a;
+    int string = typeOfNode(compiler->types, target) == TYPE_STRING;
+    emit(compiler, node, string ? OP_INPUT_STRING : OP_INPUT_INT, 0);
+    emitVariable(compiler, node, declarationOf(compiler->resolution, target), 1);
+    return finishNode(compiler, node);
+}
+
+static int leaveExpressionStatement(void *context, uint32_t node) {
+    Compiler *compiler = context;
+    uint32_t expression = compiler->ast->nodes[node].a;
+    // Assignments leave nothing behind when their value is not used
+    if (compiler->ast->nodes[expression].kind != AST_ASSIGN && typeOfNode(compiler->types, expression) != TYPE_VOID) {
+        emit(compiler, node, OP_POP, 0);
+    }
+    return finishNode(compiler, node);
+}
+
+static int leaveNumber(void *context, uint32_t node) {
+    Compiler *compiler = context;
+    int64_t value = astNumberValue(&compiler->ast->nodes[node]);
+    if (value >= INT32_MIN && value <= INT32_MAX) {
+        emit(compiler, node, OP_INT, (uint32_t)(int32_t)value);
+    } else {
+        uint32_t constant = addConstant(compiler->bytecode, (VmValue){.number = value});
+        if (constant == UINT32_MAX) {
+            compiler->failed = 1;
+            return 0;
+        }
+        emit(compiler, node, OP_CONSTANT, constant);
+    }
+    return finishNode(compiler, node);
+}
+
+static int leaveString(void *context, uint32_t node) {
+    Compiler *compiler = context;
+    SymbolId text = astSymbol(compiler->ast, compiler->ast->nodes[node].a);
+    uint32_t constant = addConstant(compiler->bytecode, (VmValue){.number = text});
+    if (constant == UINT32_MAX) {
+        compiler->failed = 1;
+        return 0;
+    }
+    emit(compiler, node, OP_CONSTANT, constant);
+    return finishNode(compiler, node);
+}
+
+// Characters and booleans
+static int leaveLiteral(void *context, uint32_t node) {
+    Compiler *compiler = context;
+    emit(compiler, node, OP_INT, compiler->ast->nodes[node].a);
+    return finishNode(compiler, node);
+}
+
+static int leaveUnary(void *context, uint32_t node) {
+    Compiler *compiler = context;
+    uint8_t op = compiler->ast->nodes[node].op;
+    if (op == OPERATOR_NOT) {
+        emit(compiler, node, OP_NOT, 0);
+    } else if (op == OPERATOR_MINUS) {
+        emit(compiler, node, OP_NEGATE, 0);
+    }
+    return finishNode(compiler, node);
+}
+
+static int leaveBinary(void *context, uint32_t node) {
+    Compiler *compiler = context;
+    const AstNode *n = &compiler->ast->nodes[node];
+    if (n->op == OPERATOR_AND) {
+        return leaveJump(compiler, node);
+    }
+    emit(compiler, node, operatorOpcode(n->op, typeOfNode(compiler->types, n->a)), 0);
+    return finishNode(compiler, node);
+}
+
+static int leaveAssignment(void *context, uint32_t node) {
+    Compiler *compiler = context;
+    const AstNode *n = &compiler->ast->nodes[node];
+    if (n->op != OPERATOR_ASSIGN) {
+        emit(compiler, node, operatorOpcode(n->op, typeOfNode(compiler->types, n->a)), 0);
+    }
+    if (compiler->ast->nodes[compiler->order->parents[node]].kind != AST_EXPR_STMT) {
+        emit(compiler, node, OP_DUP, 0);
+    }
+    emitVariable(compiler, node, declarationOf(compiler->resolution, n->a), 1);
+    return finishNode(compiler, node);
+}
+
+static int leaveCall(void *context, uint32_t node) {
+    Compiler *compiler = context;
+    uint32_t function = declarationOf(compiler->resolution, node);
+    emitPopping(compiler, node, OP_CALL, compiler->numbers[function], (int32_t)compiler->ast->nodes[node].b);
+    return finishNode(compiler, node);
+}
+
+static const AstVisitor compileVisitor = {
+    .enter = {
+        [AST_PROGRAM] = enterProgram,
+        [AST_BLOCK] = enterStatement,
+        [AST_VAR_DECL] = enterStatement,
+        [AST_FUNC_DECL] = enterDeclaration,
+        [AST_CLASS_DECL] = enterDeclaration,
+        [AST_IF] = enterStatement,
+        [AST_LOOP] = enterStatement,
+        [AST_WHILE] = enterWhile,
+        [AST_PRINT] = enterStatement,
+        [AST_INPUT] = enterStatement,
+        [AST_EXPR_STMT] = enterStatement,
+        [AST_IDENT] = enterIdentifier,
+    },
+    .leave = {
+        [AST_PROGRAM] = leaveProgram,
+        [AST_BLOCK] = finishNode,
+        [AST_VAR_DECL] = leaveVariable,
+        [AST_FUNC_DECL] = leaveDeclaration,
+        [AST_PARAMS] = finishNode,
+        [AST_CLASS_DECL] = leaveDeclaration,
+        [AST_IF] = leaveJump,
+        [AST_LOOP] = leaveLoop,
+        [AST_WHILE] = leaveWhile,
+        [AST_PRINT] = leavePrint,
+        [AST_INPUT] = leaveInput,
+        [AST_EXPR_STMT] = leaveExpressionStatement,
+        [AST_NUMBER] = leaveNumber,
+        [AST_STRING] = leaveString,
+        [AST_CHAR] = leaveLiteral,
+        [AST_BOOL] = leaveLiteral,
+        [AST_IDENT] = finishNode,
+        [AST_UNARY] = leaveUnary,
+        [AST_BINARY] = leaveBinary,
+        [AST_ASSIGN] = leaveAssignment,
+        [AST_TERNARY] = leaveJump,
+        [AST_CALL] = leaveCall,
+    },
+};
+
+// Compile the program at ast->root
+int compileProgram(const Ast *ast, const AstOrder *order, const Resolution *resolution, const TypeCheck *types,
+                   SourceLocation runFrom, Bytecode *bytecode, DiagnosticBuffer *diagnostics) {
+    Compiler compiler;
+    memset(&compiler, 0, sizeof(compiler));
+    compiler.ast = ast;
+    compiler.order = order;
+    compiler.resolution = resolution;
+    compiler.types = types;
+    compiler.bytecode = bytecode;
+    compiler.diagnostics = diagnostics;
+    compiler.runFrom = runFrom;
+    compiler.startJump = UINT32_MAX;
+    uint32_t slots = ast->nodeCount ? ast->nodeCount : 1;
+    compiler.numbers = calloc(slots, sizeof(uint32_t));
+    compiler.jumps = calloc(slots, sizeof(uint32_t));
+    compiler.labels = calloc(slots, sizeof(uint32_t));
+    if (!compiler.numbers || !compiler.jumps || !compiler.labels) {
+        fprintf(stderr, "Memory allocation failed for the compiler!\n");
+        compiler.failed = 1;
+    }
+
+    initBytecode(bytecode);
+    if (ast->root == 0 || ast->nodes[ast->root].kind != AST_PROGRAM) {
+        reportCompile(&compiler, ast->root, "Only a whole program can be compiled");
+    }
+    int ok = !compiler.failed && compiler.errorCount == 0 && numberDeclarations(&compiler) &&
+             visitTree(ast, order, &compileVisitor, &compiler) && !compiler.failed && compiler.errorCount == 0;
+
+    free(compiler.numbers);
+    free(compiler.jumps);
+    free(compiler.labels);
+    free(compiler.frames);
+    if (!ok) {
+        freeBytecode(bytecode);
+    }
+    return ok;
+}
@@ -0,0 +1,32 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include <stdint.h>
+#include "Ast.h"
+#include "Bytecode.h"
+#include "Diagnostics.h"
+#include "Resolver.h"
+#include "TypeChecker.h"
+#include "Traversal.h"
+
+// Bytecode compiler
+// Turns a resolved, type-checked tree into Bytecode in one walk over an AstOrder,
+// without recursion: each node emits its instruction when it is left, after its
+// operands, and the few places that need code between two children (the jump
+// after a यदि condition, the one over a ?: branch) are handled when that child
+// is left. Every कर्म and कक्षा is numbered up front, so calls can come before
+// the declaration; its code is placed where it is declared, behind a jump.
+//
+// The tree must be free of errors. A function whose body is still lazy compiles
+// to an empty one: expandCalledBodies() leaves only those that nothing calls.
+// The same holds for compileRegisterProgram() and lowerProgram().
+
+// Compile the program at ast->root, visiting the nodes in order (build it after
+// folding). Top-level statements that start before runFrom are compiled but
+// skipped when the program runs (NO_LOCATION runs them all), so a REPL can
+// recompile its whole session and run only the newest entry. Problems go to
+// diagnostics (may be NULL). Returns 1 on success, 0 on errors or if out of memory
+int compileProgram(const Ast *ast, const AstOrder *order, const Resolution *resolution, const TypeCheck *types,
+                   SourceLocation runFrom, Bytecode *bytecode, DiagnosticBuffer *diagnostics);
+
+#endif // COMPILER_H
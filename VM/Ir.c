@@ -0,0 +1,733 @@
+#include "Ir.h"
+#include "Interner.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+const IrOpcodeInfo irOpcodeInfo[IR_OPCODE_COUNT] = {
+    [IR_CONST]      = {"const", 0, 0},
+    [IR_PARAM]      = {"param", 0, 0},
+    [IR_PHI]        = {"phi", -1, 0},
+    [IR_ADD]        = {"add", 2, 0},
+    [IR_SUBTRACT]   = {"sub", 2, 0},
+    [IR_MULTIPLY]   = {"mul", 2, 0},
+    [IR_DIVIDE]     = {"div", 2, IR_SIDE_EFFECT},
+    [IR_CONCAT]     = {"concat", 2, 0},
+    [IR_LESS]       = {"lt", 2, 0},
+    [IR_LESS_EQUAL] = {"le", 2, 0},
+    [IR_EQUAL]      = {"eq", 2, 0},
+    [IR_NOT_EQUAL]  = {"ne", 2, 0},
+    [IR_NEGATE]     = {"neg", 1, 0},
+    [IR_NOT]        = {"not", 1, 0},
+    [IR_GET_GLOBAL] = {"get_global", 0, IR_READS_MEMORY},
+    [IR_SET_GLOBAL] = {"set_global", 1, IR_SIDE_EFFECT},
+    [IR_GET_FIELD]  = {"get_field", 0, IR_READS_MEMORY},
+    [IR_SET_FIELD]  = {"set_field", 1, IR_SIDE_EFFECT},
+    [IR_NEW]        = {"new", 0, IR_SIDE_EFFECT},
+    [IR_CALL]       = {"call", -1, IR_SIDE_EFFECT},
+    [IR_PRINT]      = {"print", 1, IR_SIDE_EFFECT},
+    [IR_PRINT_LINE] = {"print_line", 0, IR_SIDE_EFFECT},
+    [IR_INPUT]      = {"input", 0, IR_SIDE_EFFECT},
+    [IR_JUMP]       = {"jump", 0, IR_TERMINATOR | IR_SIDE_EFFECT},
+    [IR_BRANCH]     = {"branch", 1, IR_TERMINATOR | IR_SIDE_EFFECT},
+    [IR_RETURN]     = {"return", 0, IR_TERMINATOR | IR_SIDE_EFFECT},
+    [IR_HALT]       = {"halt", 0, IR_TERMINATOR | IR_SIDE_EFFECT},
+};
+
+const char *const irTypeNames[IR_TYPE_COUNT] = {"void", "int", "bool", "char", "string", "object"};
+
+// A piece of the arena. Requests are rounded up so every allocation is aligned
+// for any type
+#define IR_CHUNK_SIZE (64 * 1024)
+#define IR_ALIGN sizeof(max_align_t)
+
+typedef struct IrChunk {
+    struct IrChunk *next;
+    size_t used;
+    size_t size;
+    max_align_t data[];
+} IrChunk;
+
+void initIrProgram(IrProgram *program) {
+    memset(program, 0, sizeof(*program));
+}
+
+void freeIrProgram(IrProgram *program) {
+    IrChunk *chunk = program->arena;
+    while (chunk) {
+        IrChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(program->functions);
+    free(program->classes);
+    initIrProgram(program);
+}
+
+void *irAllocate(IrProgram *program, size_t size) {
+    size = (size + IR_ALIGN - 1) / IR_ALIGN * IR_ALIGN;
+    IrChunk *chunk = program->arena;
+    if (!chunk || chunk->size - chunk->used < size) {
+        size_t capacity = size > IR_CHUNK_SIZE ? size : IR_CHUNK_SIZE;
+        chunk = malloc(sizeof(IrChunk) + capacity);
+        if (!chunk) {
+            fprintf(stderr, "Memory allocation failed for the IR!\n");
+            program->failed = 1;
+            return NULL;
+        }
+        chunk->next = program->arena;
+        chunk->used = 0;
+        chunk->size = capacity;
+        program->arena = chunk;
+    }
+    void *memory = (unsigned char *)chunk->data + chunk->used;
+    chunk->used += size;
+    memset(memory, 0, size);
+    return memory;
+}
+
+// Make room for extra more items in a malloc'ed array
+static int reserve(IrProgram *program, void **items, uint32_t count, uint32_t *capacity, size_t size) {
+    if (count < *capacity) {
+        return 1;
+    }
+    uint32_t grown = *capacity ? *capacity * 2 : 16;
+    void *moved = realloc(*items, (size_t)grown * size);
+    if (!moved) {
+        fprintf(stderr, "Memory allocation failed for the IR!\n");
+        program->failed = 1;
+        return 0;
+    }
+    *items = moved;
+    *capacity = grown;
+    return 1;
+}
+
+// Make room for one more pointer in an arena array, copying it to a bigger one
+static int growArray(IrProgram *program, void ***items, uint32_t count, uint32_t *capacity) {
+    if (count < *capacity) {
+        return 1;
+    }
+    uint32_t grown = *capacity ? *capacity * 2 : 4;
+    void **moved = irAllocate(program, (size_t)grown * sizeof(void *));
+    if (!moved) {
+        return 0;
+    }
+    if (count > 0) {
+        memcpy(moved, *items, (size_t)count * sizeof(void *));
+    }
+    *items = moved;
+    *capacity = grown;
+    return 1;
+}
+
+uint32_t irAddFunction(IrProgram *program, IrFunction function) {
+    if (!reserve(program, (void **)&program->functions, program->functionCount, &program->functionCapacity,
+                 sizeof(IrFunction))) {
+        return UINT32_MAX;
+    }
+    program->functions[program->functionCount] = function;
+    return program->functionCount++;
+}
+
+uint32_t irAddClass(IrProgram *program, IrClass class) {
+    if (!reserve(program, (void **)&program->classes, program->classCount, &program->classCapacity,
+                 sizeof(IrClass))) {
+        return UINT32_MAX;
+    }
+    program->classes[program->classCount] = class;
+    return program->classCount++;
+}
+
+IrBlock *irNewBlock(IrProgram *program, IrFunction *function) {
+    IrBlock *block = irAllocate(program, sizeof(IrBlock));
+    if (!block || !growArray(program, (void ***)&function->blocks, function->blockCount, &function->blockCapacity)) {
+        return NULL;
+    }
+    block->id = function->nextBlockId++;
+    block->rpo = function->blockCount;
+    function->blocks[function->blockCount++] = block;
+    return block;
+}
+
+IrInstr *irNewInstr(IrProgram *program, IrFunction *function, IrOpcode op, IrType type, int64_t number,
+                    SourceLocation location) {
+    IrInstr *instr = irAllocate(program, sizeof(IrInstr));
+    if (!instr) {
+        return NULL;
+    }
+    instr->id = function->valueCount++;
+    instr->op = (uint8_t)op;
+    instr->type = (uint8_t)type;
+    instr->number = number;
+    instr->location = location;
+    return instr;
+}
+
+int irAddOperand(IrProgram *program, IrInstr *instr, IrInstr *value) {
+    if (!growArray(program, (void ***)&instr->operands, instr->operandCount, &instr->operandCapacity)) {
+        return 0;
+    }
+    instr->operands[instr->operandCount++] = value;
+    return 1;
+}
+
+void irAppend(IrBlock *block, IrInstr *instr) {
+    instr->block = block;
+    instr->prev = block->last;
+    instr->next = NULL;
+    if (block->last) {
+        block->last->next = instr;
+    } else {
+        block->first = instr;
+    }
+    block->last = instr;
+}
+
+void irInsertBefore(IrInstr *before, IrInstr *instr) {
+    IrBlock *block = before->block;
+    instr->block = block;
+    instr->prev = before->prev;
+    instr->next = before;
+    if (before->prev) {
+        before->prev->next = instr;
+    } else {
+        block->first = instr;
+    }
+    before->prev = instr;
+}
+
+void irInsertAfterPhis(IrBlock *block, IrInstr *instr) {
+    IrInstr *at = block->first;
+    while (at && at->op == IR_PHI) {
+        at = at->next;
+    }
+    if (at) {
+        irInsertBefore(at, instr);
+    } else {
+        irAppend(block, instr);
+    }
+}
+
+// The instruction keeps its operands, so a pass can still look at them
+void irRemove(IrInstr *instr) {
+    IrBlock *block = instr->block;
+    if (instr->prev) {
+        instr->prev->next = instr->next;
+    } else {
+        block->first = instr->next;
+    }
+    if (instr->next) {
+        instr->next->prev = instr->prev;
+    } else {
+        block->last = instr->prev;
+    }
+    instr->prev = NULL;
+    instr->next = NULL;
+    instr->block = NULL;
+}
+
+int irAddEdge(IrProgram *program, IrBlock *from, IrBlock *to) {
+    if (!growArray(program, (void ***)&to->preds, to->predCount, &to->predCapacity)) {
+        return 0;
+    }
+    to->preds[to->predCount++] = from;
+    from->succs[from->succCount++] = to;
+    return 1;
+}
+
+void irRemovePred(IrBlock *block, uint32_t index) {
+    memmove(block->preds + index, block->preds + index + 1, (block->predCount - index - 1) * sizeof(IrBlock *));
+    block->predCount--;
+    for (IrInstr *phi = block->first; phi && phi->op == IR_PHI; phi = phi->next) {
+        if (index < phi->operandCount) {
+            memmove(phi->operands + index, phi->operands + index + 1,
+                    (phi->operandCount - index - 1) * sizeof(IrInstr *));
+            phi->operandCount--;
+        }
+    }
+}
+
+uint32_t irPredIndex(const IrBlock *block, const IrBlock *pred) {
+    for (uint32_t i = 0; i < block->predCount; i++) {
+        if (block->preds[i] == pred) {
+            return i;
+        }
+    }
+    return UINT32_MAX;
+}
+
+IrInstr *irResolve(IrInstr *value) {
+    while (value && value->replacement) {
+        value = value->replacement;
+    }
+    return value;
+}
+
+void irResolveOperands(IrFunction *function) {
+    for (uint32_t b = 0; b < function->blockCount; b++) {
+        for (IrInstr *instr = function->blocks[b]->first; instr; instr = instr->next) {
+            for (uint32_t i = 0; i < instr->operandCount; i++) {
+                instr->operands[i] = irResolve(instr->operands[i]);
+            }
+        }
+    }
+}
+
+// Walk the blocks of a function from its entry. Sets order to the reachable
+// blocks in post-order and returns how many there are (UINT32_MAX if out of memory)
+static uint32_t postorderBlocks(IrFunction *function, IrBlock **order) {
+    uint32_t size = function->nextBlockId;
+    uint8_t *seen = calloc(size, 1);
+    IrBlock **stack = malloc((size_t)size * sizeof(IrBlock *));
+    uint32_t *nextSucc = malloc((size_t)size * sizeof(uint32_t));
+    if (!seen || !stack || !nextSucc) {
+        fprintf(stderr, "Memory allocation failed for the IR!\n");
+        free(seen);
+        free(stack);
+        free(nextSucc);
+        return UINT32_MAX;
+    }
+    uint32_t count = 0;
+    uint32_t depth = 0;
+    stack[depth] = function->blocks[0];
+    nextSucc[depth++] = 0;
+    seen[function->blocks[0]->id] = 1;
+    while (depth > 0) {
+        IrBlock *block = stack[depth - 1];
+        if (nextSucc[depth - 1] < block->succCount) {
+            IrBlock *succ = block->succs[nextSucc[depth - 1]++];
+            if (!seen[succ->id]) {
+                seen[succ->id] = 1;
+                stack[depth] = succ;
+                nextSucc[depth++] = 0;
+            }
+        } else {
+            order[count++] = block;
+            depth--;
+        }
+    }
+    free(seen);
+    free(stack);
+    free(nextSucc);
+    return count;
+}
+
+// Nearest common dominator of two blocks whose dominators are known so far
+static IrBlock *intersect(IrBlock *a, IrBlock *b) {
+    while (a != b) {
+        while (a->rpo > b->rpo) {
+            a = a->idom;
+        }
+        while (b->rpo > a->rpo) {
+            b = b->idom;
+        }
+    }
+    return a;
+}
+
+int irComputeDominators(IrProgram *program, IrFunction *function) {
+    if (function->blockCount == 0) {
+        return 1;
+    }
+    IrBlock **order = malloc((size_t)function->blockCount * sizeof(IrBlock *));
+    if (!order) {
+        fprintf(stderr, "Memory allocation failed for the IR!\n");
+        program->failed = 1;
+        return 0;
+    }
+    uint32_t count = postorderBlocks(function, order);
+    if (count == UINT32_MAX) {
+        free(order);
+        program->failed = 1;
+        return 0;
+    }
+
+    // Unreachable blocks go, with their edges into reachable ones
+    for (uint32_t b = 0; b < function->blockCount; b++) {
+        function->blocks[b]->rpo = UINT32_MAX;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        IrBlock *block = order[count - 1 - i];
+        block->rpo = i;
+        function->blocks[i] = block;
+    }
+    function->blockCount = count;
+    for (uint32_t b = 0; b < count; b++) {
+        IrBlock *block = function->blocks[b];
+        for (uint32_t p = block->predCount; p-- > 0;) {
+            if (block->preds[p]->rpo == UINT32_MAX) {
+                irRemovePred(block, p);
+            }
+        }
+        block->idom = NULL;
+        block->domChild = NULL;
+        block->domSibling = NULL;
+    }
+
+    // Immediate dominators, refined in reverse post-order until nothing changes
+    IrBlock *entry = function->blocks[0];
+    entry->idom = entry;
+    for (int changed = 1; changed;) {
+        changed = 0;
+        for (uint32_t b = 1; b < count; b++) {
+            IrBlock *block = function->blocks[b];
+            IrBlock *idom = NULL;
+            for (uint32_t p = 0; p < block->predCount; p++) {
+                IrBlock *pred = block->preds[p];
+                if (pred->idom) {
+                    idom = idom ? intersect(pred, idom) : pred;
+                }
+            }
+            if (idom != block->idom) {
+                block->idom = idom;
+                changed = 1;
+            }
+        }
+    }
+    entry->idom = NULL;
+
+    // The tree, children in reverse post-order, numbered in pre-order
+    for (uint32_t b = count; b-- > 1;) {
+        IrBlock *block = function->blocks[b];
+        block->domSibling = block->idom->domChild;
+        block->idom->domChild = block;
+    }
+    IrBlock **stack = order;
+    uint32_t depth = 0;
+    uint32_t number = 0;
+    stack[depth++] = entry;
+    while (depth > 0) {
+        IrBlock *block = stack[--depth];
+        block->domFirst = number++;
+        for (IrBlock *child = block->domChild; child; child = child->domSibling) {
+            stack[depth++] = child;
+        }
+    }
+    // A subtree ends where the next pre-order number outside it would start:
+    // compute it bottom-up, children having later rpo than their dominator
+    for (uint32_t b = count; b-- > 0;) {
+        IrBlock *block = function->blocks[b];
+        block->domLast = block->domFirst;
+        for (IrBlock *child = block->domChild; child; child = child->domSibling) {
+            if (child->domLast > block->domLast) {
+                block->domLast = child->domLast;
+            }
+        }
+    }
+    free(order);
+    return 1;
+}
+
+IrBlock *irSplitEdge(IrProgram *program, IrFunction *function, IrBlock *from, uint32_t succIndex) {
+    IrBlock *to = from->succs[succIndex];
+    IrBlock *split = irNewBlock(program, function);
+    IrInstr *jump = split ? irNewInstr(program, function, IR_JUMP, IR_TYPE_VOID, 0, from->last->location) : NULL;
+    if (!jump || !growArray(program, (void ***)&split->preds, 0, &split->predCapacity)) {
+        return NULL;
+    }
+    // The new block takes from's place among to's predecessors, so the φ
+    // operands stay where they are
+    irAppend(split, jump);
+    to->preds[irPredIndex(to, from)] = split;
+    split->preds[split->predCount++] = from;
+    split->succs[split->succCount++] = to;
+    split->sealed = 1;
+    from->succs[succIndex] = split;
+    return split;
+}
+
+int irSplitCriticalEdges(IrProgram *program, IrFunction *function) {
+    uint32_t count = function->blockCount;
+    for (uint32_t b = 0; b < count; b++) {
+        IrBlock *block = function->blocks[b];
+        if (block->succCount < 2) {
+            continue;
+        }
+        for (uint32_t s = 0; s < block->succCount; s++) {
+            if (block->succs[s]->predCount >= 2 && !irSplitEdge(program, function, block, s)) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+// Verification
+
+typedef struct {
+    const IrFunction *function;
+    DiagnosticBuffer *diagnostics;
+    uint32_t *position;        // By value id: its place in its block
+    int ok;
+} IrVerifier;
+
+static void reportIr(IrVerifier *verifier, const IrInstr *instr, const char *message) {
+    verifier->ok = 0;
+    if (verifier->diagnostics) {
+        addDiagnostic(verifier->diagnostics, DIAGNOSTIC_ERROR, instr ? instr->location : NO_LOCATION, 0,
+                      verifier->function->name, message);
+    }
+}
+
+// Whether a block belongs to the function being checked
+static int ownsBlock(const IrFunction *function, const IrBlock *block) {
+    return block && block->rpo < function->blockCount && function->blocks[block->rpo] == block;
+}
+
+// Types an instruction's operands must have, and its own
+static void checkTypes(IrVerifier *verifier, const IrInstr *instr) {
+    IrType type = (IrType)instr->type;
+    IrType first = instr->operandCount > 0 ? (IrType)instr->operands[0]->type : IR_TYPE_VOID;
+    IrType second = instr->operandCount > 1 ? (IrType)instr->operands[1]->type : IR_TYPE_VOID;
+    int ok = 1;
+    switch (instr->op) {
+        case IR_CONST:
+        case IR_PARAM:
+        case IR_GET_GLOBAL:
+        case IR_GET_FIELD:
+            ok = type != IR_TYPE_VOID;
+            break;
+        case IR_PHI:
+            for (uint32_t i = 0; i < instr->operandCount; i++) {
+                ok = ok && instr->operands[i]->type == type;
+            }
+            ok = ok && type != IR_TYPE_VOID;
+            break;
+        case IR_ADD:
+        case IR_SUBTRACT:
+        case IR_MULTIPLY:
+        case IR_DIVIDE:
+            ok = type == IR_TYPE_INT && first == IR_TYPE_INT && second == IR_TYPE_INT;
+            break;
+        case IR_CONCAT:
+            ok = type == IR_TYPE_STRING && first == IR_TYPE_STRING && second == IR_TYPE_STRING;
+            break;
+        case IR_LESS:
+        case IR_LESS_EQUAL:
+            ok = type == IR_TYPE_BOOL && first == second && (first == IR_TYPE_INT || first == IR_TYPE_CHAR);
+            break;
+        case IR_EQUAL:
+        case IR_NOT_EQUAL:
+            ok = type == IR_TYPE_BOOL && first == second && first != IR_TYPE_VOID;
+            break;
+        case IR_NEGATE:
+            ok = type == IR_TYPE_INT && first == IR_TYPE_INT;
+            break;
+        case IR_NOT:
+            ok = type == IR_TYPE_BOOL && first == IR_TYPE_BOOL;
+            break;
+        case IR_NEW:
+            ok = type == IR_TYPE_OBJECT;
+            break;
+        case IR_INPUT:
+            ok = type == IR_TYPE_INT || type == IR_TYPE_STRING;
+            break;
+        case IR_BRANCH:
+            ok = type == IR_TYPE_VOID && first == IR_TYPE_BOOL;
+            break;
+        default:
+            ok = type == IR_TYPE_VOID;
+            for (uint32_t i = 0; i < instr->operandCount; i++) {
+                ok = ok && instr->operands[i]->type != IR_TYPE_VOID;
+            }
+            break;
+    }
+    if (!ok) {
+        reportIr(verifier, instr, "IR: operand or result of the wrong type");
+    }
+}
+
+// Whether the definition of value is available at use (operand index of use)
+static int definitionReaches(IrVerifier *verifier, const IrInstr *use, uint32_t index) {
+    const IrInstr *value = use->operands[index];
+    const IrBlock *definedIn = value->block;
+    if (!ownsBlock(verifier->function, definedIn)) {
+        return 0;
+    }
+    if (use->op == IR_PHI) {
+        // At the end of the matching predecessor
+        return index < use->block->predCount && irDominates(definedIn, use->block->preds[index]);
+    }
+    if (definedIn == use->block) {
+        return verifier->position[value->id] < verifier->position[use->id];
+    }
+    return irDominates(definedIn, use->block);
+}
+
+int irVerify(const IrProgram *program, const IrFunction *function, DiagnosticBuffer *diagnostics) {
+    (void)program;
+    IrVerifier verifier = {function, diagnostics, NULL, 1};
+    if (function->blockCount == 0) {
+        reportIr(&verifier, NULL, "IR: function without an entry block");
+        return 0;
+    }
+    verifier.position = calloc(function->valueCount ? function->valueCount : 1, sizeof(uint32_t));
+    if (!verifier.position) {
+        fprintf(stderr, "Memory allocation failed for the IR!\n");
+        return 0;
+    }
+
+    // Structure: links, φ nodes first, one terminator last, edges both ways
+    for (uint32_t b = 0; b < function->blockCount; b++) {
+        const IrBlock *block = function->blocks[b];
+        if (b == 0 && block->predCount != 0) {
+            reportIr(&verifier, block->first, "IR: the entry block has predecessors");
+        }
+        uint32_t position = 0;
+        int pastPhis = 0;
+        for (const IrInstr *instr = block->first; instr; instr = instr->next) {
+            verifier.position[instr->id] = position++;
+            const IrOpcodeInfo *info = &irOpcodeInfo[instr->op];
+            if (instr->block != block || (instr->next ? instr->next->prev != instr : block->last != instr)) {
+                reportIr(&verifier, instr, "IR: broken instruction list");
+            }
+            if (instr->op == IR_PHI) {
+                if (pastPhis) {
+                    reportIr(&verifier, instr, "IR: phi after other instructions");
+                }
+                if (instr->operandCount != block->predCount) {
+                    reportIr(&verifier, instr, "IR: phi does not have one operand per predecessor");
+                }
+            } else {
+                pastPhis = 1;
+                if (info->operands >= 0 && instr->operandCount != (uint32_t)info->operands) {
+                    reportIr(&verifier, instr, "IR: wrong number of operands");
+                }
+            }
+            if ((info->flags & IR_TERMINATOR) != 0 && instr != block->last) {
+                reportIr(&verifier, instr, "IR: terminator in the middle of a block");
+            }
+        }
+        const IrInstr *last = block->last;
+        if (!last || (irOpcodeInfo[last->op].flags & IR_TERMINATOR) == 0) {
+            reportIr(&verifier, last, "IR: block does not end with a terminator");
+            continue;
+        }
+        uint32_t successors = last->op == IR_JUMP ? 1 : last->op == IR_BRANCH ? 2 : 0;
+        if (block->succCount != successors) {
+            reportIr(&verifier, last, "IR: successors do not match the terminator");
+        }
+        for (uint32_t s = 0; s < block->succCount; s++) {
+            if (!ownsBlock(function, block->succs[s]) || irPredIndex(block->succs[s], block) == UINT32_MAX) {
+                reportIr(&verifier, last, "IR: successor without the matching predecessor");
+            }
+        }
+        for (uint32_t p = 0; p < block->predCount; p++) {
+            const IrBlock *pred = block->preds[p];
+            if (!ownsBlock(function, pred) || (pred->succs[0] != block && pred->succs[1] != block)) {
+                reportIr(&verifier, block->first, "IR: predecessor without the matching successor");
+            }
+        }
+    }
+
+    // Operands: types, and definitions that dominate their uses
+    for (uint32_t b = 0; b < function->blockCount; b++) {
+        for (const IrInstr *instr = function->blocks[b]->first; instr; instr = instr->next) {
+            int defined = 1;
+            for (uint32_t i = 0; i < instr->operandCount; i++) {
+                if (!instr->operands[i] || !definitionReaches(&verifier, instr, i)) {
+                    defined = 0;
+                }
+            }
+            if (!defined) {
+                reportIr(&verifier, instr, "IR: use of a value its definition does not dominate");
+            } else {
+                checkTypes(&verifier, instr);
+            }
+        }
+    }
+    free(verifier.position);
+    return verifier.ok;
+}
+
+// Printing
+
+static void printValue(const IrInstr *value, FILE *out) {
+    fprintf(out, "v%u", value->id);
+}
+
+static void printInstr(const IrInstr *instr, FILE *out) {
+    fputs("    ", out);
+    if (instr->type != IR_TYPE_VOID) {
+        printValue(instr, out);
+        fprintf(out, ":%s = ", irTypeNames[instr->type]);
+    }
+    fputs(irOpcodeInfo[instr->op].name, out);
+    switch (instr->op) {
+        case IR_CONST:
+            if (instr->type == IR_TYPE_STRING) {
+                fprintf(out, " \"%ls\"", symbolText((SymbolId)instr->number));
+            } else {
+                fprintf(out, " %lld", (long long)instr->number);
+            }
+            break;
+        case IR_PARAM:
+        case IR_GET_GLOBAL:
+        case IR_GET_FIELD:
+            fprintf(out, " %lld", (long long)instr->number);
+            break;
+        case IR_SET_GLOBAL:
+        case IR_SET_FIELD:
+            fprintf(out, " %lld,", (long long)instr->number);
+            break;
+        case IR_NEW:
+            fprintf(out, " class %lld", (long long)instr->number);
+            break;
+        case IR_CALL:
+            fprintf(out, " f%lld", (long long)instr->number);
+            break;
+        default:
+            break;
+    }
+    for (uint32_t i = 0; i < instr->operandCount; i++) {
+        fputs(i == 0 ? " " : ", ", out);
+        if (instr->op == IR_PHI) {
+            fputc('[', out);
+            printValue(instr->operands[i], out);
+            fprintf(out, " b%u]", instr->block->preds[i]->id);
+        } else {
+            printValue(instr->operands[i], out);
+        }
+    }
+    if (instr->op == IR_JUMP || instr->op == IR_BRANCH) {
+        fputs(" ->", out);
+        for (uint32_t s = 0; s < instr->block->succCount; s++) {
+            fprintf(out, " b%u", instr->block->succs[s]->id);
+        }
+    }
+    fputc('\n', out);
+}
+
+void printIrFunction(const IrProgram *program, uint32_t index, FILE *out) {
+    const IrFunction *function = &program->functions[index];
+    fprintf(out, "function f%u", index);
+    if (function->name != NO_SYMBOL) {
+        fprintf(out, " %ls", symbolText(function->name));
+    }
+    fprintf(out, " (%u params%s):\n", function->paramCount, function->classBody ? ", class body" : "");
+    for (uint32_t b = 0; b < function->blockCount; b++) {
+        const IrBlock *block = function->blocks[b];
+        fprintf(out, "  b%u:", block->id);
+        for (uint32_t p = 0; p < block->predCount; p++) {
+            fprintf(out, "%s b%u", p == 0 ? "  ; preds" : ",", block->preds[p]->id);
+        }
+        if (block->idom) {
+            fprintf(out, "%s idom b%u", block->predCount ? ";" : "  ;", block->idom->id);
+        }
+        fputc('\n', out);
+        for (const IrInstr *instr = block->first; instr; instr = instr->next) {
+            printInstr(instr, out);
+        }
+    }
+}
+
+void printIrProgram(const IrProgram *program, FILE *out) {
+    fprintf(out, "%u globals\n", program->globalCount);
+    for (uint32_t c = 0; c < program->classCount; c++) {
+        fprintf(out, "class %u: %u fields, body f%u\n", c, program->classes[c].fieldCount, program->classes[c].init);
+    }
+    for (uint32_t f = 0; f < program->functionCount; f++) {
+        printIrFunction(program, f, out);
+    }
+}
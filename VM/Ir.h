@@ -0,0 +1,223 @@
+#ifndef IR_H
+#define IR_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "Diagnostics.h"
+#include "SourceManager.h"  // For SourceLocation
+
+// SSA intermediate representation
+// The layer between the checked tree and the backends, where optimizations are
+// written once. A function is a control-flow graph of basic blocks, and a block
+// is a doubly linked list of instructions: its φ nodes first, then ordinary
+// instructions, then exactly one terminator (jump, branch, return or halt).
+// An instruction that yields something is itself that value. It is defined
+// once and typed, and its operands point straight at the instructions that
+// define them. A φ has one operand per predecessor of its block, in the order
+// of block->preds.
+//
+// Variables of a function and the program's own globals (those no कर्म or
+// कक्षा touches) are SSA values. Other globals and fields stay in memory, read
+// and written by GET / SET instructions, since a call may change them.
+//
+// Everything of a program (instructions, blocks, operand and predecessor lists)
+// is allocated from one arena and freed with it. A value that a pass replaces
+// keeps a pointer to its replacement until the operands pointing at it are
+// rewritten (irResolve).
+
+typedef enum {
+    IR_TYPE_VOID,              // No value
+    IR_TYPE_INT,
+    IR_TYPE_BOOL,
+    IR_TYPE_CHAR,
+    IR_TYPE_STRING,            // An interned SymbolId
+    IR_TYPE_OBJECT,            // An object of some कक्षा
+    IR_TYPE_COUNT
+} IrType;
+
+typedef enum {
+    IR_CONST,                  // number: the value (a SymbolId for strings)
+    IR_PARAM,                  // number: which parameter
+    IR_PHI,                    // One operand per predecessor
+    IR_ADD,                    // Integer arithmetic on two operands (wraps around)
+    IR_SUBTRACT,
+    IR_MULTIPLY,
+    IR_DIVIDE,                 // Fails at run time on division by zero
+    IR_CONCAT,                 // Join two strings
+    IR_LESS,                   // Compare two operands (x > y is built as y < x)
+    IR_LESS_EQUAL,
+    IR_EQUAL,
+    IR_NOT_EQUAL,
+    IR_NEGATE,                 // One operand
+    IR_NOT,
+    IR_GET_GLOBAL,             // number: slot
+    IR_SET_GLOBAL,             // number: slot; operand: value
+    IR_GET_FIELD,              // number: slot of the object a class body initializes
+    IR_SET_FIELD,              // number: slot; operand: value
+    IR_NEW,                    // number: class; a new object, its class body run on it
+    IR_CALL,                   // number: function; operands: arguments
+    IR_PRINT,                  // operand: value printed as its type (number: class name symbol for objects)
+    IR_PRINT_LINE,
+    IR_INPUT,                  // A line read as the instruction's type (int or string)
+    IR_JUMP,                   // To succs[0]
+    IR_BRANCH,                 // operand: condition; to succs[0] if सत्य, succs[1] if असत्य
+    IR_RETURN,
+    IR_HALT,
+    IR_OPCODE_COUNT
+} IrOpcode;
+
+// Opcode flags
+#define IR_TERMINATOR   0x01   // Ends a block
+#define IR_SIDE_EFFECT  0x02   // Must run even if nothing uses its value (it writes, prints or may fail)
+#define IR_READS_MEMORY 0x04   // Its value depends on globals or fields, not only on its operands
+
+// What an opcode looks like, for the printer, the verifier and passes
+typedef struct {
+    const char *name;
+    int8_t operands;           // Number of operands (-1: any)
+    uint8_t flags;
+} IrOpcodeInfo;
+
+extern const IrOpcodeInfo irOpcodeInfo[IR_OPCODE_COUNT];
+extern const char *const irTypeNames[IR_TYPE_COUNT];
+
+typedef struct IrInstr {
+    struct IrInstr *prev;      // In its block
+    struct IrInstr *next;
+    struct IrBlock *block;
+    struct IrInstr **operands;
+    uint32_t operandCount;
+    uint32_t operandCapacity;
+    uint32_t id;               // Value number within its function (printed as vN)
+    uint8_t op;                // IrOpcode
+    uint8_t type;              // IrType of its value (IR_TYPE_VOID if none)
+    int64_t number;            // Constant, parameter index, slot, function, class or symbol
+    SourceLocation location;   // What it was built from, for runtime errors
+    struct IrInstr *replacement; // Value that replaced this one (NULL if none)
+} IrInstr;
+
+typedef struct IrBlock {
+    IrInstr *first;
+    IrInstr *last;             // Its terminator once the block is complete
+    struct IrBlock **preds;
+    uint32_t predCount;
+    uint32_t predCapacity;
+    struct IrBlock *succs[2];  // Given by its terminator
+    uint32_t succCount;
+    uint32_t id;               // Printed as bN
+    // Dominator tree (irComputeDominators)
+    struct IrBlock *idom;      // Immediate dominator (NULL for the entry)
+    struct IrBlock *domChild;  // First block it immediately dominates
+    struct IrBlock *domSibling; // Next block with the same immediate dominator
+    uint32_t rpo;              // Position in reverse post-order
+    uint32_t domFirst;         // Pre-order number in the dominator tree
+    uint32_t domLast;          // Largest pre-order number in its subtree
+    uint8_t sealed;            // Every predecessor is known (while the IR is being built)
+} IrBlock;
+
+typedef struct {
+    IrBlock **blocks;          // blocks[0] is the entry; in reverse post-order after irComputeDominators
+    uint32_t blockCount;
+    uint32_t blockCapacity;
+    uint32_t valueCount;       // Instruction ids handed out
+    uint32_t nextBlockId;
+    uint32_t paramCount;
+    uint32_t declaration;      // AST_FUNC_DECL / AST_CLASS_DECL node (0 for the program)
+    uint32_t name;             // SymbolId of its name (NO_SYMBOL for the program)
+    int classBody;             // Runs on a new object, whose fields it reads and writes
+} IrFunction;
+
+// A class: its objects' size and the function that initializes them
+typedef struct {
+    uint32_t fieldCount;
+    uint32_t init;
+    uint32_t declaration;
+} IrClass;
+
+typedef struct {
+    struct IrChunk *arena;
+    IrFunction *functions;     // Numbered like VmFunction: functions[0] is the program
+    uint32_t functionCount;
+    uint32_t functionCapacity;
+    IrClass *classes;          // Numbered like VmClass
+    uint32_t classCount;
+    uint32_t classCapacity;
+    uint32_t globalCount;
+    int failed;                // Out of memory
+} IrProgram;
+
+void initIrProgram(IrProgram *program);
+
+// Free the arena and everything in it
+void freeIrProgram(IrProgram *program);
+
+// Zeroed memory from the arena (NULL and program->failed set if out of memory)
+void *irAllocate(IrProgram *program, size_t size);
+
+// Add a function or class. Returns its index, UINT32_MAX if out of memory
+uint32_t irAddFunction(IrProgram *program, IrFunction function);
+uint32_t irAddClass(IrProgram *program, IrClass class);
+
+// Add an empty block to a function (NULL if out of memory)
+IrBlock *irNewBlock(IrProgram *program, IrFunction *function);
+
+// A new instruction without operands, not yet in a block (NULL if out of memory)
+IrInstr *irNewInstr(IrProgram *program, IrFunction *function, IrOpcode op, IrType type, int64_t number,
+                    SourceLocation location);
+
+// Add an operand at the end of an instruction's list. Returns 0 if out of memory
+int irAddOperand(IrProgram *program, IrInstr *instr, IrInstr *value);
+
+// Put an instruction at the end of a block, before another one, or after a
+// block's φ nodes; take one out of its block
+void irAppend(IrBlock *block, IrInstr *instr);
+void irInsertBefore(IrInstr *before, IrInstr *instr);
+void irInsertAfterPhis(IrBlock *block, IrInstr *instr);
+void irRemove(IrInstr *instr);
+
+// Add an edge from one block to another: a successor of from, and a
+// predecessor of to (φ nodes of to get no operand for it). Returns 0 if out of memory
+int irAddEdge(IrProgram *program, IrBlock *from, IrBlock *to);
+
+// Remove predecessor index of a block and the matching operand of its φ nodes
+void irRemovePred(IrBlock *block, uint32_t index);
+
+// Index of pred among block's predecessors (UINT32_MAX if it is not one)
+uint32_t irPredIndex(const IrBlock *block, const IrBlock *pred);
+
+// The value that stands for value now, following replacements
+IrInstr *irResolve(IrInstr *value);
+
+// Point every operand at the value that stands for it now
+void irResolveOperands(IrFunction *function);
+
+// Drop the blocks the entry cannot reach, order the others in reverse
+// post-order and build the dominator tree (Cooper, Harvey and Kennedy's
+// iterative algorithm). Returns 0 if out of memory
+int irComputeDominators(IrProgram *program, IrFunction *function);
+
+// Whether a dominates b (both of the same function, dominators computed)
+static inline int irDominates(const IrBlock *a, const IrBlock *b) {
+    return a->domFirst <= b->domFirst && b->domFirst <= a->domLast;
+}
+
+// Put a new block on the edge from a block to its successor succIndex, in
+// place of from among the successor's predecessors. Returns it (NULL if out of
+// memory). Dominators must be computed again afterwards
+IrBlock *irSplitEdge(IrProgram *program, IrFunction *function, IrBlock *from, uint32_t succIndex);
+
+// Put a block on every edge from a block with several successors to one with
+// several predecessors, so copies for φ nodes have somewhere to go. Returns 0
+// if out of memory. Dominators must be computed again afterwards
+int irSplitCriticalEdges(IrProgram *program, IrFunction *function);
+
+// Check a function's structure, types and SSA form (every use dominated by its
+// definition); dominators must be up to date. Problems are reported to
+// diagnostics (may be NULL). Returns 1 if it is well formed
+int irVerify(const IrProgram *program, const IrFunction *function, DiagnosticBuffer *diagnostics);
+
+// Print a function or the whole program as text
+void printIrFunction(const IrProgram *program, uint32_t index, FILE *out);
+void printIrProgram(const IrProgram *program, FILE *out);
+
+#endif // IR_H
@@ -0,0 +1,906 @@
+#include "IrBuilder.h"
+#include "utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Function, class body or program being built
+typedef struct {
+    uint32_t function;         // Its IrFunction
+    IrBlock *current;          // Block new instructions go to
+} BuildFrame;
+
+// Value a variable has at the end of a block so far
+typedef struct {
+    const IrBlock *block;      // NULL for an empty slot
+    uint32_t declaration;
+    IrInstr *value;
+} Definition;
+
+// A φ whose operands are still to be looked up in its block's predecessors
+typedef struct {
+    IrInstr *phi;
+    uint32_t declaration;
+} PendingPhi;
+
+typedef struct {
+    PendingPhi *items;
+    uint32_t count;
+    uint32_t capacity;
+} PendingPhis;
+
+typedef struct {
+    const Ast *ast;
+    const AstOrder *order;
+    const Resolution *resolution;
+    const TypeCheck *types;
+    IrProgram *program;
+    DiagnosticBuffer *diagnostics;
+    uint32_t *numbers;         // By node: IrFunction of a कर्म, IrClass of a कक्षा
+    IrInstr **values;          // By node: its value (a चक्र: its end; && and ?:, the left or
+                               // first value until the join)
+    IrBlock **joins;           // By node: where its branches meet (जबतक: its header, चक्र: its body)
+    IrBlock **alternatives;    // By node: its else branch (जबतक, चक्र: its exit)
+    uint8_t *shared;           // By declaration: a global some कर्म or कक्षा uses
+    BuildFrame *frames;        // Innermost last
+    uint32_t frameCount;
+    uint32_t frameCapacity;
+    Definition *definitions;   // Open addressing on (block, declaration)
+    uint32_t definitionCount;
+    uint32_t definitionCapacity;
+    PendingPhis incomplete;    // In blocks that are not sealed yet
+    PendingPhis ready;         // To be completed now
+    SourceLocation runFrom;
+    IrBlock *waiting;          // The program's entry, until the first statement to run starts
+    uint32_t errorCount;
+    int failed;                // Out of memory
+} IrBuilder;
+
+static void reportBuild(IrBuilder *builder, uint32_t node, const char *message) {
+    builder->errorCount++;
+    addDiagnostic(builder->diagnostics, DIAGNOSTIC_ERROR, astLocation(builder->ast, node), 0, NO_SYMBOL, message);
+}
+
+static BuildFrame *currentFrame(IrBuilder *builder) {
+    return &builder->frames[builder->frameCount - 1];
+}
+
+static IrFunction *currentFunction(IrBuilder *builder) {
+    return &builder->program->functions[currentFrame(builder)->function];
+}
+
+static IrType irTypeOf(TypeId type) {
+    switch (type) {
+        case TYPE_INT:    return IR_TYPE_INT;
+        case TYPE_BOOL:   return IR_TYPE_BOOL;
+        case TYPE_CHAR:   return IR_TYPE_CHAR;
+        case TYPE_STRING: return IR_TYPE_STRING;
+        default:          return type >= TYPE_BUILTIN_COUNT ? IR_TYPE_OBJECT : IR_TYPE_VOID;
+    }
+}
+
+static IrType nodeType(IrBuilder *builder, uint32_t node) {
+    return irTypeOf(typeOfNode(builder->types, node));
+}
+
+static IrBlock *newBlock(IrBuilder *builder) {
+    IrBlock *block = irNewBlock(builder->program, currentFunction(builder));
+    if (!block) {
+        builder->failed = 1;
+    }
+    return block;
+}
+
+// Append an instruction built from node with up to two operands to the current
+// block. Returns it, NULL if out of memory
+static IrInstr *emit(IrBuilder *builder, uint32_t node, IrOpcode op, IrType type, int64_t number, IrInstr *a,
+                     IrInstr *b) {
+    IrProgram *program = builder->program;
+    IrInstr *instr = irNewInstr(program, currentFunction(builder), op, type, number, astLocation(builder->ast, node));
+    if (!instr || (a && !irAddOperand(program, instr, a)) || (b && !irAddOperand(program, instr, b))) {
+        builder->failed = 1;
+        return NULL;
+    }
+    irAppend(currentFrame(builder)->current, instr);
+    return instr;
+}
+
+// End the current block with a jump, or a branch on condition
+static void jumpTo(IrBuilder *builder, uint32_t node, IrBlock *target) {
+    IrBlock *from = currentFrame(builder)->current;
+    if (emit(builder, node, IR_JUMP, IR_TYPE_VOID, 0, NULL, NULL) && !irAddEdge(builder->program, from, target)) {
+        builder->failed = 1;
+    }
+}
+
+static void branchTo(IrBuilder *builder, uint32_t node, IrInstr *condition, IrBlock *ifTrue, IrBlock *ifFalse) {
+    IrBlock *from = currentFrame(builder)->current;
+    if (emit(builder, node, IR_BRANCH, IR_TYPE_VOID, 0, condition, NULL) &&
+        (!irAddEdge(builder->program, from, ifTrue) || !irAddEdge(builder->program, from, ifFalse))) {
+        builder->failed = 1;
+    }
+}
+
+// A φ at the start of block, without operands yet
+static IrInstr *newPhi(IrBuilder *builder, IrBlock *block, IrType type) {
+    IrInstr *phi = irNewInstr(builder->program, currentFunction(builder), IR_PHI, type, 0, NO_LOCATION);
+    if (!phi) {
+        builder->failed = 1;
+        return NULL;
+    }
+    if (block->first) {
+        irInsertBefore(block->first, phi);
+    } else {
+        irAppend(block, phi);
+    }
+    return phi;
+}
+
+static int addPending(IrBuilder *builder, PendingPhis *list, IrInstr *phi, uint32_t declaration) {
+    if (list->count == list->capacity) {
+        uint32_t grown = list->capacity ? list->capacity * 2 : 64;
+        PendingPhi *items = realloc(list->items, grown * sizeof(PendingPhi));
+        if (!items) {
+            fprintf(stderr, "Memory allocation failed for the IR builder!\n");
+            builder->failed = 1;
+            return 0;
+        }
+        list->items = items;
+        list->capacity = grown;
+    }
+    list->items[list->count++] = (PendingPhi){phi, declaration};
+    return 1;
+}
+
+// Variables
+
+// Whether a variable is an SSA value. Fields, and globals a कर्म or कक्षा uses
+// (or that the VM keeps for the next REPL entry), stay in memory
+static int isSsaVariable(IrBuilder *builder, uint32_t declaration) {
+    switch (builder->resolution->storage[declaration]) {
+        case STORAGE_LOCAL:
+            return 1;
+        case STORAGE_GLOBAL:
+            return builder->runFrom == NO_LOCATION && !builder->shared[declaration];
+        default:
+            return 0;
+    }
+}
+
+static uint32_t definitionSlot(const IrBuilder *builder, const IrBlock *block, uint32_t declaration) {
+    uint64_t key = (uint64_t)(uintptr_t)block * 0x9E3779B97F4A7C15ull ^ (uint64_t)declaration * 0xC2B2AE3D27D4EB4Full;
+    uint32_t mask = builder->definitionCapacity - 1;
+    uint32_t slot = (uint32_t)(key >> 32) & mask;
+    while (builder->definitions[slot].block &&
+           (builder->definitions[slot].block != block || builder->definitions[slot].declaration != declaration)) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+// Record value as the variable's value at the end of block so far
+static int defineVariable(IrBuilder *builder, const IrBlock *block, uint32_t declaration, IrInstr *value) {
+    if ((builder->definitionCount + 1) * 2 > builder->definitionCapacity) {
+        uint32_t grown = builder->definitionCapacity * 2;
+        Definition *old = builder->definitions;
+        uint32_t oldCapacity = builder->definitionCapacity;
+        builder->definitions = calloc(grown, sizeof(Definition));
+        if (!builder->definitions) {
+            fprintf(stderr, "Memory allocation failed for the IR builder!\n");
+            builder->definitions = old;
+            builder->failed = 1;
+            return 0;
+        }
+        builder->definitionCapacity = grown;
+        for (uint32_t i = 0; i < oldCapacity; i++) {
+            if (old[i].block) {
+                builder->definitions[definitionSlot(builder, old[i].block, old[i].declaration)] = old[i];
+            }
+        }
+        free(old);
+    }
+    Definition *definition = &builder->definitions[definitionSlot(builder, block, declaration)];
+    if (!definition->block) {
+        builder->definitionCount++;
+    }
+    *definition = (Definition){block, declaration, value};
+    return 1;
+}
+
+// Value of a variable never assigned on the way to a read: 0, as the VM
+// starts every slot
+static IrInstr *undefinedValue(IrBuilder *builder, IrType type) {
+    IrFunction *function = currentFunction(builder);
+    IrInstr *zero = irNewInstr(builder->program, function, IR_CONST, type, 0, NO_LOCATION);
+    if (!zero) {
+        builder->failed = 1;
+        return NULL;
+    }
+    irInsertAfterPhis(function->blocks[0], zero);
+    return zero;
+}
+
+// Value of a variable at the end of block. Follows single predecessors back
+// to an assignment; where several paths meet, places a φ whose operands are
+// looked up later (builder->ready, or builder->incomplete until the block is sealed)
+static IrInstr *lookupVariable(IrBuilder *builder, IrBlock *block, uint32_t declaration, IrType type) {
+    IrBlock *at = block;
+    IrInstr *value;
+    for (;;) {
+        const Definition *definition = &builder->definitions[definitionSlot(builder, at, declaration)];
+        if (definition->block) {
+            value = definition->value;
+            break;
+        }
+        if (!at->sealed || at->predCount > 1) {
+            value = newPhi(builder, at, type);
+            if (!value || !addPending(builder, at->sealed ? &builder->ready : &builder->incomplete, value, declaration)) {
+                return NULL;
+            }
+            break;
+        }
+        if (at->predCount == 0) {
+            value = undefinedValue(builder, type);
+            break;
+        }
+        at = at->preds[0];
+    }
+    // Remembered where the search ended (so a φ answers the reads that reach it
+    // while its operands are looked up) and where it started
+    if (!value || !defineVariable(builder, at, declaration, value) ||
+        (at != block && !defineVariable(builder, block, declaration, value))) {
+        return NULL;
+    }
+    return value;
+}
+
+// Look up the operands of the φ nodes waiting in builder->ready
+static int completePhis(IrBuilder *builder) {
+    while (builder->ready.count > 0) {
+        PendingPhi pending = builder->ready.items[--builder->ready.count];
+        IrBlock *block = pending.phi->block;
+        for (uint32_t p = 0; p < block->predCount; p++) {
+            IrInstr *operand = lookupVariable(builder, block->preds[p], pending.declaration, pending.phi->type);
+            if (!operand || !irAddOperand(builder->program, pending.phi, operand)) {
+                builder->failed = 1;
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+// Every predecessor of block is known: complete the φ nodes placed in it
+static void sealBlock(IrBuilder *builder, IrBlock *block) {
+    block->sealed = 1;
+    for (uint32_t i = 0; i < builder->incomplete.count;) {
+        PendingPhi pending = builder->incomplete.items[i];
+        if (pending.phi->block == block) {
+            builder->incomplete.items[i] = builder->incomplete.items[--builder->incomplete.count];
+            if (!addPending(builder, &builder->ready, pending.phi, pending.declaration)) {
+                return;
+            }
+        } else {
+            i++;
+        }
+    }
+    completePhis(builder);
+}
+
+// Value of the variable a declaration declares, read by node
+static IrInstr *readVariable(IrBuilder *builder, uint32_t node, uint32_t declaration) {
+    IrType type = nodeType(builder, declaration);
+    if (!isSsaVariable(builder, declaration)) {
+        IrOpcode op = builder->resolution->storage[declaration] == STORAGE_FIELD ? IR_GET_FIELD : IR_GET_GLOBAL;
+        return emit(builder, node, op, type, slotOf(builder->resolution, declaration), NULL, NULL);
+    }
+    IrInstr *value = lookupVariable(builder, currentFrame(builder)->current, declaration, type);
+    return value && completePhis(builder) ? value : NULL;
+}
+
+static void writeVariable(IrBuilder *builder, uint32_t node, uint32_t declaration, IrInstr *value) {
+    if (!isSsaVariable(builder, declaration)) {
+        IrOpcode op = builder->resolution->storage[declaration] == STORAGE_FIELD ? IR_SET_FIELD : IR_SET_GLOBAL;
+        emit(builder, node, op, IR_TYPE_VOID, slotOf(builder->resolution, declaration), value, NULL);
+    } else if (!defineVariable(builder, currentFrame(builder)->current, declaration, value)) {
+        builder->failed = 1;
+    }
+}
+
+// Functions
+
+// Remove the φ nodes that merge a single value (apart from themselves), which
+// may make others redundant, until none is left
+static void removeRedundantPhis(IrFunction *function) {
+    for (int changed = 1; changed;) {
+        changed = 0;
+        for (uint32_t b = 0; b < function->blockCount; b++) {
+            IrInstr *next;
+            for (IrInstr *phi = function->blocks[b]->first; phi && phi->op == IR_PHI; phi = next) {
+                next = phi->next;
+                IrInstr *same = NULL;
+                int redundant = 1;
+                for (uint32_t i = 0; i < phi->operandCount && redundant; i++) {
+                    IrInstr *operand = irResolve(phi->operands[i]);
+                    if (operand != phi && operand != same) {
+                        redundant = same == NULL;
+                        same = operand;
+                    }
+                }
+                if (redundant && same) {
+                    phi->replacement = same;
+                    irRemove(phi);
+                    changed = 1;
+                }
+            }
+        }
+    }
+    irResolveOperands(function);
+}
+
+// Start building a function in a new entry block
+static int pushFrame(IrBuilder *builder, uint32_t function) {
+    if (builder->frameCount == builder->frameCapacity) {
+        uint32_t grown = builder->frameCapacity ? builder->frameCapacity * 2 : 16;
+        BuildFrame *frames = realloc(builder->frames, grown * sizeof(BuildFrame));
+        if (!frames) {
+            fprintf(stderr, "Memory allocation failed for the IR builder!\n");
+            builder->failed = 1;
+            return 0;
+        }
+        builder->frames = frames;
+        builder->frameCapacity = grown;
+    }
+    builder->frames[builder->frameCount++] = (BuildFrame){function, NULL};
+    IrBlock *entry = newBlock(builder);
+    if (!entry) {
+        return 0;
+    }
+    entry->sealed = 1;
+    currentFrame(builder)->current = entry;
+    return 1;
+}
+
+// End the innermost function with its last instruction (a return, or the
+// program's halt), put it into shape and check it
+static void popFrame(IrBuilder *builder, uint32_t node, IrOpcode last) {
+    emit(builder, node, last, IR_TYPE_VOID, 0, NULL, NULL);
+    IrFunction *function = currentFunction(builder);
+    if (!builder->failed && irComputeDominators(builder->program, function)) {
+        removeRedundantPhis(function);
+        if (!irVerify(builder->program, function, builder->diagnostics)) {
+            builder->errorCount++;
+        }
+    } else {
+        builder->failed = 1;
+    }
+    builder->frameCount--;
+}
+
+// Number every कर्म and कक्षा in pre-order, as the compilers do, and make sure
+// nothing in the tree is left that cannot run. Also finds the globals that a
+// कर्म or कक्षा uses
+static int numberDeclarations(IrBuilder *builder) {
+    const Ast *ast = builder->ast;
+    const AstOrder *order = builder->order;
+    IrProgram *program = builder->program;
+    uint32_t *owners = calloc(ast->nodeCount ? ast->nodeCount : 1, sizeof(uint32_t));  // By node: कर्म or कक्षा around it
+    if (!owners || irAddFunction(program, (IrFunction){.name = NO_SYMBOL}) == UINT32_MAX) {
+        free(owners);
+        return 0;
+    }
+    for (uint32_t p = 0; p < order->count; p++) {
+        uint32_t node = order->preorder[p];
+        const AstNode *n = &ast->nodes[node];
+        uint32_t parent = order->parents[node];
+        AstKind parentKind = ast->nodes[parent].kind;
+        owners[node] = parentKind == AST_FUNC_DECL || parentKind == AST_CLASS_DECL ? parent : owners[parent];
+        uint32_t number = 0;
+        if (n->kind == AST_FUNC_DECL) {
+            number = irAddFunction(program, (IrFunction){.paramCount = ast->nodes[n->b].b, .declaration = node,
+                                                         .name = astSymbol(ast, n->a)});
+        } else if (n->kind == AST_CLASS_DECL) {
+            uint32_t init = irAddFunction(program, (IrFunction){.declaration = node, .name = astSymbol(ast, n->a),
+                                                                .classBody = 1});
+            number = init == UINT32_MAX ? init
+                                        : irAddClass(program, (IrClass){slotOf(builder->resolution, node), init, node});
+        } else if (n->kind == AST_ERROR) {
+            reportBuild(builder, node, "Cannot compile code with syntax errors");
+        } else if ((n->kind == AST_IDENT || n->kind == AST_CALL || (n->kind == AST_VAR_DECL && n->c != 0)) &&
+                   declarationOf(builder->resolution, node) == 0) {
+            reportBuild(builder, node, "Cannot compile a use of an unresolved name");
+        } else if (typeOfNode(builder->types, node) == TYPE_ERROR) {
+            reportBuild(builder, node, "Cannot compile code with type errors");
+        } else if (n->kind == AST_IDENT && owners[node] != 0) {
+            uint32_t declaration = declarationOf(builder->resolution, node);
+            if (builder->resolution->storage[declaration] == STORAGE_GLOBAL) {
+                builder->shared[declaration] = 1;
+            }
+        }
+        if (number == UINT32_MAX) {
+            builder->failed = 1;
+            free(owners);
+            return 0;
+        }
+        builder->numbers[node] = number;
+    }
+    free(owners);
+    return builder->errorCount == 0;
+}
+
+// Top-level statements before runFrom are built into a block nothing jumps
+// to; the program's entry continues with the first one at or after it
+static void startStatement(IrBuilder *builder, uint32_t node) {
+    if (builder->waiting && builder->order->parents[node] == builder->ast->root &&
+        astLocation(builder->ast, node) >= builder->runFrom) {
+        emit(builder, node, IR_HALT, IR_TYPE_VOID, 0, NULL, NULL);
+        currentFrame(builder)->current = builder->waiting;
+        builder->waiting = NULL;
+    }
+}
+
+// Opcode of a binary or compound assignment operator on values of type. Sets
+// swapped if it takes its operands the other way round (x > y is y < x)
+static IrOpcode operatorOpcode(uint8_t op, TypeId type, int *swapped) {
+    *swapped = op == OPERATOR_GREATER || op == OPERATOR_GREATER_EQUAL;
+    switch (op) {
+        case OPERATOR_PLUS:
+        case OPERATOR_PLUS_ASSIGN:   return type == TYPE_STRING ? IR_CONCAT : IR_ADD;
+        case OPERATOR_MINUS:
+        case OPERATOR_MINUS_ASSIGN:  return IR_SUBTRACT;
+        case OPERATOR_STAR:
+        case OPERATOR_STAR_ASSIGN:   return IR_MULTIPLY;
+        case OPERATOR_SLASH:
+        case OPERATOR_SLASH_ASSIGN:  return IR_DIVIDE;
+        case OPERATOR_LESS:
+        case OPERATOR_GREATER:       return IR_LESS;
+        case OPERATOR_LESS_EQUAL:
+        case OPERATOR_GREATER_EQUAL: return IR_LESS_EQUAL;
+        case OPERATOR_EQUAL:         return IR_EQUAL;
+        default:                     return IR_NOT_EQUAL;
+    }
+}
+
+// Called when any node has been built: control flow between it and the next
+// child of its parent
+static int finishNode(void *context, uint32_t node) {
+    IrBuilder *builder = context;
+    const Ast *ast = builder->ast;
+    uint32_t parent = builder->order->parents[node];
+    const AstNode *p = &ast->nodes[parent];
+    BuildFrame *frame = currentFrame(builder);
+    IrInstr *value = builder->values[node];
+    switch (p->kind) {
+        case AST_IF:
+        case AST_TERNARY:
+            if (node == p->a) {
+                IrBlock *then = newBlock(builder);
+                IrBlock *otherwise = newBlock(builder);
+                if (!then || !otherwise) {
+                    return 0;
+                }
+                branchTo(builder, node, value, then, otherwise);
+                then->sealed = 1;
+                // Without an else, the branch goes straight to where the two paths meet
+                if (p->c != 0) {
+                    otherwise->sealed = 1;
+                    builder->alternatives[parent] = otherwise;
+                } else {
+                    builder->joins[parent] = otherwise;
+                }
+                frame->current = then;
+            } else if (node == p->b && p->c != 0) {
+                IrBlock *join = newBlock(builder);
+                if (!join) {
+                    return 0;
+                }
+                builder->values[parent] = value;
+                builder->joins[parent] = join;
+                jumpTo(builder, node, join);
+                frame->current = builder->alternatives[parent];
+            }
+            break;
+        case AST_BINARY:
+            if (p->op == OPERATOR_AND && node == p->a) {
+                // असत्य goes straight to the join, as the result
+                IrBlock *right = newBlock(builder);
+                IrBlock *join = newBlock(builder);
+                if (!right || !join) {
+                    return 0;
+                }
+                branchTo(builder, node, value, right, join);
+                right->sealed = 1;
+                builder->values[parent] = value;
+                builder->joins[parent] = join;
+                frame->current = right;
+            }
+            break;
+        case AST_WHILE:
+            if (node == p->a) {
+                IrBlock *body = newBlock(builder);
+                IrBlock *exit = newBlock(builder);
+                if (!body || !exit) {
+                    return 0;
+                }
+                branchTo(builder, node, value, body, exit);
+                body->sealed = 1;
+                exit->sealed = 1;
+                builder->alternatives[parent] = exit;
+                frame->current = body;
+            }
+            break;
+        case AST_LOOP:
+            if (node == p->b) {
+                // Enter the body only if the start is not past the end; the
+                // same test sits at the bottom of the body (leaveLoop)
+                IrBlock *body = newBlock(builder);
+                IrBlock *exit = newBlock(builder);
+                if (!body || !exit) {
+                    return 0;
+                }
+                builder->values[parent] = value;
+                IrInstr *start = readVariable(builder, node, p->a);
+                IrInstr *test = emit(builder, node, IR_LESS_EQUAL, IR_TYPE_BOOL, 0, start, value);
+                branchTo(builder, node, test, body, exit);
+                builder->joins[parent] = body;
+                builder->alternatives[parent] = exit;
+                frame->current = body;
+            }
+            break;
+        case AST_PRINT: {
+            TypeId type = typeOfNode(builder->types, node);
+            int64_t name = type >= TYPE_BUILTIN_COUNT ? typeInfo(&builder->types->table, type)->name : 0;
+            emit(builder, node, IR_PRINT, IR_TYPE_VOID, name, value, NULL);
+            break;
+        }
+        default:
+            break;
+    }
+    return !builder->failed;
+}
+
+// Visitor functions. Each returns 0 to stop the walk once memory ran out
+static int enterProgram(void *context, uint32_t node) {
+    IrBuilder *builder = context;
+    (void)node;
+    if (!pushFrame(builder, 0)) {
+        return 0;
+    }
+    if (builder->runFrom != NO_LOCATION) {
+        builder->waiting = currentFrame(builder)->current;
+        IrBlock *skipped = newBlock(builder);
+        if (!skipped) {
+            return 0;
+        }
+        skipped->sealed = 1;
+        currentFrame(builder)->current = skipped;
+    }
+    return 1;
+}
+
+static int enterStatement(void *context, uint32_t node) {
+    startStatement(context, node);
+    return 1;
+}
+
+static int enterDeclaration(void *context, uint32_t node) {
+    IrBuilder *builder = context;
+    startStatement(builder, node);
+    uint32_t number = builder->numbers[node];
+    if (builder->ast->nodes[node].kind == AST_CLASS_DECL) {
+        number = builder->program->classes[number].init;
+    }
+    return pushFrame(builder, number);
+}
+
+// The condition is tested in a header of its own, which the body jumps back to
+static int enterWhile(void *context, uint32_t node) {
+    IrBuilder *builder = context;
+    startStatement(builder, node);
+    IrBlock *header = newBlock(builder);
+    if (!header) {
+        return 0;
+    }
+    jumpTo(builder, node, header);
+    builder->joins[node] = header;
+    currentFrame(builder)->current = header;
+    return !builder->failed;
+}
+
+static int leaveProgram(void *context, uint32_t node) {
+    IrBuilder *builder = context;
+    if (builder->waiting) {
+        emit(builder, node, IR_HALT, IR_TYPE_VOID, 0, NULL, NULL);
+        currentFrame(builder)->current = builder->waiting;
+        builder->waiting = NULL;
+    }
+    popFrame(builder, node, IR_HALT);
+    builder->program->globalCount = slotOf(builder->resolution, node);
+    return !builder->failed;
+}
+
+static int leaveDeclaration(void *context, uint32_t node) {
+    IrBuilder *builder = context;
+    popFrame(builder, node, IR_RETURN);
+    return finishNode(builder, node);
+}
+
+static int leaveVariable(void *context, uint32_t node) {
+    IrBuilder *builder = context;
+    const AstNode *n = &builder->ast->nodes[node];
+    IrType type = nodeType(builder, node);
+    IrInstr *value;
+    if (builder->ast->nodes[builder->order->parents[node]].kind == AST_PARAMS) {
+        // Arguments are in place when the function starts
+        value = emit(builder, node, IR_PARAM, type, slotOf(builder->resolution, node), NULL, NULL);
+    } else if (n->b != 0) {
+        value = builder->values[n->b];
+    } else if (n->c != 0) {
+        // The object is stored only once its class body has run
+        uint32_t class = declarationOf(builder->resolution, node);
+        value = emit(builder, node, IR_NEW, type, builder->numbers[class], NULL, NULL);
+    } else {
+        value = emit(builder, node, IR_CONST, type, 0, NULL, NULL);
+    }
+    if (value) {
+        writeVariable(builder, node, node, value);
+    }
+    return finishNode(builder, node);
+}
+
+// Where the branches of a यदि meet
+static int leaveIf(void *context, uint32_t node) {
+    IrBuilder *builder = context;
+    IrBlock *join = builder->joins[node];
+    jumpTo(builder, node, join);
+    sealBlock(builder, join);
+    currentFrame(builder)->current = join;
+    return finishNode(builder, node);
+}
+
+static int leaveWhile(void *context, uint32_t node) {
+    IrBuilder *builder = context;
+    IrBlock *header = builder->joins[node];
+    jumpTo(builder, node, header);
+    sealBlock(builder, header);
+    currentFrame(builder)->current = builder->alternatives[node];
+    return finishNode(builder, node);
+}
+
+// Step the variable, then test it against the end and go round again
+static int leaveLoop(void *context, uint32_t node) {
+    IrBuilder *builder = context;
+    uint32_t variable = builder->ast->nodes[node].a;
+    IrInstr *end = builder->values[node];
+    IrInstr *current = readVariable(builder, node, variable);
+    IrInstr *one = emit(builder, node, IR_CONST, IR_TYPE_INT, 1, NULL, NULL);
+    IrInstr *next = emit(builder, node, IR_ADD, IR_TYPE_INT, 0, current, one);
+    if (!next) {
+        return 0;
+    }
+    writeVariable(builder, node, variable, next);
+    IrInstr *test = emit(builder, node, IR_LESS_EQUAL, IR_TYPE_BOOL, 0, next, end);
+    IrBlock *body = builder->joins[node];
+    IrBlock *exit = builder->alternatives[node];
+    branchTo(builder, node, test, body, exit);
+    sealBlock(builder, body);
+    sealBlock(builder, exit);
+    currentFrame(builder)->current = exit;
+    return finishNode(builder, node);
+}
+
+static int leavePrint(void *context, uint32_t node) {
+    IrBuilder *builder = context;
+    emit(builder, node, IR_PRINT_LINE, IR_TYPE_VOID, 0, NULL, NULL);
+    return finishNode(builder, node);
+}
+
+static int leaveInput(void *context, uint32_t node) {
+    IrBuilder *builder = context;
+    uint32_t target = builder->ast->nodes[node].a;
+    IrInstr *value = emit(builder, node, IR_INPUT, nodeType(builder, target), 0, NULL, NULL);
+    if (value) {
+        writeVariable(builder, node, declarationOf(builder->resolution, target), value);
+    }
+    return finishNode(builder, node);
+}
+
+static int leaveIdentifier(void *context, uint32_t node) {
+    IrBuilder *builder = context;
+    const AstNode *p = &builder->ast->nodes[builder->order->parents[node]];
+    // The target of = and प्रवे is only stored to
+    if ((p->kind == AST_ASSIGN && p->a == node && p->op == OPERATOR_ASSIGN) || p->kind == AST_INPUT) {
+        return 1;
+    }
+    builder->values[node] = readVariable(builder, node, declarationOf(builder->resolution, node));
+    return finishNode(builder, node);
+}
+
+static int leaveNumber(void *context, uint32_t node) {
+    IrBuilder *builder = context;
+    int64_t value = astNumberValue(&builder->ast->nodes[node]);
+    builder->values[node] = emit(builder, node, IR_CONST, IR_TYPE_INT, value, NULL, NULL);
+    return finishNode(builder, node);
+}
+
+static int leaveString(void *context, uint32_t node) {
+    IrBuilder *builder = context;
+    SymbolId text = astSymbol(builder->ast, builder->ast->nodes[node].a);
+    builder->values[node] = emit(builder, node, IR_CONST, IR_TYPE_STRING, text, NULL, NULL);
+    return finishNode(builder, node);
+}
+
+// Characters and booleans
+static int leaveLiteral(void *context, uint32_t node) {
+    IrBuilder *builder = context;
+    builder->values[node] = emit(builder, node, IR_CONST, nodeType(builder, node), builder->ast->nodes[node].a,
+                                 NULL, NULL);
+    return finishNode(builder, node);
+}
+
+static int leaveUnary(void *context, uint32_t node) {
+    IrBuilder *builder = context;
+    const AstNode *n = &builder->ast->nodes[node];
+    IrInstr *operand = builder->values[n->a];
+    if (n->op == OPERATOR_NOT) {
+        operand = emit(builder, node, IR_NOT, IR_TYPE_BOOL, 0, operand, NULL);
+    } else if (n->op == OPERATOR_MINUS) {
+        operand = emit(builder, node, IR_NEGATE, IR_TYPE_INT, 0, operand, NULL);
+    }
+    builder->values[node] = operand;
+    return finishNode(builder, node);
+}
+
+// A value that is one of two, depending on the path that reached the join
+static int leaveJoin(IrBuilder *builder, uint32_t node, IrInstr *second) {
+    IrBlock *join = builder->joins[node];
+    jumpTo(builder, node, join);
+    sealBlock(builder, join);
+    currentFrame(builder)->current = join;
+    IrInstr *phi = newPhi(builder, join, nodeType(builder, node));
+    if (!phi || !irAddOperand(builder->program, phi, builder->values[node]) ||
+        !irAddOperand(builder->program, phi, second)) {
+        builder->failed = 1;
+        return 0;
+    }
+    builder->values[node] = phi;
+    return finishNode(builder, node);
+}
+
+static int leaveBinary(void *context, uint32_t node) {
+    IrBuilder *builder = context;
+    const AstNode *n = &builder->ast->nodes[node];
+    if (n->op == OPERATOR_AND) {
+        return leaveJoin(builder, node, builder->values[n->b]);
+    }
+    int swapped;
+    IrOpcode op = operatorOpcode(n->op, typeOfNode(builder->types, n->a), &swapped);
+    IrInstr *left = builder->values[n->a];
+    IrInstr *right = builder->values[n->b];
+    builder->values[node] = emit(builder, node, op, nodeType(builder, node), 0, swapped ? right : left,
+                                 swapped ? left : right);
+    return finishNode(builder, node);
+}
+
+static int leaveAssignment(void *context, uint32_t node) {
+    IrBuilder *builder = context;
+    const AstNode *n = &builder->ast->nodes[node];
+    IrInstr *value = builder->values[n->b];
+    if (n->op != OPERATOR_ASSIGN) {
+        // The target's current value was read when it was left
+        int swapped;
+        IrOpcode op = operatorOpcode(n->op, typeOfNode(builder->types, n->a), &swapped);
+        value = emit(builder, node, op, nodeType(builder, n->a), 0, builder->values[n->a], value);
+    }
+    if (value) {
+        writeVariable(builder, node, declarationOf(builder->resolution, n->a), value);
+    }
+    builder->values[node] = value;
+    return finishNode(builder, node);
+}
+
+static int leaveTernary(void *context, uint32_t node) {
+    IrBuilder *builder = context;
+    return leaveJoin(builder, node, builder->values[builder->ast->nodes[node].c]);
+}
+
+static int leaveCall(void *context, uint32_t node) {
+    IrBuilder *builder = context;
+    uint32_t function = builder->numbers[declarationOf(builder->resolution, node)];
+    IrInstr *call = emit(builder, node, IR_CALL, IR_TYPE_VOID, function, NULL, NULL);
+    uint32_t arguments = astChildCount(builder->ast, node);
+    for (uint32_t i = 0; call && i < arguments; i++) {
+        if (!irAddOperand(builder->program, call, builder->values[astChild(builder->ast, node, i)])) {
+            builder->failed = 1;
+        }
+    }
+    return finishNode(builder, node);
+}
+
+static const AstVisitor buildVisitor = {
+    .enter = {
+        [AST_PROGRAM] = enterProgram,
+        [AST_BLOCK] = enterStatement,
+        [AST_VAR_DECL] = enterStatement,
+        [AST_FUNC_DECL] = enterDeclaration,
+        [AST_CLASS_DECL] = enterDeclaration,
+        [AST_IF] = enterStatement,
+        [AST_LOOP] = enterStatement,
+        [AST_WHILE] = enterWhile,
+        [AST_PRINT] = enterStatement,
+        [AST_INPUT] = enterStatement,
+        [AST_EXPR_STMT] = enterStatement,
+    },
+    .leave = {
+        [AST_PROGRAM] = leaveProgram,
+        [AST_BLOCK] = finishNode,
+        [AST_VAR_DECL] = leaveVariable,
+        [AST_FUNC_DECL] = leaveDeclaration,
+        [AST_PARAMS] = finishNode,
+        [AST_CLASS_DECL] = leaveDeclaration,
+        [AST_IF] = leaveIf,
+        [AST_LOOP] = leaveLoop,
+        [AST_WHILE] = leaveWhile,
+        [AST_PRINT] = leavePrint,
+        [AST_INPUT] = leaveInput,
+        [AST_EXPR_STMT] = finishNode,
+        [AST_NUMBER] = leaveNumber,
+        [AST_STRING] = leaveString,
+        [AST_CHAR] = leaveLiteral,
+        [AST_BOOL] = leaveLiteral,
+        [AST_IDENT] = leaveIdentifier,
+        [AST_UNARY] = leaveUnary,
+        [AST_BINARY] = leaveBinary,
+        [AST_ASSIGN] = leaveAssignment,
+        [AST_TERNARY] = leaveTernary,
+        [AST_CALL] = leaveCall,
+    },
+};
+
+// Lower the program at ast->root into SSA form
+int lowerProgram(const Ast *ast, const AstOrder *order, const Resolution *resolution, const TypeCheck *types,
+                 SourceLocation runFrom, IrProgram *program, DiagnosticBuffer *diagnostics) {
+    IrBuilder builder;
+    memset(&builder, 0, sizeof(builder));
+    builder.ast = ast;
+    builder.order = order;
+    builder.resolution = resolution;
+    builder.types = types;
+    builder.program = program;
+    builder.diagnostics = diagnostics;
+    builder.runFrom = runFrom;
+    uint32_t slots = ast->nodeCount ? ast->nodeCount : 1;
+    builder.numbers = calloc(slots, sizeof(uint32_t));
+    builder.values = calloc(slots, sizeof(IrInstr *));
+    builder.joins = calloc(slots, sizeof(IrBlock *));
+    builder.alternatives = calloc(slots, sizeof(IrBlock *));
+    builder.shared = calloc(slots, sizeof(uint8_t));
+    builder.definitionCapacity = 1024;
+    builder.definitions = calloc(builder.definitionCapacity, sizeof(Definition));
+    if (!builder.numbers || !builder.values || !builder.joins || !builder.alternatives || !builder.shared ||
+        !builder.definitions) {
+        fprintf(stderr, "Memory allocation failed for the IR builder!\n");
+        builder.failed = 1;
+    }
+
+    initIrProgram(program);
+    if (ast->root == 0 || ast->nodes[ast->root].kind != AST_PROGRAM) {
+        reportBuild(&builder, ast->root, "Only a whole program can be compiled");
+    }
+    int ok = !builder.failed && builder.errorCount == 0 && numberDeclarations(&builder) &&
+             visitTree(ast, order, &buildVisitor, &builder) && !builder.failed && !program->failed &&
+             builder.errorCount == 0;
+
+    free(builder.numbers);
+    free(builder.values);
+    free(builder.joins);
+    free(builder.alternatives);
+    free(builder.shared);
+    free(builder.frames);
+    free(builder.definitions);
+    free(builder.incomplete.items);
+    free(builder.ready.items);
+    if (!ok) {
+        freeIrProgram(program);
+    }
+    return ok;
+}
@@ -0,0 +1,34 @@
+#ifndef IR_BUILDER_H
+#define IR_BUILDER_H
+
+#include "Ast.h"
+#include "Diagnostics.h"
+#include "Ir.h"
+#include "Resolver.h"
+#include "TypeChecker.h"
+#include "Traversal.h"
+
+// Lowering into SSA
+// Builds the IR of a checked program in one walk of the tree, numbering
+// functions and classes as the compilers do. Control flow statements become
+// blocks as they are left. A variable's value is looked up where it is read,
+// following the blocks back to its assignments, and a φ is placed only where
+// several of them meet (Braun et al., "Simple and Efficient Construction of
+// Static Single Assignment Form"). A block whose predecessors are not all known
+// yet (a loop header before its back edge) gets placeholder φ nodes that are
+// filled in once it is sealed. Redundant φ nodes are removed when the function
+// is done. Every function is verified before it is handed on.
+//
+// चक्र loops are built with their test at the bottom, guarded once on entry,
+// so an iteration runs one conditional jump. When runFrom is given (the REPL),
+// top-level statements before it are built into blocks that are never
+// reached, which drop out, and globals stay in memory since the VM keeps them
+// for the next entry.
+
+// Lower the program at ast->root into program. Same contract as
+// compileProgram(): code that cannot be compiled is reported to diagnostics
+// and 0 returned, with program freed
+int lowerProgram(const Ast *ast, const AstOrder *order, const Resolution *resolution, const TypeCheck *types,
+                 SourceLocation runFrom, IrProgram *program, DiagnosticBuffer *diagnostics);
+
+#endif // IR_BUILDER_H
@@ -0,0 +1,849 @@
+#include "IrCodegen.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define NO_REGISTER UINT32_MAX
+#define NO_BLOCK UINT32_MAX
+
+// A jump whose target is filled in once every block has been placed
+typedef struct {
+    uint32_t offset;           // Of the jump instruction (its last operand is the target)
+    uint32_t block;            // Layout index of the target
+} PendingJump;
+
+// A register-to-register copy of the φ copies at the end of a block
+typedef struct {
+    uint32_t target;
+    uint32_t source;
+} Move;
+
+typedef struct {
+    IrProgram *program;
+    Bytecode *bytecode;
+    IrFunction *function;
+    // By value id
+    uint32_t *position;        // Where it is defined in the layout (φ nodes: the start of their block)
+    uint32_t *end;             // Last position where it is needed
+    uint32_t *reg;             // Its register (NO_REGISTER if it has none)
+    uint32_t *uses;            // Operands that are it
+    uint32_t *base;            // CALL / NEW: first register of the callee's frame
+    IrInstr **hint;            // A φ it flows into
+    uint8_t *inRegister;       // It needs a register: not a compare-and-jump, nor a constant
+                               // that all its uses take as an immediate
+    uint8_t *fused;            // A comparison its block's branch jumps on
+    // By layout index
+    uint32_t *blockEnd;        // Position of its terminator
+    uint32_t *blockOffset;     // Where its code starts (NO_BLOCK if it has none)
+    uint32_t *forward;         // The block a jump to it lands in, once empty blocks are skipped
+    uint32_t *marks;           // Value whose liveness walk last reached it (id + 1)
+    uint32_t *stack;
+    // Uses grouped by value, as (block, position) pairs
+    uint32_t *useFirst;        // By value id: index of its first use (useFirst[id + 1] ends them)
+    uint32_t *useBlock;
+    uint32_t *usePosition;
+    // Registers, by number: one past the last position of the value in it (0: free)
+    uint32_t *occupied;
+    uint32_t registerCapacity;
+    uint32_t firstRegister;    // The program's registers start after the globals
+    uint32_t maxRegister;      // Highest register used, plus one
+    uint32_t scratch;          // Register for breaking cycles of φ copies (NO_REGISTER if unused)
+    PendingJump *jumps;
+    uint32_t jumpCount;
+    uint32_t jumpCapacity;
+    Move *moves;
+    uint32_t moveCapacity;
+    int failed;                // Out of memory
+} Codegen;
+
+static void outOfMemory(Codegen *codegen) {
+    if (!codegen->failed) {
+        fprintf(stderr, "Memory allocation failed for the code generator!\n");
+    }
+    codegen->failed = 1;
+}
+
+// Instruction selection
+
+static int fitsInt32(int64_t value) {
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+static int isComparison(const IrInstr *instr) {
+    return instr->op == IR_LESS || instr->op == IR_LESS_EQUAL || instr->op == IR_EQUAL || instr->op == IR_NOT_EQUAL;
+}
+
+// Operand of an ADD or SUBTRACT that goes into ADD_INT as an immediate, -1 if none
+static int immediateOperand(const IrInstr *instr) {
+    const IrInstr *right = instr->operands[instr->operandCount - 1];
+    if (instr->op == IR_ADD) {
+        if (right->op == IR_CONST && fitsInt32(right->number)) {
+            return 1;
+        }
+        return instr->operands[0]->op == IR_CONST && fitsInt32(instr->operands[0]->number) ? 0 : -1;
+    }
+    if (instr->op == IR_SUBTRACT && right->op == IR_CONST && right->number > INT32_MIN &&
+        right->number <= INT32_MAX) {
+        return 1;
+    }
+    return -1;
+}
+
+// Whether operand index of instr can be a constant that is not in a register:
+// added as an immediate, or loaded straight into where it goes (a φ's register,
+// an argument)
+static int takesConstant(const IrInstr *instr, uint32_t index) {
+    if (instr->op == IR_PHI || instr->op == IR_CALL) {
+        return 1;
+    }
+    return (instr->op == IR_ADD || instr->op == IR_SUBTRACT) && immediateOperand(instr) == (int)index;
+}
+
+static uint32_t emitCode(Codegen *codegen, RegisterOpcode op, uint32_t a, uint32_t b, uint32_t c,
+                         SourceLocation location) {
+    const uint32_t operands[3] = {a, b, c};
+    uint32_t offset = emitInstruction(codegen->bytecode, op, operands, location);
+    if (offset == UINT32_MAX) {
+        codegen->failed = 1;
+    }
+    return offset;
+}
+
+static void emitJump(Codegen *codegen, RegisterOpcode op, uint32_t a, uint32_t b, uint32_t block,
+                     SourceLocation location) {
+    uint32_t offset = op == REG_JUMP ? emitCode(codegen, op, 0, 0, 0, location)
+                    : op == REG_JUMP_IF_FALSE ? emitCode(codegen, op, a, 0, 0, location)
+                                              : emitCode(codegen, op, a, b, 0, location);
+    if (offset == UINT32_MAX) {
+        return;
+    }
+    if (codegen->jumpCount == codegen->jumpCapacity) {
+        uint32_t grown = codegen->jumpCapacity ? codegen->jumpCapacity * 2 : 64;
+        PendingJump *jumps = realloc(codegen->jumps, grown * sizeof(PendingJump));
+        if (!jumps) {
+            outOfMemory(codegen);
+            return;
+        }
+        codegen->jumps = jumps;
+        codegen->jumpCapacity = grown;
+    }
+    codegen->jumps[codegen->jumpCount++] = (PendingJump){offset, block};
+}
+
+// Put a constant in register target
+static void loadConstant(Codegen *codegen, uint32_t target, const IrInstr *constant) {
+    if (fitsInt32(constant->number)) {
+        emitCode(codegen, REG_LOAD_INT, target, (uint32_t)(int32_t)constant->number, 0, constant->location);
+        return;
+    }
+    uint32_t index = addConstant(codegen->bytecode, (VmValue){.number = constant->number});
+    if (index == UINT32_MAX) {
+        codegen->failed = 1;
+        return;
+    }
+    emitCode(codegen, REG_LOAD_CONSTANT, target, index, 0, constant->location);
+}
+
+// Put a value in register target
+static void place(Codegen *codegen, uint32_t target, const IrInstr *value, SourceLocation location) {
+    if (!codegen->inRegister[value->id]) {
+        loadConstant(codegen, target, value);
+    } else if (codegen->reg[value->id] != target) {
+        emitCode(codegen, REG_MOVE, target, codegen->reg[value->id], 0, location);
+    }
+}
+
+// Layout and liveness
+
+// Drop φ nodes of blocks with a single predecessor (they just pass a value on),
+// then split critical edges and order the blocks
+static int prepareFunction(Codegen *codegen) {
+    IrFunction *function = codegen->function;
+    int removed = 0;
+    for (uint32_t b = 0; b < function->blockCount; b++) {
+        IrBlock *block = function->blocks[b];
+        IrInstr *next;
+        for (IrInstr *phi = block->first; phi && phi->op == IR_PHI && block->predCount == 1; phi = next) {
+            next = phi->next;
+            phi->replacement = phi->operands[0];
+            irRemove(phi);
+            removed = 1;
+        }
+    }
+    if (removed) {
+        irResolveOperands(function);
+    }
+    return irSplitCriticalEdges(codegen->program, function) && irComputeDominators(codegen->program, function);
+}
+
+// Number the instructions in layout order, count uses and decide what needs a register
+static void numberValues(Codegen *codegen) {
+    IrFunction *function = codegen->function;
+    uint32_t position = 0;
+    for (uint32_t b = 0; b < function->blockCount; b++) {
+        IrBlock *block = function->blocks[b];
+        uint32_t start = position++;
+        for (IrInstr *instr = block->first; instr; instr = instr->next) {
+            codegen->position[instr->id] = instr->op == IR_PHI ? start : position++;
+            for (uint32_t i = 0; i < instr->operandCount; i++) {
+                codegen->uses[instr->operands[i]->id]++;
+            }
+        }
+        codegen->blockEnd[b] = codegen->position[block->last->id];
+    }
+    for (uint32_t b = 0; b < function->blockCount; b++) {
+        for (IrInstr *instr = function->blocks[b]->first; instr; instr = instr->next) {
+            if (instr->type != IR_TYPE_VOID && instr->op != IR_CONST) {
+                codegen->inRegister[instr->id] = 1;
+            }
+            for (uint32_t i = 0; i < instr->operandCount; i++) {
+                const IrInstr *operand = instr->operands[i];
+                if (operand->op == IR_CONST && !takesConstant(instr, i)) {
+                    codegen->inRegister[operand->id] = 1;
+                }
+            }
+            const IrInstr *condition = instr->op == IR_BRANCH ? instr->operands[0] : NULL;
+            if (condition && isComparison(condition) && condition->block == instr->block &&
+                codegen->uses[condition->id] == 1) {
+                codegen->fused[condition->id] = 1;
+                codegen->inRegister[condition->id] = 0;
+            }
+        }
+    }
+}
+
+// Call visit for every use of a value in a register: the block and position
+// where it is needed. A φ needs its operand at the end of the matching
+// predecessor; a compare-and-jump needs its operands at the branch
+static void forEachUse(Codegen *codegen, void (*visit)(Codegen *, const IrInstr *, uint32_t, uint32_t)) {
+    IrFunction *function = codegen->function;
+    for (uint32_t b = 0; b < function->blockCount; b++) {
+        IrBlock *block = function->blocks[b];
+        for (IrInstr *instr = block->first; instr; instr = instr->next) {
+            if (codegen->fused[instr->id]) {
+                continue;
+            }
+            for (uint32_t i = 0; i < instr->operandCount; i++) {
+                const IrInstr *operand = instr->operands[i];
+                if (instr->op == IR_PHI) {
+                    uint32_t pred = block->preds[i]->rpo;
+                    visit(codegen, operand, pred, codegen->blockEnd[pred]);
+                } else if (codegen->fused[operand->id]) {
+                    for (uint32_t j = 0; j < operand->operandCount; j++) {
+                        visit(codegen, operand->operands[j], b, codegen->position[instr->id]);
+                    }
+                } else {
+                    visit(codegen, operand, b, codegen->position[instr->id]);
+                }
+            }
+        }
+    }
+}
+
+static void countUse(Codegen *codegen, const IrInstr *value, uint32_t block, uint32_t position) {
+    (void)block;
+    (void)position;
+    if (codegen->inRegister[value->id]) {
+        codegen->useFirst[value->id + 1]++;
+    }
+}
+
+static void recordUse(Codegen *codegen, const IrInstr *value, uint32_t block, uint32_t position) {
+    if (codegen->inRegister[value->id]) {
+        uint32_t use = codegen->useFirst[value->id]++;
+        codegen->useBlock[use] = block;
+        codegen->usePosition[use] = position;
+    }
+}
+
+// Find how far each value in a register lives. From each use, the walk goes
+// back through the predecessors until the definition's block: the value is
+// needed at the end of every predecessor it passes
+static int computeLiveness(Codegen *codegen) {
+    IrFunction *function = codegen->function;
+    uint32_t values = function->valueCount;
+    forEachUse(codegen, countUse);
+    for (uint32_t v = 0; v < values; v++) {
+        codegen->useFirst[v + 1] += codegen->useFirst[v];
+    }
+    uint32_t useCount = codegen->useFirst[values];
+    codegen->useBlock = malloc((useCount ? useCount : 1) * sizeof(uint32_t));
+    codegen->usePosition = malloc((useCount ? useCount : 1) * sizeof(uint32_t));
+    if (!codegen->useBlock || !codegen->usePosition) {
+        outOfMemory(codegen);
+        return 0;
+    }
+    forEachUse(codegen, recordUse);
+    // recordUse moved each start to the next value's start
+    for (uint32_t v = values; v > 0; v--) {
+        codegen->useFirst[v] = codegen->useFirst[v - 1];
+    }
+    codegen->useFirst[0] = 0;
+
+    for (uint32_t b = 0; b < function->blockCount; b++) {
+        for (IrInstr *instr = function->blocks[b]->first; instr; instr = instr->next) {
+            uint32_t id = instr->id;
+            if (!codegen->inRegister[id]) {
+                continue;
+            }
+            uint32_t definedIn = b;
+            uint32_t end = codegen->position[id];
+            uint32_t depth = 0;
+            for (uint32_t u = codegen->useFirst[id]; u < codegen->useFirst[id + 1]; u++) {
+                uint32_t block = codegen->useBlock[u];
+                if (codegen->usePosition[u] > end) {
+                    end = codegen->usePosition[u];
+                }
+                if (block != definedIn && codegen->marks[block] != id + 1) {
+                    codegen->marks[block] = id + 1;
+                    codegen->stack[depth++] = block;
+                }
+            }
+            while (depth > 0) {
+                const IrBlock *block = function->blocks[codegen->stack[--depth]];
+                for (uint32_t p = 0; p < block->predCount; p++) {
+                    uint32_t pred = block->preds[p]->rpo;
+                    if (codegen->blockEnd[pred] > end) {
+                        end = codegen->blockEnd[pred];
+                    }
+                    if (pred != definedIn && codegen->marks[pred] != id + 1) {
+                        codegen->marks[pred] = id + 1;
+                        codegen->stack[depth++] = pred;
+                    }
+                }
+            }
+            codegen->end[id] = end;
+        }
+    }
+    return 1;
+}
+
+// Register allocation
+
+static int reserveRegister(Codegen *codegen, uint32_t reg) {
+    if (reg < codegen->registerCapacity) {
+        return 1;
+    }
+    uint32_t grown = codegen->registerCapacity ? codegen->registerCapacity * 2 : 64;
+    while (grown <= reg) {
+        grown *= 2;
+    }
+    uint32_t *occupied = realloc(codegen->occupied, grown * sizeof(uint32_t));
+    if (!occupied) {
+        outOfMemory(codegen);
+        return 0;
+    }
+    memset(occupied + codegen->registerCapacity, 0, (grown - codegen->registerCapacity) * sizeof(uint32_t));
+    codegen->occupied = occupied;
+    codegen->registerCapacity = grown;
+    return 1;
+}
+
+// Whether reg can take a value defined at position. An instruction reads its
+// operands before writing its result, so it may reuse a register whose value
+// it is the last to need; φ nodes are all written at once and may not
+static int isFree(const Codegen *codegen, uint32_t reg, uint32_t position, int phi) {
+    if (reg < codegen->firstRegister) {
+        return 0;
+    }
+    if (reg >= codegen->registerCapacity) {
+        return 1;
+    }
+    return codegen->occupied[reg] <= position + (phi ? 0 : 1);
+}
+
+static void assignRegister(Codegen *codegen, const IrInstr *value, uint32_t reg) {
+    if (!reserveRegister(codegen, reg)) {
+        return;
+    }
+    codegen->reg[value->id] = reg;
+    codegen->occupied[reg] = codegen->end[value->id] + 1;
+    if (reg + 1 > codegen->maxRegister) {
+        codegen->maxRegister = reg + 1;
+    }
+}
+
+static void allocateRegister(Codegen *codegen, const IrInstr *value) {
+    uint32_t position = codegen->position[value->id];
+    int phi = value->op == IR_PHI;
+    // A φ's copies vanish if it shares a register with its operands
+    if (phi) {
+        for (uint32_t i = 0; i < value->operandCount; i++) {
+            uint32_t reg = codegen->reg[value->operands[i]->id];
+            if (reg != NO_REGISTER && isFree(codegen, reg, position, 1)) {
+                assignRegister(codegen, value, reg);
+                return;
+            }
+        }
+    }
+    const IrInstr *hint = codegen->hint[value->id];
+    if (hint && codegen->reg[hint->id] != NO_REGISTER && isFree(codegen, codegen->reg[hint->id], position, phi)) {
+        assignRegister(codegen, value, codegen->reg[hint->id]);
+        return;
+    }
+    uint32_t reg = codegen->firstRegister;
+    while (!isFree(codegen, reg, position, phi)) {
+        reg++;
+    }
+    assignRegister(codegen, value, reg);
+}
+
+// One past the highest register holding a value still needed at position:
+// where a call made there can start its frame
+static uint32_t frameBase(const Codegen *codegen, uint32_t position) {
+    uint32_t base = codegen->registerCapacity;
+    while (base > codegen->firstRegister && codegen->occupied[base - 1] <= position) {
+        base--;
+    }
+    return base > codegen->firstRegister ? base : codegen->firstRegister;
+}
+
+// Hand out registers in layout order. Parameters arrive in the first ones
+static void allocateRegisters(Codegen *codegen) {
+    IrFunction *function = codegen->function;
+    for (uint32_t b = 0; b < function->blockCount; b++) {
+        for (IrInstr *instr = function->blocks[b]->first; instr; instr = instr->next) {
+            for (uint32_t i = 0; instr->op == IR_PHI && i < instr->operandCount; i++) {
+                codegen->hint[instr->operands[i]->id] = instr;
+            }
+            if (instr->op == IR_PARAM) {
+                assignRegister(codegen, instr, (uint32_t)instr->number);
+            }
+        }
+    }
+    for (uint32_t b = 0; b < function->blockCount && !codegen->failed; b++) {
+        for (IrInstr *instr = function->blocks[b]->first; instr; instr = instr->next) {
+            uint32_t position = codegen->position[instr->id];
+            if (instr->op == IR_CALL) {
+                codegen->base[instr->id] = frameBase(codegen, position);
+            }
+            if (codegen->inRegister[instr->id] && instr->op != IR_PARAM) {
+                allocateRegister(codegen, instr);
+            }
+            if (instr->op == IR_NEW) {
+                codegen->base[instr->id] = frameBase(codegen, position);
+            }
+        }
+    }
+}
+
+// Emission
+
+// Copies into the φ nodes of succ, at the end of one of its predecessors
+static void emitPhiCopies(Codegen *codegen, const IrBlock *block, SourceLocation location) {
+    const IrBlock *succ = block->succs[0];
+    uint32_t index = irPredIndex(succ, block);
+    uint32_t count = 0;
+    for (const IrInstr *phi = succ->first; phi && phi->op == IR_PHI; phi = phi->next) {
+        count++;
+    }
+    if (count > codegen->moveCapacity) {
+        Move *moves = realloc(codegen->moves, count * sizeof(Move));
+        if (!moves) {
+            outOfMemory(codegen);
+            return;
+        }
+        codegen->moves = moves;
+        codegen->moveCapacity = count;
+    }
+    // Register copies first, in an order that reads every register before it is
+    // overwritten; a cycle is broken through the scratch register
+    Move *moves = codegen->moves;
+    count = 0;
+    for (const IrInstr *phi = succ->first; phi && phi->op == IR_PHI; phi = phi->next) {
+        const IrInstr *source = phi->operands[index];
+        if (codegen->inRegister[source->id] && codegen->reg[source->id] != codegen->reg[phi->id]) {
+            moves[count++] = (Move){codegen->reg[phi->id], codegen->reg[source->id]};
+        }
+    }
+    while (count > 0) {
+        uint32_t ready = count;
+        for (uint32_t m = 0; m < count && ready == count; m++) {
+            int needed = 0;
+            for (uint32_t other = 0; other < count && !needed; other++) {
+                needed = other != m && moves[other].source == moves[m].target;
+            }
+            if (!needed) {
+                ready = m;
+            }
+        }
+        if (ready == count) {
+            if (codegen->scratch == NO_REGISTER) {
+                codegen->scratch = codegen->maxRegister;
+            }
+            uint32_t saved = moves[0].target;
+            emitCode(codegen, REG_MOVE, codegen->scratch, saved, 0, location);
+            for (uint32_t m = 0; m < count; m++) {
+                if (moves[m].source == saved) {
+                    moves[m].source = codegen->scratch;
+                }
+            }
+            ready = 0;
+        }
+        emitCode(codegen, REG_MOVE, moves[ready].target, moves[ready].source, 0, location);
+        moves[ready] = moves[--count];
+    }
+    for (const IrInstr *phi = succ->first; phi && phi->op == IR_PHI; phi = phi->next) {
+        const IrInstr *source = phi->operands[index];
+        if (!codegen->inRegister[source->id]) {
+            loadConstant(codegen, codegen->reg[phi->id], source);
+        }
+    }
+}
+
+// Whether the end of block copies anything into its successor's φ nodes
+static int hasPhiCopies(const Codegen *codegen, const IrBlock *block) {
+    if (block->succCount != 1 || block->succs[0]->predCount < 2) {
+        return 0;
+    }
+    const IrBlock *succ = block->succs[0];
+    uint32_t index = irPredIndex(succ, block);
+    for (const IrInstr *phi = succ->first; phi && phi->op == IR_PHI; phi = phi->next) {
+        const IrInstr *source = phi->operands[index];
+        if (!codegen->inRegister[source->id] || codegen->reg[source->id] != codegen->reg[phi->id]) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Whether block produces no code but its jump, so jumps to it can go straight on
+static int isEmptyBlock(const Codegen *codegen, const IrBlock *block) {
+    if (block->last->op != IR_JUMP || hasPhiCopies(codegen, block)) {
+        return 0;
+    }
+    for (const IrInstr *instr = block->first; instr != block->last; instr = instr->next) {
+        if (instr->op != IR_PHI && instr->op != IR_PARAM && !(instr->op == IR_CONST && !codegen->inRegister[instr->id])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Where jumps to each block land: past blocks with nothing in them (but never
+// round a loop of them)
+static void forwardBlocks(Codegen *codegen) {
+    IrFunction *function = codegen->function;
+    for (uint32_t b = 0; b < function->blockCount; b++) {
+        codegen->forward[b] = b == 0 || !isEmptyBlock(codegen, function->blocks[b]) ? b : NO_BLOCK;
+    }
+    for (uint32_t b = 0; b < function->blockCount; b++) {
+        uint32_t target = b;
+        for (uint32_t steps = 0; codegen->forward[target] == NO_BLOCK && steps < function->blockCount; steps++) {
+            target = function->blocks[target]->succs[0]->rpo;
+        }
+        codegen->marks[b] = codegen->forward[target] == NO_BLOCK ? b : target;
+    }
+    for (uint32_t b = 0; b < function->blockCount; b++) {
+        codegen->forward[b] = codegen->marks[b];
+        codegen->blockOffset[b] = codegen->forward[b] == b ? 0 : NO_BLOCK;
+    }
+}
+
+static RegisterOpcode printOpcode(IrType type) {
+    switch (type) {
+        case IR_TYPE_BOOL:   return REG_PRINT_BOOL;
+        case IR_TYPE_CHAR:   return REG_PRINT_CHAR;
+        case IR_TYPE_STRING: return REG_PRINT_STRING;
+        case IR_TYPE_OBJECT: return REG_PRINT_OBJECT;
+        default:             return REG_PRINT_INT;
+    }
+}
+
+static RegisterOpcode binaryOpcode(IrOpcode op) {
+    switch (op) {
+        case IR_ADD:        return REG_ADD;
+        case IR_SUBTRACT:   return REG_SUBTRACT;
+        case IR_MULTIPLY:   return REG_MULTIPLY;
+        case IR_DIVIDE:     return REG_DIVIDE;
+        case IR_CONCAT:     return REG_CONCAT;
+        case IR_LESS:       return REG_LESS;
+        case IR_LESS_EQUAL: return REG_LESS_EQUAL;
+        case IR_EQUAL:      return REG_EQUAL;
+        default:            return REG_NOT_EQUAL;
+    }
+}
+
+// End a block with a branch on condition to the blocks at layout indices ifTrue
+// and ifFalse, given the block placed next
+static void emitBranch(Codegen *codegen, const IrInstr *branch, uint32_t ifTrue, uint32_t ifFalse, uint32_t next) {
+    const IrInstr *condition = branch->operands[0];
+    SourceLocation location = branch->location;
+    if (ifTrue == ifFalse) {
+        if (ifTrue != next) {
+            emitJump(codegen, REG_JUMP, 0, 0, ifTrue, location);
+        }
+        return;
+    }
+    if (!codegen->fused[condition->id]) {
+        emitJump(codegen, REG_JUMP_IF_FALSE, codegen->reg[condition->id], 0, ifFalse, location);
+        if (ifTrue != next) {
+            emitJump(codegen, REG_JUMP, 0, 0, ifTrue, location);
+        }
+        return;
+    }
+    // Jump on the comparison, or on its opposite (not x < y is y <= x) to fall
+    // through into the true block
+    uint32_t left = codegen->reg[condition->operands[0]->id];
+    uint32_t right = codegen->reg[condition->operands[1]->id];
+    int negate = ifTrue == next;
+    uint32_t target = negate ? ifFalse : ifTrue;
+    RegisterOpcode op;
+    switch (condition->op) {
+        case IR_LESS:
+            op = negate ? REG_JUMP_IF_LESS_EQUAL : REG_JUMP_IF_LESS;
+            break;
+        case IR_LESS_EQUAL:
+            op = negate ? REG_JUMP_IF_LESS : REG_JUMP_IF_LESS_EQUAL;
+            break;
+        case IR_EQUAL:
+            op = negate ? REG_JUMP_IF_NOT_EQUAL : REG_JUMP_IF_EQUAL;
+            break;
+        default:
+            op = negate ? REG_JUMP_IF_EQUAL : REG_JUMP_IF_NOT_EQUAL;
+            break;
+    }
+    if (negate && (condition->op == IR_LESS || condition->op == IR_LESS_EQUAL)) {
+        emitJump(codegen, op, right, left, target, location);
+    } else {
+        emitJump(codegen, op, left, right, target, location);
+    }
+    if (!negate && ifFalse != next) {
+        emitJump(codegen, REG_JUMP, 0, 0, ifFalse, location);
+    }
+}
+
+static void emitInstr(Codegen *codegen, const IrInstr *instr) {
+    const uint32_t *reg = codegen->reg;
+    uint32_t target = reg[instr->id];
+    uint32_t a = instr->operandCount > 0 ? reg[instr->operands[0]->id] : 0;
+    uint32_t b = instr->operandCount > 1 ? reg[instr->operands[1]->id] : 0;
+    SourceLocation location = instr->location;
+    switch (instr->op) {
+        case IR_CONST:
+            if (codegen->inRegister[instr->id]) {
+                loadConstant(codegen, target, instr);
+            }
+            break;
+        case IR_PARAM:
+        case IR_PHI:
+            break;
+        case IR_ADD:
+        case IR_SUBTRACT: {
+            int immediate = immediateOperand(instr);
+            if (immediate >= 0) {
+                int64_t value = instr->operands[immediate]->number;
+                uint32_t other = reg[instr->operands[1 - immediate]->id];
+                int32_t added = (int32_t)(instr->op == IR_SUBTRACT ? -value : value);
+                emitCode(codegen, REG_ADD_INT, target, other, (uint32_t)added, location);
+                break;
+            }
+            emitCode(codegen, binaryOpcode((IrOpcode)instr->op), target, a, b, location);
+            break;
+        }
+        case IR_MULTIPLY:
+        case IR_DIVIDE:
+        case IR_CONCAT:
+        case IR_LESS:
+        case IR_LESS_EQUAL:
+        case IR_EQUAL:
+        case IR_NOT_EQUAL:
+            if (!codegen->fused[instr->id]) {
+                emitCode(codegen, binaryOpcode((IrOpcode)instr->op), target, a, b, location);
+            }
+            break;
+        case IR_NEGATE:
+            emitCode(codegen, REG_NEGATE, target, a, 0, location);
+            break;
+        case IR_NOT:
+            emitCode(codegen, REG_NOT, target, a, 0, location);
+            break;
+        case IR_GET_GLOBAL:
+            emitCode(codegen, REG_GET_GLOBAL, target, (uint32_t)instr->number, 0, location);
+            break;
+        case IR_SET_GLOBAL:
+            emitCode(codegen, REG_SET_GLOBAL, (uint32_t)instr->number, a, 0, location);
+            break;
+        case IR_GET_FIELD:
+            emitCode(codegen, REG_GET_FIELD, target, (uint32_t)instr->number, 0, location);
+            break;
+        case IR_SET_FIELD:
+            emitCode(codegen, REG_SET_FIELD, (uint32_t)instr->number, a, 0, location);
+            break;
+        case IR_NEW:
+            emitCode(codegen, REG_NEW, target, (uint32_t)instr->number, codegen->base[instr->id], location);
+            break;
+        case IR_CALL: {
+            uint32_t base = codegen->base[instr->id];
+            for (uint32_t i = 0; i < instr->operandCount; i++) {
+                place(codegen, base + i, instr->operands[i], location);
+            }
+            emitCode(codegen, REG_CALL, (uint32_t)instr->number, base, 0, location);
+            break;
+        }
+        case IR_PRINT: {
+            RegisterOpcode op = printOpcode((IrType)instr->operands[0]->type);
+            emitCode(codegen, op, a, op == REG_PRINT_OBJECT ? (uint32_t)instr->number : 0, 0, location);
+            break;
+        }
+        case IR_PRINT_LINE:
+            emitCode(codegen, REG_PRINT_LINE, 0, 0, 0, location);
+            break;
+        case IR_INPUT:
+            emitCode(codegen, instr->type == IR_TYPE_STRING ? REG_INPUT_STRING : REG_INPUT_INT, target, 0, 0, location);
+            break;
+        case IR_RETURN:
+            emitCode(codegen, REG_RETURN, 0, 0, 0, location);
+            break;
+        case IR_HALT:
+            emitCode(codegen, REG_HALT, 0, 0, 0, location);
+            break;
+        default:
+            break;
+    }
+}
+
+// Lay out the blocks that have code, each falling through to the next where it can
+static void emitFunction(Codegen *codegen) {
+    IrFunction *function = codegen->function;
+    uint32_t count = function->blockCount;
+    codegen->jumpCount = 0;
+    forwardBlocks(codegen);
+    for (uint32_t b = 0; b < count && !codegen->failed; b++) {
+        if (codegen->blockOffset[b] == NO_BLOCK) {
+            continue;
+        }
+        codegen->blockOffset[b] = codegen->bytecode->codeCount;
+        const IrBlock *block = function->blocks[b];
+        uint32_t next = b + 1;
+        while (next < count && codegen->blockOffset[next] == NO_BLOCK) {
+            next++;
+        }
+        for (const IrInstr *instr = block->first; instr != block->last; instr = instr->next) {
+            emitInstr(codegen, instr);
+        }
+        const IrInstr *last = block->last;
+        if (last->op == IR_JUMP) {
+            if (hasPhiCopies(codegen, block)) {
+                emitPhiCopies(codegen, block, last->location);
+            }
+            uint32_t target = codegen->forward[block->succs[0]->rpo];
+            if (target != next) {
+                emitJump(codegen, REG_JUMP, 0, 0, target, last->location);
+            }
+        } else if (last->op == IR_BRANCH) {
+            emitBranch(codegen, last, codegen->forward[block->succs[0]->rpo], codegen->forward[block->succs[1]->rpo],
+                       next);
+        } else {
+            emitInstr(codegen, last);
+        }
+    }
+    for (uint32_t j = 0; j < codegen->jumpCount && !codegen->failed; j++) {
+        const PendingJump *jump = &codegen->jumps[j];
+        patchOperand(codegen->bytecode, jump->offset, codegen->blockOffset[jump->block]);
+    }
+}
+
+static void freeFunctionState(Codegen *codegen) {
+    free(codegen->position);
+    free(codegen->end);
+    free(codegen->reg);
+    free(codegen->uses);
+    free(codegen->base);
+    free(codegen->hint);
+    free(codegen->inRegister);
+    free(codegen->fused);
+    free(codegen->blockEnd);
+    free(codegen->blockOffset);
+    free(codegen->forward);
+    free(codegen->marks);
+    free(codegen->stack);
+    free(codegen->useFirst);
+    free(codegen->useBlock);
+    free(codegen->usePosition);
+    codegen->useBlock = NULL;
+    codegen->usePosition = NULL;
+}
+
+// Generate the code of functions[index]
+static int generateFunction(Codegen *codegen, uint32_t index) {
+    IrFunction *function = &codegen->program->functions[index];
+    codegen->function = function;
+    if (!prepareFunction(codegen)) {
+        outOfMemory(codegen);
+        return 0;
+    }
+    size_t values = function->valueCount ? function->valueCount : 1;
+    size_t blocks = function->blockCount ? function->blockCount : 1;
+    codegen->position = calloc(values, sizeof(uint32_t));
+    codegen->end = calloc(values, sizeof(uint32_t));
+    codegen->reg = malloc(values * sizeof(uint32_t));
+    codegen->uses = calloc(values, sizeof(uint32_t));
+    codegen->base = calloc(values, sizeof(uint32_t));
+    codegen->hint = calloc(values, sizeof(IrInstr *));
+    codegen->inRegister = calloc(values, 1);
+    codegen->fused = calloc(values, 1);
+    codegen->blockEnd = calloc(blocks, sizeof(uint32_t));
+    codegen->blockOffset = calloc(blocks, sizeof(uint32_t));
+    codegen->forward = calloc(blocks, sizeof(uint32_t));
+    codegen->marks = calloc(blocks, sizeof(uint32_t));
+    codegen->stack = calloc(blocks, sizeof(uint32_t));
+    codegen->useFirst = calloc(values + 1, sizeof(uint32_t));
+    if (!codegen->position || !codegen->end || !codegen->reg || !codegen->uses || !codegen->base || !codegen->hint ||
+        !codegen->inRegister || !codegen->fused || !codegen->blockEnd || !codegen->blockOffset || !codegen->forward ||
+        !codegen->marks || !codegen->stack || !codegen->useFirst) {
+        outOfMemory(codegen);
+        freeFunctionState(codegen);
+        return 0;
+    }
+    memset(codegen->reg, 0xFF, values * sizeof(uint32_t));
+    if (codegen->occupied) {
+        memset(codegen->occupied, 0, codegen->registerCapacity * sizeof(uint32_t));
+    }
+    codegen->firstRegister = index == 0 ? codegen->program->globalCount : 0;
+    codegen->maxRegister = codegen->firstRegister;
+    codegen->scratch = NO_REGISTER;
+
+    numberValues(codegen);
+    if (computeLiveness(codegen)) {
+        allocateRegisters(codegen);
+        memset(codegen->marks, 0, blocks * sizeof(uint32_t));
+        VmFunction *compiled = &codegen->bytecode->functions[index];
+        compiled->entry = codegen->bytecode->codeCount;
+        emitFunction(codegen);
+        uint32_t frameSize = codegen->maxRegister + (codegen->scratch != NO_REGISTER);
+        compiled->frameSize = frameSize > function->paramCount ? frameSize : function->paramCount;
+    }
+    freeFunctionState(codegen);
+    return !codegen->failed;
+}
+
+// Generate register code for the whole program
+int generateRegisterCode(IrProgram *program, Bytecode *bytecode) {
+    Codegen codegen;
+    memset(&codegen, 0, sizeof(codegen));
+    codegen.program = program;
+    codegen.bytecode = bytecode;
+
+    initRegisterCode(bytecode);
+    bytecode->globalCount = program->globalCount;
+    int ok = 1;
+    for (uint32_t f = 0; f < program->functionCount && ok; f++) {
+        const IrFunction *function = &program->functions[f];
+        ok = addFunction(bytecode, (VmFunction){0, function->paramCount, 0, 0, function->declaration}) != UINT32_MAX;
+    }
+    for (uint32_t c = 0; c < program->classCount && ok; c++) {
+        const IrClass *class = &program->classes[c];
+        ok = addClass(bytecode, (VmClass){class->fieldCount, class->init, class->declaration}) != UINT32_MAX;
+    }
+    for (uint32_t f = 0; f < program->functionCount && ok; f++) {
+        ok = generateFunction(&codegen, f);
+    }
+
+    free(codegen.occupied);
+    free(codegen.jumps);
+    free(codegen.moves);
+    if (!ok) {
+        freeBytecode(bytecode);
+    }
+    return ok;
+}
@@ -0,0 +1,29 @@
+#ifndef IR_CODEGEN_H
+#define IR_CODEGEN_H
+
+#include "Bytecode.h"
+#include "Ir.h"
+
+// Register code from the IR
+// Turns each IrFunction into register instructions (Bytecode.h) for
+// runRegisterCode(), keeping the numbering of functions and classes. Critical
+// edges are split, so every φ's copies can go at the end of its predecessors,
+// and blocks are laid out in reverse post-order; a block left with nothing to do
+// is jumped over. Each value's live range is the stretch of the layout from its
+// definition to the last point where some path still needs it, found by walking
+// back from its uses. Registers are then handed out in one pass over the layout,
+// lowest free first, preferring the register of a φ the value flows into, so a
+// loop variable is stepped in place. A comparison that only decides its block's
+// branch becomes a compare-and-jump, and small constants added or subtracted go
+// into ADD_INT.
+//
+// The program's registers start after the globals, as in the register
+// compiler; a call's arguments go to the registers just above everything live
+// at the call.
+
+// Generate code for every function of program into bytecode (in the register
+// instruction set). The IR's blocks are rearranged on the way. Returns 1 on
+// success, 0 if out of memory (bytecode is then freed)
+int generateRegisterCode(IrProgram *program, Bytecode *bytecode);
+
+#endif // IR_CODEGEN_H
@@ -0,0 +1,461 @@
+#include "IrInline.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Cost model, in instructions (constants and parameters not counted)
+#define INLINE_TINY_SIZE 8     // Callees this small are inlined at any call site
+#define INLINE_HOT_SIZE 40     // Largest callee inlined at a hot call site
+#define INLINE_HOT_CALLS 64    // Calls that make a call site hot (a loop counts as 64)
+#define INLINE_MIN_BUDGET 64   // Growth allowed however small the program is
+
+#define NOT_VISITED UINT32_MAX
+
+// A call that might be inlined
+typedef struct {
+    IrInstr *call;
+    uint64_t frequency;        // Profiled calls, or a guess from its loop nesting
+} CallSite;
+
+typedef struct {
+    IrProgram *program;
+    const CallProfile *profile; // NULL if there is no profile to go by
+    uint32_t *size;            // By function
+    uint8_t *inlinable;        // By function: small, not recursive, no fields
+    uint32_t *order;           // Functions, callees before their callers
+    int64_t budget;            // Instructions that may still be added
+    uint32_t inlined;
+    // Scratch for one call
+    IrInstr **values;          // Callee's value id -> the caller's value
+    uint32_t valueCapacity;
+    IrBlock **blocks;          // Callee's block id -> the copy
+    uint32_t blockCapacity;
+    CallSite *sites;
+    uint32_t siteCapacity;
+    uint32_t *loopDepth;       // By block rpo of the caller
+    uint32_t *loopMark;
+    IrBlock **work;
+    uint32_t workCapacity;
+} Inliner;
+
+static void inlinerOutOfMemory(void) {
+    fprintf(stderr, "Memory allocation failed for the inliner!\n");
+}
+
+static uint32_t functionSize(const IrFunction *function) {
+    uint32_t size = 0;
+    for (uint32_t b = 0; b < function->blockCount; b++) {
+        for (const IrInstr *instr = function->blocks[b]->first; instr; instr = instr->next) {
+            size += instr->op != IR_CONST && instr->op != IR_PARAM;
+        }
+    }
+    return size;
+}
+
+static int touchesFields(const IrFunction *function) {
+    for (uint32_t b = 0; b < function->blockCount; b++) {
+        for (const IrInstr *instr = function->blocks[b]->first; instr; instr = instr->next) {
+            if (instr->op == IR_GET_FIELD || instr->op == IR_SET_FIELD) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Function a call or new instruction runs (UINT32_MAX for others)
+static uint32_t calleeOf(const IrProgram *program, const IrInstr *instr) {
+    if (instr->op == IR_CALL) {
+        return (uint32_t)instr->number;
+    }
+    return instr->op == IR_NEW ? program->classes[instr->number].init : UINT32_MAX;
+}
+
+// Order the functions callees first and find the recursive ones: those in a
+// cycle of the call graph (Tarjan's strongly connected components, without
+// recursion). Returns 0 if out of memory
+static int orderFunctions(Inliner *inliner, uint8_t *recursive) {
+    IrProgram *program = inliner->program;
+    uint32_t count = program->functionCount;
+    // The call graph, as lists of callees
+    uint32_t *first = calloc((size_t)count + 1, sizeof(uint32_t));
+    uint32_t *index = malloc((size_t)count * sizeof(uint32_t));
+    uint32_t *low = malloc((size_t)count * sizeof(uint32_t));
+    uint8_t *onStack = calloc(count, 1);
+    uint32_t *stack = malloc((size_t)count * sizeof(uint32_t));
+    uint32_t *path = malloc((size_t)count * sizeof(uint32_t));
+    uint32_t *nextEdge = malloc((size_t)count * sizeof(uint32_t));
+    uint32_t *edges = NULL;
+    int ok = first && index && low && onStack && stack && path && nextEdge;
+    if (ok) {
+        for (uint32_t f = 0; f < count; f++) {
+            const IrFunction *function = &program->functions[f];
+            first[f + 1] = first[f];
+            for (uint32_t b = 0; b < function->blockCount; b++) {
+                for (const IrInstr *instr = function->blocks[b]->first; instr; instr = instr->next) {
+                    first[f + 1] += calleeOf(program, instr) != UINT32_MAX;
+                }
+            }
+        }
+        edges = malloc((first[count] ? first[count] : 1) * sizeof(uint32_t));
+        ok = edges != NULL;
+    }
+    if (ok) {
+        for (uint32_t f = 0; f < count; f++) {
+            const IrFunction *function = &program->functions[f];
+            uint32_t edge = first[f];
+            for (uint32_t b = 0; b < function->blockCount; b++) {
+                for (const IrInstr *instr = function->blocks[b]->first; instr; instr = instr->next) {
+                    uint32_t callee = calleeOf(program, instr);
+                    if (callee != UINT32_MAX) {
+                        edges[edge++] = callee;
+                        recursive[f] |= callee == f;
+                    }
+                }
+            }
+            index[f] = NOT_VISITED;
+        }
+        uint32_t visited = 0;
+        uint32_t stackDepth = 0;
+        uint32_t ordered = 0;
+        for (uint32_t root = 0; root < count; root++) {
+            if (index[root] != NOT_VISITED) {
+                continue;
+            }
+            uint32_t depth = 0;
+            path[depth++] = root;
+            index[root] = low[root] = visited++;
+            nextEdge[root] = first[root];
+            stack[stackDepth++] = root;
+            onStack[root] = 1;
+            while (depth > 0) {
+                uint32_t f = path[depth - 1];
+                if (nextEdge[f] < first[f + 1]) {
+                    uint32_t callee = edges[nextEdge[f]++];
+                    if (index[callee] == NOT_VISITED) {
+                        index[callee] = low[callee] = visited++;
+                        nextEdge[callee] = first[callee];
+                        stack[stackDepth++] = callee;
+                        onStack[callee] = 1;
+                        path[depth++] = callee;
+                    } else if (onStack[callee] && index[callee] < low[f]) {
+                        low[f] = index[callee];
+                    }
+                    continue;
+                }
+                depth--;
+                if (depth > 0 && low[f] < low[path[depth - 1]]) {
+                    low[path[depth - 1]] = low[f];
+                }
+                if (low[f] != index[f]) {
+                    continue;
+                }
+                // f roots a component: everything above it on the stack
+                uint32_t bottom = stackDepth;
+                do {
+                    onStack[stack[--bottom]] = 0;
+                } while (stack[bottom] != f);
+                for (uint32_t s = bottom; s < stackDepth; s++) {
+                    recursive[stack[s]] |= stackDepth - bottom > 1;
+                    inliner->order[ordered++] = stack[s];
+                }
+                stackDepth = bottom;
+            }
+        }
+    } else {
+        inlinerOutOfMemory();
+    }
+    free(first);
+    free(index);
+    free(low);
+    free(onStack);
+    free(stack);
+    free(path);
+    free(nextEdge);
+    free(edges);
+    return ok;
+}
+
+// How many loops each block of function is in
+static int computeLoopDepths(Inliner *inliner, const IrFunction *function) {
+    uint32_t count = function->blockCount;
+    if (count > inliner->workCapacity) {
+        free(inliner->loopDepth);
+        free(inliner->loopMark);
+        free(inliner->work);
+        inliner->loopDepth = malloc((size_t)count * sizeof(uint32_t));
+        inliner->loopMark = malloc((size_t)count * sizeof(uint32_t));
+        inliner->work = malloc((size_t)count * sizeof(IrBlock *));
+        inliner->workCapacity = count;
+        if (!inliner->loopDepth || !inliner->loopMark || !inliner->work) {
+            inliner->workCapacity = 0;
+            inlinerOutOfMemory();
+            return 0;
+        }
+    }
+    memset(inliner->loopDepth, 0, (size_t)count * sizeof(uint32_t));
+    memset(inliner->loopMark, 0xFF, (size_t)count * sizeof(uint32_t));
+    for (uint32_t h = 0; h < count; h++) {
+        IrBlock *header = function->blocks[h];
+        uint32_t depth = 0;
+        for (uint32_t p = 0; p < header->predCount; p++) {
+            IrBlock *latch = header->preds[p];
+            if (irDominates(header, latch) && inliner->loopMark[latch->rpo] != h) {
+                inliner->loopMark[latch->rpo] = h;
+                inliner->work[depth++] = latch;
+            }
+        }
+        if (depth == 0) {
+            continue;
+        }
+        if (inliner->loopMark[h] != h) {
+            inliner->loopMark[h] = h;
+            inliner->loopDepth[h]++;
+        }
+        while (depth > 0) {
+            IrBlock *block = inliner->work[--depth];
+            inliner->loopDepth[block->rpo]++;
+            for (uint32_t p = 0; p < block->predCount; p++) {
+                IrBlock *pred = block->preds[p];
+                if (inliner->loopMark[pred->rpo] != h) {
+                    inliner->loopMark[pred->rpo] = h;
+                    inliner->work[depth++] = pred;
+                }
+            }
+        }
+    }
+    return 1;
+}
+
+// Whether a call site is worth inlining its callee at, given what is left of
+// the budget
+static int worthInlining(const Inliner *inliner, const CallSite *site) {
+    uint32_t size = inliner->size[site->call->number];
+    if (size > inliner->budget) {
+        return 0;
+    }
+    if (size <= INLINE_TINY_SIZE) {
+        return 1;
+    }
+    return size <= INLINE_HOT_SIZE && site->frequency >= INLINE_HOT_CALLS;
+}
+
+static int hotterSite(const void *a, const void *b) {
+    uint64_t left = ((const CallSite *)a)->frequency;
+    uint64_t right = ((const CallSite *)b)->frequency;
+    return (left < right) - (left > right);
+}
+
+// Make the scratch arrays big enough to copy callee
+static int reserveScratch(Inliner *inliner, const IrFunction *callee) {
+    if (callee->valueCount > inliner->valueCapacity) {
+        IrInstr **values = realloc(inliner->values, (size_t)callee->valueCount * sizeof(IrInstr *));
+        if (!values) {
+            return 0;
+        }
+        inliner->values = values;
+        inliner->valueCapacity = callee->valueCount;
+    }
+    if (callee->nextBlockId > inliner->blockCapacity) {
+        IrBlock **blocks = realloc(inliner->blocks, (size_t)callee->nextBlockId * sizeof(IrBlock *));
+        if (!blocks) {
+            return 0;
+        }
+        inliner->blocks = blocks;
+        inliner->blockCapacity = callee->nextBlockId;
+    }
+    return 1;
+}
+
+// Put a copy of callee in place of call. The call's block is split after it:
+// the call becomes a jump into the copy, whose returns jump to the rest of
+// the block. Returns 0 if out of memory
+static int inlineCall(Inliner *inliner, IrFunction *caller, IrInstr *call, const IrFunction *callee) {
+    IrProgram *program = inliner->program;
+    IrBlock *block = call->block;
+    IrBlock *rest = reserveScratch(inliner, callee) ? irNewBlock(program, caller) : NULL;
+    if (!rest) {
+        return 0;
+    }
+    rest->sealed = 1;
+    while (call->next) {
+        IrInstr *instr = call->next;
+        irRemove(instr);
+        irAppend(rest, instr);
+    }
+    for (uint32_t s = 0; s < block->succCount; s++) {
+        IrBlock *succ = block->succs[s];
+        for (uint32_t p = 0; p < succ->predCount; p++) {
+            if (succ->preds[p] == block) {
+                succ->preds[p] = rest;
+            }
+        }
+        rest->succs[s] = succ;
+    }
+    rest->succCount = block->succCount;
+    block->succCount = 0;
+
+    // Blocks and instructions first, operands once every value has its copy
+    for (uint32_t b = 0; b < callee->blockCount; b++) {
+        IrBlock *copy = irNewBlock(program, caller);
+        if (!copy) {
+            return 0;
+        }
+        copy->sealed = 1;
+        inliner->blocks[callee->blocks[b]->id] = copy;
+    }
+    for (uint32_t b = 0; b < callee->blockCount; b++) {
+        IrBlock *copy = inliner->blocks[callee->blocks[b]->id];
+        for (const IrInstr *instr = callee->blocks[b]->first; instr; instr = instr->next) {
+            if (instr->op == IR_PARAM) {
+                inliner->values[instr->id] = call->operands[instr->number];
+                continue;
+            }
+            IrOpcode op = instr->op == IR_RETURN ? IR_JUMP : (IrOpcode)instr->op;
+            IrInstr *clone = irNewInstr(program, caller, op, (IrType)instr->type, instr->number, instr->location);
+            if (!clone) {
+                return 0;
+            }
+            irAppend(copy, clone);
+            inliner->values[instr->id] = clone;
+        }
+    }
+    for (uint32_t b = 0; b < callee->blockCount; b++) {
+        for (const IrInstr *instr = callee->blocks[b]->first; instr; instr = instr->next) {
+            IrInstr *clone = inliner->values[instr->id];
+            for (uint32_t i = 0; instr->op != IR_PARAM && i < instr->operandCount; i++) {
+                if (!irAddOperand(program, clone, inliner->values[instr->operands[i]->id])) {
+                    return 0;
+                }
+            }
+        }
+    }
+    // Edges in the order of each block's predecessors, which the φ operands
+    // follow; then the successors put back in their own order
+    for (uint32_t b = 0; b < callee->blockCount; b++) {
+        const IrBlock *original = callee->blocks[b];
+        IrBlock *copy = inliner->blocks[original->id];
+        for (uint32_t p = 0; p < original->predCount; p++) {
+            if (!irAddEdge(program, inliner->blocks[original->preds[p]->id], copy)) {
+                return 0;
+            }
+        }
+    }
+    for (uint32_t b = 0; b < callee->blockCount; b++) {
+        const IrBlock *original = callee->blocks[b];
+        IrBlock *copy = inliner->blocks[original->id];
+        for (uint32_t s = 0; s < original->succCount; s++) {
+            copy->succs[s] = inliner->blocks[original->succs[s]->id];
+        }
+        if (original->last->op == IR_RETURN && !irAddEdge(program, copy, rest)) {
+            return 0;
+        }
+    }
+
+    call->op = IR_JUMP;
+    call->number = 0;
+    call->operandCount = 0;
+    return irAddEdge(program, block, inliner->blocks[callee->blocks[0]->id]);
+}
+
+// Inline the worthwhile calls of one function, hottest first
+static int inlineInto(Inliner *inliner, IrFunction *caller) {
+    IrProgram *program = inliner->program;
+    int useProfile = inliner->profile && inliner->profile->totalCalls > 0;
+    if (!useProfile && !computeLoopDepths(inliner, caller)) {
+        return 0;
+    }
+    uint32_t siteCount = 0;
+    for (uint32_t b = 0; b < caller->blockCount; b++) {
+        for (IrInstr *instr = caller->blocks[b]->first; instr; instr = instr->next) {
+            if (instr->op != IR_CALL || !inliner->inlinable[instr->number]) {
+                continue;
+            }
+            if (siteCount == inliner->siteCapacity) {
+                uint32_t grown = inliner->siteCapacity ? inliner->siteCapacity * 2 : 64;
+                CallSite *sites = realloc(inliner->sites, grown * sizeof(CallSite));
+                if (!sites) {
+                    inlinerOutOfMemory();
+                    return 0;
+                }
+                inliner->sites = sites;
+                inliner->siteCapacity = grown;
+            }
+            // Without a profile, every loop is guessed to make a call site hot
+            uint32_t depth = useProfile ? 0 : inliner->loopDepth[b];
+            uint64_t frequency = useProfile ? callCountAt(inliner->profile, instr->location)
+                                            : (uint64_t)1 << (6 * (depth < 8 ? depth : 8));
+            inliner->sites[siteCount++] = (CallSite){instr, frequency};
+        }
+    }
+    if (siteCount == 0) {
+        return 1;
+    }
+    qsort(inliner->sites, siteCount, sizeof(CallSite), hotterSite);
+    int changed = 0;
+    for (uint32_t s = 0; s < siteCount; s++) {
+        const CallSite *site = &inliner->sites[s];
+        if (!worthInlining(inliner, site)) {
+            continue;
+        }
+        uint32_t callee = (uint32_t)site->call->number;
+        inliner->budget -= inliner->size[callee];
+        if (!inlineCall(inliner, caller, site->call, &program->functions[callee])) {
+            inlinerOutOfMemory();
+            return 0;
+        }
+        inliner->inlined++;
+        changed = 1;
+    }
+    if (changed) {
+        if (!irComputeDominators(program, caller)) {
+            return 0;
+        }
+        inliner->size[caller - program->functions] = functionSize(caller);
+    }
+    return 1;
+}
+
+int inlineCalls(IrProgram *program, const CallProfile *profile, uint32_t *inlined) {
+    Inliner inliner;
+    memset(&inliner, 0, sizeof(inliner));
+    inliner.program = program;
+    inliner.profile = profile;
+    *inlined = 0;
+    uint32_t count = program->functionCount;
+    inliner.size = malloc((size_t)count * sizeof(uint32_t));
+    inliner.inlinable = calloc(count, 1);
+    inliner.order = malloc((size_t)count * sizeof(uint32_t));
+    uint8_t *recursive = calloc(count, 1);
+    int ok = inliner.size && inliner.inlinable && inliner.order && recursive;
+    if (!ok) {
+        inlinerOutOfMemory();
+    }
+    ok = ok && orderFunctions(&inliner, recursive);
+    if (ok) {
+        uint64_t total = 0;
+        for (uint32_t f = 0; f < count; f++) {
+            const IrFunction *function = &program->functions[f];
+            inliner.size[f] = functionSize(function);
+            total += inliner.size[f];
+            inliner.inlinable[f] = f > 0 && !function->classBody && !recursive[f] && !touchesFields(function);
+        }
+        inliner.budget = (int64_t)(total / 2) + INLINE_MIN_BUDGET;
+        // Callees are inlined into before their callers, so their copies carry
+        // their own inlined calls
+        for (uint32_t i = 0; i < count && ok; i++) {
+            ok = inlineInto(&inliner, &program->functions[inliner.order[i]]);
+        }
+    }
+    *inlined = inliner.inlined;
+    free(inliner.size);
+    free(inliner.inlinable);
+    free(inliner.order);
+    free(inliner.values);
+    free(inliner.blocks);
+    free(inliner.sites);
+    free(inliner.loopDepth);
+    free(inliner.loopMark);
+    free(inliner.work);
+    free(recursive);
+    return ok;
+}
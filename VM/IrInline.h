@@ -0,0 +1,26 @@
+#ifndef IR_INLINE_H
+#define IR_INLINE_H
+
+#include <stdint.h>
+#include "Ir.h"
+#include "Profile.h"
+
+// Inlining
+// Replaces calls of small कर्म functions by a copy of their blocks, so a helper
+// called in a loop costs no frame setup or dispatch and its code is optimized
+// together with the loop's. Functions are visited callees first (the strongly
+// connected components of the call graph, by Tarjan's algorithm), so a function
+// is inlined with its own small calls already in it. Recursive functions, class
+// bodies and functions that touch fields are never inlined.
+//
+// Which calls are worth it is decided per call site from the callee's size and
+// how often the site runs: by its count in the profile when there is one, or
+// else by how deeply it is nested in loops. Tiny callees are always inlined, and
+// bigger ones only at hot call sites. The code added in all is kept within a
+// budget of half the program's size.
+
+// Inline calls throughout program, guided by profile (NULL or empty: by loop
+// nesting). Sets *inlined to the number of calls replaced. Returns 0 if out of memory
+int inlineCalls(IrProgram *program, const CallProfile *profile, uint32_t *inlined);
+
+#endif // IR_INLINE_H
@@ -0,0 +1,858 @@
+#include "IrPasses.h"
+#include "IrInline.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+const char *const irPassNames[IR_PASS_COUNT] = {"inline", "sccp", "gvn", "licm", "dce"};
+
+// State shared by the passes over one function
+typedef struct {
+    IrProgram *program;
+    IrFunction *function;
+    int failed;                // Out of memory
+} PassContext;
+
+static void passOutOfMemory(PassContext *context) {
+    if (!context->failed) {
+        fprintf(stderr, "Memory allocation failed for the optimizer!\n");
+    }
+    context->failed = 1;
+}
+
+// Whether an instruction computes its value from its operands alone, so a copy
+// elsewhere computes the same
+static int isPure(const IrInstr *instr) {
+    return instr->op != IR_PHI && instr->op != IR_PARAM &&
+           !(irOpcodeInfo[instr->op].flags & (IR_SIDE_EFFECT | IR_READS_MEMORY | IR_TERMINATOR));
+}
+
+// Arithmetic as the VM does it: wrapping around, INT64_MIN / -1 included
+static int64_t wrapAdd(int64_t left, int64_t right) {
+    return (int64_t)((uint64_t)left + (uint64_t)right);
+}
+
+static int64_t wrapSubtract(int64_t left, int64_t right) {
+    return (int64_t)((uint64_t)left - (uint64_t)right);
+}
+
+static int64_t wrapMultiply(int64_t left, int64_t right) {
+    return (int64_t)((uint64_t)left * (uint64_t)right);
+}
+
+// Sparse conditional constant propagation
+
+typedef enum {
+    LATTICE_UNKNOWN,           // Not reached yet: could still be anything
+    LATTICE_CONSTANT,
+    LATTICE_VARYING
+} LatticeState;
+
+typedef struct {
+    uint8_t state;             // LatticeState
+    int64_t value;             // LATTICE_CONSTANT
+} Lattice;
+
+typedef struct {
+    PassContext *context;
+    IrFunction *function;
+    Lattice *lattice;          // By value id
+    uint32_t *userFirst;       // By value id: its users are users[userFirst[id] .. userFirst[id + 1])
+    IrInstr **users;
+    uint8_t *reached;          // By block rpo
+    uint32_t *edgeFirst;       // By block rpo: its incoming edges are edges edgeFirst[rpo] + pred index
+    uint8_t *edgeTaken;
+    IrBlock **blockWork;
+    uint32_t blockDepth;
+    IrInstr **valueWork;
+    uint32_t valueDepth;
+    uint32_t valueCapacity;
+} Sccp;
+
+static void pushValue(Sccp *sccp, IrInstr *instr) {
+    if (sccp->valueDepth == sccp->valueCapacity) {
+        uint32_t grown = sccp->valueCapacity ? sccp->valueCapacity * 2 : 64;
+        IrInstr **work = realloc(sccp->valueWork, grown * sizeof(IrInstr *));
+        if (!work) {
+            passOutOfMemory(sccp->context);
+            return;
+        }
+        sccp->valueWork = work;
+        sccp->valueCapacity = grown;
+    }
+    sccp->valueWork[sccp->valueDepth++] = instr;
+}
+
+// Take the edge from a block to succ (every such edge, should a branch go
+// there both ways)
+static void takeEdge(Sccp *sccp, IrBlock *from, IrBlock *succ) {
+    uint32_t first = sccp->edgeFirst[succ->rpo];
+    int taken = 0;
+    for (uint32_t p = 0; p < succ->predCount; p++) {
+        if (succ->preds[p] == from && !sccp->edgeTaken[first + p]) {
+            sccp->edgeTaken[first + p] = 1;
+            taken = 1;
+        }
+    }
+    if (!taken) {
+        return;
+    }
+    if (!sccp->reached[succ->rpo]) {
+        sccp->reached[succ->rpo] = 1;
+        sccp->blockWork[sccp->blockDepth++] = succ;
+        return;
+    }
+    // A new edge into a block already reached only changes its φ nodes
+    for (IrInstr *phi = succ->first; phi && phi->op == IR_PHI; phi = phi->next) {
+        pushValue(sccp, phi);
+    }
+}
+
+static Lattice meet(Lattice a, Lattice b) {
+    if (a.state == LATTICE_UNKNOWN) {
+        return b;
+    }
+    if (b.state == LATTICE_UNKNOWN) {
+        return a;
+    }
+    if (a.state == LATTICE_CONSTANT && b.state == LATTICE_CONSTANT && a.value == b.value) {
+        return a;
+    }
+    return (Lattice){LATTICE_VARYING, 0};
+}
+
+// What an instruction yields given what its operands are known to be
+static Lattice evaluate(const Sccp *sccp, const IrInstr *instr) {
+    const Lattice varying = {LATTICE_VARYING, 0};
+    if (instr->op == IR_CONST) {
+        return (Lattice){LATTICE_CONSTANT, instr->number};
+    }
+    if (instr->op == IR_PHI) {
+        Lattice result = {LATTICE_UNKNOWN, 0};
+        uint32_t first = sccp->edgeFirst[instr->block->rpo];
+        for (uint32_t i = 0; i < instr->operandCount; i++) {
+            if (sccp->edgeTaken[first + i]) {
+                result = meet(result, sccp->lattice[instr->operands[i]->id]);
+            }
+        }
+        return result;
+    }
+    switch (instr->op) {
+        case IR_ADD: case IR_SUBTRACT: case IR_MULTIPLY: case IR_DIVIDE:
+        case IR_LESS: case IR_LESS_EQUAL: case IR_EQUAL: case IR_NOT_EQUAL:
+        case IR_NEGATE: case IR_NOT:
+            break;
+        default:
+            return varying;
+    }
+    for (uint32_t i = 0; i < instr->operandCount; i++) {
+        if (sccp->lattice[instr->operands[i]->id].state == LATTICE_VARYING) {
+            return varying;
+        }
+    }
+    for (uint32_t i = 0; i < instr->operandCount; i++) {
+        if (sccp->lattice[instr->operands[i]->id].state == LATTICE_UNKNOWN) {
+            return (Lattice){LATTICE_UNKNOWN, 0};
+        }
+    }
+    int64_t left = sccp->lattice[instr->operands[0]->id].value;
+    int64_t right = instr->operandCount > 1 ? sccp->lattice[instr->operands[1]->id].value : 0;
+    int64_t value;
+    switch (instr->op) {
+        case IR_ADD:        value = wrapAdd(left, right); break;
+        case IR_SUBTRACT:   value = wrapSubtract(left, right); break;
+        case IR_MULTIPLY:   value = wrapMultiply(left, right); break;
+        case IR_DIVIDE:
+            if (right == 0) {
+                return varying;  // Left to fail at run time
+            }
+            value = right == -1 ? wrapSubtract(0, left) : left / right;
+            break;
+        case IR_LESS:       value = left < right; break;
+        case IR_LESS_EQUAL: value = left <= right; break;
+        case IR_EQUAL:      value = left == right; break;
+        case IR_NOT_EQUAL:  value = left != right; break;
+        case IR_NEGATE:     value = wrapSubtract(0, left); break;
+        default:            value = !left; break;
+    }
+    return (Lattice){LATTICE_CONSTANT, value};
+}
+
+static void visitInstr(Sccp *sccp, IrInstr *instr) {
+    IrBlock *block = instr->block;
+    if (instr->op == IR_JUMP) {
+        takeEdge(sccp, block, block->succs[0]);
+        return;
+    }
+    if (instr->op == IR_BRANCH) {
+        Lattice condition = sccp->lattice[instr->operands[0]->id];
+        if (condition.state == LATTICE_CONSTANT) {
+            takeEdge(sccp, block, block->succs[condition.value ? 0 : 1]);
+        } else if (condition.state == LATTICE_VARYING) {
+            takeEdge(sccp, block, block->succs[0]);
+            takeEdge(sccp, block, block->succs[1]);
+        }
+        return;
+    }
+    if (instr->type == IR_TYPE_VOID) {
+        return;
+    }
+    Lattice old = sccp->lattice[instr->id];
+    Lattice result = meet(old, evaluate(sccp, instr));
+    if (result.state != old.state) {
+        sccp->lattice[instr->id] = result;
+        for (uint32_t u = sccp->userFirst[instr->id]; u < sccp->userFirst[instr->id + 1]; u++) {
+            pushValue(sccp, sccp->users[u]);
+        }
+    }
+}
+
+// Find every value's users
+static int buildUsers(Sccp *sccp) {
+    IrFunction *function = sccp->function;
+    uint32_t values = function->valueCount;
+    sccp->userFirst = calloc((size_t)values + 1, sizeof(uint32_t));
+    if (!sccp->userFirst) {
+        return 0;
+    }
+    for (uint32_t b = 0; b < function->blockCount; b++) {
+        for (IrInstr *instr = function->blocks[b]->first; instr; instr = instr->next) {
+            for (uint32_t i = 0; i < instr->operandCount; i++) {
+                sccp->userFirst[instr->operands[i]->id + 1]++;
+            }
+        }
+    }
+    for (uint32_t v = 0; v < values; v++) {
+        sccp->userFirst[v + 1] += sccp->userFirst[v];
+    }
+    uint32_t count = sccp->userFirst[values];
+    uint32_t *next = malloc(((size_t)values + 1) * sizeof(uint32_t));
+    sccp->users = malloc((count ? count : 1) * sizeof(IrInstr *));
+    if (!next || !sccp->users) {
+        free(next);
+        return 0;
+    }
+    memcpy(next, sccp->userFirst, ((size_t)values + 1) * sizeof(uint32_t));
+    for (uint32_t b = 0; b < function->blockCount; b++) {
+        for (IrInstr *instr = function->blocks[b]->first; instr; instr = instr->next) {
+            for (uint32_t i = 0; i < instr->operandCount; i++) {
+                sccp->users[next[instr->operands[i]->id]++] = instr;
+            }
+        }
+    }
+    free(next);
+    return 1;
+}
+
+// Replace what was found constant, and turn branches that can only go one way
+// into jumps
+static uint32_t applyConstants(Sccp *sccp) {
+    PassContext *context = sccp->context;
+    IrFunction *function = sccp->function;
+    uint32_t changes = 0;
+    for (uint32_t b = 0; b < function->blockCount; b++) {
+        IrBlock *block = function->blocks[b];
+        if (!sccp->reached[b]) {
+            continue;
+        }
+        IrInstr *next;
+        for (IrInstr *instr = block->first; instr; instr = next) {
+            next = instr->next;
+            Lattice value = sccp->lattice[instr->id];
+            if (instr->op == IR_CONST || instr->type == IR_TYPE_VOID || value.state != LATTICE_CONSTANT) {
+                continue;
+            }
+            IrInstr *constant = irNewInstr(context->program, function, IR_CONST, (IrType)instr->type, value.value,
+                                           instr->location);
+            if (!constant) {
+                passOutOfMemory(context);
+                return changes;
+            }
+            if (instr->op == IR_PHI) {
+                irInsertAfterPhis(block, constant);
+            } else {
+                irInsertBefore(instr, constant);
+            }
+            instr->replacement = constant;
+            irRemove(instr);
+            changes++;
+        }
+        IrInstr *last = block->last;
+        if (last->op != IR_BRANCH) {
+            continue;
+        }
+        Lattice condition = sccp->lattice[last->operands[0]->id];  // Operands are resolved afterwards
+        if (condition.state != LATTICE_CONSTANT || block->succs[0] == block->succs[1]) {
+            continue;
+        }
+        IrBlock *taken = block->succs[condition.value ? 0 : 1];
+        IrBlock *dropped = block->succs[condition.value ? 1 : 0];
+        irRemovePred(dropped, irPredIndex(dropped, block));
+        last->op = IR_JUMP;
+        last->operandCount = 0;
+        block->succs[0] = taken;
+        block->succCount = 1;
+        changes++;
+    }
+    return changes;
+}
+
+static uint32_t runSccp(PassContext *context, IrFunction *function) {
+    Sccp sccp;
+    memset(&sccp, 0, sizeof(sccp));
+    sccp.context = context;
+    sccp.function = function;
+    uint32_t blocks = function->blockCount;
+    uint32_t edges = 0;
+    sccp.lattice = calloc(function->valueCount ? function->valueCount : 1, sizeof(Lattice));
+    sccp.reached = calloc(blocks, 1);
+    sccp.edgeFirst = malloc((size_t)blocks * sizeof(uint32_t));
+    sccp.blockWork = malloc((size_t)blocks * sizeof(IrBlock *));
+    uint32_t changes = 0;
+    if (sccp.edgeFirst) {
+        for (uint32_t b = 0; b < blocks; b++) {
+            sccp.edgeFirst[b] = edges;
+            edges += function->blocks[b]->predCount;
+        }
+    }
+    sccp.edgeTaken = calloc(edges ? edges : 1, 1);
+    if (!sccp.lattice || !sccp.reached || !sccp.edgeFirst || !sccp.blockWork || !sccp.edgeTaken ||
+        !buildUsers(&sccp)) {
+        passOutOfMemory(context);
+    } else {
+        sccp.reached[0] = 1;
+        sccp.blockWork[sccp.blockDepth++] = function->blocks[0];
+        while ((sccp.blockDepth > 0 || sccp.valueDepth > 0) && !context->failed) {
+            if (sccp.blockDepth > 0) {
+                IrBlock *block = sccp.blockWork[--sccp.blockDepth];
+                for (IrInstr *instr = block->first; instr; instr = instr->next) {
+                    visitInstr(&sccp, instr);
+                }
+            } else {
+                IrInstr *instr = sccp.valueWork[--sccp.valueDepth];
+                if (sccp.reached[instr->block->rpo]) {
+                    visitInstr(&sccp, instr);
+                }
+            }
+        }
+        if (!context->failed) {
+            changes = applyConstants(&sccp);
+            irResolveOperands(function);
+            if (!irComputeDominators(context->program, function)) {
+                passOutOfMemory(context);
+            }
+        }
+    }
+    free(sccp.lattice);
+    free(sccp.reached);
+    free(sccp.edgeFirst);
+    free(sccp.blockWork);
+    free(sccp.edgeTaken);
+    free(sccp.userFirst);
+    free(sccp.users);
+    free(sccp.valueWork);
+    return changes;
+}
+
+// Global value numbering
+
+typedef struct {
+    IrInstr *instr;
+    uint32_t next;             // Next entry of its bucket (UINT32_MAX: none)
+    uint32_t bucket;
+} GvnEntry;
+
+// A block to enter, or to leave (dropping the entries made in it)
+typedef struct {
+    IrBlock *block;
+    uint32_t mark;             // Entries made before it (UINT32_MAX: enter it)
+} GvnStep;
+
+typedef struct {
+    uint32_t *buckets;         // Head entry of each (UINT32_MAX: none)
+    uint32_t mask;
+    GvnEntry *entries;         // A stack: the innermost scope's are on top
+    uint32_t entryCount;
+    uint32_t entryCapacity;
+} GvnTable;
+
+static int isCommutative(IrOpcode op) {
+    return op == IR_ADD || op == IR_MULTIPLY || op == IR_EQUAL || op == IR_NOT_EQUAL;
+}
+
+static uint32_t hashInstr(const IrInstr *instr) {
+    uint64_t hash = 1469598103934665603ull;
+    hash = (hash ^ instr->op) * 1099511628211ull;
+    hash = (hash ^ instr->type) * 1099511628211ull;
+    hash = (hash ^ (uint64_t)instr->number) * 1099511628211ull;
+    if (instr->op == IR_PHI) {
+        hash = (hash ^ instr->block->id) * 1099511628211ull;
+    }
+    for (uint32_t i = 0; i < instr->operandCount; i++) {
+        hash = (hash ^ instr->operands[i]->id) * 1099511628211ull;
+    }
+    return (uint32_t)(hash ^ (hash >> 32));
+}
+
+static int sameComputation(const IrInstr *a, const IrInstr *b) {
+    if (a->op != b->op || a->type != b->type || a->number != b->number || a->operandCount != b->operandCount ||
+        (a->op == IR_PHI && a->block != b->block)) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < a->operandCount; i++) {
+        if (a->operands[i] != b->operands[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// The value a φ always has, NULL if it merges several
+static IrInstr *phiSingleValue(IrInstr *phi) {
+    IrInstr *single = NULL;
+    for (uint32_t i = 0; i < phi->operandCount; i++) {
+        IrInstr *operand = irResolve(phi->operands[i]);
+        if (operand == phi || operand == single) {
+            continue;
+        }
+        if (single) {
+            return NULL;
+        }
+        single = operand;
+    }
+    return single;
+}
+
+// Look instr up; if nothing computes the same yet it is added. Returns the
+// earlier instruction, NULL if there is none (or out of memory)
+static IrInstr *findOrAdd(PassContext *context, GvnTable *table, IrInstr *instr) {
+    uint32_t bucket = hashInstr(instr) & table->mask;
+    for (uint32_t e = table->buckets[bucket]; e != UINT32_MAX; e = table->entries[e].next) {
+        if (sameComputation(table->entries[e].instr, instr)) {
+            return table->entries[e].instr;
+        }
+    }
+    if (table->entryCount == table->entryCapacity) {
+        uint32_t grown = table->entryCapacity ? table->entryCapacity * 2 : 256;
+        GvnEntry *entries = realloc(table->entries, grown * sizeof(GvnEntry));
+        if (!entries) {
+            passOutOfMemory(context);
+            return NULL;
+        }
+        table->entries = entries;
+        table->entryCapacity = grown;
+    }
+    table->entries[table->entryCount] = (GvnEntry){instr, table->buckets[bucket], bucket};
+    table->buckets[bucket] = table->entryCount++;
+    return NULL;
+}
+
+static uint32_t numberBlock(PassContext *context, GvnTable *table, IrBlock *block) {
+    uint32_t changes = 0;
+    IrInstr *next;
+    for (IrInstr *instr = block->first; instr && !context->failed; instr = next) {
+        next = instr->next;
+        for (uint32_t i = 0; i < instr->operandCount; i++) {
+            instr->operands[i] = irResolve(instr->operands[i]);
+        }
+        IrInstr *same = NULL;
+        if (instr->op == IR_PHI) {
+            same = phiSingleValue(instr);
+            if (!same) {
+                same = findOrAdd(context, table, instr);
+            }
+        } else if (isPure(instr) || instr->op == IR_DIVIDE) {
+            // A division that a dominating one already made cannot fail either
+            if (isCommutative((IrOpcode)instr->op) && instr->operands[0]->id > instr->operands[1]->id) {
+                IrInstr *swap = instr->operands[0];
+                instr->operands[0] = instr->operands[1];
+                instr->operands[1] = swap;
+            }
+            same = findOrAdd(context, table, instr);
+        }
+        if (same) {
+            instr->replacement = same;
+            irRemove(instr);
+            changes++;
+        }
+    }
+    return changes;
+}
+
+static uint32_t runGvn(PassContext *context, IrFunction *function) {
+    GvnTable table;
+    memset(&table, 0, sizeof(table));
+    uint32_t size = 16;
+    while (size < function->valueCount * 2) {
+        size *= 2;
+    }
+    table.mask = size - 1;
+    table.buckets = malloc((size_t)size * sizeof(uint32_t));
+    // Every block is entered and left once
+    GvnStep *steps = malloc((size_t)function->blockCount * 2 * sizeof(GvnStep));
+    uint32_t changes = 0;
+    if (!table.buckets || !steps) {
+        passOutOfMemory(context);
+    } else {
+        memset(table.buckets, 0xFF, (size_t)size * sizeof(uint32_t));
+        uint32_t depth = 0;
+        steps[depth++] = (GvnStep){function->blocks[0], UINT32_MAX};
+        while (depth > 0 && !context->failed) {
+            GvnStep step = steps[--depth];
+            if (step.mark != UINT32_MAX) {
+                while (table.entryCount > step.mark) {
+                    const GvnEntry *entry = &table.entries[--table.entryCount];
+                    table.buckets[entry->bucket] = entry->next;
+                }
+                continue;
+            }
+            steps[depth++] = (GvnStep){step.block, table.entryCount};
+            changes += numberBlock(context, &table, step.block);
+            for (IrBlock *child = step.block->domChild; child; child = child->domSibling) {
+                steps[depth++] = (GvnStep){child, UINT32_MAX};
+            }
+        }
+        irResolveOperands(function);
+    }
+    free(table.buckets);
+    free(table.entries);
+    free(steps);
+    return changes;
+}
+
+// Loop-invariant code motion
+
+typedef struct {
+    PassContext *context;
+    IrFunction *function;
+    uint32_t *loop;            // By block rpo: the last loop found to contain it (stamp)
+    IrBlock **work;
+    uint32_t *storedGlobal;    // By slot: the last loop found to store to it (stamp)
+    uint32_t *storedField;
+    uint32_t globalSlots;
+    uint32_t fieldSlots;
+} Licm;
+
+// The block a loop is entered from, if it has one that leads only there
+static IrBlock *preheaderOf(IrBlock *header) {
+    IrBlock *preheader = NULL;
+    for (uint32_t p = 0; p < header->predCount; p++) {
+        IrBlock *pred = header->preds[p];
+        if (irDominates(header, pred)) {
+            continue;  // A back edge
+        }
+        if (preheader) {
+            return NULL;
+        }
+        preheader = pred;
+    }
+    return preheader && preheader->succCount == 1 ? preheader : NULL;
+}
+
+static int isLoopHeader(const IrBlock *block) {
+    for (uint32_t p = 0; p < block->predCount; p++) {
+        if (irDominates(block, block->preds[p])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Give every loop entered by a single edge a block of its own on that edge, for
+// code moved out of the loop
+static int addPreheaders(Licm *licm) {
+    IrFunction *function = licm->function;
+    int added = 0;
+    uint32_t count = function->blockCount;
+    for (uint32_t b = 0; b < count; b++) {
+        IrBlock *header = function->blocks[b];
+        if (!isLoopHeader(header) || preheaderOf(header)) {
+            continue;
+        }
+        IrBlock *entry = NULL;
+        uint32_t entries = 0;
+        for (uint32_t p = 0; p < header->predCount; p++) {
+            if (!irDominates(header, header->preds[p])) {
+                entry = header->preds[p];
+                entries++;
+            }
+        }
+        if (entries != 1 || entry->succs[0] == entry->succs[1]) {
+            continue;
+        }
+        uint32_t succ = entry->succs[0] == header ? 0 : 1;
+        if (!irSplitEdge(licm->context->program, function, entry, succ)) {
+            return 0;
+        }
+        added = 1;
+    }
+    return !added || irComputeDominators(licm->context->program, function);
+}
+
+// Whether instr can be computed before the loop stamped loop, its operands
+// being available there
+static int isInvariant(const Licm *licm, const IrInstr *instr, uint32_t loop, int callsOrStores) {
+    switch (instr->op) {
+        case IR_GET_GLOBAL:
+            if (callsOrStores == 2 || licm->storedGlobal[instr->number] == loop) {
+                return 0;
+            }
+            break;
+        case IR_GET_FIELD:
+            if (callsOrStores == 2 || licm->storedField[instr->number] == loop) {
+                return 0;
+            }
+            break;
+        case IR_DIVIDE: {
+            // Only by a constant that cannot fail
+            const IrInstr *divisor = instr->operands[1];
+            if (divisor->op != IR_CONST || divisor->number == 0) {
+                return 0;
+            }
+            break;
+        }
+        default:
+            if (!isPure(instr)) {
+                return 0;
+            }
+            break;
+    }
+    for (uint32_t i = 0; i < instr->operandCount; i++) {
+        if (licm->loop[instr->operands[i]->block->rpo] == loop) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Move what does not change out of the loop headed by header
+static uint32_t hoistLoop(Licm *licm, IrBlock *header, uint32_t loop) {
+    IrFunction *function = licm->function;
+    IrBlock *preheader = preheaderOf(header);
+    if (!preheader) {
+        return 0;
+    }
+    // The loop's blocks: those that reach a back edge without passing the header
+    uint32_t depth = 0;
+    licm->loop[header->rpo] = loop;
+    for (uint32_t p = 0; p < header->predCount; p++) {
+        IrBlock *latch = header->preds[p];
+        if (irDominates(header, latch) && licm->loop[latch->rpo] != loop) {
+            licm->loop[latch->rpo] = loop;
+            licm->work[depth++] = latch;
+        }
+    }
+    while (depth > 0) {
+        IrBlock *block = licm->work[--depth];
+        for (uint32_t p = 0; p < block->predCount; p++) {
+            IrBlock *pred = block->preds[p];
+            if (licm->loop[pred->rpo] != loop) {
+                licm->loop[pred->rpo] = loop;
+                licm->work[depth++] = pred;
+            }
+        }
+    }
+    // What it writes: 2 if it calls something or makes an object, which may write anything
+    int callsOrStores = 0;
+    for (uint32_t b = header->rpo; b < function->blockCount; b++) {
+        if (licm->loop[b] != loop) {
+            continue;
+        }
+        for (IrInstr *instr = function->blocks[b]->first; instr; instr = instr->next) {
+            if (instr->op == IR_CALL || instr->op == IR_NEW) {
+                callsOrStores = 2;
+            } else if (instr->op == IR_SET_GLOBAL) {
+                licm->storedGlobal[instr->number] = loop;
+            } else if (instr->op == IR_SET_FIELD) {
+                licm->storedField[instr->number] = loop;
+            }
+        }
+    }
+    // In reverse post-order, so an instruction's operands are looked at first
+    uint32_t changes = 0;
+    for (uint32_t b = header->rpo; b < function->blockCount; b++) {
+        if (licm->loop[b] != loop) {
+            continue;
+        }
+        IrInstr *next;
+        for (IrInstr *instr = function->blocks[b]->first; instr; instr = next) {
+            next = instr->next;
+            if (isInvariant(licm, instr, loop, callsOrStores)) {
+                irRemove(instr);
+                irInsertBefore(preheader->last, instr);
+                changes++;
+            }
+        }
+    }
+    return changes;
+}
+
+static uint32_t runLicm(PassContext *context, IrFunction *function) {
+    Licm licm;
+    memset(&licm, 0, sizeof(licm));
+    licm.context = context;
+    licm.function = function;
+    if (!addPreheaders(&licm)) {
+        passOutOfMemory(context);
+        return 0;
+    }
+    for (uint32_t b = 0; b < function->blockCount; b++) {
+        for (IrInstr *instr = function->blocks[b]->first; instr; instr = instr->next) {
+            if ((instr->op == IR_GET_GLOBAL || instr->op == IR_SET_GLOBAL) && instr->number >= licm.globalSlots) {
+                licm.globalSlots = (uint32_t)instr->number + 1;
+            } else if ((instr->op == IR_GET_FIELD || instr->op == IR_SET_FIELD) && instr->number >= licm.fieldSlots) {
+                licm.fieldSlots = (uint32_t)instr->number + 1;
+            }
+        }
+    }
+    uint32_t blocks = function->blockCount;
+    licm.loop = calloc(blocks, sizeof(uint32_t));
+    licm.work = malloc((size_t)blocks * sizeof(IrBlock *));
+    licm.storedGlobal = calloc(licm.globalSlots ? licm.globalSlots : 1, sizeof(uint32_t));
+    licm.storedField = calloc(licm.fieldSlots ? licm.fieldSlots : 1, sizeof(uint32_t));
+    uint32_t changes = 0;
+    if (!licm.loop || !licm.work || !licm.storedGlobal || !licm.storedField) {
+        passOutOfMemory(context);
+    } else {
+        // Inner loops first: a loop's header comes after its enclosing loop's
+        uint32_t stamp = 0;
+        for (uint32_t b = blocks; b-- > 0;) {
+            IrBlock *header = function->blocks[b];
+            if (isLoopHeader(header)) {
+                changes += hoistLoop(&licm, header, ++stamp);
+            }
+        }
+    }
+    free(licm.loop);
+    free(licm.work);
+    free(licm.storedGlobal);
+    free(licm.storedField);
+    return changes;
+}
+
+// Dead code elimination
+
+static uint32_t runDce(PassContext *context, IrFunction *function) {
+    uint8_t *live = calloc(function->valueCount ? function->valueCount : 1, 1);
+    IrInstr **work = malloc((function->valueCount ? function->valueCount : 1) * sizeof(IrInstr *));
+    if (!live || !work) {
+        passOutOfMemory(context);
+        free(live);
+        free(work);
+        return 0;
+    }
+    // Everything that has an effect is needed, and so is what it uses
+    uint32_t depth = 0;
+    for (uint32_t b = 0; b < function->blockCount; b++) {
+        for (IrInstr *instr = function->blocks[b]->first; instr; instr = instr->next) {
+            if (irOpcodeInfo[instr->op].flags & IR_SIDE_EFFECT) {
+                live[instr->id] = 1;
+                work[depth++] = instr;
+            }
+        }
+    }
+    while (depth > 0) {
+        IrInstr *instr = work[--depth];
+        for (uint32_t i = 0; i < instr->operandCount; i++) {
+            IrInstr *operand = instr->operands[i];
+            if (!live[operand->id]) {
+                live[operand->id] = 1;
+                work[depth++] = operand;
+            }
+        }
+    }
+    uint32_t changes = 0;
+    for (uint32_t b = 0; b < function->blockCount; b++) {
+        IrInstr *next;
+        for (IrInstr *instr = function->blocks[b]->first; instr; instr = next) {
+            next = instr->next;
+            if (!live[instr->id]) {
+                irRemove(instr);
+                changes++;
+            }
+        }
+    }
+    free(live);
+    free(work);
+    return changes;
+}
+
+// Pass manager
+
+typedef uint32_t (*PassFunction)(PassContext *context, IrFunction *function);
+
+// Per function (the inliner works on the whole program)
+static const PassFunction passFunctions[IR_PASS_COUNT] = {
+    [IR_PASS_SCCP] = runSccp,
+    [IR_PASS_GVN] = runGvn,
+    [IR_PASS_LICM] = runLicm,
+    [IR_PASS_DCE] = runDce,
+};
+
+static double seconds(void) {
+    struct timespec t;
+    timespec_get(&t, TIME_UTC);
+    return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+void initIrPassManager(IrPassManager *passes) {
+    memset(passes, 0, sizeof(*passes));
+    memset(passes->enabled, 1, sizeof(passes->enabled));
+}
+
+int setIrPass(IrPassManager *passes, const char *name, int enabled) {
+    for (uint32_t p = 0; p < IR_PASS_COUNT; p++) {
+        if (strcmp(irPassNames[p], name) == 0) {
+            passes->enabled[p] = (uint8_t)(enabled != 0);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int runIrPasses(IrPassManager *passes, IrProgram *program, DiagnosticBuffer *diagnostics) {
+    if (passes->enabled[IR_PASS_INLINE]) {
+        double start = seconds();
+        uint32_t inlined;
+        int ok = inlineCalls(program, passes->profile, &inlined);
+        passes->changes[IR_PASS_INLINE] += inlined;
+        passes->seconds[IR_PASS_INLINE] += seconds() - start;
+        if (!ok || program->failed) {
+            return 0;
+        }
+        for (uint32_t f = 0; f < program->functionCount; f++) {
+            if (!irVerify(program, &program->functions[f], diagnostics)) {
+                return 0;
+            }
+        }
+    }
+    PassContext context = {program, NULL, 0};
+    for (uint32_t f = 0; f < program->functionCount; f++) {
+        IrFunction *function = &program->functions[f];
+        context.function = function;
+        for (uint32_t p = 0; p < IR_PASS_COUNT; p++) {
+            if (!passes->enabled[p] || !passFunctions[p]) {
+                continue;
+            }
+            double start = seconds();
+            passes->changes[p] += passFunctions[p](&context, function);
+            passes->seconds[p] += seconds() - start;
+            if (context.failed || program->failed) {
+                return 0;
+            }
+            if (!irVerify(program, function, diagnostics)) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+void printIrPassStats(const IrPassManager *passes, FILE *out) {
+    for (uint32_t p = 0; p < IR_PASS_COUNT; p++) {
+        if (passes->enabled[p]) {
+            fprintf(out, "%s: %.3f ms, %llu changes\n", irPassNames[p], passes->seconds[p] * 1e3,
+                    (unsigned long long)passes->changes[p]);
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef IR_PASSES_H
+#define IR_PASSES_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "Diagnostics.h"
+#include "Ir.h"
+#include "Profile.h"
+
+// Optimization passes
+// The pass manager first inlines small functions into their callers across the
+// whole program (IrInline.h). Each other pass rewrites one function of the IR in
+// place, and the enabled ones run over every function in this order:
+//   sccp  Sparse conditional constant propagation (Wegman and Zadeck): values
+//         are evaluated over the blocks that can run, assuming a φ only sees
+//         the edges that can be taken. Values found constant become constants,
+//         branches on them become jumps, and blocks that cannot run are dropped.
+//   gvn   Global value numbering over the dominator tree: an instruction that
+//         computes what a dominating one already has (same operation on the same
+//         operands, either order for + * == !=) is replaced by it, as are φ nodes
+//         that merge a single value.
+//   licm  Loop-invariant code motion: an instruction of a loop whose operands
+//         come from outside it moves to the block before the loop, innermost
+//         loops first, so it is computed once. Globals and fields are only read
+//         early if the loop neither stores to them nor calls anything.
+//   dce   Dead code elimination: instructions whose values nothing needs go,
+//         keeping everything that prints, stores, calls or may fail.
+// Every function is verified after each pass.
+
+typedef enum {
+    IR_PASS_INLINE,
+    IR_PASS_SCCP,
+    IR_PASS_GVN,
+    IR_PASS_LICM,
+    IR_PASS_DCE,
+    IR_PASS_COUNT
+} IrPassId;
+
+extern const char *const irPassNames[IR_PASS_COUNT];
+
+// Which passes run, and what they did over all runs
+typedef struct {
+    uint8_t enabled[IR_PASS_COUNT];
+    double seconds[IR_PASS_COUNT];
+    uint64_t changes[IR_PASS_COUNT];   // Calls inlined; instructions folded, merged, moved or removed
+    const CallProfile *profile;        // Call-site counts for the inliner (NULL if none)
+} IrPassManager;
+
+// Enable every pass, with no profile
+void initIrPassManager(IrPassManager *passes);
+
+// Enable or disable the pass called name. Returns 0 if there is none
+int setIrPass(IrPassManager *passes, const char *name, int enabled);
+
+// Run the enabled passes over every function of program. Returns 0 if out of
+// memory or a function fails verification (reported to diagnostics)
+int runIrPasses(IrPassManager *passes, IrProgram *program, DiagnosticBuffer *diagnostics);
+
+// Print the time each pass took and how much it changed
+void printIrPassStats(const IrPassManager *passes, FILE *out);
+
+#endif // IR_PASSES_H
@@ -0,0 +1,90 @@
+#include "Profile.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+void initCallProfile(CallProfile *profile) {
+    memset(profile, 0, sizeof(*profile));
+}
+
+void freeCallProfile(CallProfile *profile) {
+    free(profile->sites);
+    initCallProfile(profile);
+}
+
+// Index of the first site at or after offset
+static uint32_t findSite(const CallProfile *profile, uint32_t offset) {
+    uint32_t low = 0;
+    uint32_t high = profile->count;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (profile->sites[middle].offset < offset) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+static int addSiteCount(CallProfile *profile, uint32_t offset, uint64_t calls) {
+    uint32_t index = findSite(profile, offset);
+    if (index == profile->count || profile->sites[index].offset != offset) {
+        if (profile->count == profile->capacity) {
+            uint32_t grown = profile->capacity ? profile->capacity * 2 : 64;
+            CallSiteCount *sites = realloc(profile->sites, grown * sizeof(CallSiteCount));
+            if (!sites) {
+                fprintf(stderr, "Memory allocation failed for the call profile!\n");
+                return 0;
+            }
+            profile->sites = sites;
+            profile->capacity = grown;
+        }
+        memmove(profile->sites + index + 1, profile->sites + index,
+                (profile->count - index) * sizeof(CallSiteCount));
+        profile->sites[index] = (CallSiteCount){offset, 0};
+        profile->count++;
+    }
+    profile->sites[index].count += calls;
+    profile->totalCalls += calls;
+    return 1;
+}
+
+// Offset of a location in its file
+static uint32_t fileOffset(SourceLocation location) {
+    return location - sourceFileStart(sourceFileOf(location));
+}
+
+int addCallCount(CallProfile *profile, SourceLocation location, uint64_t calls) {
+    if (location == NO_LOCATION) {
+        return 1;
+    }
+    return addSiteCount(profile, fileOffset(location), calls);
+}
+
+uint64_t callCountAt(const CallProfile *profile, SourceLocation location) {
+    if (location == NO_LOCATION) {
+        return 0;
+    }
+    uint32_t offset = fileOffset(location);
+    uint32_t index = findSite(profile, offset);
+    return index < profile->count && profile->sites[index].offset == offset ? profile->sites[index].count : 0;
+}
+
+void writeCallProfile(const CallProfile *profile, FILE *out) {
+    for (uint32_t s = 0; s < profile->count; s++) {
+        fprintf(out, "%" PRIu32 " %" PRIu64 "\n", profile->sites[s].offset, profile->sites[s].count);
+    }
+}
+
+int readCallProfile(CallProfile *profile, FILE *in) {
+    uint32_t offset;
+    uint64_t count;
+    int read;
+    while ((read = fscanf(in, "%" SCNu32 " %" SCNu64, &offset, &count)) == 2) {
+        if (!addSiteCount(profile, offset, count)) {
+            return 0;
+        }
+    }
+    return read == EOF && !ferror(in);
+}
@@ -0,0 +1,41 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "SourceManager.h"
+
+// Call-site profile
+// How many times each call site ran, by its character offset in the source. A
+// VM given a profile adds the calls of every run to it, and the inliner reads it
+// to tell hot call sites from cold ones. Sites are kept by offset rather than by
+// location so the counts still apply when the same text is registered again: the
+// next REPL entry, or the script run again with the profile read back from a file.
+
+typedef struct {
+    uint32_t offset;           // Of the call in its file
+    uint64_t count;
+} CallSiteCount;
+
+typedef struct {
+    CallSiteCount *sites;      // Sorted by offset
+    uint32_t count;
+    uint32_t capacity;
+    uint64_t totalCalls;
+} CallProfile;
+
+void initCallProfile(CallProfile *profile);
+void freeCallProfile(CallProfile *profile);
+
+// Add calls to the call site at location. Returns 0 if out of memory
+int addCallCount(CallProfile *profile, SourceLocation location, uint64_t calls);
+
+// Calls counted at the call site at location (0 if none)
+uint64_t callCountAt(const CallProfile *profile, SourceLocation location);
+
+// Write a profile as lines of "offset count"; read such lines, adding them to
+// profile. readCallProfile returns 0 if the text is malformed or out of memory
+void writeCallProfile(const CallProfile *profile, FILE *out);
+int readCallProfile(CallProfile *profile, FILE *in);
+
+#endif // PROFILE_H
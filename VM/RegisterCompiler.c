@@ -0,0 +1,828 @@
+#include "RegisterCompiler.h"
+#include "utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define NO_REGISTER UINT32_MAX
+
+// Code being compiled for one function, class body or the program
+typedef struct {
+    uint32_t function;         // Its VmFunction
+    uint32_t firstTemp;        // First register after the resolver's slots
+    uint32_t temps;            // Temporaries in use
+    uint32_t maxTemps;
+} RegisterFrame;
+
+typedef struct {
+    const Ast *ast;
+    const AstOrder *order;
+    const Resolution *resolution;
+    const TypeCheck *types;
+    Bytecode *bytecode;
+    DiagnosticBuffer *diagnostics;
+    uint32_t *numbers;         // By node: VmFunction of a कर्म, VmClass of a कक्षा
+    uint32_t *jumps;           // By node: forward jump waiting for the node's code to end
+    uint32_t *labels;          // By node: start of a loop's body or test
+    uint32_t *results;         // By node: register holding an expression's value (a चक्र: its end)
+    uint8_t *assigns;          // By node: 1 if its subtree assigns to a variable
+    RegisterFrame *frames;     // Innermost last
+    uint32_t frameCount;
+    uint32_t frameCapacity;
+    uint32_t lastWrite;        // Offset of the last instruction if it wrote a temporary (else UINT32_MAX)
+    SourceLocation runFrom;
+    uint32_t startJump;        // Jump to the first statement to run (UINT32_MAX once placed)
+    uint32_t errorCount;
+    int failed;                // Out of memory
+} RegisterCompiler;
+
+static void reportCompile(RegisterCompiler *compiler, uint32_t node, const char *message) {
+    compiler->errorCount++;
+    addDiagnostic(compiler->diagnostics, DIAGNOSTIC_ERROR, astLocation(compiler->ast, node), 0, NO_SYMBOL, message);
+}
+
+static RegisterFrame *currentFrame(RegisterCompiler *compiler) {
+    return &compiler->frames[compiler->frameCount - 1];
+}
+
+// Append an instruction compiled from node with up to three operands. Returns
+// its offset, UINT32_MAX if out of memory
+static uint32_t emit(RegisterCompiler *compiler, uint32_t node, RegisterOpcode op, uint32_t a, uint32_t b,
+                     uint32_t c) {
+    const uint32_t operands[3] = {a, b, c};
+    uint32_t offset = emitInstruction(compiler->bytecode, op, operands, astLocation(compiler->ast, node));
+    if (offset == UINT32_MAX) {
+        compiler->failed = 1;
+    }
+    compiler->lastWrite = UINT32_MAX;
+    return offset;
+}
+
+static int isTemp(RegisterCompiler *compiler, uint32_t reg) {
+    return reg != NO_REGISTER && reg >= currentFrame(compiler)->firstTemp;
+}
+
+// Append an instruction that writes its result to register a, which may be
+// redirected into a variable afterwards (see moveInto)
+static void emitResult(RegisterCompiler *compiler, uint32_t node, RegisterOpcode op, uint32_t a, uint32_t b,
+                       uint32_t c) {
+    uint32_t offset = emit(compiler, node, op, a, b, c);
+    if (isTemp(compiler, a)) {
+        compiler->lastWrite = offset;
+    }
+}
+
+// Offset of the next instruction, as a jump target: nothing may be redirected
+// across it, since another path reaches it too
+static uint32_t here(RegisterCompiler *compiler) {
+    compiler->lastWrite = UINT32_MAX;
+    return compiler->bytecode->codeCount;
+}
+
+// Point a forward jump at the next instruction
+static void patchHere(RegisterCompiler *compiler, uint32_t jump) {
+    uint32_t target = here(compiler);
+    if (jump != UINT32_MAX) {
+        patchOperand(compiler->bytecode, jump, target);
+    }
+}
+
+static uint32_t allocTemp(RegisterCompiler *compiler) {
+    RegisterFrame *frame = currentFrame(compiler);
+    uint32_t reg = frame->firstTemp + frame->temps++;
+    if (frame->temps > frame->maxTemps) {
+        frame->maxTemps = frame->temps;
+    }
+    return reg;
+}
+
+// Give a temporary back (variables' registers are left alone). Temporaries are
+// freed newest first
+static void freeTemp(RegisterCompiler *compiler, uint32_t reg) {
+    if (isTemp(compiler, reg)) {
+        currentFrame(compiler)->temps--;
+    }
+}
+
+// Copy value into target. If the instruction just emitted computed value into
+// a temporary, it is made to write target instead
+static void moveInto(RegisterCompiler *compiler, uint32_t node, uint32_t target, uint32_t value) {
+    if (value == target) {
+        return;
+    }
+    uint32_t last = compiler->lastWrite;
+    if (last != UINT32_MAX && readOperand(compiler->bytecode->code + last + 1) == value) {
+        patchOperandAt(compiler->bytecode, last, 0, target);
+        compiler->lastWrite = UINT32_MAX;
+        return;
+    }
+    emit(compiler, node, REG_MOVE, target, value, 0);
+}
+
+// Start compiling a function at the next instruction
+static int pushFrame(RegisterCompiler *compiler, uint32_t function, uint32_t firstTemp) {
+    if (compiler->frameCount == compiler->frameCapacity) {
+        uint32_t grown = compiler->frameCapacity ? compiler->frameCapacity * 2 : 16;
+        RegisterFrame *frames = realloc(compiler->frames, grown * sizeof(RegisterFrame));
+        if (!frames) {
+            fprintf(stderr, "Memory allocation failed for the compiler!\n");
+            compiler->failed = 1;
+            return 0;
+        }
+        compiler->frames = frames;
+        compiler->frameCapacity = grown;
+    }
+    compiler->frames[compiler->frameCount++] = (RegisterFrame){function, firstTemp, 0, 0};
+    compiler->bytecode->functions[function].entry = here(compiler);
+    return 1;
+}
+
+// Finish the innermost function with its last instruction (a return, or the
+// program's halt) and record the registers its frame needs
+static void popFrame(RegisterCompiler *compiler, uint32_t node, RegisterOpcode last) {
+    emit(compiler, node, last, 0, 0, 0);
+    const RegisterFrame *frame = currentFrame(compiler);
+    compiler->bytecode->functions[frame->function].frameSize = frame->firstTemp + frame->maxTemps;
+    compiler->frameCount--;
+}
+
+// Register of the variable a declaration declares in the current frame,
+// NO_REGISTER if it is a field or a global seen from a function
+static uint32_t variableRegister(RegisterCompiler *compiler, uint32_t node, uint32_t declaration) {
+    const Resolution *resolution = compiler->resolution;
+    switch (resolution->storage[declaration]) {
+        case STORAGE_GLOBAL:
+            return currentFrame(compiler)->function == 0 ? slotOf(resolution, declaration) : NO_REGISTER;
+        case STORAGE_LOCAL:
+            return slotOf(resolution, declaration);
+        case STORAGE_FIELD:
+            return NO_REGISTER;
+        default:
+            reportCompile(compiler, node, "Cannot compile a use of an unresolved name");
+            return NO_REGISTER;
+    }
+}
+
+// Copy a variable that is not a register into reg, or reg into it
+static void accessVariable(RegisterCompiler *compiler, uint32_t node, uint32_t declaration, uint32_t reg, int store) {
+    uint32_t slot = slotOf(compiler->resolution, declaration);
+    if (compiler->resolution->storage[declaration] == STORAGE_FIELD) {
+        if (store) {
+            emit(compiler, node, REG_SET_FIELD, slot, reg, 0);
+        } else {
+            emitResult(compiler, node, REG_GET_FIELD, reg, slot, 0);
+        }
+    } else if (store) {
+        emit(compiler, node, REG_SET_GLOBAL, slot, reg, 0);
+    } else {
+        emitResult(compiler, node, REG_GET_GLOBAL, reg, slot, 0);
+    }
+}
+
+// Store the value in register value into a variable
+static void storeVariable(RegisterCompiler *compiler, uint32_t node, uint32_t declaration, uint32_t value) {
+    uint32_t reg = variableRegister(compiler, node, declaration);
+    if (reg != NO_REGISTER) {
+        moveInto(compiler, node, reg, value);
+    } else {
+        accessVariable(compiler, node, declaration, value, 1);
+    }
+}
+
+// Whether a variable read by node must be copied before it is used: it is the
+// left operand and the right one assigns, so the variable may change under it
+static int readChangesLater(RegisterCompiler *compiler, uint32_t node) {
+    const AstNode *p = &compiler->ast->nodes[compiler->order->parents[node]];
+    return ((p->kind == AST_BINARY && p->op != OPERATOR_AND) || p->kind == AST_ASSIGN) && p->a == node &&
+           compiler->assigns[p->b];
+}
+
+// Whether node is a small number added or subtracted, which goes into the
+// instruction itself (ADD_INT). Sets value to what is added
+static int immediateOperand(RegisterCompiler *compiler, uint32_t node, int32_t *value) {
+    const AstNode *n = &compiler->ast->nodes[node];
+    const AstNode *p = &compiler->ast->nodes[compiler->order->parents[node]];
+    if (n->kind != AST_NUMBER || p->b != node || (p->kind != AST_BINARY && p->kind != AST_ASSIGN)) {
+        return 0;
+    }
+    int64_t number = astNumberValue(n);
+    if (p->op == OPERATOR_MINUS || p->op == OPERATOR_MINUS_ASSIGN) {
+        number = number == INT64_MIN ? number : -number;
+    } else if (p->op != OPERATOR_PLUS && p->op != OPERATOR_PLUS_ASSIGN) {
+        return 0;
+    }
+    if (number < INT32_MIN || number > INT32_MAX) {
+        return 0;
+    }
+    *value = (int32_t)number;
+    return 1;
+}
+
+// Whether node is a comparison its parent jumps on directly (see branchIfFalse)
+static int isBranchComparison(RegisterCompiler *compiler, uint32_t node) {
+    const AstNode *n = &compiler->ast->nodes[node];
+    const AstNode *p = &compiler->ast->nodes[compiler->order->parents[node]];
+    if (n->kind != AST_BINARY || p->a != node || (p->kind != AST_IF && p->kind != AST_WHILE && p->kind != AST_TERNARY)) {
+        return 0;
+    }
+    return n->op == OPERATOR_LESS || n->op == OPERATOR_LESS_EQUAL || n->op == OPERATOR_GREATER ||
+           n->op == OPERATOR_GREATER_EQUAL || n->op == OPERATOR_EQUAL || n->op == OPERATOR_NOT_EQUAL;
+}
+
+// Jump when the condition at node is असत्य. Returns the jump to patch
+static uint32_t branchIfFalse(RegisterCompiler *compiler, uint32_t node) {
+    const AstNode *n = &compiler->ast->nodes[node];
+    if (!isBranchComparison(compiler, node)) {
+        uint32_t condition = compiler->results[node];
+        freeTemp(compiler, condition);
+        return emit(compiler, node, REG_JUMP_IF_FALSE, condition, 0, 0);
+    }
+    // Jump on the opposite comparison: not (x < y) is y <= x
+    uint32_t left = compiler->results[n->a];
+    uint32_t right = compiler->results[n->b];
+    freeTemp(compiler, right);
+    freeTemp(compiler, left);
+    switch (n->op) {
+        case OPERATOR_LESS:          return emit(compiler, node, REG_JUMP_IF_LESS_EQUAL, right, left, 0);
+        case OPERATOR_LESS_EQUAL:    return emit(compiler, node, REG_JUMP_IF_LESS, right, left, 0);
+        case OPERATOR_GREATER:       return emit(compiler, node, REG_JUMP_IF_LESS_EQUAL, left, right, 0);
+        case OPERATOR_GREATER_EQUAL: return emit(compiler, node, REG_JUMP_IF_LESS, left, right, 0);
+        case OPERATOR_EQUAL:         return emit(compiler, node, REG_JUMP_IF_NOT_EQUAL, left, right, 0);
+        default:                     return emit(compiler, node, REG_JUMP_IF_EQUAL, left, right, 0);
+    }
+}
+
+// Instruction of a binary or compound assignment operator on values of type.
+// Sets swapped if it takes its operands the other way round (x > y is y < x)
+static RegisterOpcode operatorOpcode(uint8_t op, TypeId type, int *swapped) {
+    *swapped = op == OPERATOR_GREATER || op == OPERATOR_GREATER_EQUAL;
+    switch (op) {
+        case OPERATOR_PLUS:
+        case OPERATOR_PLUS_ASSIGN:   return type == TYPE_STRING ? REG_CONCAT : REG_ADD;
+        case OPERATOR_MINUS:
+        case OPERATOR_MINUS_ASSIGN:  return REG_SUBTRACT;
+        case OPERATOR_STAR:
+        case OPERATOR_STAR_ASSIGN:   return REG_MULTIPLY;
+        case OPERATOR_SLASH:
+        case OPERATOR_SLASH_ASSIGN:  return REG_DIVIDE;
+        case OPERATOR_LESS:
+        case OPERATOR_GREATER:       return REG_LESS;
+        case OPERATOR_LESS_EQUAL:
+        case OPERATOR_GREATER_EQUAL: return REG_LESS_EQUAL;
+        case OPERATOR_EQUAL:         return REG_EQUAL;
+        case OPERATOR_NOT_EQUAL:     return REG_NOT_EQUAL;
+        default:                     return REG_OPCODE_COUNT;
+    }
+}
+
+// Number every कर्म and कक्षा in pre-order, the order their code will start in,
+// and make sure nothing in the tree is left that cannot run. Also marks the
+// subtrees that assign
+static int numberDeclarations(RegisterCompiler *compiler) {
+    const Ast *ast = compiler->ast;
+    Bytecode *bytecode = compiler->bytecode;
+    if (addFunction(bytecode, (VmFunction){0, 0, 0, 0, 0}) == UINT32_MAX) {
+        return 0;
+    }
+    for (uint32_t p = 0; p < compiler->order->count; p++) {
+        uint32_t node = compiler->order->preorder[p];
+        const AstNode *n = &ast->nodes[node];
+        uint32_t number = 0;
+        if (n->kind == AST_FUNC_DECL) {
+            number = addFunction(bytecode, (VmFunction){0, ast->nodes[n->b].b, 0, 0, node});
+        } else if (n->kind == AST_CLASS_DECL) {
+            uint32_t init = addFunction(bytecode, (VmFunction){0, 0, 0, 0, node});
+            number = init == UINT32_MAX ? init
+                                        : addClass(bytecode, (VmClass){slotOf(compiler->resolution, node), init, node});
+        } else if (n->kind == AST_ERROR) {
+            reportCompile(compiler, node, "Cannot compile code with syntax errors");
+        } else if ((n->kind == AST_IDENT || n->kind == AST_CALL || (n->kind == AST_VAR_DECL && n->c != 0)) &&
+                   declarationOf(compiler->resolution, node) == 0) {
+            reportCompile(compiler, node, "Cannot compile a use of an unresolved name");
+        } else if (typeOfNode(compiler->types, node) == TYPE_ERROR) {
+            reportCompile(compiler, node, "Cannot compile code with type errors");
+        }
+        if (number == UINT32_MAX) {
+            compiler->failed = 1;
+            return 0;
+        }
+        compiler->numbers[node] = number;
+    }
+    for (uint32_t p = 0; p < compiler->order->count; p++) {
+        uint32_t node = compiler->order->postorder[p];
+        if (ast->nodes[node].kind == AST_ASSIGN) {
+            compiler->assigns[node] = 1;
+        }
+        if (compiler->assigns[node] && node != ast->root) {
+            compiler->assigns[compiler->order->parents[node]] = 1;
+        }
+    }
+    return compiler->errorCount == 0;
+}
+
+// The program starts at the first top-level statement at or after runFrom
+static void startStatement(RegisterCompiler *compiler, uint32_t node) {
+    if (compiler->startJump != UINT32_MAX && compiler->order->parents[node] == compiler->ast->root &&
+        astLocation(compiler->ast, node) >= compiler->runFrom) {
+        patchHere(compiler, compiler->startJump);
+        compiler->startJump = UINT32_MAX;
+    }
+}
+
+// Called when any node has been compiled: code that goes between it and the
+// next child of its parent
+static int finishNode(void *context, uint32_t node) {
+    RegisterCompiler *compiler = context;
+    const Ast *ast = compiler->ast;
+    uint32_t parent = compiler->order->parents[node];
+    const AstNode *p = &ast->nodes[parent];
+    uint32_t result = compiler->results[node];
+    switch (p->kind) {
+        case AST_IF:
+            if (node == p->a) {
+                compiler->jumps[parent] = branchIfFalse(compiler, node);
+            } else if (node == p->b && p->c != 0) {
+                uint32_t skipElse = emit(compiler, node, REG_JUMP, 0, 0, 0);
+                patchHere(compiler, compiler->jumps[parent]);
+                compiler->jumps[parent] = skipElse;
+            }
+            break;
+        case AST_TERNARY:
+            // Both branches leave their value in the same register
+            if (node == p->a) {
+                compiler->jumps[parent] = branchIfFalse(compiler, node);
+                compiler->results[parent] = allocTemp(compiler);
+            } else if (node == p->b) {
+                moveInto(compiler, node, compiler->results[parent], result);
+                freeTemp(compiler, result);
+                uint32_t skipElse = emit(compiler, node, REG_JUMP, 0, 0, 0);
+                patchHere(compiler, compiler->jumps[parent]);
+                compiler->jumps[parent] = skipElse;
+            }
+            break;
+        case AST_BINARY:
+            if (p->op == OPERATOR_AND && node == p->a) {
+                // The left operand's register becomes the result, if it is a temporary
+                if (!isTemp(compiler, result)) {
+                    uint32_t copy = allocTemp(compiler);
+                    emit(compiler, node, REG_MOVE, copy, result, 0);
+                    result = copy;
+                }
+                compiler->results[parent] = result;
+                compiler->jumps[parent] = emit(compiler, node, REG_JUMP_IF_FALSE, result, 0, 0);
+            }
+            break;
+        case AST_WHILE:
+            if (node == p->a) {
+                compiler->jumps[parent] = branchIfFalse(compiler, node);
+            }
+            break;
+        case AST_LOOP:
+            if (node == p->b) {
+                // Keep the end in a temporary; the test sits after the body
+                if (!isTemp(compiler, result)) {
+                    uint32_t end = allocTemp(compiler);
+                    emit(compiler, node, REG_MOVE, end, result, 0);
+                    result = end;
+                }
+                compiler->results[parent] = result;
+                compiler->jumps[parent] = emit(compiler, parent, REG_JUMP, 0, 0, 0);
+                compiler->labels[parent] = here(compiler);
+            }
+            break;
+        case AST_CALL:
+            // Arguments go to consecutive temporaries, where the callee's frame starts
+            if (!isTemp(compiler, result)) {
+                uint32_t argument = allocTemp(compiler);
+                emit(compiler, node, REG_MOVE, argument, result, 0);
+                compiler->results[node] = argument;
+            }
+            break;
+        case AST_PRINT: {
+            TypeId type = typeOfNode(compiler->types, node);
+            if (type == TYPE_BOOL) {
+                emit(compiler, node, REG_PRINT_BOOL, result, 0, 0);
+            } else if (type == TYPE_CHAR) {
+                emit(compiler, node, REG_PRINT_CHAR, result, 0, 0);
+            } else if (type == TYPE_STRING) {
+                emit(compiler, node, REG_PRINT_STRING, result, 0, 0);
+            } else if (type >= TYPE_BUILTIN_COUNT) {
+                emit(compiler, node, REG_PRINT_OBJECT, result, typeInfo(&compiler->types->table, type)->name, 0);
+            } else {
+                emit(compiler, node, REG_PRINT_INT, result, 0, 0);
+            }
+            freeTemp(compiler, result);
+            break;
+        }
+        default:
+            break;
+    }
+    return !compiler->failed;
+}
+
+// Visitor functions. Each returns 0 to stop the walk once memory ran out
+static int enterProgram(void *context, uint32_t node) {
+    RegisterCompiler *compiler = context;
+    // The globals are the program's registers
+    if (!pushFrame(compiler, 0, slotOf(compiler->resolution, node))) {
+        return 0;
+    }
+    if (compiler->runFrom != NO_LOCATION) {
+        compiler->startJump = emit(compiler, node, REG_JUMP, 0, 0, 0);
+    }
+    return !compiler->failed;
+}
+
+static int enterStatement(void *context, uint32_t node) {
+    startStatement(context, node);
+    return 1;
+}
+
+// A कर्म or कक्षा: its code goes here, behind a jump for the code around it
+static int enterDeclaration(void *context, uint32_t node) {
+    RegisterCompiler *compiler = context;
+    startStatement(compiler, node);
+    compiler->jumps[node] = emit(compiler, node, REG_JUMP, 0, 0, 0);
+    if (compiler->ast->nodes[node].kind == AST_FUNC_DECL) {
+        return pushFrame(compiler, compiler->numbers[node], slotOf(compiler->resolution, node));
+    }
+    // Fields live in the object, so a class body's frame holds only its temporaries
+    return pushFrame(compiler, compiler->bytecode->classes[compiler->numbers[node]].init, 0);
+}
+
+static int enterWhile(void *context, uint32_t node) {
+    RegisterCompiler *compiler = context;
+    startStatement(compiler, node);
+    compiler->labels[node] = here(compiler);
+    return 1;
+}
+
+static int leaveProgram(void *context, uint32_t node) {
+    RegisterCompiler *compiler = context;
+    patchHere(compiler, compiler->startJump);
+    compiler->startJump = UINT32_MAX;
+    popFrame(compiler, node, REG_HALT);
+    compiler->bytecode->globalCount = slotOf(compiler->resolution, node);
+    return !compiler->failed;
+}
+
+static int leaveDeclaration(void *context, uint32_t node) {
+    RegisterCompiler *compiler = context;
+    popFrame(compiler, node, REG_RETURN);
+    patchHere(compiler, compiler->jumps[node]);
+    return finishNode(compiler, node);
+}
+
+static int leaveVariable(void *context, uint32_t node) {
+    RegisterCompiler *compiler = context;
+    const AstNode *n = &compiler->ast->nodes[node];
+    if (compiler->ast->nodes[compiler->order->parents[node]].kind == AST_PARAMS) {
+        return 1;  // Arguments are in place when the function starts
+    }
+    uint32_t value;
+    if (n->b != 0) {
+        value = compiler->results[n->b];
+    } else if (n->c != 0) {
+        // The object is stored only once its class body has run
+        uint32_t class = declarationOf(compiler->resolution, node);
+        value = allocTemp(compiler);
+        emit(compiler, node, REG_NEW, value, compiler->numbers[class], value + 1);
+    } else {
+        value = allocTemp(compiler);
+        emitResult(compiler, node, REG_LOAD_INT, value, 0, 0);
+    }
+    storeVariable(compiler, node, node, value);
+    freeTemp(compiler, value);
+    return finishNode(compiler, node);
+}
+
+static int leaveJump(void *context, uint32_t node) {
+    RegisterCompiler *compiler = context;
+    patchHere(compiler, compiler->jumps[node]);
+    return finishNode(compiler, node);
+}
+
+static int leaveWhile(void *context, uint32_t node) {
+    RegisterCompiler *compiler = context;
+    emit(compiler, node, REG_JUMP, compiler->labels[node], 0, 0);
+    return leaveJump(compiler, node);
+}
+
+// Step the variable, then test it against the end and jump back to the body
+static int leaveLoop(void *context, uint32_t node) {
+    RegisterCompiler *compiler = context;
+    uint32_t variable = compiler->ast->nodes[node].a;
+    uint32_t end = compiler->results[node];
+    uint32_t reg = variableRegister(compiler, node, variable);
+    if (reg != NO_REGISTER) {
+        emit(compiler, node, REG_ADD_INT, reg, reg, 1);
+        patchHere(compiler, compiler->jumps[node]);
+    } else {
+        reg = allocTemp(compiler);
+        accessVariable(compiler, node, variable, reg, 0);
+        emit(compiler, node, REG_ADD_INT, reg, reg, 1);
+        accessVariable(compiler, node, variable, reg, 1);
+        patchHere(compiler, compiler->jumps[node]);
+        accessVariable(compiler, node, variable, reg, 0);
+        freeTemp(compiler, reg);
+    }
+    emit(compiler, node, REG_JUMP_IF_LESS_EQUAL, reg, end, compiler->labels[node]);
+    freeTemp(compiler, end);
+    return finishNode(compiler, node);
+}
+
+static int leavePrint(void *context, uint32_t node) {
+    RegisterCompiler *compiler = context;
+    emit(compiler, node, REG_PRINT_LINE, 0, 0, 0);
+    return finishNode(compiler, node);
+}
+
+static int leaveInput(void *context, uint32_t node) {
+    RegisterCompiler *compiler = context;
+    uint32_t target = compiler->ast->nodes[node].a;
+    uint32_t declaration = declarationOf(compiler->resolution, target);
+    RegisterOpcode op = typeOfNode(compiler->types, target) == TYPE_STRING ? REG_INPUT_STRING : REG_INPUT_INT;
+    uint32_t reg = variableRegister(compiler, node, declaration);
+    if (reg != NO_REGISTER) {
+        emit(compiler, node, op, reg, 0, 0);
+    } else {
+        reg = allocTemp(compiler);
+        emit(compiler, node, op, reg, 0, 0);
+        accessVariable(compiler, node, declaration, reg, 1);
+        freeTemp(compiler, reg);
+    }
+    return finishNode(compiler, node);
+}
+
+static int leaveExpressionStatement(void *context, uint32_t node) {
+    RegisterCompiler *compiler = context;
+    freeTemp(compiler, compiler->results[compiler->ast->nodes[node].a]);
+    return finishNode(compiler, node);
+}
+
+static int leaveIdentifier(void *context, uint32_t node) {
+    RegisterCompiler *compiler = context;
+    uint32_t parent = compiler->order->parents[node];
+    const AstNode *p = &compiler->ast->nodes[parent];
+    // The target of = and प्रवे is only stored to
+    if ((p->kind == AST_ASSIGN && p->a == node && p->op == OPERATOR_ASSIGN) || p->kind == AST_INPUT) {
+        compiler->results[node] = NO_REGISTER;
+        return 1;
+    }
+    uint32_t declaration = declarationOf(compiler->resolution, node);
+    uint32_t reg = variableRegister(compiler, node, declaration);
+    if (reg == NO_REGISTER) {
+        reg = allocTemp(compiler);
+        accessVariable(compiler, node, declaration, reg, 0);
+    } else if (readChangesLater(compiler, node)) {
+        uint32_t copy = allocTemp(compiler);
+        emit(compiler, node, REG_MOVE, copy, reg, 0);
+        reg = copy;
+    }
+    compiler->results[node] = reg;
+    return finishNode(compiler, node);
+}
+
+static int leaveNumber(void *context, uint32_t node) {
+    RegisterCompiler *compiler = context;
+    int64_t value = astNumberValue(&compiler->ast->nodes[node]);
+    int32_t immediate;
+    if (immediateOperand(compiler, node, &immediate)) {
+        compiler->results[node] = NO_REGISTER;  // Its parent adds it itself
+        return finishNode(compiler, node);
+    }
+    uint32_t reg = allocTemp(compiler);
+    if (value >= INT32_MIN && value <= INT32_MAX) {
+        emitResult(compiler, node, REG_LOAD_INT, reg, (uint32_t)(int32_t)value, 0);
+    } else {
+        uint32_t constant = addConstant(compiler->bytecode, (VmValue){.number = value});
+        if (constant == UINT32_MAX) {
+            compiler->failed = 1;
+            return 0;
+        }
+        emitResult(compiler, node, REG_LOAD_CONSTANT, reg, constant, 0);
+    }
+    compiler->results[node] = reg;
+    return finishNode(compiler, node);
+}
+
+static int leaveString(void *context, uint32_t node) {
+    RegisterCompiler *compiler = context;
+    SymbolId text = astSymbol(compiler->ast, compiler->ast->nodes[node].a);
+    uint32_t constant = addConstant(compiler->bytecode, (VmValue){.number = text});
+    if (constant == UINT32_MAX) {
+        compiler->failed = 1;
+        return 0;
+    }
+    uint32_t reg = allocTemp(compiler);
+    emitResult(compiler, node, REG_LOAD_CONSTANT, reg, constant, 0);
+    compiler->results[node] = reg;
+    return finishNode(compiler, node);
+}
+
+// Characters and booleans
+static int leaveLiteral(void *context, uint32_t node) {
+    RegisterCompiler *compiler = context;
+    uint32_t reg = allocTemp(compiler);
+    emitResult(compiler, node, REG_LOAD_INT, reg, compiler->ast->nodes[node].a, 0);
+    compiler->results[node] = reg;
+    return finishNode(compiler, node);
+}
+
+static int leaveUnary(void *context, uint32_t node) {
+    RegisterCompiler *compiler = context;
+    const AstNode *n = &compiler->ast->nodes[node];
+    uint32_t operand = compiler->results[n->a];
+    if (n->op == OPERATOR_NOT || n->op == OPERATOR_MINUS) {
+        freeTemp(compiler, operand);
+        uint32_t reg = allocTemp(compiler);
+        emitResult(compiler, node, n->op == OPERATOR_NOT ? REG_NOT : REG_NEGATE, reg, operand, 0);
+        operand = reg;
+    }
+    compiler->results[node] = operand;
+    return finishNode(compiler, node);
+}
+
+static int leaveBinary(void *context, uint32_t node) {
+    RegisterCompiler *compiler = context;
+    const AstNode *n = &compiler->ast->nodes[node];
+    if (n->op == OPERATOR_AND) {
+        // The right operand's value is the result when the left one is सत्य
+        uint32_t right = compiler->results[n->b];
+        moveInto(compiler, node, compiler->results[node], right);
+        freeTemp(compiler, right);
+        return leaveJump(compiler, node);
+    }
+    if (isBranchComparison(compiler, node)) {
+        compiler->results[node] = NO_REGISTER;  // Its parent jumps on it (branchIfFalse)
+        return finishNode(compiler, node);
+    }
+    uint32_t left = compiler->results[n->a];
+    uint32_t right = compiler->results[n->b];
+    int32_t immediate;
+    freeTemp(compiler, right);
+    freeTemp(compiler, left);
+    uint32_t reg = allocTemp(compiler);
+    if (immediateOperand(compiler, n->b, &immediate)) {
+        emitResult(compiler, node, REG_ADD_INT, reg, left, (uint32_t)immediate);
+    } else {
+        int swapped;
+        RegisterOpcode op = operatorOpcode(n->op, typeOfNode(compiler->types, n->a), &swapped);
+        emitResult(compiler, node, op, reg, swapped ? right : left, swapped ? left : right);
+    }
+    compiler->results[node] = reg;
+    return finishNode(compiler, node);
+}
+
+static int leaveAssignment(void *context, uint32_t node) {
+    RegisterCompiler *compiler = context;
+    const AstNode *n = &compiler->ast->nodes[node];
+    uint32_t declaration = declarationOf(compiler->resolution, n->a);
+    uint32_t reg = variableRegister(compiler, node, declaration);
+    uint32_t value = compiler->results[n->b];
+    uint32_t result;
+    if (n->op == OPERATOR_ASSIGN) {
+        storeVariable(compiler, node, declaration, value);
+        if (reg != NO_REGISTER) {
+            freeTemp(compiler, value);
+            result = reg;
+        } else {
+            result = value;
+        }
+    } else {
+        // The target's current value was read when it was left (a temporary
+        // unless it is the variable's own register)
+        uint32_t current = compiler->results[n->a];
+        uint32_t target = reg != NO_REGISTER ? reg : current;
+        int32_t immediate;
+        if (immediateOperand(compiler, n->b, &immediate)) {
+            emit(compiler, node, REG_ADD_INT, target, current, (uint32_t)immediate);
+        } else {
+            int swapped;
+            RegisterOpcode op = operatorOpcode(n->op, typeOfNode(compiler->types, n->a), &swapped);
+            emit(compiler, node, op, target, current, value);
+        }
+        freeTemp(compiler, value);
+        if (reg != NO_REGISTER) {
+            freeTemp(compiler, current);
+            result = reg;
+        } else {
+            accessVariable(compiler, node, declaration, current, 1);
+            result = current;
+        }
+    }
+    if (compiler->ast->nodes[compiler->order->parents[node]].kind == AST_EXPR_STMT) {
+        freeTemp(compiler, result);
+        result = NO_REGISTER;
+    } else if (!isTemp(compiler, result) && readChangesLater(compiler, node)) {
+        uint32_t copy = allocTemp(compiler);
+        emit(compiler, node, REG_MOVE, copy, result, 0);
+        result = copy;
+    }
+    compiler->results[node] = result;
+    return finishNode(compiler, node);
+}
+
+static int leaveTernary(void *context, uint32_t node) {
+    RegisterCompiler *compiler = context;
+    uint32_t otherwise = compiler->results[compiler->ast->nodes[node].c];
+    moveInto(compiler, node, compiler->results[node], otherwise);
+    freeTemp(compiler, otherwise);
+    return leaveJump(compiler, node);
+}
+
+static int leaveCall(void *context, uint32_t node) {
+    RegisterCompiler *compiler = context;
+    uint32_t function = declarationOf(compiler->resolution, node);
+    uint32_t arguments = compiler->ast->nodes[node].b;
+    RegisterFrame *frame = currentFrame(compiler);
+    uint32_t base = frame->firstTemp + frame->temps - arguments;
+    emit(compiler, node, REG_CALL, compiler->numbers[function], base, 0);
+    frame->temps -= arguments;
+    compiler->results[node] = NO_REGISTER;
+    return finishNode(compiler, node);
+}
+
+static const AstVisitor compileVisitor = {
+    .enter = {
+        [AST_PROGRAM] = enterProgram,
+        [AST_BLOCK] = enterStatement,
+        [AST_VAR_DECL] = enterStatement,
+        [AST_FUNC_DECL] = enterDeclaration,
+        [AST_CLASS_DECL] = enterDeclaration,
+        [AST_IF] = enterStatement,
+        [AST_LOOP] = enterStatement,
+        [AST_WHILE] = enterWhile,
+        [AST_PRINT] = enterStatement,
+        [AST_INPUT] = enterStatement,
+        [AST_EXPR_STMT] = enterStatement,
+    },
+    .leave = {
+        [AST_PROGRAM] = leaveProgram,
+        [AST_BLOCK] = finishNode,
+        [AST_VAR_DECL] = leaveVariable,
+        [AST_FUNC_DECL] = leaveDeclaration,
+        [AST_PARAMS] = finishNode,
+        [AST_CLASS_DECL] = leaveDeclaration,
+        [AST_IF] = leaveJump,
+        [AST_LOOP] = leaveLoop,
+        [AST_WHILE] = leaveWhile,
+        [AST_PRINT] = leavePrint,
+        [AST_INPUT] = leaveInput,
+        [AST_EXPR_STMT] = leaveExpressionStatement,
+        [AST_NUMBER] = leaveNumber,
+        [AST_STRING] = leaveString,
+        [AST_CHAR] = leaveLiteral,
+        [AST_BOOL] = leaveLiteral,
+        [AST_IDENT] = leaveIdentifier,
+        [AST_UNARY] = leaveUnary,
+        [AST_BINARY] = leaveBinary,
+        [AST_ASSIGN] = leaveAssignment,
+        [AST_TERNARY] = leaveTernary,
+        [AST_CALL] = leaveCall,
+    },
+};
+
+// Compile the program at ast->root into register code
+int compileRegisterProgram(const Ast *ast, const AstOrder *order, const Resolution *resolution,
+                           const TypeCheck *types, SourceLocation runFrom, Bytecode *bytecode,
+                           DiagnosticBuffer *diagnostics) {
+    RegisterCompiler compiler;
+    memset(&compiler, 0, sizeof(compiler));
+    compiler.ast = ast;
+    compiler.order = order;
+    compiler.resolution = resolution;
+    compiler.types = types;
+    compiler.bytecode = bytecode;
+    compiler.diagnostics = diagnostics;
+    compiler.runFrom = runFrom;
+    compiler.startJump = UINT32_MAX;
+    compiler.lastWrite = UINT32_MAX;
+    uint32_t slots = ast->nodeCount ? ast->nodeCount : 1;
+    compiler.numbers = calloc(slots, sizeof(uint32_t));
+    compiler.jumps = calloc(slots, sizeof(uint32_t));
+    compiler.labels = calloc(slots, sizeof(uint32_t));
+    compiler.results = calloc(slots, sizeof(uint32_t));
+    compiler.assigns = calloc(slots, sizeof(uint8_t));
+    if (!compiler.numbers || !compiler.jumps || !compiler.labels || !compiler.results || !compiler.assigns) {
+        fprintf(stderr, "Memory allocation failed for the compiler!\n");
+        compiler.failed = 1;
+    }
+
+    initRegisterCode(bytecode);
+    if (ast->root == 0 || ast->nodes[ast->root].kind != AST_PROGRAM) {
+        reportCompile(&compiler, ast->root, "Only a whole program can be compiled");
+    }
+    int ok = !compiler.failed && compiler.errorCount == 0 && numberDeclarations(&compiler) &&
+             visitTree(ast, order, &compileVisitor, &compiler) && !compiler.failed && compiler.errorCount == 0;
+
+    free(compiler.numbers);
+    free(compiler.jumps);
+    free(compiler.labels);
+    free(compiler.results);
+    free(compiler.assigns);
+    free(compiler.frames);
+    if (!ok) {
+        freeBytecode(bytecode);
+    }
+    return ok;
+}
@@ -0,0 +1,34 @@
+#ifndef REGISTER_COMPILER_H
+#define REGISTER_COMPILER_H
+
+#include <stdint.h>
+#include "Ast.h"
+#include "Bytecode.h"
+#include "Diagnostics.h"
+#include "Resolver.h"
+#include "TypeChecker.h"
+#include "Traversal.h"
+
+// Register compiler
+// The alternative backend to compileProgram(): same walk, same numbering of
+// functions and classes, but it emits the register instruction set. A frame's
+// registers are the resolver's slots (the program's are its globals, a
+// function's its locals, parameters first) followed by temporaries for the
+// values expressions work on. Temporaries are handed out like a stack: an
+// expression's result takes the lowest free one once its operands' are given
+// back, so a frame needs only as many as its deepest expression. Operands that
+// are variables in registers are read where they live, and a value computed
+// only to be stored is written straight into its variable, so a = b + c is one
+// instruction. Conditions that compare two values jump on the comparison
+// without making a boolean first.
+//
+// Fields, and globals used inside a function, are not registers of the frame
+// and go through GET / SET instructions.
+
+// Compile the program at ast->root into bytecode in the register instruction
+// set. Same contract as compileProgram()
+int compileRegisterProgram(const Ast *ast, const AstOrder *order, const Resolution *resolution,
+                           const TypeCheck *types, SourceLocation runFrom, Bytecode *bytecode,
+                           DiagnosticBuffer *diagnostics);
+
+#endif // REGISTER_COMPILER_H
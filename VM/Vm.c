@@ -0,0 +1,914 @@
+#include "Vm.h"
+#include "Interner.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wctype.h>
+
+#define DEFAULT_STACK_SIZE (1u << 20)
+#define DEFAULT_FRAME_LIMIT (1u << 16)
+
+// Labels as values are a GNU extension (GCC and Clang)
+#if defined(__GNUC__) && !defined(VM_SWITCH_DISPATCH)
+#define VM_COMPUTED_GOTO 1
+#endif
+
+// Counting dispatches costs an add on every instruction, a fair share of a
+// short one, so it is only built in on request (-DVM_COUNT_INSTRUCTIONS)
+#ifdef VM_COUNT_INSTRUCTIONS
+#define COUNT_DISPATCH() count++
+#else
+#define COUNT_DISPATCH() ((void)0)
+#endif
+
+int initVm(Vm *vm, uint32_t stackSize, uint32_t frameLimit) {
+    memset(vm, 0, sizeof(*vm));
+    vm->stackSize = stackSize ? stackSize : DEFAULT_STACK_SIZE;
+    vm->frameLimit = frameLimit ? frameLimit : DEFAULT_FRAME_LIMIT;
+    vm->stack = malloc((size_t)vm->stackSize * sizeof(VmValue));
+    vm->frames = malloc((size_t)vm->frameLimit * sizeof(VmFrame));
+    vm->input = stdin;
+    vm->output = stdout;
+    if (!vm->stack || !vm->frames) {
+        fprintf(stderr, "Memory allocation failed for the VM!\n");
+        freeVm(vm);
+        return 0;
+    }
+    return 1;
+}
+
+void freeVm(Vm *vm) {
+    while (vm->objects) {
+        VmObject *next = vm->objects->next;
+        free(vm->objects);
+        vm->objects = next;
+    }
+    free(vm->stack);
+    free(vm->frames);
+    free(vm->globals);
+    free(vm->text);
+    memset(vm, 0, sizeof(*vm));
+}
+
+// Make the scratch buffer hold at least length characters and a terminator
+static int reserveText(Vm *vm, size_t length) {
+    if (length < vm->textCapacity) {
+        return 1;
+    }
+    if (length >= UINT32_MAX / 2) {
+        return 0;
+    }
+    uint32_t grown = vm->textCapacity ? vm->textCapacity : 256;
+    while (grown <= length) {
+        grown *= 2;
+    }
+    wchar_t *text = realloc(vm->text, grown * sizeof(wchar_t));
+    if (!text) {
+        fprintf(stderr, "Memory allocation failed for a string!\n");
+        return 0;
+    }
+    vm->text = text;
+    vm->textCapacity = grown;
+    return 1;
+}
+
+// Join two strings into a new symbol (NO_SYMBOL if out of memory)
+static SymbolId concatStrings(Vm *vm, SymbolId left, SymbolId right) {
+    uint32_t leftLength = symbolLength(left);
+    uint32_t rightLength = symbolLength(right);
+    if (!reserveText(vm, (size_t)leftLength + rightLength)) {
+        return NO_SYMBOL;
+    }
+    wmemcpy(vm->text, symbolText(left), leftLength);
+    wmemcpy(vm->text + leftLength, symbolText(right), rightLength);
+    return internSymbol(vm->text, (size_t)leftLength + rightLength);
+}
+
+static VmObject *newObject(Vm *vm, uint32_t class, uint32_t fieldCount) {
+    VmObject *object = calloc(1, sizeof(VmObject) + (size_t)fieldCount * sizeof(VmValue));
+    if (!object) {
+        fprintf(stderr, "Memory allocation failed for an object!\n");
+        return NULL;
+    }
+    object->class = class;
+    object->fieldCount = fieldCount;
+    object->next = vm->objects;
+    vm->objects = object;
+    return object;
+}
+
+// Write wide text as UTF-8 (or whatever the locale's multibyte encoding is)
+static void writeText(FILE *out, const wchar_t *text, size_t length) {
+    char bytes[MB_LEN_MAX];
+    mbstate_t state;
+    memset(&state, 0, sizeof(state));
+    for (size_t i = 0; i < length; i++) {
+        size_t size = wcrtomb(bytes, text[i], &state);
+        if (size == (size_t)-1) {
+            fputc('?', out);
+            memset(&state, 0, sizeof(state));
+        } else {
+            fwrite(bytes, 1, size, out);
+        }
+    }
+}
+
+// Read one line without its line break into vm->text. Returns its length, -1 at
+// the end of the input or if out of memory
+static long readLine(Vm *vm) {
+    fflush(vm->output);
+    char bytes[256];
+    size_t length = 0;
+    mbstate_t state;
+    memset(&state, 0, sizeof(state));
+    int any = 0;
+    while (fgets(bytes, sizeof(bytes), vm->input)) {
+        any = 1;
+        size_t size = strlen(bytes);
+        int done = size > 0 && bytes[size - 1] == '\n';
+        for (size_t i = 0; i < size;) {
+            if (!reserveText(vm, length + 1)) {
+                return -1;
+            }
+            size_t used = mbrtowc(&vm->text[length], bytes + i, size - i, &state);
+            if (used == (size_t)-2) {
+                break;  // A character split across two reads; the rest comes next time
+            }
+            if (used == (size_t)-1) {
+                vm->text[length] = L'?';
+                memset(&state, 0, sizeof(state));
+                used = 1;
+            }
+            i += used ? used : 1;
+            length++;
+        }
+        if (done) {
+            break;
+        }
+    }
+    if (!any) {
+        return -1;
+    }
+    while (length > 0 && (vm->text[length - 1] == L'\n' || vm->text[length - 1] == L'\r')) {
+        length--;
+    }
+    vm->text[length] = L'\0';
+    return (long)length;
+}
+
+// Parse a line as a पूर्ण, in ASCII or Devanagari digits. Returns 0 if it is not one
+static int parseInteger(const wchar_t *text, long length, int64_t *value) {
+    long i = 0;
+    while (i < length && iswspace(text[i])) i++;
+    int negative = i < length && text[i] == L'-';
+    if (i < length && (text[i] == L'-' || text[i] == L'+')) i++;
+    uint64_t magnitude = 0;
+    long digits = 0;
+    for (; i < length; i++, digits++) {
+        wchar_t c = text[i];
+        uint32_t digit;
+        if (c >= L'0' && c <= L'9') {
+            digit = (uint32_t)(c - L'0');
+        } else if (c >= 0x0966 && c <= 0x096F) {
+            digit = (uint32_t)(c - 0x0966);
+        } else {
+            break;
+        }
+        magnitude = magnitude * 10 + digit;  // Wraps around like the language's arithmetic
+    }
+    while (i < length && iswspace(text[i])) i++;
+    if (digits == 0 || i != length) {
+        return 0;
+    }
+    *value = (int64_t)(negative ? 0 - magnitude : magnitude);
+    return 1;
+}
+
+// Report a runtime error at the instruction at offset
+static VmResult runtimeError(const Bytecode *bytecode, uint32_t offset, DiagnosticBuffer *diagnostics,
+                             const char *message) {
+    addDiagnostic(diagnostics, DIAGNOSTIC_ERROR, bytecodeLocation(bytecode, offset), 0, NO_SYMBOL, message);
+    return VM_RUNTIME_ERROR;
+}
+
+// Add the globals a program has and the VM does not yet, set to 0. Returns 0 if
+// out of memory
+static int reserveGlobals(Vm *vm, uint32_t count) {
+    if (count > vm->globalCount) {
+        VmValue *globals = realloc(vm->globals, (size_t)count * sizeof(VmValue));
+        if (!globals) {
+            fprintf(stderr, "Memory allocation failed for globals!\n");
+            return 0;
+        }
+        memset(globals + vm->globalCount, 0, (size_t)(count - vm->globalCount) * sizeof(VmValue));
+        vm->globals = globals;
+        vm->globalCount = count;
+    }
+    return 1;
+}
+
+// Counters for a run: calls made from each code offset, or NULL if the VM
+// keeps no profile. Returns 0 if out of memory
+static int startProfile(const Vm *vm, const Bytecode *bytecode, uint64_t **calls) {
+    *calls = NULL;
+    if (!vm->profile) {
+        return 1;
+    }
+    *calls = calloc(bytecode->codeCount ? bytecode->codeCount : 1, sizeof(uint64_t));
+    if (!*calls) {
+        fprintf(stderr, "Memory allocation failed for the call profile!\n");
+        return 0;
+    }
+    return 1;
+}
+
+// Add a run's calls to the VM's profile by call site, and free the counters.
+// Returns 0 if out of memory
+static int finishProfile(Vm *vm, const Bytecode *bytecode, uint64_t *calls) {
+    int ok = 1;
+    for (uint32_t offset = 0; calls && offset < bytecode->codeCount && ok; offset++) {
+        if (calls[offset] > 0) {
+            ok = addCallCount(vm->profile, bytecodeLocation(bytecode, offset), calls[offset]);
+        }
+    }
+    free(calls);
+    return ok;
+}
+
+// Run a compiled program from its first instruction
+VmResult runBytecode(Vm *vm, const Bytecode *bytecode, DiagnosticBuffer *diagnostics) {
+    vm->instructions = 0;
+    if (!reserveGlobals(vm, bytecode->globalCount)) {
+        return VM_OUT_OF_MEMORY;
+    }
+    const VmFunction *program = &bytecode->functions[0];
+    if ((uint64_t)program->frameSize + program->maxStack > vm->stackSize) {
+        return runtimeError(bytecode, program->entry, diagnostics, "The program needs a bigger stack");
+    }
+    uint64_t *calls;                            // By code offset, if profiled
+    if (!startProfile(vm, bytecode, &calls)) {
+        return VM_OUT_OF_MEMORY;
+    }
+
+    // Hot state, kept in locals
+    const uint8_t *const code = bytecode->code;
+    const VmFunction *const functions = bytecode->functions;
+    const VmValue *const constants = bytecode->constants;
+    VmValue *const globals = vm->globals;
+    const VmValue *const stackEnd = vm->stack + vm->stackSize;
+    const VmFrame *const lastFrame = vm->frames + vm->frameLimit - 1;
+    const uint8_t *ip = code + program->entry;
+    VmValue *locals = vm->stack;
+    VmValue *sp = locals + program->frameSize;  // Next free value
+    VmObject *self = NULL;
+    VmFrame *frame = vm->frames;                // Record of the current function
+    const VmFunction *callee;
+    const uint8_t *at;                          // Instruction being run, for errors
+    uint64_t count = 0;                         // Instructions dispatched, if counted
+    VmResult result;
+
+#define OPERAND() (ip += 4, readOperand(ip - 4))
+#define STOP(value) do { result = (value); goto stop; } while (0)
+#define FAIL(message) STOP(runtimeError(bytecode, (uint32_t)(at - code), diagnostics, message))
+
+#ifdef VM_COMPUTED_GOTO
+    static const void *const dispatch[OP_COUNT] = {
+        [OP_INT] = &&do_OP_INT, [OP_CONSTANT] = &&do_OP_CONSTANT, [OP_POP] = &&do_OP_POP,
+        [OP_DUP] = &&do_OP_DUP, [OP_LOAD_GLOBAL] = &&do_OP_LOAD_GLOBAL,
+        [OP_STORE_GLOBAL] = &&do_OP_STORE_GLOBAL, [OP_LOAD_LOCAL] = &&do_OP_LOAD_LOCAL,
+        [OP_STORE_LOCAL] = &&do_OP_STORE_LOCAL, [OP_LOAD_FIELD] = &&do_OP_LOAD_FIELD,
+        [OP_STORE_FIELD] = &&do_OP_STORE_FIELD, [OP_ADD] = &&do_OP_ADD, [OP_SUBTRACT] = &&do_OP_SUBTRACT,
+        [OP_MULTIPLY] = &&do_OP_MULTIPLY, [OP_DIVIDE] = &&do_OP_DIVIDE, [OP_NEGATE] = &&do_OP_NEGATE,
+        [OP_CONCAT] = &&do_OP_CONCAT, [OP_LESS] = &&do_OP_LESS, [OP_LESS_EQUAL] = &&do_OP_LESS_EQUAL,
+        [OP_GREATER] = &&do_OP_GREATER, [OP_GREATER_EQUAL] = &&do_OP_GREATER_EQUAL,
+        [OP_EQUAL] = &&do_OP_EQUAL, [OP_NOT_EQUAL] = &&do_OP_NOT_EQUAL, [OP_NOT] = &&do_OP_NOT,
+        [OP_JUMP] = &&do_OP_JUMP, [OP_JUMP_IF_FALSE] = &&do_OP_JUMP_IF_FALSE, [OP_AND] = &&do_OP_AND,
+        [OP_CALL] = &&do_OP_CALL, [OP_NEW] = &&do_OP_NEW, [OP_RETURN] = &&do_OP_RETURN,
+        [OP_PRINT_INT] = &&do_OP_PRINT_INT, [OP_PRINT_BOOL] = &&do_OP_PRINT_BOOL,
+        [OP_PRINT_CHAR] = &&do_OP_PRINT_CHAR, [OP_PRINT_STRING] = &&do_OP_PRINT_STRING,
+        [OP_PRINT_OBJECT] = &&do_OP_PRINT_OBJECT, [OP_PRINT_LINE] = &&do_OP_PRINT_LINE,
+        [OP_INPUT_INT] = &&do_OP_INPUT_INT, [OP_INPUT_STRING] = &&do_OP_INPUT_STRING,
+        [OP_HALT] = &&do_OP_HALT,
+    };
+#define CASE(op) do_##op:
+#define NEXT() do { COUNT_DISPATCH(); goto *dispatch[*ip++]; } while (0)
+    NEXT();
+#else
+#define CASE(op) case op:
+#define NEXT() continue
+    for (;;) {
+        COUNT_DISPATCH();
+        switch (*ip++) {
+#endif
+
+    CASE(OP_INT) {
+        sp->number = (int32_t)OPERAND();
+        sp++;
+        NEXT();
+    }
+    CASE(OP_CONSTANT) {
+        *sp++ = constants[OPERAND()];
+        NEXT();
+    }
+    CASE(OP_POP) {
+        sp--;
+        NEXT();
+    }
+    CASE(OP_DUP) {
+        sp[0] = sp[-1];
+        sp++;
+        NEXT();
+    }
+    CASE(OP_LOAD_GLOBAL) {
+        *sp++ = globals[OPERAND()];
+        NEXT();
+    }
+    CASE(OP_STORE_GLOBAL) {
+        globals[OPERAND()] = *--sp;
+        NEXT();
+    }
+    CASE(OP_LOAD_LOCAL) {
+        *sp++ = locals[OPERAND()];
+        NEXT();
+    }
+    CASE(OP_STORE_LOCAL) {
+        locals[OPERAND()] = *--sp;
+        NEXT();
+    }
+    CASE(OP_LOAD_FIELD) {
+        *sp++ = self->fields[OPERAND()];
+        NEXT();
+    }
+    CASE(OP_STORE_FIELD) {
+        self->fields[OPERAND()] = *--sp;
+        NEXT();
+    }
+    CASE(OP_ADD) {
+        sp--;
+        sp[-1].number = (int64_t)((uint64_t)sp[-1].number + (uint64_t)sp[0].number);
+        NEXT();
+    }
+    CASE(OP_SUBTRACT) {
+        sp--;
+        sp[-1].number = (int64_t)((uint64_t)sp[-1].number - (uint64_t)sp[0].number);
+        NEXT();
+    }
+    CASE(OP_MULTIPLY) {
+        sp--;
+        sp[-1].number = (int64_t)((uint64_t)sp[-1].number * (uint64_t)sp[0].number);
+        NEXT();
+    }
+    CASE(OP_DIVIDE) {
+        at = ip - 1;
+        sp--;
+        int64_t divisor = sp[0].number;
+        if (divisor == 0) {
+            FAIL("Division by zero");
+        }
+        // INT64_MIN / -1 overflows; it wraps around like the other operators
+        sp[-1].number = divisor == -1 ? (int64_t)(0 - (uint64_t)sp[-1].number) : sp[-1].number / divisor;
+        NEXT();
+    }
+    CASE(OP_NEGATE) {
+        sp[-1].number = (int64_t)(0 - (uint64_t)sp[-1].number);
+        NEXT();
+    }
+    CASE(OP_CONCAT) {
+        at = ip - 1;
+        sp--;
+        SymbolId joined = concatStrings(vm, (SymbolId)sp[-1].number, (SymbolId)sp[0].number);
+        if (joined == NO_SYMBOL) {
+            STOP(VM_OUT_OF_MEMORY);
+        }
+        sp[-1].number = joined;
+        NEXT();
+    }
+    CASE(OP_LESS) {
+        sp--;
+        sp[-1].number = sp[-1].number < sp[0].number;
+        NEXT();
+    }
+    CASE(OP_LESS_EQUAL) {
+        sp--;
+        sp[-1].number = sp[-1].number <= sp[0].number;
+        NEXT();
+    }
+    CASE(OP_GREATER) {
+        sp--;
+        sp[-1].number = sp[-1].number > sp[0].number;
+        NEXT();
+    }
+    CASE(OP_GREATER_EQUAL) {
+        sp--;
+        sp[-1].number = sp[-1].number >= sp[0].number;
+        NEXT();
+    }
+    CASE(OP_EQUAL) {
+        sp--;
+        sp[-1].number = sp[-1].number == sp[0].number;
+        NEXT();
+    }
+    CASE(OP_NOT_EQUAL) {
+        sp--;
+        sp[-1].number = sp[-1].number != sp[0].number;
+        NEXT();
+    }
+    CASE(OP_NOT) {
+        sp[-1].number = !sp[-1].number;
+        NEXT();
+    }
+    CASE(OP_JUMP) {
+        ip = code + readOperand(ip);
+        NEXT();
+    }
+    CASE(OP_JUMP_IF_FALSE) {
+        uint32_t target = OPERAND();
+        if (!(--sp)->number) {
+            ip = code + target;
+        }
+        NEXT();
+    }
+    CASE(OP_AND) {
+        uint32_t target = OPERAND();
+        if (!sp[-1].number) {
+            ip = code + target;
+        } else {
+            sp--;
+        }
+        NEXT();
+    }
+    CASE(OP_CALL) {
+        at = ip - 1;
+        if (calls) {
+            calls[at - code]++;
+        }
+        callee = &functions[OPERAND()];
+        goto call;
+    }
+    CASE(OP_NEW) {
+        at = ip - 1;
+        const VmClass *class = &bytecode->classes[OPERAND()];
+        VmObject *object = newObject(vm, (uint32_t)(class - bytecode->classes), class->fieldCount);
+        if (!object) {
+            STOP(VM_OUT_OF_MEMORY);
+        }
+        sp->object = object;
+        sp++;
+        callee = &functions[class->init];
+        if (frame == lastFrame || sp + callee->frameSize + callee->maxStack > stackEnd) {
+            FAIL("Too many nested calls");
+        }
+        *frame++ = (VmFrame){ip, locals, self};
+        locals = sp;
+        sp = locals + callee->frameSize;
+        self = object;
+        ip = code + callee->entry;
+        NEXT();
+    }
+    call:
+        // The arguments on the stack become the callee's first locals
+        if (frame == lastFrame || sp - callee->paramCount + callee->frameSize + callee->maxStack > stackEnd) {
+            FAIL("Too many nested calls");
+        }
+        *frame++ = (VmFrame){ip, locals, self};
+        locals = sp - callee->paramCount;
+        sp = locals + callee->frameSize;
+        self = NULL;
+        ip = code + callee->entry;
+        NEXT();
+    CASE(OP_RETURN) {
+        sp = locals;
+        frame--;
+        ip = frame->returnTo;
+        locals = frame->locals;
+        self = frame->self;
+        NEXT();
+    }
+    CASE(OP_PRINT_INT) {
+        fprintf(vm->output, "%lld", (long long)(--sp)->number);
+        NEXT();
+    }
+    CASE(OP_PRINT_BOOL) {
+        fputs((--sp)->number ? "सत्य" : "असत्य", vm->output);
+        NEXT();
+    }
+    CASE(OP_PRINT_CHAR) {
+        wchar_t c = (wchar_t)(--sp)->number;
+        writeText(vm->output, &c, 1);
+        NEXT();
+    }
+    CASE(OP_PRINT_STRING) {
+        SymbolId text = (SymbolId)(--sp)->number;
+        writeText(vm->output, symbolText(text), symbolLength(text));
+        NEXT();
+    }
+    CASE(OP_PRINT_OBJECT) {
+        SymbolId name = OPERAND();
+        sp--;
+        fputc('<', vm->output);
+        writeText(vm->output, symbolText(name), symbolLength(name));
+        fputc('>', vm->output);
+        NEXT();
+    }
+    CASE(OP_PRINT_LINE) {
+        fputc('\n', vm->output);
+        NEXT();
+    }
+    CASE(OP_INPUT_INT) {
+        at = ip - 1;
+        long length = readLine(vm);
+        if (length < 0) {
+            FAIL("No input left for प्रवे");
+        }
+        if (!parseInteger(vm->text, length, &sp->number)) {
+            FAIL("Input for a पूर्ण variable is not a number");
+        }
+        sp++;
+        NEXT();
+    }
+    CASE(OP_INPUT_STRING) {
+        at = ip - 1;
+        long length = readLine(vm);
+        if (length < 0) {
+            FAIL("No input left for प्रवे");
+        }
+        SymbolId text = internSymbol(vm->text, (size_t)length);
+        if (text == NO_SYMBOL) {
+            STOP(VM_OUT_OF_MEMORY);
+        }
+        sp->number = text;
+        sp++;
+        NEXT();
+    }
+    CASE(OP_HALT) {
+        STOP(VM_OK);
+    }
+
+#ifndef VM_COMPUTED_GOTO
+            default:
+                at = ip - 1;
+                FAIL("Invalid instruction");
+        }
+    }
+#endif
+
+stop:
+    vm->instructions = count;
+    if (!finishProfile(vm, bytecode, calls)) {
+        result = VM_OUT_OF_MEMORY;
+    }
+    return result;
+
+#undef OPERAND
+#undef STOP
+#undef FAIL
+#undef CASE
+#undef NEXT
+}
+
+// Run a program in the register instruction set from its first instruction
+VmResult runRegisterCode(Vm *vm, const Bytecode *bytecode, DiagnosticBuffer *diagnostics) {
+    vm->instructions = 0;
+    if (!reserveGlobals(vm, bytecode->globalCount)) {
+        return VM_OUT_OF_MEMORY;
+    }
+    const VmFunction *program = &bytecode->functions[0];
+    if (program->frameSize > vm->stackSize) {
+        return runtimeError(bytecode, program->entry, diagnostics, "The program needs a bigger stack");
+    }
+    uint64_t *calls;                            // By code offset, if profiled
+    if (!startProfile(vm, bytecode, &calls)) {
+        return VM_OUT_OF_MEMORY;
+    }
+    // The program's registers start with the globals; they go back to
+    // vm->globals when the run ends, however it ends
+    if (bytecode->globalCount > 0) {
+        memcpy(vm->stack, vm->globals, (size_t)bytecode->globalCount * sizeof(VmValue));
+    }
+
+    // Hot state, kept in locals
+    const uint8_t *const code = bytecode->code;
+    const VmFunction *const functions = bytecode->functions;
+    const VmValue *const constants = bytecode->constants;
+    VmValue *const globals = vm->stack;
+    const VmValue *const stackEnd = vm->stack + vm->stackSize;
+    const VmFrame *const lastFrame = vm->frames + vm->frameLimit - 1;
+    const uint8_t *ip = code + program->entry;
+    VmValue *regs = vm->stack;                  // Register 0 of the current frame
+    VmObject *self = NULL;
+    VmFrame *frame = vm->frames;                // Record of the current function
+    const VmFunction *callee;
+    VmValue *base;                              // Register 0 of the frame being called
+    const uint8_t *at;                          // Instruction being run, for errors
+    uint64_t count = 0;                         // Instructions dispatched, if counted
+    VmResult result;
+
+#define OPERAND() (ip += 4, readOperand(ip - 4))
+#define STOP(value) do { result = (value); goto stop; } while (0)
+#define FAIL(message) STOP(runtimeError(bytecode, (uint32_t)(at - code), diagnostics, message))
+#define BINARY(expression) do {                                  \
+        VmValue *target = &regs[OPERAND()];                      \
+        int64_t left = regs[OPERAND()].number;                   \
+        int64_t right = regs[OPERAND()].number;                  \
+        target->number = (expression);                           \
+    } while (0)
+#define JUMP_IF(condition) do {                                  \
+        int64_t left = regs[OPERAND()].number;                   \
+        int64_t right = regs[OPERAND()].number;                  \
+        uint32_t target = OPERAND();                             \
+        if (condition) {                                         \
+            ip = code + target;                                  \
+        }                                                        \
+    } while (0)
+
+#ifdef VM_COMPUTED_GOTO
+    static const void *const dispatch[REG_OPCODE_COUNT] = {
+        [REG_MOVE] = &&do_REG_MOVE, [REG_LOAD_INT] = &&do_REG_LOAD_INT,
+        [REG_LOAD_CONSTANT] = &&do_REG_LOAD_CONSTANT, [REG_GET_GLOBAL] = &&do_REG_GET_GLOBAL,
+        [REG_SET_GLOBAL] = &&do_REG_SET_GLOBAL, [REG_GET_FIELD] = &&do_REG_GET_FIELD,
+        [REG_SET_FIELD] = &&do_REG_SET_FIELD, [REG_ADD] = &&do_REG_ADD, [REG_ADD_INT] = &&do_REG_ADD_INT,
+        [REG_SUBTRACT] = &&do_REG_SUBTRACT, [REG_MULTIPLY] = &&do_REG_MULTIPLY,
+        [REG_DIVIDE] = &&do_REG_DIVIDE, [REG_CONCAT] = &&do_REG_CONCAT, [REG_LESS] = &&do_REG_LESS,
+        [REG_LESS_EQUAL] = &&do_REG_LESS_EQUAL, [REG_EQUAL] = &&do_REG_EQUAL,
+        [REG_NOT_EQUAL] = &&do_REG_NOT_EQUAL, [REG_NEGATE] = &&do_REG_NEGATE, [REG_NOT] = &&do_REG_NOT,
+        [REG_JUMP] = &&do_REG_JUMP, [REG_JUMP_IF_FALSE] = &&do_REG_JUMP_IF_FALSE,
+        [REG_JUMP_IF_LESS] = &&do_REG_JUMP_IF_LESS, [REG_JUMP_IF_LESS_EQUAL] = &&do_REG_JUMP_IF_LESS_EQUAL,
+        [REG_JUMP_IF_EQUAL] = &&do_REG_JUMP_IF_EQUAL, [REG_JUMP_IF_NOT_EQUAL] = &&do_REG_JUMP_IF_NOT_EQUAL,
+        [REG_CALL] = &&do_REG_CALL, [REG_NEW] = &&do_REG_NEW, [REG_RETURN] = &&do_REG_RETURN,
+        [REG_PRINT_INT] = &&do_REG_PRINT_INT, [REG_PRINT_BOOL] = &&do_REG_PRINT_BOOL,
+        [REG_PRINT_CHAR] = &&do_REG_PRINT_CHAR, [REG_PRINT_STRING] = &&do_REG_PRINT_STRING,
+        [REG_PRINT_OBJECT] = &&do_REG_PRINT_OBJECT, [REG_PRINT_LINE] = &&do_REG_PRINT_LINE,
+        [REG_INPUT_INT] = &&do_REG_INPUT_INT, [REG_INPUT_STRING] = &&do_REG_INPUT_STRING,
+        [REG_HALT] = &&do_REG_HALT,
+    };
+#define CASE(op) do_##op:
+#define NEXT() do { COUNT_DISPATCH(); goto *dispatch[*ip++]; } while (0)
+    NEXT();
+#else
+#define CASE(op) case op:
+#define NEXT() continue
+    for (;;) {
+        COUNT_DISPATCH();
+        switch (*ip++) {
+#endif
+
+    CASE(REG_MOVE) {
+        VmValue *target = &regs[OPERAND()];
+        *target = regs[OPERAND()];
+        NEXT();
+    }
+    CASE(REG_LOAD_INT) {
+        VmValue *target = &regs[OPERAND()];
+        target->number = (int32_t)OPERAND();
+        NEXT();
+    }
+    CASE(REG_LOAD_CONSTANT) {
+        VmValue *target = &regs[OPERAND()];
+        *target = constants[OPERAND()];
+        NEXT();
+    }
+    CASE(REG_GET_GLOBAL) {
+        VmValue *target = &regs[OPERAND()];
+        *target = globals[OPERAND()];
+        NEXT();
+    }
+    CASE(REG_SET_GLOBAL) {
+        VmValue *target = &globals[OPERAND()];
+        *target = regs[OPERAND()];
+        NEXT();
+    }
+    CASE(REG_GET_FIELD) {
+        VmValue *target = &regs[OPERAND()];
+        *target = self->fields[OPERAND()];
+        NEXT();
+    }
+    CASE(REG_SET_FIELD) {
+        VmValue *target = &self->fields[OPERAND()];
+        *target = regs[OPERAND()];
+        NEXT();
+    }
+    CASE(REG_ADD) {
+        BINARY((int64_t)((uint64_t)left + (uint64_t)right));
+        NEXT();
+    }
+    CASE(REG_ADD_INT) {
+        VmValue *target = &regs[OPERAND()];
+        int64_t left = regs[OPERAND()].number;
+        target->number = (int64_t)((uint64_t)left + (uint64_t)(int64_t)(int32_t)OPERAND());
+        NEXT();
+    }
+    CASE(REG_SUBTRACT) {
+        BINARY((int64_t)((uint64_t)left - (uint64_t)right));
+        NEXT();
+    }
+    CASE(REG_MULTIPLY) {
+        BINARY((int64_t)((uint64_t)left * (uint64_t)right));
+        NEXT();
+    }
+    CASE(REG_DIVIDE) {
+        at = ip - 1;
+        VmValue *target = &regs[OPERAND()];
+        int64_t left = regs[OPERAND()].number;
+        int64_t divisor = regs[OPERAND()].number;
+        if (divisor == 0) {
+            FAIL("Division by zero");
+        }
+        // INT64_MIN / -1 overflows; it wraps around like the other operators
+        target->number = divisor == -1 ? (int64_t)(0 - (uint64_t)left) : left / divisor;
+        NEXT();
+    }
+    CASE(REG_CONCAT) {
+        VmValue *target = &regs[OPERAND()];
+        SymbolId left = (SymbolId)regs[OPERAND()].number;
+        SymbolId right = (SymbolId)regs[OPERAND()].number;
+        SymbolId joined = concatStrings(vm, left, right);
+        if (joined == NO_SYMBOL) {
+            STOP(VM_OUT_OF_MEMORY);
+        }
+        target->number = joined;
+        NEXT();
+    }
+    CASE(REG_LESS) {
+        BINARY(left < right);
+        NEXT();
+    }
+    CASE(REG_LESS_EQUAL) {
+        BINARY(left <= right);
+        NEXT();
+    }
+    CASE(REG_EQUAL) {
+        BINARY(left == right);
+        NEXT();
+    }
+    CASE(REG_NOT_EQUAL) {
+        BINARY(left != right);
+        NEXT();
+    }
+    CASE(REG_NEGATE) {
+        VmValue *target = &regs[OPERAND()];
+        target->number = (int64_t)(0 - (uint64_t)regs[OPERAND()].number);
+        NEXT();
+    }
+    CASE(REG_NOT) {
+        VmValue *target = &regs[OPERAND()];
+        target->number = !regs[OPERAND()].number;
+        NEXT();
+    }
+    CASE(REG_JUMP) {
+        ip = code + readOperand(ip);
+        NEXT();
+    }
+    CASE(REG_JUMP_IF_FALSE) {
+        int64_t value = regs[OPERAND()].number;
+        uint32_t target = OPERAND();
+        if (!value) {
+            ip = code + target;
+        }
+        NEXT();
+    }
+    CASE(REG_JUMP_IF_LESS) {
+        JUMP_IF(left < right);
+        NEXT();
+    }
+    CASE(REG_JUMP_IF_LESS_EQUAL) {
+        JUMP_IF(left <= right);
+        NEXT();
+    }
+    CASE(REG_JUMP_IF_EQUAL) {
+        JUMP_IF(left == right);
+        NEXT();
+    }
+    CASE(REG_JUMP_IF_NOT_EQUAL) {
+        JUMP_IF(left != right);
+        NEXT();
+    }
+    CASE(REG_CALL) {
+        // The arguments are already in the callee's first registers
+        at = ip - 1;
+        if (calls) {
+            calls[at - code]++;
+        }
+        callee = &functions[OPERAND()];
+        base = regs + OPERAND();
+        if (frame == lastFrame || base + callee->frameSize > stackEnd) {
+            FAIL("Too many nested calls");
+        }
+        *frame++ = (VmFrame){ip, regs, self};
+        regs = base;
+        self = NULL;
+        ip = code + callee->entry;
+        NEXT();
+    }
+    CASE(REG_NEW) {
+        at = ip - 1;
+        VmValue *target = &regs[OPERAND()];
+        const VmClass *class = &bytecode->classes[OPERAND()];
+        base = regs + OPERAND();
+        VmObject *object = newObject(vm, (uint32_t)(class - bytecode->classes), class->fieldCount);
+        if (!object) {
+            STOP(VM_OUT_OF_MEMORY);
+        }
+        target->object = object;
+        callee = &functions[class->init];
+        if (frame == lastFrame || base + callee->frameSize > stackEnd) {
+            FAIL("Too many nested calls");
+        }
+        *frame++ = (VmFrame){ip, regs, self};
+        regs = base;
+        self = object;
+        ip = code + callee->entry;
+        NEXT();
+    }
+    CASE(REG_RETURN) {
+        frame--;
+        ip = frame->returnTo;
+        regs = frame->locals;
+        self = frame->self;
+        NEXT();
+    }
+    CASE(REG_PRINT_INT) {
+        fprintf(vm->output, "%lld", (long long)regs[OPERAND()].number);
+        NEXT();
+    }
+    CASE(REG_PRINT_BOOL) {
+        fputs(regs[OPERAND()].number ? "सत्य" : "असत्य", vm->output);
+        NEXT();
+    }
+    CASE(REG_PRINT_CHAR) {
+        wchar_t c = (wchar_t)regs[OPERAND()].number;
+        writeText(vm->output, &c, 1);
+        NEXT();
+    }
+    CASE(REG_PRINT_STRING) {
+        SymbolId text = (SymbolId)regs[OPERAND()].number;
+        writeText(vm->output, symbolText(text), symbolLength(text));
+        NEXT();
+    }
+    CASE(REG_PRINT_OBJECT) {
+        ip += 4;
+        SymbolId name = OPERAND();
+        fputc('<', vm->output);
+        writeText(vm->output, symbolText(name), symbolLength(name));
+        fputc('>', vm->output);
+        NEXT();
+    }
+    CASE(REG_PRINT_LINE) {
+        fputc('\n', vm->output);
+        NEXT();
+    }
+    CASE(REG_INPUT_INT) {
+        at = ip - 1;
+        VmValue *target = &regs[OPERAND()];
+        long length = readLine(vm);
+        if (length < 0) {
+            FAIL("No input left for प्रवे");
+        }
+        if (!parseInteger(vm->text, length, &target->number)) {
+            FAIL("Input for a पूर्ण variable is not a number");
+        }
+        NEXT();
+    }
+    CASE(REG_INPUT_STRING) {
+        at = ip - 1;
+        VmValue *target = &regs[OPERAND()];
+        long length = readLine(vm);
+        if (length < 0) {
+            FAIL("No input left for प्रवे");
+        }
+        SymbolId text = internSymbol(vm->text, (size_t)length);
+        if (text == NO_SYMBOL) {
+            STOP(VM_OUT_OF_MEMORY);
+        }
+        target->number = text;
+        NEXT();
+    }
+    CASE(REG_HALT) {
+        STOP(VM_OK);
+    }
+
+#ifndef VM_COMPUTED_GOTO
+            default:
+                at = ip - 1;
+                FAIL("Invalid instruction");
+        }
+    }
+#endif
+
+stop:
+    vm->instructions = count;
+    if (bytecode->globalCount > 0) {
+        memcpy(vm->globals, vm->stack, (size_t)bytecode->globalCount * sizeof(VmValue));
+    }
+    if (!finishProfile(vm, bytecode, calls)) {
+        result = VM_OUT_OF_MEMORY;
+    }
+    return result;
+
+#undef OPERAND
+#undef STOP
+#undef FAIL
+#undef BINARY
+#undef JUMP_IF
+#undef CASE
+#undef NEXT
+}
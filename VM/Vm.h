@@ -0,0 +1,87 @@
+#ifndef VM_H
+#define VM_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <wchar.h>
+#include "Bytecode.h"
+#include "Diagnostics.h"
+#include "Profile.h"
+
+// Stack virtual machine
+// Runs Bytecode with one value stack that holds every frame's locals followed by
+// the values its expressions are working on: a call leaves its arguments where
+// they are, and they become the callee's first locals. The loop keeps the
+// instruction pointer, the top of the stack and the current frame's locals in
+// local variables, so they can stay in registers; they are written back only
+// for a call or an error. With GCC or Clang each instruction ends by jumping
+// straight to the next one's code through a table of label addresses
+// (computed goto), which gives the branch predictor one indirect jump per
+// opcode instead of one shared switch; other compilers get the switch.
+//
+// runRegisterCode() runs the register instruction set (RegisterCompiler.h) the
+// same way, except that a frame is a window of registers on the same stack: an
+// instruction names the registers it reads and writes, and a call's frame starts
+// at the register holding its first argument. Built with VM_COUNT_INSTRUCTIONS,
+// both loops count the instructions they dispatch, so the two backends can be
+// compared on the same program. A VM given a CallProfile counts the calls each
+// call site makes and adds them to it when a run ends.
+//
+// Objects are allocated when a class-typed variable is declared and freed with
+// the VM. The VM keeps its globals between runs, so a REPL can run one
+// compiled entry after another against the same variables.
+
+// An object of a कक्षा
+typedef struct VmObject {
+    struct VmObject *next;     // Every object of the VM, newest first
+    uint32_t class;            // Its VmClass
+    uint32_t fieldCount;
+    VmValue fields[];
+} VmObject;
+
+// A function that has been called and not returned yet
+typedef struct {
+    const uint8_t *returnTo;   // Caller's next instruction
+    VmValue *locals;           // First local of the function
+    VmObject *self;            // Object a class body is initializing (NULL otherwise)
+} VmFrame;
+
+typedef enum {
+    VM_OK,
+    VM_RUNTIME_ERROR,          // Reported to the diagnostics
+    VM_OUT_OF_MEMORY
+} VmResult;
+
+typedef struct {
+    VmValue *stack;
+    uint32_t stackSize;        // Values
+    VmFrame *frames;
+    uint32_t frameLimit;       // Deepest call nesting
+    VmValue *globals;
+    uint32_t globalCount;
+    VmObject *objects;
+    FILE *input;               // Read by प्रवे (stdin by default)
+    FILE *output;              // Written by लेख (stdout by default)
+    wchar_t *text;             // Scratch buffer for joining strings and reading lines
+    uint32_t textCapacity;
+    uint64_t instructions;     // Instructions the last run dispatched (0 unless VM_COUNT_INSTRUCTIONS)
+    CallProfile *profile;      // Calls of every run are added to it (NULL: not counted)
+} Vm;
+
+// Prepare a VM with room for stackSize values and frameLimit nested calls (0 picks
+// the defaults). Returns 1 on success, 0 if out of memory
+int initVm(Vm *vm, uint32_t stackSize, uint32_t frameLimit);
+
+// Free the VM's stacks, globals and objects
+void freeVm(Vm *vm);
+
+// Run a compiled program from its first instruction. Globals the program has
+// and the VM does not yet are added (set to 0); the others keep their values.
+// A runtime error (division by zero, too deep recursion, unreadable input) is
+// added to diagnostics (may be NULL) at the instruction that failed
+VmResult runBytecode(Vm *vm, const Bytecode *bytecode, DiagnosticBuffer *diagnostics);
+
+// Run a program compiled by compileRegisterProgram(), like runBytecode()
+VmResult runRegisterCode(Vm *vm, const Bytecode *bytecode, DiagnosticBuffer *diagnostics);
+
+#endif // VM_H
@@ -0,0 +1,416 @@
+#define _POSIX_C_SOURCE 200809L
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wchar.h>
+#include "Lexer.h"
+#include "Parser.h"
+#include "Fold.h"
+#include "Resolver.h"
+#include "TypeChecker.h"
+#include "Traversal.h"
+#include "Compiler.h"
+#include "RegisterCompiler.h"
+#include "IrBuilder.h"
+#include "IrPasses.h"
+#include "IrCodegen.h"
+#include "Vm.h"
+
+// Command line options
+typedef struct {
+    int disassemble;           // Print the code instead of running it
+    int registers;             // Use the register backend instead of the stack one
+    int ir;                    // Build register code through the SSA IR
+    int dumpIr;                // Print the IR instead of running it
+    int lazy;                  // Parse only the function bodies that can be called
+    IrPassManager *passes;     // Optimizations run on the IR
+    CallProfile *profile;      // Call-site counts read in or gathered, for the inliner
+    const char *profileOut;    // Where to write the calls of the run (NULL: not counted)
+    int stats;                 // Report the time taken (and instructions run, if counted)
+} RunOptions;
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+// Order, resolve and type check a tree. Returns 1 if it checked; the results
+// then need freeChecks(), otherwise nothing is left to free
+static int checkTree(const Ast *ast, AstOrder *order, Resolution *resolution, TypeCheck *types,
+                     DiagnosticBuffer *diagnostics) {
+    if (!buildAstOrder(ast, ast->root, order)) {
+        return 0;
+    }
+    int ok = resolveNames(ast, order, resolution, diagnostics);
+    if (ok) {
+        ok = checkTypes(ast, order, resolution, types, diagnostics);
+        if (!ok) {
+            freeTypeCheck(types);
+        }
+    }
+    if (!ok) {
+        freeResolution(resolution);
+        freeAstOrder(order);
+    }
+    return ok;
+}
+
+// Release what checkTree() filled in
+static void freeChecks(AstOrder *order, Resolution *resolution, TypeCheck *types) {
+    freeTypeCheck(types);
+    freeResolution(resolution);
+    freeAstOrder(order);
+}
+
+// Lex, parse, resolve, type check, fold and compile a registered file for the
+// chosen backend. The tree is checked as written, so whether it compiles does not
+// depend on what folding cuts off; a folded tree is checked again for the
+// compiler. Code of top-level statements before runFrom is compiled but not run
+// (see compileProgram). Errors go to diagnostics. Returns 1 if it compiled
+static int compileSource(SourceFileId file, SourceLocation runFrom, const RunOptions *options, Bytecode *bytecode,
+                         DiagnosticBuffer *diagnostics) {
+    TokenCollector tokens = tokenizeSourceFile(file);
+    Ast ast;
+    initAst(&ast, tokens.count / 2 + 16);
+    Parser parser;
+    initParser(&parser, &tokens, &ast);
+    parser.diagnostics = diagnostics;
+    parser.lazyBodies = options->lazy;
+    parseProgram(&parser);
+    freeParser(&parser);
+    if (options->lazy) {
+        expandCalledBodies(&ast, &tokens, diagnostics);
+    }
+    freeTokenCollector(&tokens);
+    if (ast.failed || tokens.failed || diagnostics->errorCount > 0) {
+        freeAst(&ast);
+        return 0;
+    }
+
+    AstOrder order;
+    Resolution resolution;
+    TypeCheck types;
+    int ok = checkTree(&ast, &order, &resolution, &types, diagnostics);
+    if (ok && foldConstants(&ast, &order, NULL) > 0) {
+        freeChecks(&order, &resolution, &types);
+        ok = checkTree(&ast, &order, &resolution, &types, diagnostics);
+    }
+    if (ok) {
+        if (options->ir) {
+            IrProgram ir;
+            ok = lowerProgram(&ast, &order, &resolution, &types, runFrom, &ir, diagnostics);
+            if (ok) {
+                ok = runIrPasses(options->passes, &ir, diagnostics);
+                if (ok && options->dumpIr) {
+                    printIrProgram(&ir, stdout);
+                }
+                ok = ok && generateRegisterCode(&ir, bytecode);
+                freeIrProgram(&ir);
+            }
+        } else if (options->registers) {
+            ok = compileRegisterProgram(&ast, &order, &resolution, &types, runFrom, bytecode, diagnostics);
+        } else {
+            ok = compileProgram(&ast, &order, &resolution, &types, runFrom, bytecode, diagnostics);
+        }
+        freeChecks(&order, &resolution, &types);
+    }
+    freeAst(&ast);
+    return ok;
+}
+
+// Run a compiled program on the backend it was compiled for
+static VmResult runProgram(Vm *vm, const Bytecode *bytecode, const RunOptions *options,
+                           DiagnosticBuffer *diagnostics) {
+    double start = now();
+    VmResult result = options->registers ? runRegisterCode(vm, bytecode, diagnostics)
+                                         : runBytecode(vm, bytecode, diagnostics);
+    if (options->stats) {
+        fflush(vm->output);
+        fprintf(stderr, "%s VM: %.3f s", options->registers ? "register" : "stack", now() - start);
+        if (vm->instructions > 0) {
+            fprintf(stderr, ", %llu instructions", (unsigned long long)vm->instructions);
+        }
+        fputc('\n', stderr);
+    }
+    return result;
+}
+
+// Write the call-site counts to a file. Returns 0 if it cannot be written
+static int writeProfile(const CallProfile *profile, const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Error: Unable to open file %s\n", path);
+        return 0;
+    }
+    writeCallProfile(profile, file);
+    return fclose(file) == 0;
+}
+
+// Add the call-site counts of a file to profile. Returns 0 if it cannot be read
+static int readProfile(CallProfile *profile, const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Error: Unable to open file %s\n", path);
+        return 0;
+    }
+    int ok = readCallProfile(profile, file);
+    fclose(file);
+    if (!ok) {
+        fprintf(stderr, "Error: Invalid profile %s\n", path);
+    }
+    return ok;
+}
+
+// Run a script. Returns the process exit status
+static int runFile(const char *path, const RunOptions *options) {
+    SourceFileId file = loadSourceFile(path);
+    if (file == NO_FILE) {
+        return 1;
+    }
+    DiagnosticBuffer diagnostics;
+    initDiagnostics(&diagnostics);
+    Bytecode bytecode;
+    int status = 1;
+    int compiled = compileSource(file, NO_LOCATION, options, &bytecode, &diagnostics);
+    if (compiled && options->ir && options->stats) {
+        printIrPassStats(options->passes, stderr);
+    }
+    if (!compiled) {
+        printDiagnostics(&diagnostics, stderr);
+    } else if (options->disassemble || options->dumpIr) {
+        if (options->disassemble) {
+            disassembleBytecode(&bytecode, stdout);
+        }
+        freeBytecode(&bytecode);
+        status = 0;
+    } else {
+        Vm vm;
+        if (initVm(&vm, 0, 0)) {
+            vm.profile = options->profileOut ? options->profile : NULL;
+            VmResult result = runProgram(&vm, &bytecode, options, &diagnostics);
+            fflush(vm.output);
+            printDiagnostics(&diagnostics, stderr);
+            status = result != VM_OK;
+            freeVm(&vm);
+            if (options->profileOut && !writeProfile(options->profile, options->profileOut)) {
+                status = 1;
+            }
+        }
+        freeBytecode(&bytecode);
+    }
+    freeDiagnostics(&diagnostics);
+    return status;
+}
+
+// Text typed into the REPL
+typedef struct {
+    wchar_t *text;
+    size_t length;
+    size_t capacity;
+} ReplText;
+
+static int appendReplText(ReplText *text, const wchar_t *more, size_t length) {
+    if (text->length + length + 1 > text->capacity) {
+        size_t grown = text->capacity ? text->capacity * 2 : 1024;
+        while (grown < text->length + length + 1) {
+            grown *= 2;
+        }
+        wchar_t *moved = realloc(text->text, grown * sizeof(wchar_t));
+        if (!moved) {
+            fprintf(stderr, "Memory allocation failed for the REPL!\n");
+            return 0;
+        }
+        text->text = moved;
+        text->capacity = grown;
+    }
+    wmemcpy(text->text + text->length, more, length);
+    text->length += length;
+    text->text[text->length] = L'\0';
+    return 1;
+}
+
+// Read one line of input into entry. Returns 0 at the end of the input
+static int readReplLine(ReplText *entry) {
+    char bytes[1024];
+    if (!fgets(bytes, sizeof(bytes), stdin)) {
+        return 0;
+    }
+    wchar_t wide[1024];
+    size_t length = mbstowcs(wide, bytes, sizeof(wide) / sizeof(wide[0]) - 1);
+    if (length == (size_t)-1) {
+        fprintf(stderr, "Error: Invalid multibyte sequence in input\n");
+        return 1;
+    }
+    return appendReplText(entry, wide, length);
+}
+
+// Braces still open in an entry, so a block can be typed over several lines
+static int openBraces(const ReplText *entry) {
+    int depth = 0;
+    int quoted = 0;
+    for (size_t i = 0; i < entry->length; i++) {
+        wchar_t c = entry->text[i];
+        if (c == L'"') {
+            quoted = !quoted;
+        } else if (!quoted && c == L'{') {
+            depth++;
+        } else if (!quoted && c == L'}') {
+            depth--;
+        }
+    }
+    return depth;
+}
+
+// Read-eval-print loop. Every entry is checked and compiled together with the
+// entries before it, so it can use their variables, functions and classes, but
+// only its own statements run; the VM keeps the globals between entries.
+// An entry that does not compile is forgotten
+static int runRepl(const RunOptions *options) {
+    Vm vm;
+    if (!initVm(&vm, 0, 0)) {
+        return 1;
+    }
+    // Entries count their calls, so later entries are inlined by what ran
+    vm.profile = options->ir ? options->profile : NULL;
+    ReplText session = {0};
+    ReplText entry = {0};
+    printf("ShAKti REPL - end with Ctrl-D\n");
+    for (;;) {
+        printf(entry.length ? "... " : ">>> ");
+        fflush(stdout);
+        if (!readReplLine(&entry)) {
+            break;
+        }
+        if (openBraces(&entry) > 0) {
+            continue;
+        }
+
+        // The session so far plus the new entry, as a file of its own
+        wchar_t *text = malloc((session.length + entry.length + 1) * sizeof(wchar_t));
+        if (!text) {
+            fprintf(stderr, "Memory allocation failed for the REPL!\n");
+            break;
+        }
+        wmemcpy(text, session.text ? session.text : L"", session.length);
+        wmemcpy(text + session.length, entry.text, entry.length + 1);
+        SourceFileId file = addSourceBuffer("<repl>", text, session.length + entry.length);
+        if (file == NO_FILE) {
+            break;
+        }
+
+        DiagnosticBuffer diagnostics;
+        initDiagnostics(&diagnostics);
+        Bytecode bytecode;
+        if (compileSource(file, makeLocation(file, (uint32_t)session.length), options, &bytecode, &diagnostics)) {
+            VmResult result = runProgram(&vm, &bytecode, options, &diagnostics);
+            freeBytecode(&bytecode);
+            if (result == VM_OUT_OF_MEMORY || !appendReplText(&session, entry.text, entry.length)) {
+                freeDiagnostics(&diagnostics);
+                break;
+            }
+        }
+        fflush(stdout);
+        printDiagnostics(&diagnostics, stderr);
+        freeDiagnostics(&diagnostics);
+        entry.length = 0;
+    }
+    printf("\n");
+    free(session.text);
+    free(entry.text);
+    freeVm(&vm);
+    return 0;
+}
+
+// Enable just the passes named in a comma-separated list ("none" for no pass).
+// Returns 0 if one is unknown
+static int choosePasses(IrPassManager *passes, const char *list) {
+    for (uint32_t p = 0; p < IR_PASS_COUNT; p++) {
+        setIrPass(passes, irPassNames[p], 0);
+    }
+    if (strcmp(list, "none") == 0) {
+        return 1;
+    }
+    char name[32];
+    while (*list) {
+        size_t length = strcspn(list, ",");
+        if (length >= sizeof(name)) {
+            return 0;
+        }
+        memcpy(name, list, length);
+        name[length] = '\0';
+        if (!setIrPass(passes, name, 1)) {
+            return 0;
+        }
+        list += length + (list[length] == ',');
+    }
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    // Source files and program output are UTF-8
+    if (setlocale(LC_ALL, "C.UTF-8") == NULL) {
+        setlocale(LC_ALL, "");
+    }
+
+    RunOptions options = {0};
+    IrPassManager passes;
+    initIrPassManager(&passes);
+    CallProfile profile;
+    initCallProfile(&profile);
+    passes.profile = &profile;
+    options.passes = &passes;
+    options.profile = &profile;
+    const char *path = NULL;
+    int usage = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--disassemble") == 0) {
+            options.disassemble = 1;
+        } else if (strcmp(argv[i], "--vm=stack") == 0) {
+            options.registers = 0;
+            options.ir = 0;
+        } else if (strcmp(argv[i], "--vm=register") == 0) {
+            options.registers = 1;
+        } else if (strcmp(argv[i], "--ir") == 0) {
+            options.registers = 1;
+            options.ir = 1;
+        } else if (strcmp(argv[i], "--dump-ir") == 0) {
+            options.registers = 1;
+            options.ir = 1;
+            options.dumpIr = 1;
+        } else if (strcmp(argv[i], "--lazy") == 0) {
+            options.lazy = 1;
+        } else if (strncmp(argv[i], "--passes=", 9) == 0) {
+            options.registers = 1;
+            options.ir = 1;
+            usage |= !choosePasses(&passes, argv[i] + 9);
+        } else if (strncmp(argv[i], "--no-", 5) == 0) {
+            options.registers = 1;
+            options.ir = 1;
+            usage |= !setIrPass(&passes, argv[i] + 5, 0);
+        } else if (strncmp(argv[i], "--profile=", 10) == 0) {
+            options.profileOut = argv[i] + 10;
+        } else if (strncmp(argv[i], "--use-profile=", 14) == 0) {
+            usage |= !readProfile(&profile, argv[i] + 14);
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            options.stats = 1;
+        } else if (argv[i][0] != '-' && !path) {
+            path = argv[i];
+        } else {
+            usage = 1;
+        }
+    }
+    if (usage || ((options.disassemble || options.dumpIr) && !path)) {
+        fprintf(stderr,
+                "Usage: %s [--disassemble] [--vm=stack|register] [--ir] [--dump-ir] [--passes=LIST] [--no-PASS]\n"
+                "          [--lazy] [--profile=FILE] [--use-profile=FILE] [--stats] [file]\n",
+                argv[0]);
+        freeCallProfile(&profile);
+        return 1;
+    }
+    int status = path ? runFile(path, &options) : runRepl(&options);
+    freeCallProfile(&profile);
+    return status;
+}
@@ -0,0 +1,58 @@
+#!/bin/sh
+# Differential checks for shakti: every program in VM/tests is run on every
+# backend, with each IR pass alone, with none and with all of them, with lazy
+# parsing and with a call-site profile, and must print exactly its .out file
+# (standard output and errors together) and exit with 1 only if that has an error.
+# A program reads its .in file as input, if there is one.
+#
+# Usage (from the repository root, after make shakti): sh VM/tests/vm_check.sh
+
+SHAKTI=./shakti
+PROFILE=${TMPDIR:-/tmp}/vm_check$$.profile
+ACTUAL=${TMPDIR:-/tmp}/vm_check$$.out
+checks=0
+failures=0
+
+# run NAME OPTIONS...: run $program with OPTIONS and compare with its .out file
+run() {
+    what=$1
+    shift
+    input=/dev/null
+    if [ -f "${program%.sk}.in" ]; then
+        input=${program%.sk}.in
+    fi
+    "$SHAKTI" "$@" "$program" < "$input" > "$ACTUAL" 2>&1
+    status=$?
+    expected=0
+    if grep -q ': error: ' "${program%.sk}.out"; then
+        expected=1
+    fi
+    checks=$((checks + 1))
+    if ! cmp -s "${program%.sk}.out" "$ACTUAL"; then
+        failures=$((failures + 1))
+        echo "FAIL $program ($what): output differs"
+        diff "${program%.sk}.out" "$ACTUAL" | head -n 10
+    elif [ "$status" -ne "$expected" ]; then
+        failures=$((failures + 1))
+        echo "FAIL $program ($what): exit status $status instead of $expected"
+    fi
+}
+
+for program in VM/tests/*.sk; do
+    run stack --vm=stack
+    run register --vm=register
+    run ir --ir
+    run "no passes" --passes=none
+    for pass in inline sccp gvn licm dce; do
+        run "$pass only" --passes=$pass
+        run "all but $pass" --no-$pass
+    done
+    run "lazy stack" --lazy --vm=stack
+    run "lazy ir" --lazy --ir
+    run profiling --vm=stack --profile="$PROFILE"
+    run "ir with profile" --ir --use-profile="$PROFILE"
+done
+rm -f "$PROFILE" "$ACTUAL"
+
+echo "vm_check: $failures of $checks runs failed"
+[ "$failures" -eq 0 ]